@@ -135,7 +135,7 @@ Bias::calcForceAndUpdateBias(const awh_dvec        coordValue,
             state_.doSkippedUpdatesInNeighborhood(params_, grid_);
         }
 
-        convolvedBias = state_.updateProbabilityWeightsAndConvolvedBias(dimParams_, grid_, &probWeightNeighbor);
+        convolvedBias = state_.updateProbabilityWeightsAndConvolvedBias(dimParams_, grid_, &tempKernel_, &probWeightNeighbor);
 
         if (sampleCoord)
         {
@@ -332,6 +332,7 @@ Bias::Bias(int                             biasIndexInCollection,
     biasForce_(ndim()),
     alignedTempWorkSpace_(),
     tempForce_(ndim()),
+    tempKernel_(),
     numWarningsIssued_(0)
 {
     /* For a global update updateList covers all points, so reserve that */
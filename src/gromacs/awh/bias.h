@@ -371,6 +371,7 @@ class Bias
          */
         std::vector < double, AlignedAllocator < double>> alignedTempWorkSpace_; /**< Working vector of doubles. */
         std::vector<double>   tempForce_;                                        /**< Bias force work buffer. */
+        std::vector<double>   tempKernel_;                                       /**< Umbrella potential work buffer. */
 
         /* Run-local counter to avoid flooding log with warnings. */
         int                          numWarningsIssued_; /**< The number of warning issued in the current run. */
@@ -59,6 +59,7 @@
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/utilities.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdtypes/awh-history.h"
 #include "gromacs/mdtypes/awh-params.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -202,44 +203,167 @@ double freeEnergyMinimumValue(gmx::ArrayRef<const PointState> pointState)
     return fMin;
 }
 
+//! The minimum number of points in an update for using multiple threads
+constexpr int c_minNumPointsForThreadedUpdate = 1000;
+
+#if GMX_SIMD_HAVE_DOUBLE
+//! The SIMD type used for computing probability weights
+typedef SimdDouble PackType;
+//! The number of weights in a PackType
+constexpr int      c_packSize = GMX_SIMD_DOUBLE_WIDTH;
+#else
+//! The type used for computing probability weights
+typedef double     PackType;
+//! The number of weights in a PackType
+constexpr int      c_packSize = 1;
+#endif
+
 /*! \brief
- * Find and return the log of the probability weight of a point given a coordinate value.
+ * Compute the umbrella part of the log of the probability weights of points given a coordinate value.
+ *
+ * The harmonic umbrella potential is a sum over the dimensions of terms
+ * that only depend on the index of the point along the grid axis.
+ * We compute these terms once for each axis index present in the list
+ * of points and look them up for each point. This avoids computing
+ * periodic deviations for each point and dimension.
+ *
+ * \param[in]     dimParams     The bias dimensions parameters
+ * \param[in]     grid          The grid.
+ * \param[in]     pointIndices  The points to evaluate the weights for.
+ * \param[in]     value         Coordinate value.
+ * \param[in,out] kernelBuffer  Buffer for the umbrella terms along each axis.
+ * \param[out]    logWeight     The umbrella log weights, size pointIndices.size().
+ */
+void calcUmbrellaLogWeights(const std::vector<DimParams> &dimParams,
+                            const Grid                   &grid,
+                            const std::vector<int>       &pointIndices,
+                            const awh_dvec                value,
+                            std::vector<double>          *kernelBuffer,
+                            double                       *logWeight)
+{
+    const int numDim = dimParams.size();
+
+    if (pointIndices.empty())
+    {
+        return;
+    }
+
+    /* Determine the index range along each axis */
+    awh_ivec  indexMin;
+    awh_ivec  indexMax;
+    for (int d = 0; d < numDim; d++)
+    {
+        indexMin[d] = grid.axis(d).numPoints();
+        indexMax[d] = -1;
+    }
+    for (int pointIndex : pointIndices)
+    {
+        const awh_ivec &index = grid.point(pointIndex).index;
+        for (int d = 0; d < numDim; d++)
+        {
+            indexMin[d] = std::min(indexMin[d], index[d]);
+            indexMax[d] = std::max(indexMax[d], index[d]);
+        }
+    }
+
+    /* Compute the umbrella terms, stored at offset[d] + index */
+    awh_ivec  offset;
+    int       bufferSize = 0;
+    for (int d = 0; d < numDim; d++)
+    {
+        offset[d]   = bufferSize - indexMin[d];
+        bufferSize += indexMax[d] - indexMin[d] + 1;
+    }
+    kernelBuffer->resize(bufferSize);
+    double *kernel = kernelBuffer->data();
+    for (int d = 0; d < numDim; d++)
+    {
+        for (int i = indexMin[d]; i <= indexMax[d]; i++)
+        {
+            double dev            = getDeviationFromAxisIndex(grid.axis(d), i, value[d]);
+            kernel[offset[d] + i] = -0.5*dimParams[d].betak*dev*dev;
+        }
+    }
+
+    for (size_t n = 0; n < pointIndices.size(); n++)
+    {
+        const awh_ivec &index = grid.point(pointIndices[n]).index;
+        double          logW  = 0;
+        for (int d = 0; d < numDim; d++)
+        {
+            logW += kernel[offset[d] + index[d]];
+        }
+        logWeight[n] = logW;
+    }
+}
+
+/*! \brief
+ * Compute the probability weights of points given a coordinate value and return their sum.
  *
  * The unnormalized weight is given by
  * w(point|value) = exp(bias(point) - U(value,point)),
  * where U is a harmonic umbrella potential.
+ * Only points in the target region have non-zero weight.
+ * The exponentials are computed using SIMD when available.
  *
- * \param[in] dimParams     The bias dimensions parameters
- * \param[in] points        The point state.
- * \param[in] grid          The grid.
- * \param[in] pointIndex    Point to evaluate probability weight for.
- * \param[in] pointBias     Bias for the point (as a log weight).
- * \param[in] value         Coordinate value.
- * \returns the log of the biased probability weight.
+ * \param[in]     dimParams     The bias dimensions parameters
+ * \param[in]     points        The point state.
+ * \param[in]     grid          The grid.
+ * \param[in]     pointIndices  The points to evaluate the weights for.
+ * \param[in]     value         Coordinate value.
+ * \param[in]     biasOfPoint   Function returning the bias (as a log weight) given a point index.
+ * \param[in,out] kernelBuffer  Buffer for the umbrella terms along each axis.
+ * \param[out]    weight        The weights, padded with zeros to a multiple of the SIMD width.
+ * \returns the sum of the weights.
  */
-double biasedLogWeightFromPoint(const std::vector<DimParams>  &dimParams,
-                                const std::vector<PointState> &points,
-                                const Grid                    &grid,
-                                int                            pointIndex,
-                                double                         pointBias,
-                                const awh_dvec                 value)
+template<typename BiasOfPoint>
+double calcBiasedWeights(const std::vector<DimParams>                   &dimParams,
+                         const std::vector<PointState>                  &points,
+                         const Grid                                     &grid,
+                         const std::vector<int>                         &pointIndices,
+                         const awh_dvec                                  value,
+                         BiasOfPoint                                     biasOfPoint,
+                         std::vector<double>                            *kernelBuffer,
+                         std::vector < double, AlignedAllocator < double>> *weight)
 {
-    double logWeight = c_largeNegativeExponent;
+    const int numPoints  = pointIndices.size();
 
-    /* Only points in the target reigon have non-zero weight */
-    if (points[pointIndex].inTargetRegion())
-    {
-        logWeight = pointBias;
+    /* Round the size of the weight array up to c_packSize */
+    const int weightSize = ((numPoints + c_packSize - 1)/c_packSize)*c_packSize;
+    weight->resize(weightSize);
 
-        /* Add potential for all parameter dimensions */
-        for (size_t d = 0; d < dimParams.size(); d++)
+    double * gmx_restrict weightData = weight->data();
+
+    calcUmbrellaLogWeights(dimParams, grid, pointIndices, value, kernelBuffer, weightData);
+
+    for (int n = 0; n < numPoints; n++)
+    {
+        const int pointIndex = pointIndices[n];
+        if (points[pointIndex].inTargetRegion())
         {
-            double dev = getDeviationFromPointAlongGridAxis(grid, d, pointIndex, value[d]);
-            logWeight -= 0.5*dimParams[d].betak*dev*dev;
+            weightData[n] += biasOfPoint(pointIndex);
         }
+        else
+        {
+            weightData[n]  = c_largeNegativeExponent;
+        }
+    }
+    for (int n = numPoints; n < weightSize; n++)
+    {
+        /* Pad with values that don't affect the result */
+        weightData[n] = c_largeNegativeExponent;
     }
 
-    return logWeight;
+    PackType weightSumPack(0.0);
+    for (int i = 0; i < weightSize; i += c_packSize)
+    {
+        PackType weightPack = load<PackType>(weightData + i);
+        weightPack          = gmx::exp(weightPack);
+        weightSumPack       = weightSumPack + weightPack;
+        store(weightData + i, weightPack);
+    }
+
+    return reduce(weightSumPack);
 }
 
 }   // namespace
@@ -256,26 +380,36 @@ void BiasState::calcConvolvedPmf(const std::vector<DimParams>  &dimParams,
     std::vector<float> pmf(numPoints);
     getPmf(pmf);
 
-    for (size_t m = 0; m < numPoints; m++)
+    /* The negative PMF is a positive bias. */
+    auto biasOfPoint = [&pmf](int pointIndex) { return -static_cast<double>(pmf[pointIndex]); };
+
+    /* The points are independent, so we can use all threads */
+    const int numThreads = std::max(gmx_omp_nthreads_get(emntDefault), 1);
+#pragma omp parallel num_threads(numThreads)
     {
-        double           freeEnergyWeights = 0;
-        const GridPoint &point             = grid.point(m);
-        for (auto &neighbor : point.neighbor)
+        std::vector<double>                               kernelBuffer;
+        std::vector < double, AlignedAllocator < double>> weight;
+
+#pragma omp for schedule(static)
+        for (int m = 0; m < static_cast<int>(numPoints); m++)
         {
-            /* The negative PMF is a positive bias. */
-            double biasNeighbor = -pmf[neighbor];
-
-            /* Add the convolved PMF weights for the neighbors of this point.
-               Note that this function only adds point within the target > 0 region.
-               Sum weights, take the logarithm last to get the free energy. */
-            double logWeight   = biasedLogWeightFromPoint(dimParams, points_, grid,
-                                                          neighbor, biasNeighbor,
-                                                          point.coordValue);
-            freeEnergyWeights += std::exp(logWeight);
+            try
+            {
+                const GridPoint &point = grid.point(m);
+
+                /* Sum the convolved PMF weights for the neighbors of this point.
+                   Note that only points within the target > 0 region contribute.
+                   Sum weights, take the logarithm last to get the free energy. */
+                double freeEnergyWeights = calcBiasedWeights(dimParams, points_, grid,
+                                                             point.neighbor, point.coordValue,
+                                                             biasOfPoint,
+                                                             &kernelBuffer, &weight);
+
+                GMX_RELEASE_ASSERT(freeEnergyWeights > 0, "Attempting to do log(<= 0) in AWH convolved PMF calculation.");
+                (*convolvedPmf)[m] = -std::log(static_cast<float>(freeEnergyWeights));
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
         }
-
-        GMX_RELEASE_ASSERT(freeEnergyWeights > 0, "Attempting to do log(<= 0) in AWH convolved PMF calculation.");
-        (*convolvedPmf)[m] = -std::log(static_cast<float>(freeEnergyWeights));
     }
 }
 
@@ -1111,19 +1245,31 @@ void BiasState::updateFreeEnergyAndAddSamplesToHistogram(const std::vector<DimPa
     setHistogramUpdateScaleFactors(params, newHistogramSize, histogramSize_.histogramSize(),
                                    &weightHistScalingNew, &logPmfsumScalingNew);
 
+    /* The point updates are independent, so with many points, e.g. for
+     * a global update of a multidimensional grid, we use all threads.
+     */
+    const int numPointsToUpdate = updateList->size();
+    const int numThreads        = (numPointsToUpdate >= c_minNumPointsForThreadedUpdate ?
+                                   std::max(gmx_omp_nthreads_get(emntDefault), 1) : 1);
+
     /* Update free energy and reference weight histogram for points in the update list. */
-    for (int pointIndex : *updateList)
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int i = 0; i < numPointsToUpdate; i++)
     {
-        PointState *pointStateToUpdate = &points_[pointIndex];
-
-        /* Do updates from previous update steps that were skipped because this point was at that time non-local. */
-        if (params.skipUpdates())
+        try
         {
-            pointStateToUpdate->performPreviouslySkippedUpdates(params, histogramSize_.numUpdates(), weightHistScalingSkipped, logPmfsumScalingSkipped);
-        }
+            PointState *pointStateToUpdate = &points_[(*updateList)[i]];
+
+            /* Do updates from previous update steps that were skipped because this point was at that time non-local. */
+            if (params.skipUpdates())
+            {
+                pointStateToUpdate->performPreviouslySkippedUpdates(params, histogramSize_.numUpdates(), weightHistScalingSkipped, logPmfsumScalingSkipped);
+            }
 
-        /* Now do an update with new sampling data. */
-        pointStateToUpdate->updateWithNewSampling(params, histogramSize_.numUpdates(), weightHistScalingNew, logPmfsumScalingNew);
+            /* Now do an update with new sampling data. */
+            pointStateToUpdate->updateWithNewSampling(params, histogramSize_.numUpdates(), weightHistScalingNew, logPmfsumScalingNew);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
     /* Only update the histogram size after we are done with the local point updates */
@@ -1142,9 +1288,10 @@ void BiasState::updateFreeEnergyAndAddSamplesToHistogram(const std::vector<DimPa
 
     /* Update the bias. The bias is updated separately and last since it simply a function of
        the free energy and the target distribution and we want to avoid doing extra work. */
-    for (int pointIndex : *updateList)
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int i = 0; i < numPointsToUpdate; i++)
     {
-        points_[pointIndex].updateBias();
+        points_[(*updateList)[i]].updateBias();
     }
 
     /* Increase the update counter. */
@@ -1153,48 +1300,19 @@ void BiasState::updateFreeEnergyAndAddSamplesToHistogram(const std::vector<DimPa
 
 double BiasState::updateProbabilityWeightsAndConvolvedBias(const std::vector<DimParams>                      &dimParams,
                                                            const Grid                                        &grid,
+                                                           std::vector<double>                               *kernelWorkBuffer,
                                                            std::vector < double, AlignedAllocator < double>> *weight) const
 {
     /* Only neighbors of the current coordinate value will have a non-negligible chance of getting sampled */
     const std::vector<int> &neighbors = grid.point(coordState_.gridpointIndex()).neighbor;
 
-#if GMX_SIMD_HAVE_DOUBLE
-    typedef SimdDouble PackType;
-    constexpr int packSize = GMX_SIMD_DOUBLE_WIDTH;
-#else
-    typedef double PackType;
-    constexpr int packSize = 1;
-#endif
-    /* Round the size of the weight array up to packSize */
-    const int     weightSize = ((neighbors.size() + packSize - 1)/packSize)*packSize;
-    weight->resize(weightSize);
+    auto                    biasOfPoint = [this](int pointIndex) { return points_[pointIndex].bias(); };
 
-    double * gmx_restrict weightData = weight->data();
-    PackType              weightSumPack(0.0);
-    for (size_t i = 0; i < neighbors.size(); i += packSize)
-    {
-        for (size_t n = i; n < i + packSize; n++)
-        {
-            if (n < neighbors.size())
-            {
-                const int neighbor = neighbors[n];
-                (*weight)[n] = biasedLogWeightFromPoint(dimParams, points_, grid,
-                                                        neighbor, points_[neighbor].bias(),
-                                                        coordState_.coordValue());
-            }
-            else
-            {
-                /* Pad with values that don't affect the result */
-                (*weight)[n] = c_largeNegativeExponent;
-            }
-        }
-        PackType weightPack = load<PackType>(weightData + i);
-        weightPack          = gmx::exp(weightPack);
-        weightSumPack       = weightSumPack + weightPack;
-        store(weightData + i, weightPack);
-    }
     /* Sum of probability weights */
-    double weightSum    = reduce(weightSumPack);
+    double weightSum = calcBiasedWeights(dimParams, points_, grid,
+                                         neighbors, coordState_.coordValue(),
+                                         biasOfPoint,
+                                         kernelWorkBuffer, weight);
     GMX_RELEASE_ASSERT(weightSum > 0, "zero probability weight when updating AWH probability weights.");
 
     /* Normalize probabilities to sum to 1 */
@@ -1216,14 +1334,13 @@ double BiasState::calcConvolvedBias(const std::vector<DimParams>  &dimParams,
     const GridPoint &gridPoint  = grid.point(point);
 
     /* Sum the probability weights from the neighborhood of the given point */
-    double weightSum = 0;
-    for (int neighbor : gridPoint.neighbor)
-    {
-        double logWeight = biasedLogWeightFromPoint(dimParams, points_, grid,
-                                                    neighbor, points_[neighbor].bias(),
-                                                    coordValue);
-        weightSum       += std::exp(logWeight);
-    }
+    std::vector<double>                               kernelBuffer;
+    std::vector < double, AlignedAllocator < double>> weight;
+    auto                                              biasOfPoint = [this](int pointIndex) { return points_[pointIndex].bias(); };
+    double                                            weightSum   = calcBiasedWeights(dimParams, points_, grid,
+                                                                                      gridPoint.neighbor, coordValue,
+                                                                                      biasOfPoint,
+                                                                                      &kernelBuffer, &weight);
 
     /* Returns -GMX_FLOAT_MAX if no neighboring points were in the target region. */
     return (weightSum > 0) ? std::log(weightSum) : -GMX_FLOAT_MAX;
@@ -426,14 +426,16 @@ class BiasState
          * it here since this saves us from doing extra exponential function evaluations
          * later on.
          *
-         * \param[in]  dimParams  The bias dimensions parameters
-         * \param[in]  grid       The grid.
-         * \param[out] weight     Probability weights of the neighbors, SIMD aligned.
+         * \param[in]     dimParams         The bias dimensions parameters
+         * \param[in]     grid              The grid.
+         * \param[in,out] kernelWorkBuffer  Work buffer for the umbrella potential along the grid axes.
+         * \param[out]    weight            Probability weights of the neighbors, SIMD aligned.
          * \returns the convolved bias.
          */
 
         double updateProbabilityWeightsAndConvolvedBias(const std::vector<DimParams>                  &dimParams,
                                                         const Grid                                    &grid,
+                                                        std::vector<double>                           *kernelWorkBuffer,
                                                         std::vector < double, AlignedAllocator < double>> *weight) const;
 
         /*! \brief
@@ -202,6 +202,15 @@ double getDeviationFromPointAlongGridAxis(const Grid &grid,
     return getDeviationPeriodic(value, coordValue, grid.axis(dimIndex).period());
 }
 
+double getDeviationFromAxisIndex(const GridAxis &axis,
+                                 int             axisIndex,
+                                 double          value)
+{
+    double coordValue = axis.origin() + axisIndex*axis.spacing();
+
+    return getDeviationPeriodic(value, coordValue, axis.period());
+}
+
 void linearArrayIndexToMultiDim(int indexLinear, int numDimensions, const awh_ivec numPointsDim, awh_ivec indexMulti)
 {
     for (int d = 0; d < numDimensions; d++)
@@ -384,6 +384,22 @@ double getDeviationFromPointAlongGridAxis(const Grid &grid,
                                           int         pointIndex,
                                           double      value);
 
+/*! \brief
+ * Get the deviation from the given value to the point with the given index along a grid axis.
+ *
+ * Gives the same result as getDeviationFromPointAlongGridAxis() for
+ * the points that have index \p axisIndex along the axis, but only
+ * requires the axis.
+ *
+ * \param[in] axis        The grid axis.
+ * \param[in] axisIndex   Point index along the axis, in [0, axis.numPoints() - 1].
+ * \param[in] value       Value along the axis.
+ * \returns the deviation of the given value to the given point.
+ */
+double getDeviationFromAxisIndex(const GridAxis &axis,
+                                 int             axisIndex,
+                                 double          value);
+
 } // namespace gmx
 
 #endif
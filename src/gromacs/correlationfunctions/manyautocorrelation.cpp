@@ -99,7 +99,9 @@ int many_auto_correl(std::vector<std::vector<realA> > *c)
             out.resize(2*nfft, 0);
             for (int i = i0; (i < i1); i++)
             {
-                for (size_t j = 0; j < ndata; j++)
+                /* Copy including the zero padding, since in still holds
+                 * the previous function's spectrum beyond ndata */
+                for (size_t j = 0; j < nfft; j++)
                 {
                     in[2*j+0] = (*c)[i][j];
                     in[2*j+1] = 0;
@@ -50,6 +50,7 @@
 #include <gtest/gtest.h>
 
 #include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 
 #include "testutils/testasserts.h"
 #include "testutils/testfilemanager.h"
@@ -81,6 +82,37 @@ TEST_F (ManyAutocorrelationTest, DifferentLength)
 }
 #endif
 
+TEST_F (ManyAutocorrelationTest, SeveralFunctionsPerThreadMatchSingleFunctions)
+{
+    // Make every thread handle more than one function, so the zero
+    // padding of the work arrays is reused between functions
+    const int                        nfunc = 3*gmx_omp_get_max_threads() + 1;
+    const size_t                     ndata = 37;
+    std::vector<std::vector<realA> > c(nfunc);
+    for (int i = 0; i < nfunc; i++)
+    {
+        c[i].resize(ndata);
+        for (size_t j = 0; j < ndata; j++)
+        {
+            c[i][j] = std::cos(0.3*(i + 1)*j) + 0.1*i;
+        }
+    }
+    std::vector<std::vector<realA> > reference(c);
+
+    EXPECT_EQ(0, many_auto_correl(&c));
+    test::FloatingPointTolerance     tolerance(test::relativeToleranceAsFloatingPoint(ndata, 1e-5));
+    for (int i = 0; i < nfunc; i++)
+    {
+        std::vector<std::vector<realA> > single(1, reference[i]);
+        EXPECT_EQ(0, many_auto_correl(&single));
+        ASSERT_EQ(ndata, c[i].size());
+        for (size_t j = 0; j < ndata; j++)
+        {
+            EXPECT_REAL_EQ_TOL(single[0][j], c[i][j], tolerance) << "function " << i << ", lag " << j;
+        }
+    }
+}
+
 }
 
 }
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief This file defines the placement of DLB cell boundaries from cost profiles.
+ *
+ * \ingroup module_domdec
+ */
+
+#include "gmxpre.h"
+
+#include "dlbcostdensity.h"
+
+bool dd_cell_sizes_from_cost_density(int ncd, int ncostbin,
+                                     const realA *cell_f, const float *cost,
+                                     realA *cell_size)
+{
+    double cost_tot = 0;
+    for (int i = 0; i < ncd*ncostbin; i++)
+    {
+        cost_tot += cost[i];
+    }
+    /* Without any measured cost all boundaries would end up at the start */
+    if (cost_tot <= 0)
+    {
+        return false;
+    }
+
+    double cost_cell = cost_tot/ncd;
+    double cost_sum  = 0;
+    realA  bound     = 0;
+    int    c         = 1;
+    for (int i = 0; i < ncd; i++)
+    {
+        realA bin_size = (cell_f[i+1] - cell_f[i])/ncostbin;
+        for (int b = 0; b < ncostbin; b++)
+        {
+            double cost_bin = cost[i*ncostbin + b];
+            /* Place all boundaries that fall within this bin */
+            while (c < ncd && cost_bin > 0 && cost_sum + cost_bin >= c*cost_cell)
+            {
+                realA bound_new = cell_f[i] + (b + (c*cost_cell - cost_sum)/cost_bin)*bin_size;
+                cell_size[c-1]  = bound_new - bound;
+                bound           = bound_new;
+                c++;
+            }
+            cost_sum += cost_bin;
+        }
+    }
+    /* With rounding or invalid costs some boundaries might not be placed.
+     * We should not generate zero sized cells, so leave it to the caller.
+     */
+    if (c < ncd)
+    {
+        return false;
+    }
+    cell_size[ncd-1] = 1 - bound;
+
+    return true;
+}
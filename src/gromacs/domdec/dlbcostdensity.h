@@ -0,0 +1,67 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ *
+ * \brief This file declares the placement of DLB cell boundaries from cost profiles.
+ *
+ * \ingroup module_domdec
+ */
+
+#ifndef GMX_DOMDEC_DLBCOSTDENSITY_H
+#define GMX_DOMDEC_DLBCOSTDENSITY_H
+
+#include "gromacs/utility/real.h"
+
+/*! \brief Sets the cell sizes along a row for equal cost per cell
+ *
+ * The cost profiles of the cells are concatenated into a piecewise
+ * constant cost density along the row. The new cell boundaries are
+ * placed where the prefix sum of this density crosses multiples
+ * of the average cost per cell.
+ *
+ * \param[in]  ncd        The number of cells along the row
+ * \param[in]  ncostbin   The number of cost profile bins per cell
+ * \param[in]  cell_f     The current relative cell boundaries, size \p ncd+1
+ * \param[in]  cost       The cost profiles of the cells, size \p ncd*ncostbin
+ * \param[out] cell_size  The relative cell sizes for equal cost, size \p ncd
+ * \returns false when no valid boundaries could be determined, in which
+ *          case \p cell_size is not usable and the caller should fall back
+ *          to load based scaling.
+ */
+bool dd_cell_sizes_from_cost_density(int ncd, int ncostbin,
+                                     const realA *cell_f, const float *cost,
+                                     realA *cell_size);
+
+#endif
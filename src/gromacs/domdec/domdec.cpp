@@ -75,6 +75,7 @@
 #include "gromacs/mdlib/mdsetup.h"
 #include "gromacs/mdlib/nb_verlet.h"
 #include "gromacs/mdlib/nbnxn_grid.h"
+#include "gromacs/mdlib/nbnxn_search.h"
 #include "gromacs/mdlib/nsgrid.h"
 #include "gromacs/mdlib/vsite.h"
 #include "gromacs/mdtypes/commrec.h"
@@ -108,6 +109,7 @@
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
 
+#include "dlbcostdensity.h"
 #include "domdec_constraints.h"
 #include "domdec_internal.h"
 #include "domdec_vsite.h"
@@ -128,7 +130,7 @@ struct gmx_domdec_master_t
     rvec  *vbuf;   /* Buffer for state scattering and gathering */
 };
 
-#define DD_NLOAD_MAX 9
+#define DD_NLOAD_MAX (9 + DIM*DD_COST_NBIN_MAX)
 
 static const char *edlbs_names[edlbsNR] = { "off", "off", "off", "locked", "on", "on" };
 
@@ -3105,6 +3107,7 @@ static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
     int                ncd, d1, i, pos;
     realA              *cell_size;
     realA               load_aver, load_i, imbalance, change, change_max, sc;
+    realA               cell_size_old;
     realA               cellsize_limit_f, dist_min_f, dist_min_f_hard, space;
     realA               change_limit;
     realA               relax = 0.5;
@@ -3134,6 +3137,31 @@ static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
             cell_size[i] = 1.0/ncd;
         }
     }
+    else if (dd_load_count(comm) > 0 && root->bCostValid &&
+             dd_cell_sizes_from_cost_density(ncd, comm->ncostbin,
+                                             root->cell_f, root->cost,
+                                             cell_size))
+    {
+        /* Move towards the boundaries that give equal cost per cell */
+        change_max = 0;
+        for (i = 0; i < ncd; i++)
+        {
+            cell_size_old = root->cell_f[i+1] - root->cell_f[i];
+            change        = (cell_size[i] - cell_size_old)/cell_size_old;
+            change_max    = std::max(change_max, std::max(change, -change));
+        }
+        /* Limit the amount of scaling, as in the load based scaling below */
+        sc = relax;
+        if (sc*change_max > change_limit)
+        {
+            sc = change_limit/change_max;
+        }
+        for (i = 0; i < ncd; i++)
+        {
+            cell_size_old = root->cell_f[i+1] - root->cell_f[i];
+            cell_size[i]  = cell_size_old + sc*(cell_size[i] - cell_size_old);
+        }
+    }
     else if (dd_load_count(comm) > 0)
     {
         load_aver  = comm->load[d].sum_m/ncd;
@@ -4878,6 +4906,97 @@ static void clear_dd_cycle_counts(gmx_domdec_t *dd)
     dd->comm->flop_n = 0;
 }
 
+/*! \brief Sets the normalized cost profile of the home atoms along each DD dimension
+ *
+ * With the Verlet scheme the cost of an atom is estimated from the number
+ * of cluster pairs its cluster is in, with the group scheme all atoms
+ * have equal cost. The profiles are later scaled with the measured load.
+ */
+static void dd_set_cost_profile(gmx_domdec_t *dd, const t_forcerec *fr,
+                                const t_state *state)
+{
+    gmx_domdec_comm_t *comm    = dd->comm;
+    int                ncostbin = comm->ncostbin;
+    int                nat_home = dd->nat_home;
+    double             cost_sum;
+    matrix             tcm;
+
+    if (nat_home > comm->atom_cost_nalloc)
+    {
+        comm->atom_cost_nalloc = over_alloc_dd(nat_home);
+        srenew(comm->atom_cost, comm->atom_cost_nalloc);
+    }
+    for (int a = 0; a < nat_home; a++)
+    {
+        comm->atom_cost[a] = 0;
+    }
+
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        for (int iloc = eintLocal; iloc <= eintNonlocal; iloc++)
+        {
+            nbnxn_add_pairlist_atom_cost(fr->nbv->nbs, &fr->nbv->grp[iloc].nbl_lists,
+                                         nat_home, comm->atom_cost);
+        }
+    }
+    cost_sum = 0;
+    for (int a = 0; a < nat_home; a++)
+    {
+        cost_sum += comm->atom_cost[a];
+    }
+    if (cost_sum <= 0)
+    {
+        /* No cost estimate available, use the atom density */
+        for (int a = 0; a < nat_home; a++)
+        {
+            comm->atom_cost[a] = 1;
+        }
+        cost_sum = nat_home;
+    }
+
+    for (int i = 0; i < dd->ndim*ncostbin; i++)
+    {
+        comm->cost_profile[i] = 0;
+    }
+    if (nat_home == 0)
+    {
+        return;
+    }
+
+    make_tric_corr_matrix(dd->npbcdim, state->box, tcm);
+
+    const rvec *x = as_rvec_array(state->x.data());
+    for (int d = 0; d < dd->ndim; d++)
+    {
+        int    dim      = dd->dim[d];
+        realA  x0       = comm->cell_x0[dim];
+        realA  bin_inv  = ncostbin/(comm->cell_x1[dim] - comm->cell_x0[dim]);
+        float *profile  = comm->cost_profile + d*ncostbin;
+
+        for (int a = 0; a < nat_home; a++)
+        {
+            /* Determine the location in lattice coordinates */
+            realA pos_d = x[a][dim];
+            if (comm->tric_dir[dim])
+            {
+                for (int d2 = dim + 1; d2 < DIM; d2++)
+                {
+                    pos_d += x[a][d2]*tcm[d2][dim];
+                }
+            }
+            /* Atoms can have moved out of the cell since the last partitioning */
+            int b = static_cast<int>((pos_d - x0)*bin_inv);
+            b     = std::min(std::max(b, 0), ncostbin - 1);
+
+            profile[b] += comm->atom_cost[a];
+        }
+        for (int b = 0; b < ncostbin; b++)
+        {
+            profile[b] /= cost_sum;
+        }
+    }
+}
+
 static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
 {
     gmx_domdec_comm_t *comm;
@@ -4885,7 +5004,7 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
     domdec_root_t     *root = nullptr;
     int                d, dim, i, pos;
     float              cell_frac = 0, sbuf[DD_NLOAD_MAX];
-    gmx_bool           bSepPME;
+    gmx_bool           bSepPME, bCostProfile;
 
     if (debug)
     {
@@ -4898,6 +5017,8 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
 
     bSepPME = (dd->pme_nodeid >= 0);
 
+    bCostProfile = (isDlbOn(comm) && comm->ncostbin > 0);
+
     if (dd->ndim == 0 && bSepPME)
     {
         /* Without decomposition, but with PME nodes, we need the load */
@@ -4937,6 +5058,16 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
                     sbuf[pos++] = comm->cycl[ddCyclPPduringPME];
                     sbuf[pos++] = comm->cycl[ddCyclPME];
                 }
+                if (bCostProfile)
+                {
+                    /* Our cost profiles along dimensions 0 to d,
+                     * scaled with our measured load.
+                     */
+                    for (i = 0; i < (d + 1)*comm->ncostbin; i++)
+                    {
+                        sbuf[pos++] = comm->cost_profile[i]*sbuf[0];
+                    }
+                }
             }
             else
             {
@@ -4958,6 +5089,16 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
                     sbuf[pos++] = comm->load[d+1].mdf;
                     sbuf[pos++] = comm->load[d+1].pme;
                 }
+                if (bCostProfile)
+                {
+                    /* The cost profiles along dimensions 0 to d,
+                     * summed over the row along dimension d+1.
+                     */
+                    for (i = 0; i < (d + 1)*comm->ncostbin; i++)
+                    {
+                        sbuf[pos++] = comm->load[d+1].cost[i];
+                    }
+                }
             }
             load->nload = pos;
             /* Communicate a row in DD direction d.
@@ -4983,6 +5124,13 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
                 load->mdf      = 0;
                 load->pme      = 0;
                 pos            = 0;
+                if (bCostProfile)
+                {
+                    for (i = 0; i < d*comm->ncostbin; i++)
+                    {
+                        load->cost[i] = 0;
+                    }
+                }
                 for (i = 0; i < dd->nc[dim]; i++)
                 {
                     load->sum += load->load[pos++];
@@ -5021,6 +5169,24 @@ static void get_load_distribution(gmx_domdec_t *dd, gmx_wallcycle_t wcycle)
                         load->pme = std::max(load->pme, load->load[pos]);
                         pos++;
                     }
+                    if (bCostProfile)
+                    {
+                        /* Sum the profiles along the lower dimensions,
+                         * store the profile along our dimension per cell.
+                         */
+                        for (int b = 0; b < d*comm->ncostbin; b++)
+                        {
+                            load->cost[b] += load->load[pos++];
+                        }
+                        for (int b = 0; b < comm->ncostbin; b++)
+                        {
+                            root->cost[i*comm->ncostbin + b] = load->load[pos++];
+                        }
+                    }
+                }
+                if (isDlbOn(comm))
+                {
+                    root->bCostValid = bCostProfile;
                 }
                 if (isDlbOn(comm) && root->bLimited)
                 {
@@ -5367,6 +5533,10 @@ static void make_load_communicator(gmx_domdec_t *dd, int dim_ind, ivec loc)
                     snew(root->bound_max, dd->nc[dim]);
                 }
                 snew(root->buf_ncd, dd->nc[dim]);
+                if (dd->comm->ncostbin > 0)
+                {
+                    snew(root->cost, dd->nc[dim]*dd->comm->ncostbin);
+                }
             }
             else
             {
@@ -5377,6 +5547,10 @@ static void make_load_communicator(gmx_domdec_t *dd, int dim_ind, ivec loc)
         if (dd->ci[dim] == dd->master_ci[dim])
         {
             snew(dd->comm->load[dim_ind].load, dd->nc[dim]*DD_NLOAD_MAX);
+            if (dd->comm->ncostbin > 0)
+            {
+                snew(dd->comm->load[dim_ind].cost, DIM*dd->comm->ncostbin);
+            }
         }
     }
 }
@@ -6820,6 +6994,8 @@ static void turn_on_dlb(FILE *fplog, t_commrec *cr, gmx_int64_t step)
                 }
             }
             comm->root[d]->cell_f[nc] = 1.0;
+            /* The cost profiles were not communicated without DLB */
+            comm->root[d]->bCostValid = FALSE;
         }
     }
 }
@@ -7208,12 +7384,26 @@ static void set_dd_envvar_options(FILE *fplog, gmx_domdec_t *dd, int rank_mysim)
     comm->nstDDDump     = dd_getenv(fplog, "GMX_DD_NST_DUMP", 0);
     comm->nstDDDumpGrid = dd_getenv(fplog, "GMX_DD_NST_DUMP_GRID", 0);
     comm->DD_debug      = dd_getenv(fplog, "GMX_DD_DEBUG", 0);
+    comm->ncostbin      = dd_getenv(fplog, "GMX_DLB_COST_PROFILE_BINS", 0);
 
     if (dd->bSendRecv2 && fplog)
     {
         fprintf(fplog, "Will use two sequential MPI_Sendrecv calls instead of two simultaneous non-blocking MPI_Irecv and MPI_Isend pairs for constraint and vsite communication\n");
     }
 
+    if (comm->ncostbin > 0)
+    {
+        comm->ncostbin = std::min(comm->ncostbin, DD_COST_NBIN_MAX);
+        if (fplog)
+        {
+            fprintf(fplog, "Will load balance using the cost density along each dimension, estimated with %d bins per cell\n", comm->ncostbin);
+        }
+    }
+    else
+    {
+        comm->ncostbin = 0;
+    }
+
     if (comm->eFlop)
     {
         if (fplog)
@@ -9306,6 +9496,10 @@ void dd_partition_system(FILE                *fplog,
         if (bDoDLB || bLogLoad || bCheckWhetherToTurnDlbOn ||
             (bVerbose && (ir->nstlist == 0 || nstglobalcomm <= ir->nstlist)))
         {
+            if (isDlbOn(comm) && comm->ncostbin > 0)
+            {
+                dd_set_cost_profile(dd, fr, state_local);
+            }
             get_load_distribution(dd, wcycle);
             if (DDMASTER(dd))
             {
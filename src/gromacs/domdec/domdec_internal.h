@@ -55,6 +55,9 @@
 
 struct BalanceRegion;
 
+/*! \brief The maximum number of cost profile bins per cell, per dimension */
+#define DD_COST_NBIN_MAX 16
+
 typedef struct
 {
     /* The numbers of charge groups to send and receive for each cell
@@ -92,6 +95,8 @@ typedef struct
     realA     *bound_max;   /**< Temp. var.: upper limit for cell boundary     */
     gmx_bool  bLimited;    /**< State var.: is DLB limited in this row        */
     realA     *buf_ncd;     /**< Temp. var.                                    */
+    float    *cost;        /**< Temp. var.: cost profile per cell, size nc*ncostbin */
+    gmx_bool  bCostValid;  /**< Temp. var.: did we receive valid cost profiles */
 } domdec_root_t;
 
 /*! \brief Struct for compute load commuication
@@ -110,6 +115,7 @@ typedef struct
     float  mdf;       /**< The PP time during which PME can overlap */
     float  pme;       /**< The PME-only rank load */
     int    flags;     /**< Bit flags that tell if DLB was limited, per dimension */
+    float *cost;      /**< The cost profiles along the lower dimensions, summed over the ranks contributing to \p sum */
 } domdec_load_t;
 
 typedef struct
@@ -357,6 +363,10 @@ struct gmx_domdec_comm_t
 
     /* Information for managing the dynamic load balancing */
     int            dlb_scale_lim;      /**< Maximum DLB scaling per load balancing step in percent */
+    int            ncostbin;           /**< The number of cost profile bins per cell along each dimension, 0 means no cost profiles */
+    float          cost_profile[DIM*DD_COST_NBIN_MAX]; /**< The normalized cost profile of our home atoms along each DD dimension */
+    realA         *atom_cost;          /**< Buffer for the cost estimate per home atom */
+    int            atom_cost_nalloc;   /**< Allocation size of \p atom_cost */
 
     BalanceRegion *balanceRegion;      /**< Struct for timing the force load balancing region */
 
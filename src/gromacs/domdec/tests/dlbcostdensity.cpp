@@ -0,0 +1,124 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the placement of DLB cell boundaries from cost profiles.
+ *
+ * \ingroup module_domdec
+ */
+#include "gmxpre.h"
+
+#include "gromacs/domdec/dlbcostdensity.h"
+
+#include <cmath>
+
+#include <limits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+using gmx::test::defaultRealTolerance;
+
+//! Returns \p ncd uniform relative cell boundaries
+std::vector<realA> uniformBoundaries(int ncd)
+{
+    std::vector<realA> cell_f(ncd + 1);
+    for (int i = 0; i <= ncd; i++)
+    {
+        cell_f[i] = i/static_cast<realA>(ncd);
+    }
+    return cell_f;
+}
+
+TEST(DlbCostDensityTest, UniformCostGivesUniformCells)
+{
+    const int          ncd      = 4;
+    const int          ncostbin = 3;
+    std::vector<realA> cell_f   = uniformBoundaries(ncd);
+    std::vector<float> cost(ncd*ncostbin, 2.0f);
+    std::vector<realA> cell_size(ncd);
+
+    ASSERT_TRUE(dd_cell_sizes_from_cost_density(ncd, ncostbin, cell_f.data(), cost.data(), cell_size.data()));
+    for (int i = 0; i < ncd; i++)
+    {
+        EXPECT_REAL_EQ_TOL(0.25, cell_size[i], defaultRealTolerance());
+    }
+}
+
+TEST(DlbCostDensityTest, PlacesBoundariesForEqualCost)
+{
+    const int          ncd      = 2;
+    const int          ncostbin = 2;
+    std::vector<realA> cell_f   = uniformBoundaries(ncd);
+    /* All cost in the first half of the row, three times as much in the first bin */
+    std::vector<float> cost     = { 3.0f, 1.0f, 0.0f, 0.0f };
+    std::vector<realA> cell_size(ncd);
+
+    ASSERT_TRUE(dd_cell_sizes_from_cost_density(ncd, ncostbin, cell_f.data(), cost.data(), cell_size.data()));
+    /* Half of the cost is reached at 2/3 of the first bin of width 0.25 */
+    EXPECT_REAL_EQ_TOL(0.25*2/3.0, cell_size[0], defaultRealTolerance());
+    EXPECT_REAL_EQ_TOL(1 - 0.25*2/3.0, cell_size[1], defaultRealTolerance());
+}
+
+TEST(DlbCostDensityTest, ZeroCostIsRejected)
+{
+    const int          ncd      = 3;
+    const int          ncostbin = 2;
+    std::vector<realA> cell_f   = uniformBoundaries(ncd);
+    std::vector<float> cost(ncd*ncostbin, 0.0f);
+    std::vector<realA> cell_size(ncd, -1);
+
+    EXPECT_FALSE(dd_cell_sizes_from_cost_density(ncd, ncostbin, cell_f.data(), cost.data(), cell_size.data()));
+}
+
+TEST(DlbCostDensityTest, UnplacedBoundariesAreRejected)
+{
+    const int          ncd      = 3;
+    const int          ncostbin = 2;
+    std::vector<realA> cell_f   = uniformBoundaries(ncd);
+    /* An invalid cost makes all comparisons fail, so no boundary gets placed */
+    std::vector<float> cost(ncd*ncostbin, 1.0f);
+    cost[1] = std::numeric_limits<float>::quiet_NaN();
+    std::vector<realA> cell_size(ncd, -1);
+
+    EXPECT_FALSE(dd_cell_sizes_from_cost_density(ncd, ncostbin, cell_f.data(), cost.data(), cell_size.data()));
+}
+
+} // namespace
@@ -48,6 +48,7 @@
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/linearalgebra/gmx_blas.h"
 #include "gromacs/linearalgebra/nrjac.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/utilities.h"
@@ -90,7 +91,8 @@ typedef struct
     int     neig;    /* nr of eigenvectors             */
     int    *ieig;    /* index nrs of eigenvectors      */
     realA   *stpsz;   /* stepsizes (per eigenvector)    */
-    rvec  **vec;     /* eigenvector components         */
+    rvec  **vec;     /* eigenvector components, the vectors are stored
+                        contiguously, vec[i] = vec[0] + i*nr         */
     realA   *xproj;   /* instantaneous x projections    */
     realA   *fproj;   /* instantaneous f projections    */
     realA    radius;  /* instantaneous radius           */
@@ -218,6 +220,7 @@ struct t_do_edsam
 /* definition of ED buffer structure */
 struct t_ed_buffer
 {
+    rvec                 *          xmw;       /* mass-weighted positions for projection */
     struct t_fit_to_ref *           fit_to_ref;
     struct t_do_edfit *             do_edfit;
     struct t_do_edsam *             do_edsam;
@@ -295,6 +298,62 @@ static realA projectx(t_edpar *edi, rvec *xcoll, rvec *vec)
 }
 
 
+/* Stores the mass-weighted positions x, with the average positions
+ * subtracted when bSubtractAverage=TRUE, in the ED buffer for projection
+ * with project_prepared(). This leaves x unchanged.
+ */
+static void prepare_projection(t_edpar *edi, const rvec *x, gmx_bool bSubtractAverage)
+{
+    if (edi->buf->xmw == nullptr)
+    {
+        snew(edi->buf->xmw, edi->sav.nr);
+    }
+    rvec *xmw = edi->buf->xmw;
+
+    for (int i = 0; i < edi->sav.nr; i++)
+    {
+        if (bSubtractAverage)
+        {
+            rvec_sub(x[i], edi->sav.x[i], xmw[i]);
+            svmul(edi->sav.sqrtm[i], xmw[i], xmw[i]);
+        }
+        else
+        {
+            svmul(edi->sav.sqrtm[i], x[i], xmw[i]);
+        }
+    }
+}
+
+
+/* Projects the positions stored by prepare_projection() onto all
+ * eigenvectors in vec and stores the projections in proj.
+ * Since the eigenvectors are stored contiguously, this is a single
+ * matrix-vector product.
+ */
+static void project_prepared(t_edpar *edi, t_eigvec *vec, realA *proj)
+{
+    if (vec->neig == 0)
+    {
+        return;
+    }
+
+    int   m     = DIM*edi->sav.nr;
+    int   n     = vec->neig;
+    int   inc   = 1;
+    realA alpha = 1;
+    realA beta  = 0;
+
+    /* The eigenvectors form the columns of a column-major m x n matrix */
+#if GMX_DOUBLE
+    F77_FUNC(dgemv, DGEMV) ("T", &m, &n, &alpha, vec->vec[0][0], &m,
+                            edi->buf->xmw[0], &inc, &beta, proj, &inc);
+#else
+    F77_FUNC(sgemv, SGEMV) ("T", &m, &n, &alpha, vec->vec[0][0], &m,
+                            edi->buf->xmw[0], &inc, &beta, proj, &inc);
+#endif
+}
+
+
 /* Specialized: projection is stored in vec->refproj
  * -> used for radacc, radfix, radcon  and center of flooding potential
  * subtracts average positions, projects vector x */
@@ -303,58 +362,30 @@ static void rad_project(t_edpar *edi, rvec *x, t_eigvec *vec)
     int  i;
     realA rad = 0.0;
 
-    /* Subtract average positions */
-    for (i = 0; i < edi->sav.nr; i++)
-    {
-        rvec_dec(x[i], edi->sav.x[i]);
-    }
+    prepare_projection(edi, x, TRUE);
+    project_prepared(edi, vec, vec->refproj);
 
     for (i = 0; i < vec->neig; i++)
     {
-        vec->refproj[i] = projectx(edi, x, vec->vec[i]);
         rad            += gmx::square((vec->refproj[i]-vec->xproj[i]));
     }
     vec->radius = sqrt(rad);
-
-    /* Add average positions */
-    for (i = 0; i < edi->sav.nr; i++)
-    {
-        rvec_inc(x[i], edi->sav.x[i]);
-    }
 }
 
 
-/* Project vector x, subtract average positions prior to projection and add
- * them afterwards to retain the unchanged vector. Store in xproj. Mass-weighting
- * is applied. */
+/* Project vector x, subtracting average positions prior to projection,
+ * x is not modified. Store in xproj. Mass-weighting is applied. */
 static void project_to_eigvectors(rvec       *x,    /* The positions to project to an eigenvector */
                                   t_eigvec   *vec,  /* The eigenvectors */
                                   t_edpar    *edi)
 {
-    int  i;
-
-
     if (!vec->neig)
     {
         return;
     }
 
-    /* Subtract average positions */
-    for (i = 0; i < edi->sav.nr; i++)
-    {
-        rvec_dec(x[i], edi->sav.x[i]);
-    }
-
-    for (i = 0; i < vec->neig; i++)
-    {
-        vec->xproj[i] = projectx(edi, x, vec->vec[i]);
-    }
-
-    /* Add average positions */
-    for (i = 0; i < edi->sav.nr; i++)
-    {
-        rvec_inc(x[i], edi->sav.x[i]);
-    }
+    prepare_projection(edi, x, TRUE);
+    project_prepared(edi, vec, vec->xproj);
 }
 
 
@@ -362,14 +393,14 @@ static void project_to_eigvectors(rvec       *x,    /* The positions to project
 static void project(rvec      *x,     /* positions to project */
                     t_edpar   *edi)   /* edi data set */
 {
-    /* It is not more work to subtract the average position in every
-     * subroutine again, because these routines are rarely used simultaneously */
-    project_to_eigvectors(x, &edi->vecs.mon, edi);
-    project_to_eigvectors(x, &edi->vecs.linfix, edi);
-    project_to_eigvectors(x, &edi->vecs.linacc, edi);
-    project_to_eigvectors(x, &edi->vecs.radfix, edi);
-    project_to_eigvectors(x, &edi->vecs.radacc, edi);
-    project_to_eigvectors(x, &edi->vecs.radcon, edi);
+    /* Subtract the average positions and mass-weight only once */
+    prepare_projection(edi, x, TRUE);
+    project_prepared(edi, &edi->vecs.mon, edi->vecs.mon.xproj);
+    project_prepared(edi, &edi->vecs.linfix, edi->vecs.linfix.xproj);
+    project_prepared(edi, &edi->vecs.linacc, edi->vecs.linacc.xproj);
+    project_prepared(edi, &edi->vecs.radfix, edi->vecs.radfix.xproj);
+    project_prepared(edi, &edi->vecs.radacc, edi->vecs.radacc.xproj);
+    project_prepared(edi, &edi->vecs.radcon, edi->vecs.radcon.xproj);
 }
 
 
@@ -925,14 +956,16 @@ static void flood_blowup(t_edpar *edi, rvec *forces_cart)
         clear_rvec(forces_cart[j]);
     }
 
-    /* Now compute atomwise */
-    for (j = 0; j < edi->sav.nr_loc; j++)
+    /* Now add the contributions of the eigenvectors one by one,
+     * which accesses the eigenvector components sequentially */
+    for (eig = 0; eig < edi->flood.vecs.neig; eig++)
     {
-        /* Compute forces_cart[edi->sav.anrs[j]] */
-        for (eig = 0; eig < edi->flood.vecs.neig; eig++)
+        const rvec *vec = edi->flood.vecs.vec[eig];
+
+        for (j = 0; j < edi->sav.nr_loc; j++)
         {
             /* Force vector is force * eigenvector (compute only atom j) */
-            svmul(forces_sub[eig], edi->flood.vecs.vec[eig][edi->sav.c_ind[j]], dum);
+            svmul(forces_sub[eig], vec[edi->sav.c_ind[j]], dum);
             /* Add this vector to the cartesian forces */
             rvec_inc(forces_cart[j], dum);
         }
@@ -1309,10 +1342,15 @@ static void bc_ed_vecs(t_commrec *cr, t_eigvec *ev, int length, gmx_bool bHarmon
     nblock_bc(cr, ev->neig, ev->refproj);
 
     snew_bc(cr, ev->vec, ev->neig);      /* Eigenvector components        */
-    for (i = 0; i < ev->neig; i++)
+    if (ev->neig > 0)
     {
-        snew_bc(cr, ev->vec[i], length);
-        nblock_bc(cr, length, ev->vec[i]);
+        /* The eigenvectors are stored contiguously, see read_edvec() */
+        snew_bc(cr, ev->vec[0], ev->neig*length);
+        nblock_bc(cr, ev->neig*length, ev->vec[0]);
+        for (i = 1; i < ev->neig; i++)
+        {
+            ev->vec[i] = ev->vec[0] + i*length;
+        }
     }
 
     /* For harmonic restraints the reference projections can change with time */
@@ -1614,9 +1652,11 @@ static void read_edvec(FILE *in, int nr, t_eigvec *tvec, gmx_bool bReadRefproj,
             tvec->stpsz[i] = rdum;
         } /* end of loop over eigenvectors */
 
+        /* Store the eigenvectors contiguously for projection */
+        snew(tvec->vec[0], tvec->neig*nr);
         for (i = 0; (i < tvec->neig); i++)
         {
-            snew(tvec->vec[i], nr);
+            tvec->vec[i] = tvec->vec[0] + i*nr;
             scan_edvec(in, nr, tvec->vec[i]);
         }
     }
@@ -2059,11 +2099,11 @@ static void do_radfix(rvec *xcoll, t_edpar *edi)
 
     snew(proj, edi->vecs.radfix.neig);
 
-    /* loop over radfix vectors */
+    /* calculate the projections, radius */
+    prepare_projection(edi, xcoll, FALSE);
+    project_prepared(edi, &edi->vecs.radfix, proj);
     for (i = 0; i < edi->vecs.radfix.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(edi, xcoll, edi->vecs.radfix.vec[i]);
         rad    += gmx::square(proj[i] - edi->vecs.radfix.refproj[i]);
     }
 
@@ -2104,11 +2144,11 @@ static void do_radacc(rvec *xcoll, t_edpar *edi)
 
     snew(proj, edi->vecs.radacc.neig);
 
-    /* loop over radacc vectors */
+    /* calculate the projections, radius */
+    prepare_projection(edi, xcoll, FALSE);
+    project_prepared(edi, &edi->vecs.radacc, proj);
     for (i = 0; i < edi->vecs.radacc.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(edi, xcoll, edi->vecs.radacc.vec[i]);
         rad    += gmx::square(proj[i] - edi->vecs.radacc.refproj[i]);
     }
     rad = sqrt(rad);
@@ -2175,11 +2215,11 @@ static void do_radcon(rvec *xcoll, t_edpar *edi)
         snew(loc->proj, edi->vecs.radcon.neig);
     }
 
-    /* loop over radcon vectors */
+    /* calculate the projections, radius */
+    prepare_projection(edi, xcoll, FALSE);
+    project_prepared(edi, &edi->vecs.radcon, loc->proj);
     for (i = 0; i < edi->vecs.radcon.neig; i++)
     {
-        /* calculate the projections, radius */
-        loc->proj[i] = projectx(edi, xcoll, edi->vecs.radcon.vec[i]);
         rad         += gmx::square(loc->proj[i] - edi->vecs.radcon.refproj[i]);
     }
     rad = sqrt(rad);
@@ -41,6 +41,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <vector>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
@@ -2203,6 +2204,285 @@ static double bar_err(int nbmin, int nbmax, const double *partsum)
 }
 
 
+/* The maximum number of MBAR self-consistent iterations */
+static const int mbar_max_iter = 100000;
+
+/* Return the sample collections for MBAR, sc[k*nstate + l] holds the
+   energy differences from native state k to state l and is NULL for l == k.
+   All native states need the energy differences to all other states,
+   as lists of delta U values for the same samples. */
+static std::vector<sample_coll_t *> mbar_sample_colls(sim_data_t *sd, int *nstate)
+{
+    std::vector<lambda_data_t *> states;
+    lambda_data_t               *head = sd->lb;
+
+    for (lambda_data_t *l = head->next; l != head; l = l->next)
+    {
+        states.push_back(l);
+    }
+    *nstate = states.size();
+
+    std::vector<sample_coll_t *> sc(states.size()*states.size(), nullptr);
+    for (size_t k = 0; k < states.size(); k++)
+    {
+        const sample_coll_t *ref = nullptr;
+
+        for (size_t l = 0; l < states.size(); l++)
+        {
+            if (l == k)
+            {
+                continue;
+            }
+            sample_coll_t *c = lambda_data_find_sample_coll(states[k], states[l]->lambda);
+            if (!c)
+            {
+                char descX[STRLEN], descY[STRLEN];
+                snprint_lambda_vec(descX, STRLEN, "X", states[l]->lambda);
+                snprint_lambda_vec(descY, STRLEN, "Y", states[k]->lambda);
+                gmx_fatal(FARGS, "MBAR needs the energy differences to all lambda states, but there is no set for foreign lambda (state X below)\nin the files for main lambda (state Y below)\n\n%s\n%s\n", descX, descY);
+            }
+            if (!ref)
+            {
+                ref = c;
+            }
+            if (c->nsamples != ref->nsamples)
+            {
+                gmx_fatal(FARGS, "For MBAR the energy differences to all lambda states should be computed for the same samples, which is not the case in file %s", c->s[0]->filename);
+            }
+            for (int i = 0; i < c->nsamples; i++)
+            {
+                if (c->s[i]->hist)
+                {
+                    gmx_fatal(FARGS, "MBAR can not use the histograms in file %s", c->s[i]->filename);
+                }
+                if (c->s[i]->filename != ref->s[i]->filename ||
+                    c->r[i].use != ref->r[i].use ||
+                    c->r[i].start != ref->r[i].start ||
+                    c->r[i].end != ref->r[i].end)
+                {
+                    gmx_fatal(FARGS, "For MBAR the energy differences to all lambda states should be computed for the same samples, which is not the case in file %s", c->s[i]->filename);
+                }
+            }
+            sc[k*states.size() + l] = c;
+        }
+    }
+
+    return sc;
+}
+
+/* Append the reduced energy differences u_l - u_k to all states l
+   of the samples of native state k in sc to u */
+static void mbar_add_reduced_energies(int nstate, int k, sample_coll_t **sc,
+                                      double beta, std::vector<double> *u)
+{
+    /* All collections hold the same samples, take the ranges of one of them */
+    const sample_coll_t *ref = sc[k == 0 ? 1 : 0];
+
+    for (int i = 0; i < ref->nsamples; i++)
+    {
+        if (!ref->r[i].use)
+        {
+            continue;
+        }
+        for (int n = ref->r[i].start; n < ref->r[i].end; n++)
+        {
+            for (int l = 0; l < nstate; l++)
+            {
+                u->push_back(l == k ? 0 : beta*sc[l]->s[i]->du[n]);
+            }
+        }
+    }
+}
+
+/* Solve the MBAR equations for the free energies f (in kT, f[0] = 0) of
+   all states, given the number of samples per state and the reduced energy
+   differences u of all samples to all states. f should contain the initial
+   guess. Returns whether the free energies converged within tol. */
+static gmx_bool calc_mbar_lowlevel(int nstate, const std::vector<double> &nsample,
+                                   const std::vector<double> &u,
+                                   double tol, std::vector<double> *f)
+{
+    const size_t        ntot = u.size()/nstate;
+    std::vector<double> logN(nstate), logden(ntot), fmax(nstate), fsum(nstate);
+
+    for (int k = 0; k < nstate; k++)
+    {
+        logN[k] = std::log(nsample[k]);
+    }
+
+    for (int iter = 0; iter < mbar_max_iter; iter++)
+    {
+        /* The log of the denominators sum_k N_k exp(f_k - u_k) of all samples */
+        for (size_t n = 0; n < ntot; n++)
+        {
+            const double *un   = &u[n*nstate];
+            double        amax = -std::numeric_limits<double>::max();
+            for (int k = 0; k < nstate; k++)
+            {
+                amax = std::max(amax, logN[k] + (*f)[k] - un[k]);
+            }
+            double sum = 0;
+            for (int k = 0; k < nstate; k++)
+            {
+                sum += std::exp(logN[k] + (*f)[k] - un[k] - amax);
+            }
+            logden[n] = amax + std::log(sum);
+        }
+
+        /* The new free energies -log sum_n exp(-u_l - logden), with log-sum-exp */
+        std::fill(fmax.begin(), fmax.end(), -std::numeric_limits<double>::max());
+        for (size_t n = 0; n < ntot; n++)
+        {
+            for (int l = 0; l < nstate; l++)
+            {
+                fmax[l] = std::max(fmax[l], -u[n*nstate + l] - logden[n]);
+            }
+        }
+        std::fill(fsum.begin(), fsum.end(), 0.0);
+        for (size_t n = 0; n < ntot; n++)
+        {
+            for (int l = 0; l < nstate; l++)
+            {
+                fsum[l] += std::exp(-u[n*nstate + l] - logden[n] - fmax[l]);
+            }
+        }
+
+        double f0     = -(fmax[0] + std::log(fsum[0]));
+        double maxdif = 0;
+        for (int l = 0; l < nstate; l++)
+        {
+            double fl = -(fmax[l] + std::log(fsum[l])) - f0;
+            maxdif    = std::max(maxdif, std::abs(fl - (*f)[l]));
+            (*f)[l]   = fl;
+        }
+        if (maxdif < tol)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Compute the MBAR free energies f (in kT) of all states from the
+   sample collections sc, subsample p out of np of each collection */
+static void calc_mbar_subsample(int nstate, sample_coll_t **sc, double temp,
+                                double tol, int p, int np,
+                                std::vector<double> *f)
+{
+    const double                 beta = 1.0/(BOLTZ*temp);
+    std::vector<double>          u, nsample(nstate);
+    std::vector<sample_coll_t>   sub(nstate);
+    std::vector<sample_coll_t *> scsub(nstate*nstate, nullptr);
+
+    for (int k = 0; k < nstate; k++)
+    {
+        for (int l = 0; l < nstate; l++)
+        {
+            sample_coll_t *c = sc[k*nstate + l];
+            if (c)
+            {
+                /* sub is reused for each native state k */
+                if (np > 1)
+                {
+                    sample_coll_create_subsample(&sub[l], c, p, np);
+                    scsub[k*nstate + l] = &sub[l];
+                }
+                else
+                {
+                    scsub[k*nstate + l] = c;
+                }
+            }
+        }
+        nsample[k] = scsub[k*nstate + (k == 0 ? 1 : 0)]->ntot;
+        mbar_add_reduced_energies(nstate, k, &scsub[k*nstate], beta, &u);
+        if (np > 1)
+        {
+            for (int l = 0; l < nstate; l++)
+            {
+                if (l != k)
+                {
+                    sample_coll_destroy(&sub[l]);
+                }
+            }
+        }
+    }
+
+    if (!calc_mbar_lowlevel(nstate, nsample, u, tol, f))
+    {
+        printf("WARNING: MBAR did not converge to %g kT in %d iterations\n",
+               tol, mbar_max_iter);
+    }
+}
+
+/* Compute the MBAR free energy differences dg (in kT) between
+   consecutive lambda states and their block averaging errors dg_err
+   and the error of the total dg_tot_err. The BAR results are used as
+   initial guess. */
+static void calc_mbar(sim_data_t *sd, const barres_t *results, int nresults,
+                      double temp, double tol, int nbmin, int nbmax,
+                      std::vector<double> *dg, std::vector<double> *dg_err,
+                      double *dg_tot_err)
+{
+    int                          nstate;
+    std::vector<sample_coll_t *> sc = mbar_sample_colls(sd, &nstate);
+    std::vector<double>          fguess(nstate, 0.0), f;
+
+    GMX_RELEASE_ASSERT(nstate == nresults + 1, "We should have one BAR result less than lambda states");
+
+    for (int i = 0; i < nresults; i++)
+    {
+        fguess[i + 1] = fguess[i] + results[i].dg;
+    }
+
+    f = fguess;
+    calc_mbar_subsample(nstate, sc.data(), temp, tol, 0, 1, &f);
+    dg->resize(nresults);
+    for (int i = 0; i < nresults; i++)
+    {
+        (*dg)[i] = f[i + 1] - f[i];
+    }
+
+    /* Block averaging of the errors, as for BAR */
+    std::vector<double> dg_sig2(nresults, 0.0);
+    double              tot_sig2 = 0;
+    for (int npee = nbmin; npee <= nbmax; npee++)
+    {
+        std::vector<double> dgs(nresults, 0.0), dgs2(nresults, 0.0);
+        double              tots = 0, tots2 = 0;
+
+        for (int p = 0; p < npee; p++)
+        {
+            f = fguess;
+            calc_mbar_subsample(nstate, sc.data(), temp, tol, p, npee, &f);
+            for (int i = 0; i < nresults; i++)
+            {
+                double dgp = f[i + 1] - f[i];
+                dgs[i]    += dgp;
+                dgs2[i]   += dgp*dgp;
+            }
+            tots  += f[nstate - 1];
+            tots2 += f[nstate - 1]*f[nstate - 1];
+        }
+        for (int i = 0; i < nresults; i++)
+        {
+            dgs[i]     /= npee;
+            dgs2[i]    /= npee;
+            dg_sig2[i] += (dgs2[i] - dgs[i]*dgs[i])/(npee - 1);
+        }
+        tots     /= npee;
+        tots2    /= npee;
+        tot_sig2 += (tots2 - tots*tots)/(npee - 1);
+    }
+    dg_err->resize(nresults);
+    for (int i = 0; i < nresults; i++)
+    {
+        (*dg_err)[i] = std::sqrt(dg_sig2[i]/(nbmax - nbmin + 1));
+    }
+    *dg_tot_err = std::sqrt(tot_sig2/(nbmax - nbmin + 1));
+}
+
+
 /* Seek the end of an identifier (consecutive non-spaces), followed by
    an optional number of spaces or '='-signs. Returns a pointer to the
    first non-space value found after that. Returns NULL if the string
@@ -3547,12 +3827,23 @@ int gmx_bar(int argc, char *argv[])
 
         "To get a visual estimate of the phase space overlap, use the ",
         "[TT]-oh[tt] option to write series of histograms, together with the ",
-        "[TT]-nbin[tt] option.[PAR]"
+        "[TT]-nbin[tt] option.[PAR]",
+
+        "With [TT]-mbar[tt], the free energy differences are also estimated ",
+        "with the multistate Bennett acceptance ratio (MBAR), which uses ",
+        "the energy differences of the samples of each state to all other ",
+        "states: Shirts & Chodera, J. Chem. Phys. 129, 124105 (2008). ",
+        "This requires that all files contain lists of energy differences ",
+        "to all [GRK]lambda[grk] states (see the [REF].mdp[ref] option ",
+        "[TT]calc-lambda-neighbors[tt]), histograms can not be used. ",
+        "The errors are estimated with the same block averaging as for BAR. ",
+        "The MBAR results are printed after the BAR results.[PAR]"
     };
     static realA        begin    = 0, end = -1, temp = -1;
     int                nd       = 2, nbmin = 5, nbmax = 5;
     int                nbin     = 100;
     gmx_bool           use_dhdl = FALSE;
+    gmx_bool           bMBAR    = FALSE;
     t_pargs            pa[]     = {
         { "-b",    FALSE, etREAL, {&begin},  "Begin time for BAR" },
         { "-e",    FALSE, etREAL, {&end},    "End time for BAR" },
@@ -3561,7 +3852,8 @@ int gmx_bar(int argc, char *argv[])
         { "-nbmin",  FALSE, etINT,  {&nbmin}, "Minimum number of blocks for error estimation" },
         { "-nbmax",  FALSE, etINT,  {&nbmax}, "Maximum number of blocks for error estimation" },
         { "-nbin",  FALSE, etINT, {&nbin}, "Number of bins for histogram output"},
-        { "-extp",  FALSE, etBOOL, {&use_dhdl}, "Whether to linearly extrapolate dH/dl values to use as energies"}
+        { "-extp",  FALSE, etBOOL, {&use_dhdl}, "Whether to linearly extrapolate dH/dl values to use as energies"},
+        { "-mbar",  FALSE, etBOOL, {&bMBAR}, "Also estimate the free energy differences with MBAR, using the energy differences to all lambda states"}
     };
 
     t_filenm           fnm[] = {
@@ -3640,6 +3932,11 @@ int gmx_bar(int argc, char *argv[])
     }
     prec = std::pow(10.0, static_cast<double>(-nd));
 
+    if (bMBAR && use_dhdl)
+    {
+        gmx_fatal(FARGS, "MBAR needs the energy differences to all lambda states, it can not be combined with -extp");
+    }
+
     snew(partsum, (nbmax+1)*(nbmax+1));
     nf = 0;
 
@@ -3921,6 +4218,47 @@ int gmx_bar(int argc, char *argv[])
     }
     printf("\n");
 
+    if (bMBAR)
+    {
+        std::vector<double> mbar_dg, mbar_dg_err;
+        double              mbar_tot_err;
+
+        calc_mbar(&sim_data, results, nresults, temp, 0.1*prec, nbmin, nbmax,
+                  &mbar_dg, &mbar_dg_err, &mbar_tot_err);
+
+        printf("\nMBAR results in kJ/mol:\n\n");
+        dg_tot = 0;
+        for (f = 0; f < nresults; f++)
+        {
+            printf("point ");
+            lambda_vec_print_short(results[f].a->native_lambda, buf);
+            lambda_vec_print_short(results[f].b->native_lambda, buf2);
+            printf("%s - %s", buf, buf2);
+            printf(",   DG ");
+            printf(dgformat, mbar_dg[f]*kT);
+            if (bEE)
+            {
+                printf(" +/- ");
+                printf(dgformat, mbar_dg_err[f]*kT);
+            }
+            printf("\n");
+            dg_tot += mbar_dg[f];
+        }
+        printf("\n");
+        printf("total ");
+        lambda_vec_print_short(results[0].a->native_lambda, buf);
+        lambda_vec_print_short(results[nresults-1].b->native_lambda, buf2);
+        printf("%s - %s", buf, buf2);
+        printf(",   DG ");
+        printf(dgformat, dg_tot*kT);
+        if (bEE)
+        {
+            printf(" +/- ");
+            printf(dgformat, mbar_tot_err*kT);
+        }
+        printf("\n\n");
+    }
+
 
     if (fpi != nullptr)
     {
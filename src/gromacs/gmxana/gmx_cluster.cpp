@@ -62,8 +62,10 @@
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
 
@@ -321,6 +323,22 @@ static realA rms_dist(int isize, realA **d, realA **d_r)
     return std::sqrt(r2);
 }
 
+/*! \brief Stores the upper triangle entries of rows r0 to r1 of the matrix
+ * that were computed in place, updating the matrix statistics */
+static void store_mat_rows(t_mat *rms, int r0, int r1, gmx_int64_t *nrms)
+{
+    for (int i1 = r0; i1 < r1; i1++)
+    {
+        for (int i2 = i1+1; i2 < rms->n1; i2++)
+        {
+            set_mat_entry(rms, i1, i2, rms->mat[i1][i2]);
+        }
+        *nrms -= rms->n1-i1-1;
+    }
+    fprintf(stderr, "\r# RMSD calculations left: " "%" GMX_PRId64 "   ", *nrms);
+    fflush(stderr);
+}
+
 static bool rms_dist_comp(const t_dist &a, const t_dist &b)
 {
     return a.dist < b.dist;
@@ -1386,9 +1404,10 @@ int gmx_cluster(int argc, char *argv[])
     FILE              *fp, *log;
     int                nf   = 0, i, i1, i2, j;
     gmx_int64_t        nrms = 0;
+    int                nthreads, blockSize;
 
     matrix             box;
-    rvec              *xtps, *usextps, *x1, **xx = nullptr;
+    rvec              *xtps, *usextps, **xx = nullptr;
     const char        *fn, *trx_out_fn;
     t_clusters         clust;
     t_mat             *rms, *orig = nullptr;
@@ -1402,7 +1421,7 @@ int gmx_cluster(int argc, char *argv[])
     int                isize = 0, ifsize = 0, iosize = 0;
     int               *index = nullptr, *fitidx = nullptr, *outidx = nullptr;
     char              *grpname;
-    realA               rmsd, **d1, **d2, *time = nullptr, time_invfac, *mass = nullptr;
+    realA              *time = nullptr, time_invfac, *mass = nullptr;
     char               buf[STRLEN], buf1[80];
     gmx_bool           bAnalyze, bUseRmsdCut, bJP_RMSD = FALSE, bReadMat, bReadTraj, bPBC = TRUE;
 
@@ -1719,66 +1738,84 @@ int gmx_cluster(int argc, char *argv[])
     }
     else   /* !bReadMat */
     {
-        rms  = init_mat(nf, method == m_diagonalize);
-        nrms = (static_cast<gmx_int64_t>(nf)*static_cast<gmx_int64_t>(nf-1))/2;
+        rms       = init_mat(nf, method == m_diagonalize);
+        nrms      = (static_cast<gmx_int64_t>(nf)*static_cast<gmx_int64_t>(nf-1))/2;
+        nthreads  = gmx_omp_get_max_threads();
+        blockSize = 4*nthreads;
+        /* The rows are computed in blocks, with the rows of a block
+         * distributed over the threads. The entries are then stored
+         * in the original order, so the matrix statistics do not depend
+         * on the number of threads.
+         */
         if (!bRMSdist)
         {
             fprintf(stderr, "Computing %dx%d RMS deviation matrix\n", nf, nf);
-            /* Initialize work array */
-            snew(x1, isize);
-            for (i1 = 0; i1 < nf; i1++)
+            for (int b0 = 0; b0 < nf; b0 += blockSize)
             {
-                for (i2 = i1+1; i2 < nf; i2++)
+                int b1 = std::min(b0 + blockSize, nf);
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+                for (int r = b0; r < b1; r++)
                 {
-                    for (i = 0; i < isize; i++)
+                    try
                     {
-                        copy_rvec(xx[i1][i], x1[i]);
-                    }
-                    if (bFit)
-                    {
-                        do_fit(isize, mass, xx[i2], x1);
+                        for (int c = r+1; c < nf; c++)
+                        {
+                            /* With fitting the deviation is obtained directly
+                             * from the correlation matrix, without rotating.
+                             */
+                            rms->mat[r][c] = (bFit ?
+                                              rmsdev_fit(isize, mass, xx[c], xx[r]) :
+                                              rmsdev(isize, mass, xx[c], xx[r]));
+                        }
                     }
-                    rmsd = rmsdev(isize, mass, xx[i2], x1);
-                    set_mat_entry(rms, i1, i2, rmsd);
+                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
                 }
-                nrms -= nf-i1-1;
-                fprintf(stderr, "\r# RMSD calculations left: " "%" GMX_PRId64 "   ", nrms);
-                fflush(stderr);
+                store_mat_rows(rms, b0, b1, &nrms);
             }
-            sfree(x1);
         }
         else /* bRMSdist */
         {
             fprintf(stderr, "Computing %dx%d RMS distance deviation matrix\n", nf, nf);
-
-            /* Initiate work arrays */
-            snew(d1, isize);
-            snew(d2, isize);
-            for (i = 0; (i < isize); i++)
-            {
-                snew(d1[i], isize);
-                snew(d2[i], isize);
-            }
-            for (i1 = 0; i1 < nf; i1++)
+            for (int b0 = 0; b0 < nf; b0 += blockSize)
             {
-                calc_dist(isize, xx[i1], d1);
-                for (i2 = i1+1; (i2 < nf); i2++)
+                int b1 = std::min(b0 + blockSize, nf);
+#pragma omp parallel num_threads(nthreads)
                 {
-                    calc_dist(isize, xx[i2], d2);
-                    set_mat_entry(rms, i1, i2, rms_dist(isize, d1, d2));
+                    try
+                    {
+                        realA **d1, **d2;
+
+                        /* Initiate thread-local work arrays */
+                        snew(d1, isize);
+                        snew(d2, isize);
+                        for (int a = 0; (a < isize); a++)
+                        {
+                            snew(d1[a], isize);
+                            snew(d2[a], isize);
+                        }
+#pragma omp for schedule(dynamic)
+                        for (int r = b0; r < b1; r++)
+                        {
+                            calc_dist(isize, xx[r], d1);
+                            for (int c = r+1; (c < nf); c++)
+                            {
+                                calc_dist(isize, xx[c], d2);
+                                rms->mat[r][c] = rms_dist(isize, d1, d2);
+                            }
+                        }
+                        /* Clean up work arrays */
+                        for (int a = 0; (a < isize); a++)
+                        {
+                            sfree(d1[a]);
+                            sfree(d2[a]);
+                        }
+                        sfree(d1);
+                        sfree(d2);
+                    }
+                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
                 }
-                nrms -= nf-i1-1;
-                fprintf(stderr, "\r# RMSD calculations left: " "%" GMX_PRId64 "   ", nrms);
-                fflush(stderr);
-            }
-            /* Clean up work arrays */
-            for (i = 0; (i < isize); i++)
-            {
-                sfree(d1[i]);
-                sfree(d2[i]);
+                store_mat_rows(rms, b0, b1, &nrms);
             }
-            sfree(d1);
-            sfree(d2);
         }
         fprintf(stderr, "\n\n");
     }
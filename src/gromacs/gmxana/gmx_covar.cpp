@@ -39,6 +39,8 @@
 #include <cmath>
 #include <cstring>
 
+#include <algorithm>
+
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/matio.h"
@@ -55,11 +57,66 @@
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/sysinfo.h"
 
+/*! \brief Number of frames added to the covariance matrix at once */
+static const int c_covarBatchSize = 64;
+
+/*! \brief Adds the outer products of nbatch displacement vectors of length
+ * ndim, stored consecutively in xbatch, to the covariance matrix mat.
+ *
+ * As in the original frame-by-frame accumulation, only the elements of
+ * the upper triangle of 3x3 atom blocks are computed and the frames are
+ * added in order, so the result does not depend on the batch size or the
+ * number of threads. The atoms (triples of rows) are distributed over the
+ * threads and their rows are processed in column tiles, so the tiles of
+ * mat and of the batch stay in cache while the whole batch is added.
+ */
+static void add_covariance_batch(gmx_int64_t ndim, int nbatch, const realA *xbatch,
+                                 realA *mat)
+{
+    const gmx_int64_t tileSize = 64*DIM;
+    const gmx_int64_t natoms   = ndim/DIM;
+    const int         nthreads = gmx_omp_get_max_threads();
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (gmx_int64_t a = 0; a < natoms; a++)
+    {
+        try
+        {
+            /* Start at the diagonal atom block */
+            const gmx_int64_t r0 = DIM*a;
+
+            for (gmx_int64_t cStart = r0; cStart < ndim; cStart += tileSize)
+            {
+                const gmx_int64_t cEnd = std::min(ndim, cStart + tileSize);
+
+                for (int f = 0; f < nbatch; f++)
+                {
+                    const realA *xf = xbatch + ndim*f;
+
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        const realA  xr = xf[r0 + d];
+                        realA       *m  = mat + ndim*(r0 + d);
+
+                        for (gmx_int64_t c = cStart; c < cEnd; c++)
+                        {
+                            m[c] += xf[c]*xr;
+                        }
+                    }
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
 int gmx_covar(int argc, char *argv[])
 {
     const char       *desc[] = {
@@ -119,10 +176,11 @@ int gmx_covar(int argc, char *argv[])
     matrix            box, zerobox;
     realA             *sqrtm, *mat, *eigenvalues, sum, trace, inv_nframes;
     realA              t, tstart, tend, **mat2;
-    realA              xj, *w_rls = nullptr;
+    realA             *xbatch, *w_rls = nullptr;
+    rvec              *xb;
     realA              min, max, *axis;
-    int               natoms, nat, nframes0, nframes, nlevels;
-    gmx_int64_t       ndim, i, j, k, l;
+    int               natoms, nat, nframes0, nframes, nbatch, nlevels;
+    gmx_int64_t       ndim, i, j, k;
     int               WriteXref;
     const char       *fitfile, *trxfile, *ndxfile;
     const char       *eigvalfile, *eigvecfile, *averfile, *logfile;
@@ -303,6 +361,8 @@ int gmx_covar(int argc, char *argv[])
 
     fprintf(stderr, "Constructing covariance matrix (%dx%d) ...\n", static_cast<int>(ndim), static_cast<int>(ndim));
     nframes = 0;
+    nbatch  = 0;
+    snew(xbatch, ndim*c_covarBatchSize);
     nat     = read_first_x(oenv, &status, trxfile, &t, &xread, box);
     tstart  = t;
     do
@@ -319,42 +379,36 @@ int gmx_covar(int argc, char *argv[])
             reset_x(nfit, ifit, nat, nullptr, xread, w_rls);
             do_fit(nat, w_rls, xref, xread);
         }
+        /* Store the displacements in the batch */
+        xb = reinterpret_cast<rvec *>(xbatch + ndim*nbatch);
         if (bRef)
         {
             for (i = 0; i < natoms; i++)
             {
-                rvec_sub(xread[index[i]], xref[index[i]], x[i]);
+                rvec_sub(xread[index[i]], xref[index[i]], xb[i]);
             }
         }
         else
         {
             for (i = 0; i < natoms; i++)
             {
-                rvec_sub(xread[index[i]], xav[i], x[i]);
+                rvec_sub(xread[index[i]], xav[i], xb[i]);
             }
         }
+        nbatch++;
 
-        for (j = 0; j < natoms; j++)
+        if (nbatch == c_covarBatchSize)
         {
-            for (dj = 0; dj < DIM; dj++)
-            {
-                k  = ndim*(DIM*j+dj);
-                xj = x[j][dj];
-                for (i = j; i < natoms; i++)
-                {
-                    l = k+DIM*i;
-                    for (d = 0; d < DIM; d++)
-                    {
-                        mat[l+d] += x[i][d]*xj;
-                    }
-                }
-            }
+            add_covariance_batch(ndim, nbatch, xbatch, mat);
+            nbatch = 0;
         }
     }
     while (read_next_x(oenv, status, &t, xread, box) &&
            (bRef || nframes < nframes0));
     close_trx(status);
     gmx_rmpbc_done(gpbc);
+    add_covariance_batch(ndim, nbatch, xbatch, mat);
+    sfree(xbatch);
 
     fprintf(stderr, "Read %d frames\n", nframes);
 
@@ -510,45 +564,76 @@ int gmx_covar(int argc, char *argv[])
     }
 
 
+    /* Set 'end', the maximum eigenvector and -value index used for output */
+    if (end == -1)
+    {
+        if (nframes-1 < ndim)
+        {
+            end = nframes-1;
+            fprintf(stderr, "\nWARNING: there are fewer frames in your trajectory than there are\n");
+            fprintf(stderr, "degrees of freedom in your system. Only generating the first\n");
+            fprintf(stderr, "%d out of %d eigenvectors and eigenvalues.\n", end, static_cast<int>(ndim));
+        }
+        else
+        {
+            end = ndim;
+        }
+    }
+    end = std::max(std::min(static_cast<gmx_int64_t>(end), ndim), static_cast<gmx_int64_t>(0));
+
     /* call diagonalization routine */
 
     snew(eigenvalues, ndim);
     snew(eigenvectors, ndim*ndim);
 
-    std::memcpy(eigenvectors, mat, ndim*ndim*sizeof(realA));
-    fprintf(stderr, "\nDiagonalizing ...\n");
-    fflush(stderr);
-    eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+    if (end == 0)
+    {
+        /* With a single frame or -last 0 there is nothing to determine,
+         * and the partial solver would get an empty index range.
+         */
+        fprintf(stderr, "\nNo eigenvectors requested, skipping the diagonalization\n");
+    }
+    else
+    {
+        std::memcpy(eigenvectors, mat, ndim*ndim*sizeof(realA));
+        fprintf(stderr, "\nDiagonalizing ...\n");
+        fflush(stderr);
+        if (end < ndim)
+        {
+            /* Only determine the largest eigenvalues and their vectors, and
+             * move them to the end of the arrays as for the full solution.
+             */
+            eigensolver(eigenvectors, ndim, ndim-end, ndim, eigenvalues, mat);
+            std::memmove(eigenvalues + ndim - end, eigenvalues, end*sizeof(realA));
+            std::memmove(mat + ndim*(ndim - end), mat, ndim*end*sizeof(realA));
+        }
+        else
+        {
+            eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+        }
+    }
     sfree(eigenvectors);
 
     /* now write the output */
 
     sum = 0;
-    for (i = 0; i < ndim; i++)
+    for (i = ndim - end; i < ndim; i++)
     {
         sum += eigenvalues[i];
     }
-    fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n",
-            sum, bM ? "u " : "");
-    if (std::abs(trace-sum) > 0.01*trace)
+    if (end < ndim)
     {
-        fprintf(stderr, "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
+        fprintf(stderr, "\nSum of the %d largest eigenvalues: %g (%snm^2)\n",
+                static_cast<int>(end), sum, bM ? "u " : "");
     }
-
-    /* Set 'end', the maximum eigenvector and -value index used for output */
-    if (end == -1)
+    else
     {
-        if (nframes-1 < ndim)
-        {
-            end = nframes-1;
-            fprintf(stderr, "\nWARNING: there are fewer frames in your trajectory than there are\n");
-            fprintf(stderr, "degrees of freedom in your system. Only generating the first\n");
-            fprintf(stderr, "%d out of %d eigenvectors and eigenvalues.\n", end, static_cast<int>(ndim));
-        }
-        else
-        {
-            end = ndim;
-        }
+        fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n",
+                sum, bM ? "u " : "");
+    }
+    if (std::abs(trace-sum) > 0.01*trace && (end == ndim || sum > trace))
+    {
+        fprintf(stderr, "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
     }
 
     fprintf(stderr, "\nWriting eigenvalues to %s\n", eigvalfile);
@@ -627,8 +712,16 @@ int gmx_covar(int argc, char *argv[])
     fprintf(out, "Diagonalized the %dx%d covariance matrix\n", static_cast<int>(ndim), static_cast<int>(ndim));
     fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n",
             trace);
-    fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
-            sum);
+    if (end < ndim)
+    {
+        fprintf(out, "Sum of the %d largest eigenvalues: %g\n\n",
+                static_cast<int>(end), sum);
+    }
+    else
+    {
+        fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
+                sum);
+    }
 
     fprintf(out, "Wrote %d eigenvalues to %s\n", static_cast<int>(end), eigvalfile);
     if (WriteXref == eWXR_YES)
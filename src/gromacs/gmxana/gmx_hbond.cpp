@@ -43,6 +43,7 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
@@ -50,6 +51,7 @@
 #include "gromacs/correlationfunctions/crosscorr.h"
 #include "gromacs/correlationfunctions/expfit.h"
 #include "gromacs/correlationfunctions/integrate.h"
+#include "gromacs/correlationfunctions/manyautocorrelation.h"
 #include "gromacs/fileio/matio.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
@@ -1921,32 +1923,20 @@ static void do_hbac(const char *fn, t_hbdata *hb,
         "Cc\\scontact,hb\\v{}\\z{}(t)",
         "-dAc\\sfs\\v{}\\z{}/dt"
     };
-    gmx_bool       bNorm = FALSE;
     double         nhb   = 0;
-    realA          *rhbex = nullptr, *ht, *gt, *ght, *dght, *kt;
+    realA          *ght, *kt;
     realA          *ct, tail, tail2, dtail, *cct;
     const realA     tol     = 1e-3;
     int            nframes = hb->nframes;
     unsigned int **h       = nullptr, **g = nullptr;
     int            nh, nhbonds, nhydro;
     t_hbond       *hbh;
-    int            acType;
-    int           *dondata      = nullptr;
-
-    enum {
-        AC_NONE, AC_NN, AC_GEM, AC_LUZAR
-    };
-
-    const bool bOMP = GMX_OPENMP;
 
     printf("Doing autocorrelation ");
-
-    acType = AC_LUZAR;
     printf("according to the theory of Luzar and Chandler.\n");
     fflush(stdout);
 
-    /* build hbexist matrix in reals for autocorr */
-    /* Allocate memory for computing ACF (rhbex) and aggregating the ACF (ct) */
+    /* Allocate memory for aggregating the ACF (ct) */
     n2 = 1;
     while (n2 < nframes)
     {
@@ -1955,55 +1945,15 @@ static void do_hbac(const char *fn, t_hbdata *hb,
 
     nn = nframes/2;
 
-    if (acType != AC_NN || bOMP)
-    {
-        snew(h, hb->maxhydro);
-        snew(g, hb->maxhydro);
-    }
+    snew(h, hb->maxhydro);
+    snew(g, hb->maxhydro);
 
     /* Dump hbonds for debugging */
     dump_ac(hb, bMerge || bContact, nDump);
 
-    /* Total number of hbonds analyzed here */
-    nhbonds = 0;
-
-    if (acType != AC_LUZAR && bOMP)
-    {
-        nThreads = std::min((nThreads <= 0) ? INT_MAX : nThreads, gmx_omp_get_max_threads());
-
-        gmx_omp_set_num_threads(nThreads);
-        snew(dondata, nThreads);
-        for (i = 0; i < nThreads; i++)
-        {
-            dondata[i] = -1;
-        }
-        printf("ACF calculations parallelized with OpenMP using %i threads.\n"
-               "Expect close to linear scaling over this donor-loop.\n", nThreads);
-        fflush(stdout);
-        fprintf(stderr, "Donors: [thread no]\n");
-        {
-            char tmpstr[7];
-            for (i = 0; i < nThreads; i++)
-            {
-                snprintf(tmpstr, 7, "[%i]", i);
-                fprintf(stderr, "%-7s", tmpstr);
-            }
-        }
-        fprintf(stderr, "\n");
-    }
-
-
-    /* Build the ACF */
-    snew(rhbex, 2*n2);
-    snew(ct, 2*n2);
-    snew(gt, 2*n2);
-    snew(ht, 2*n2);
-    snew(ght, 2*n2);
-    snew(dght, 2*n2);
-
-    snew(kt, nn);
-    snew(cct, nn);
-
+    /* Collect the existence arrays of all hbonds (or contacts) analyzed here */
+    std::vector<unsigned int *> hbExist, distExist;
+    std::vector<int>            hbNframes;
     for (i = 0; (i < hb->d.nrd); i++)
     {
         for (k = 0; (k < hb->a.nra); k++)
@@ -2035,67 +1985,134 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                     }
                 }
 
-                int nf = hbh->nframes;
                 for (nh = 0; (nh < nhydro); nh++)
                 {
-                    int nrint = bContact ? hb->nrdist : hb->nrhb;
-                    if ((((nhbonds+1) % 10) == 0) || (nhbonds+1 == nrint))
-                    {
-                        fprintf(stderr, "\rACF %d/%d", nhbonds+1, nrint);
-                        fflush(stderr);
-                    }
-                    nhbonds++;
-                    for (j = 0; (j < nframes); j++)
-                    {
-                        if (j <= nf)
-                        {
-                            ihb   = is_hb(h[nh], j);
-                            idist = is_hb(g[nh], j);
-                        }
-                        else
-                        {
-                            ihb = idist = 0;
-                        }
-                        rhbex[j] = ihb;
-                        /* For contacts: if a second cut-off is provided, use it,
-                         * otherwise use g(t) = 1-h(t) */
-                        if (!R2 && bContact)
-                        {
-                            gt[j]  = 1-ihb;
-                        }
-                        else
-                        {
-                            gt[j]  = idist*(1-ihb);
-                        }
-                        ht[j]    = rhbex[j];
-                        nhb     += ihb;
-                    }
+                    hbExist.push_back(h[nh]);
+                    distExist.push_back(g[nh]);
+                    hbNframes.push_back(hbh->nframes);
+                }
+            }
+        }
+    }
+    sfree(h);
+    sfree(g);
+    nhbonds = static_cast<int>(hbExist.size());
+
+    /* Build the ACF.
+     * The correlation functions are computed for batches of hbonds at once,
+     * such that the FFTs within a batch run in parallel, while the memory
+     * for the real-valued time series stays bounded. The batches are summed
+     * in hbond order, so the result does not depend on the number of threads.
+     */
+    nThreads = std::min((nThreads <= 0) ? INT_MAX : nThreads, gmx_omp_get_max_threads());
+    gmx_omp_set_num_threads(nThreads);
+    if (nThreads > 1)
+    {
+        printf("ACF calculations parallelized with OpenMP using %i threads.\n", nThreads);
+        fflush(stdout);
+    }
 
-                    /* The autocorrelation function is normalized after summation only */
-                    low_do_autocorr(nullptr, oenv, nullptr, nframes, 1, -1, &rhbex, hb->time[1]-hb->time[0],
-                                    eacNormal, 1, FALSE, bNorm, FALSE, 0, -1, 0);
+    const int                        batchSize = 4*nThreads;
+    std::vector<std::vector<realA> > acBatch;
+    realA                          **htBatch, **gtBatch, **ghtBatch;
+    int                             *nData;
 
-                    /* Cross correlation analysis for thermodynamics */
-                    for (j = nframes; (j < n2); j++)
-                    {
-                        ht[j] = 0;
-                        gt[j] = 0;
-                    }
+    snew(htBatch, batchSize);
+    snew(gtBatch, batchSize);
+    snew(ghtBatch, batchSize);
+    snew(nData, batchSize);
+    for (int b = 0; b < batchSize; b++)
+    {
+        snew(htBatch[b], n2);
+        snew(gtBatch[b], n2);
+        snew(ghtBatch[b], n2);
+        nData[b] = n2;
+    }
 
-                    cross_corr(n2, ht, gt, dght);
+    snew(ct, 2*n2);
+    snew(ght, 2*n2);
 
-                    for (j = 0; (j < nn); j++)
-                    {
-                        ct[j]  += rhbex[j];
-                        ght[j] += dght[j];
-                    }
+    snew(kt, nn);
+    snew(cct, nn);
+
+    for (int b0 = 0; b0 < nhbonds; b0 += batchSize)
+    {
+        int nbatch = std::min(batchSize, nhbonds - b0);
+
+        fprintf(stderr, "\rACF %d/%d", b0 + nbatch, nhbonds);
+        fflush(stderr);
+
+        acBatch.resize(nbatch);
+        for (int b = 0; b < nbatch; b++)
+        {
+            unsigned int *hb_h = hbExist[b0 + b];
+            unsigned int *hb_g = distExist[b0 + b];
+            int           nf   = hbNframes[b0 + b];
+            realA        *ht   = htBatch[b];
+            realA        *gt   = gtBatch[b];
+
+            acBatch[b].assign(nframes, 0);
+            for (j = 0; (j < nframes); j++)
+            {
+                if (j <= nf)
+                {
+                    ihb   = is_hb(hb_h, j);
+                    idist = is_hb(hb_g, j);
                 }
+                else
+                {
+                    ihb = idist = 0;
+                }
+                acBatch[b][j] = ihb;
+                /* For contacts: if a second cut-off is provided, use it,
+                 * otherwise use g(t) = 1-h(t) */
+                if (!R2 && bContact)
+                {
+                    gt[j]  = 1-ihb;
+                }
+                else
+                {
+                    gt[j]  = idist*(1-ihb);
+                }
+                ht[j]    = ihb;
+                nhb     += ihb;
+            }
+            /* Zero padding for the cross correlation */
+            for (j = nframes; (j < n2); j++)
+            {
+                ht[j] = 0;
+                gt[j] = 0;
+            }
+        }
+
+        /* The autocorrelation functions are normalized after summation only */
+        many_auto_correl(&acBatch);
+
+        /* Cross correlation analysis for thermodynamics */
+        many_cross_corr(nbatch, nData, htBatch, gtBatch, ghtBatch);
+
+        for (int b = 0; b < nbatch; b++)
+        {
+            for (j = 0; (j < nn); j++)
+            {
+                ct[j]  += acBatch[b][j]/(realA)(nframes-j);
+                ght[j] += ghtBatch[b][j];
             }
         }
     }
     fprintf(stderr, "\n");
-    sfree(h);
-    sfree(g);
+
+    for (int b = 0; b < batchSize; b++)
+    {
+        sfree(htBatch[b]);
+        sfree(gtBatch[b]);
+        sfree(ghtBatch[b]);
+    }
+    sfree(htBatch);
+    sfree(gtBatch);
+    sfree(ghtBatch);
+    sfree(nData);
+
     normalizeACF(ct, ght, static_cast<int>(nhb), nn);
 
     /* Determine tail value for statistics */
@@ -2153,12 +2170,8 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                  fit_start, temp);
 
     do_view(oenv, fn, nullptr);
-    sfree(rhbex);
     sfree(ct);
-    sfree(gt);
-    sfree(ht);
     sfree(ght);
-    sfree(dght);
     sfree(cct);
     sfree(kt);
 }
@@ -36,11 +36,16 @@
  */
 #include "gmxpre.h"
 
+#include <climits>
 #include <cmath>
 #include <cstring>
 
+#include <algorithm>
+#include <vector>
+
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
+#include "gromacs/fft/fft.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/fileio/xvgr.h"
@@ -54,9 +59,11 @@
 #include "gromacs/topology/index.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arraysize.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define FACTOR  1000.0  /* Convert nm^2/ps to 10e-5 cm^2/s */
@@ -837,6 +844,349 @@ static int corr_loop(t_corr *curr, const char *fn, const t_topology *top, int eP
     return natoms;
 }
 
+/* Returns the smallest even FFT length >= n with only factors 2, 3 and 5 */
+static int fft_size(int n)
+{
+    for (int nfft = std::max(2, n + (n % 2));; nfft += 2)
+    {
+        int f = nfft;
+        for (int p : { 2, 3, 5 })
+        {
+            while (f % p == 0)
+            {
+                f /= p;
+            }
+        }
+        if (f == 1)
+        {
+            return nfft;
+        }
+    }
+}
+
+/* Returns the number of atoms, at least one, whose coordinates for nframes
+ * frames fit in maxBytes bytes */
+static int columns_in_memory(gmx_int64_t maxBytes, int nframes)
+{
+    gmx_int64_t n = maxBytes/(static_cast<gmx_int64_t>(nframes)*sizeof(gmx::RVec));
+
+    return static_cast<int>(std::min<gmx_int64_t>(std::max<gmx_int64_t>(n, 1), INT_MAX));
+}
+
+/* Unwraps the coordinates of the atoms in columns c0 to c1 of the
+ * concatenated group indices, i.e. removes periodic boundary crossings.
+ */
+static void prep_columns(int ngrp, const int gnx[], int *index[], int c0, int c1,
+                         rvec xcur[], rvec xprev[], matrix box)
+{
+    int offset = 0;
+
+    for (int g = 0; g < ngrp; g++)
+    {
+        int start = std::max(c0 - offset, 0);
+        int end   = std::min(c1 - offset, gnx[g]);
+        if (end > start)
+        {
+            prep_data(FALSE, end - start, index[g] + start, xcur, xprev, box);
+        }
+        offset += gnx[g];
+    }
+}
+
+/* Computes the MSD over all time origins with FFTs, as an alternative for
+ * corr_loop and calc_corr. Per atom and dimension, the MSD for lag m over
+ * all N-m origins is split into a sum of squares, computed by recursion,
+ * minus twice the position autocorrelation, computed from the power
+ * spectrum (Calandrini et al., Collection SFN 12, 201 (2011)).
+ * As the power spectra are summed over the atoms before the inverse
+ * transform, only one forward transform per atom and dimension is needed.
+ *
+ * The unwrapped coordinates are stored for all frames, but at most for
+ * as many atoms as fit in maxMem MB; the trajectory is read again for
+ * each following block of atoms.
+ */
+static void corr_loop_fft(t_corr *curr, const char *fn, const t_topology *top,
+                          int gnx[], int *index[], gmx_bool bMW,
+                          int *gnx_com, int *index_com[], int maxMem,
+                          const gmx_output_env_t *oenv)
+{
+    rvec              *x[2];
+    rvec               com = {0};
+    realA              t;
+    int                natoms, cur = 0;
+    t_trxstatus       *status;
+    matrix             box;
+    std::vector<gmx::RVec>  comFrame;
+    gmx_bool           bDim[DIM];
+    int                ncol, c0, c1, nframes = 0;
+    const gmx_int64_t  maxBytes = static_cast<gmx_int64_t>(std::max(maxMem, 1))*1024*1024;
+
+    for (int d = 0; d < DIM; d++)
+    {
+        switch (curr->type)
+        {
+            case NORMAL:  bDim[d] = TRUE; break;
+            case X:
+            case Y:
+            case Z:       bDim[d] = (d == curr->type - X); break;
+            case LATERAL: bDim[d] = (d != curr->axis); break;
+            default:
+                gmx_fatal(FARGS, "Error: did not expect option value %d", curr->type);
+        }
+    }
+
+    ncol = 0;
+    for (int g = 0; g < curr->ngrp; g++)
+    {
+        ncol += gnx[g];
+    }
+
+    int                 nfft  = 0, nspec = 0;
+    std::vector<double> wtot(curr->ngrp, 0);
+    /* Per group, the power spectrum and the sum of squares per frame */
+    std::vector<std::vector<double> > power(curr->ngrp), sqsum(curr->ngrp);
+
+    /* Each pass over the trajectory stores columns c0 to c1 */
+    c0 = 0;
+    c1 = ncol;
+    while (c0 < ncol)
+    {
+        std::vector<std::vector<gmx::RVec> > colx(c1 - c0);
+        int frame = 0;
+
+        natoms = read_first_x(oenv, &status, fn, &t, &(x[cur]), box);
+        snew(x[1-cur], natoms);
+        if (c0 == 0)
+        {
+            curr->t0 = t;
+        }
+        do
+        {
+            if (c0 == 0)
+            {
+                srenew(curr->time, frame + 1);
+                curr->time[frame] = t - curr->t0;
+            }
+            else if (frame >= nframes)
+            {
+                gmx_fatal(FARGS, "The trajectory changed between reading passes");
+            }
+            if (frame == 0)
+            {
+                std::memcpy(x[1-cur], x[cur], natoms*sizeof(x[cur][0]));
+            }
+            prep_columns(curr->ngrp, gnx, index, c0, c1, x[cur], x[1-cur], box);
+            if (gnx_com)
+            {
+                if (c0 == 0)
+                {
+                    calc_com(FALSE, gnx_com[0], index_com[0], x[cur], x[1-cur], box,
+                             &top->atoms, com);
+                    comFrame.push_back(com);
+                }
+                else
+                {
+                    copy_rvec(comFrame[frame], com);
+                }
+            }
+
+            int offset = 0, g = 0;
+            for (int c = c0; c < c1; c++)
+            {
+                while (c - offset >= gnx[g])
+                {
+                    offset += gnx[g];
+                    g++;
+                }
+                gmx::RVec xc;
+                rvec_sub(x[cur][index[g][c - offset]], com, xc);
+                colx[c - c0].push_back(xc);
+            }
+            frame++;
+
+            /* In the first pass, drop the last columns when out of memory */
+            if (c0 == 0 && c1 - c0 > columns_in_memory(maxBytes, frame))
+            {
+                c1 = c0 + columns_in_memory(maxBytes, frame);
+                colx.resize(c1 - c0);
+            }
+            cur = 1 - cur;
+        }
+        while (read_next_x(oenv, status, &t, x[cur], box));
+        close_trx(status);
+        sfree(x[0]);
+        sfree(x[1]);
+
+        if (c0 == 0)
+        {
+            nframes  = frame;
+            nfft  = fft_size(2*nframes);
+            nspec = nfft/2 + 1;
+            for (int g = 0; g < curr->ngrp; g++)
+            {
+                power[g].resize(nspec, 0);
+                sqsum[g].resize(nframes, 0);
+            }
+            if (c1 < ncol)
+            {
+                fprintf(stderr, "\nStoring %d of %d atoms per pass over the trajectory\n",
+                        c1 - c0, ncol);
+            }
+        }
+        else if (frame != nframes)
+        {
+            gmx_fatal(FARGS, "The trajectory changed between reading passes");
+        }
+
+        /* Accumulate the power spectra and squares of the stored columns */
+        int nthreads = gmx_omp_get_max_threads();
+        std::vector<std::vector<double> > powerThread(nthreads*curr->ngrp);
+        std::vector<std::vector<double> > sqsumThread(nthreads*curr->ngrp);
+        std::vector<double> wtotThread(nthreads*curr->ngrp, 0);
+#pragma omp parallel num_threads(nthreads)
+        {
+            try
+            {
+                int                    th = gmx_omp_get_thread_num();
+                gmx_fft_t              fft;
+                std::vector<realA>     in(nfft);
+                std::vector<t_complex> out(nspec);
+
+                for (int g = 0; g < curr->ngrp; g++)
+                {
+                    powerThread[th*curr->ngrp + g].resize(nspec, 0);
+                    sqsumThread[th*curr->ngrp + g].resize(nframes, 0);
+                }
+                gmx_fft_init_1d_real(&fft, nfft, GMX_FFT_FLAG_CONSERVATIVE);
+#pragma omp for schedule(dynamic)
+                for (int c = c0; c < c1; c++)
+                {
+                    int offset = 0, g = 0;
+                    while (c - offset >= gnx[g])
+                    {
+                        offset += gnx[g];
+                        g++;
+                    }
+                    int    ix = index[g][c - offset];
+                    double w  = bMW ? curr->mass[ix] : 1;
+                    if (w == 0)
+                    {
+                        continue;
+                    }
+                    const std::vector<gmx::RVec> &xc = colx[c - c0];
+                    std::vector<double>     &pw = powerThread[th*curr->ngrp + g];
+                    std::vector<double>     &sq = sqsumThread[th*curr->ngrp + g];
+                    wtotThread[th*curr->ngrp + g] += w;
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        if (!bDim[d])
+                        {
+                            continue;
+                        }
+                        /* The MSD is invariant to a shift, subtracting
+                         * the average improves the precision.
+                         */
+                        double av = 0;
+                        for (int k = 0; k < nframes; k++)
+                        {
+                            av += xc[k][d];
+                        }
+                        av /= nframes;
+                        for (int k = 0; k < nframes; k++)
+                        {
+                            double dx = xc[k][d] - av;
+                            in[k]     = dx;
+                            sq[k]    += w*dx*dx;
+                        }
+                        std::fill(in.begin() + nframes, in.end(), 0);
+                        gmx_fft_1d_real(fft, GMX_FFT_REAL_TO_COMPLEX, in.data(), out.data());
+                        for (int j = 0; j < nspec; j++)
+                        {
+                            pw[j] += w*(gmx::square(static_cast<double>(out[j].re)) +
+                                        gmx::square(static_cast<double>(out[j].im)));
+                        }
+                    }
+                    /* Release the column as soon as it is processed */
+                    std::vector<gmx::RVec>().swap(colx[c - c0]);
+                }
+                gmx_fft_destroy(fft);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        }
+        for (int th = 0; th < nthreads; th++)
+        {
+            for (int g = 0; g < curr->ngrp; g++)
+            {
+                for (int j = 0; j < nspec; j++)
+                {
+                    power[g][j] += powerThread[th*curr->ngrp + g][j];
+                }
+                for (int k = 0; k < nframes; k++)
+                {
+                    sqsum[g][k] += sqsumThread[th*curr->ngrp + g][k];
+                }
+                wtot[g] += wtotThread[th*curr->ngrp + g];
+            }
+        }
+
+        c0 = c1;
+        c1 = std::min(ncol, c0 + columns_in_memory(maxBytes, nframes));
+    }
+
+    /* Back transform the summed spectra and combine with the squares */
+    gmx_fft_t              fft;
+    std::vector<t_complex> in(nspec);
+    std::vector<realA>     acf(nfft);
+
+    gmx_fft_init_1d_real(&fft, nfft, GMX_FFT_FLAG_CONSERVATIVE);
+    curr->nframes  = nframes;
+    curr->nrestart = nframes;
+    for (int g = 0; g < curr->ngrp; g++)
+    {
+        snew(curr->data[g], nframes);
+        snew(curr->ndata[g], nframes);
+        for (int j = 0; j < nspec; j++)
+        {
+            in[j].re = power[g][j]/nfft;
+            in[j].im = 0;
+        }
+        gmx_fft_1d_real(fft, GMX_FFT_COMPLEX_TO_REAL, in.data(), acf.data());
+
+        double q = 0;
+        for (int k = 0; k < nframes; k++)
+        {
+            q += 2*sqsum[g][k];
+        }
+        for (int m = 0; m < nframes; m++)
+        {
+            if (m > 0)
+            {
+                q -= sqsum[g][m-1] + sqsum[g][nframes-m];
+            }
+            curr->ndata[g][m] = 1;
+            if (m > 0 && wtot[g] > 0)
+            {
+                curr->data[g][m] = std::max(0.0, (q - 2*acf[m])/((nframes - m)*wtot[g]));
+            }
+        }
+    }
+    gmx_fft_destroy(fft);
+
+    for (int k = 2; k < nframes; k++)
+    {
+        if (std::abs((curr->time[k] - curr->time[k-1]) - curr->time[1]) > 1e-3*curr->time[1])
+        {
+            fprintf(stderr, "\nWARNING: The frames are not equally spaced in time, "
+                    "the MSD computed with FFTs will not be correct\n");
+            break;
+        }
+    }
+    fprintf(stderr, "\nUsed all %d frames as restart points over %g %s\n\n",
+            nframes,
+            output_env_conv_time(oenv, curr->time[nframes-1]),
+            output_env_get_time_unit(oenv).c_str());
+}
+
 static void index_atom2mol(int *n, int *index, const t_block *mols)
 {
     int nat, i, nmol, mol, j;
@@ -874,7 +1224,7 @@ static void index_atom2mol(int *n, int *index, const t_block *mols)
 static void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
                     const char *mol_file, const char *pdb_file, realA t_pdb,
                     int nrgrp, t_topology *top, int ePBC,
-                    gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM,
+                    gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM, gmx_bool bFFT, int maxMem,
                     int type, realA dim_factor, int axis,
                     realA dt, realA beginfit, realA endfit, const gmx_output_env_t *oenv)
 {
@@ -916,11 +1266,19 @@ static void do_corr(const char *trx_file, const char *ndx_file, const char *msd_
                     mol_file == nullptr ? 0 : gnx[0], bTen, bMW, dt, top,
                     beginfit, endfit);
 
-    nat_trx =
-        corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
-                  (mol_file != nullptr) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
-                  bTen, gnx_com, index_com, dt, t_pdb,
-                  pdb_file ? &x : nullptr, box, oenv);
+    if (bFFT)
+    {
+        corr_loop_fft(msd, trx_file, top, gnx, index, bMW, gnx_com, index_com, maxMem, oenv);
+        nat_trx = 0;
+    }
+    else
+    {
+        nat_trx =
+            corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
+                      (mol_file != nullptr) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
+                      bTen, gnx_com, index_com, dt, t_pdb,
+                      pdb_file ? &x : nullptr, box, oenv);
+    }
 
     /* Correct for the number of points */
     for (j = 0; (j < msd->ngrp); j++)
@@ -1071,7 +1429,16 @@ int gmx_msd(int argc, char *argv[])
         "Option [TT]-pdb[tt] writes a [REF].pdb[ref] file with the coordinates of the frame",
         "at time [TT]-tpdb[tt] with in the B-factor field the square root of",
         "the diffusion coefficient of the molecule.",
-        "This option implies option [TT]-mol[tt]."
+        "This option implies option [TT]-mol[tt].[PAR]",
+        "With option [TT]-fft[tt] every frame is used as a reference point,",
+        "independently of [TT]-trestart[tt], and the MSD is computed using",
+        "fast Fourier transforms, which scales as N log N with the number",
+        "of frames N instead of as N times the number of reference points.",
+        "The frames should then be equally spaced in time.",
+        "The coordinates of all frames are stored for at most as many atoms",
+        "as fit in [TT]-maxmem[tt] MB, for larger groups the trajectory",
+        "is read multiple times. This option can not be combined with",
+        "[TT]-ten[tt] or [TT]-mol[tt]."
     };
     static const char *normtype[] = { nullptr, "no", "x", "y", "z", nullptr };
     static const char *axtitle[]  = { nullptr, "no", "x", "y", "z", nullptr };
@@ -1083,6 +1450,8 @@ int gmx_msd(int argc, char *argv[])
     static gmx_bool    bTen       = FALSE;
     static gmx_bool    bMW        = TRUE;
     static gmx_bool    bRmCOMM    = FALSE;
+    static gmx_bool    bFFT       = FALSE;
+    static int         maxMem     = 1024;
     t_pargs            pa[]       = {
         { "-type",    FALSE, etENUM, {normtype},
           "Compute diffusion coefficient in one direction" },
@@ -1103,7 +1472,11 @@ int gmx_msd(int argc, char *argv[])
         { "-beginfit", FALSE, etTIME, {&beginfit},
           "Start time for fitting the MSD (%t), -1 is 10%" },
         { "-endfit", FALSE, etTIME, {&endfit},
-          "End time for fitting the MSD (%t), -1 is 90%" }
+          "End time for fitting the MSD (%t), -1 is 90%" },
+        { "-fft", FALSE, etBOOL, {&bFFT},
+          "Use all frames as reference points and compute the MSD with FFTs" },
+        { "-maxmem", FALSE, etINT, {&maxMem},
+          "Maximum memory (MB) for storing coordinates with [TT]-fft[tt]" }
     };
 
     t_filenm           fnm[] = {
@@ -1191,6 +1564,10 @@ int gmx_msd(int argc, char *argv[])
     {
         gmx_fatal(FARGS, "Can only calculate the full tensor for 3D msd");
     }
+    if (bFFT && (bTen || mol_file))
+    {
+        gmx_fatal(FARGS, "Option -fft can not be combined with -ten or -mol");
+    }
 
     bTop = read_tps_conf(tps_file, &top, &ePBC, &xdum, nullptr, box, bMW || bRmCOMM);
     if (mol_file && !bTop)
@@ -1201,7 +1578,7 @@ int gmx_msd(int argc, char *argv[])
     }
 
     do_corr(trx_file, ndx_file, msd_file, mol_file, pdb_file, t_pdb, ngroup,
-            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit,
+            &top, ePBC, bTen, bMW, bRmCOMM, bFFT, maxMem, type, dim_factor, axis, dt, beginfit, endfit,
             oenv);
 
     view_all(oenv, NFILE, fnm);
@@ -59,8 +59,10 @@
 #include "gromacs/topology/index.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arraysize.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -222,26 +224,25 @@ int gmx_rms(int argc, char *argv[])
           "HIDDENAverage over this distance in the RMSD matrix" }
     };
     int             natoms_trx, natoms_trx2, natoms;
-    int             i, j, k, m;
+    int             i, j, k;
 #define NFRAME 5000
     int             maxframe = NFRAME, maxframe2 = NFRAME;
     realA            t, *w_rls, *w_rms, *w_rls_m = nullptr, *w_rms_m = nullptr;
     gmx_bool        bNorm, bAv, bFreq2, bFile2, bMat, bBond, bDelta, bMirror, bMass;
-    gmx_bool        bFit, bReset;
+    gmx_bool        bFit, bReset, bQCP;
     t_topology      top;
     int             ePBC;
     t_iatom        *iatom = nullptr;
 
     matrix          box = {{0}};
-    rvec           *x, *xp, *xm = nullptr, **mat_x = nullptr, **mat_x2, *mat_x2_j = nullptr, vec1,
-                    vec2;
+    rvec           *x, *xp, *xm = nullptr, **mat_x = nullptr, **mat_x2;
     t_trxstatus    *status;
     char            buf[256], buf2[256];
     int             ncons = 0;
     FILE           *fp;
     realA            rlstot = 0, **rls, **rlsm = nullptr, *time, *time2, *rlsnorm = nullptr,
     **rmsd_mat             = nullptr, **bond_mat = nullptr, *axis, *axis2, *del_xaxis,
-    *del_yaxis, rmsd_max, rmsd_min, rmsd_avg, bond_max, bond_min, ang;
+    *del_yaxis, rmsd_max, rmsd_min, rmsd_avg, bond_max, bond_min;
     realA            **rmsdav_mat = nullptr, av_tot, weight, weight_tot;
     realA            **delta      = nullptr, delta_max, delta_scalex = 0, delta_scaley = 0,
     *delta_tot;
@@ -867,15 +868,32 @@ int gmx_rms(int argc, char *argv[])
             }
         }
 
-        if (bFitAll)
+        /* When fitting and RMSD use the same atoms and weights, the RMSD
+         * after fitting can be obtained directly from the correlation
+         * matrix, without rotating the coordinates.
+         */
+        bQCP = (bMat && !bBond && bFitAll && ewhat == ewRMSD);
+        for (k = 0; k < n_ind_m && bQCP; k++)
         {
-            snew(mat_x2_j, natoms);
+            bQCP = (w_rls_m[k] == w_rms_m[k]);
         }
+        if (bQCP)
+        {
+            int nw_rms = 0, nw_rms_ind = 0;
+            for (k = 0; k < n_ind_m; k++)
+            {
+                nw_rms += (w_rms_m[k] != 0) ? 1 : 0;
+            }
+            for (k = 0; k < irms[0]; k++)
+            {
+                nw_rms_ind += (w_rms_m[ind_rms_m[k]] != 0) ? 1 : 0;
+            }
+            bQCP = (nw_rms == nw_rms_ind);
+        }
+
         for (i = 0; i < tel_mat; i++)
         {
             axis[i] = time[freq*i];
-            fprintf(stderr, "\r element %5d; time %5.2f  ", i, axis[i]);
-            fflush(stderr);
             if (bMat)
             {
                 snew(rmsd_mat[i], tel_mat2);
@@ -884,27 +902,82 @@ int gmx_rms(int argc, char *argv[])
             {
                 snew(bond_mat[i], tel_mat2);
             }
-            for (j = 0; j < tel_mat2; j++)
+        }
+        /* Compute the independent elements, the rows are distributed over
+         * the threads. The extremes and average are collected afterwards
+         * in the original order.
+         */
+        int nthreads = gmx_omp_get_max_threads();
+#pragma omp parallel num_threads(nthreads)
+        {
+            try
             {
-                if (bFitAll)
+                rvec *x2_fit = nullptr;
+
+                if (bFitAll && !bQCP)
                 {
-                    for (k = 0; k < n_ind_m; k++)
-                    {
-                        copy_rvec(mat_x2[j][k], mat_x2_j[k]);
-                    }
-                    do_fit(n_ind_m, w_rls_m, mat_x[i], mat_x2_j);
+                    snew(x2_fit, n_ind_m);
                 }
-                else
+#pragma omp for schedule(dynamic)
+                for (int ii = 0; ii < tel_mat; ii++)
                 {
-                    mat_x2_j = mat_x2[j];
+                    for (int jj = (bFile2 ? 0 : ii); jj < tel_mat2; jj++)
+                    {
+                        gmx_bool bDoMat  = (bMat && (bFile2 || ii < jj));
+                        gmx_bool bDoBond = bBond;
+                        rvec    *x2      = mat_x2[jj];
+
+                        if (!bDoMat && !bDoBond)
+                        {
+                            continue;
+                        }
+                        if (bQCP)
+                        {
+                            rmsd_mat[ii][jj] = rmsdev_fit(n_ind_m, w_rls_m, mat_x[ii], x2);
+                            continue;
+                        }
+                        if (bFitAll)
+                        {
+                            for (int a = 0; a < n_ind_m; a++)
+                            {
+                                copy_rvec(x2[a], x2_fit[a]);
+                            }
+                            do_fit(n_ind_m, w_rls_m, mat_x[ii], x2_fit);
+                            x2 = x2_fit;
+                        }
+                        if (bDoMat)
+                        {
+                            rmsd_mat[ii][jj] =
+                                calc_similar_ind(ewhat != ewRMSD, irms[0], ind_rms_m,
+                                                 w_rms_m, mat_x[ii], x2);
+                        }
+                        if (bDoBond)
+                        {
+                            realA angSum = 0.0;
+                            rvec  v1, v2;
+                            for (int b = 0; b < ibond; b++)
+                            {
+                                rvec_sub(mat_x[ii][ind_bond1[b]], mat_x[ii][ind_bond2[b]], v1);
+                                rvec_sub(x2[ind_bond1[b]], x2[ind_bond2[b]], v2);
+                                angSum += std::acos(cos_angle(v1, v2));
+                            }
+                            bond_mat[ii][jj] = angSum*180.0/(M_PI*ibond);
+                        }
+                    }
                 }
+                sfree(x2_fit);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        }
+
+        for (i = 0; i < tel_mat; i++)
+        {
+            for (j = 0; j < tel_mat2; j++)
+            {
                 if (bMat)
                 {
                     if (bFile2 || (i < j))
                     {
-                        rmsd_mat[i][j] =
-                            calc_similar_ind(ewhat != ewRMSD, irms[0], ind_rms_m,
-                                             w_rms_m, mat_x[i], mat_x2_j);
                         if (rmsd_mat[i][j] > rmsd_max)
                         {
                             rmsd_max = rmsd_mat[i][j];
@@ -924,14 +997,6 @@ int gmx_rms(int argc, char *argv[])
                 {
                     if (bFile2 || (i <= j))
                     {
-                        ang = 0.0;
-                        for (m = 0; m < ibond; m++)
-                        {
-                            rvec_sub(mat_x[i][ind_bond1[m]], mat_x[i][ind_bond2[m]], vec1);
-                            rvec_sub(mat_x2_j[ind_bond1[m]], mat_x2_j[ind_bond2[m]], vec2);
-                            ang += std::acos(cos_angle(vec1, vec2));
-                        }
-                        bond_mat[i][j] = ang*180.0/(M_PI*ibond);
                         if (bond_mat[i][j] > bond_max)
                         {
                             bond_max = bond_mat[i][j];
@@ -188,6 +188,18 @@ typedef struct
 
     /*! \brief TRUE, if any data point of the histogram is within min and max, otherwise FALSE */
     gmx_bool **bContrib;
+    /*! \brief Boltzmann factors exp(-U/kT) of the umbrella potentials for all bins.
+     *
+     * These do not change during the WHAM iterations and are shared with the
+     * synthetic windows used for bootstrapping.
+     */
+    double  **bolt;
+    /*! \brief The exponents -U/kT of bolt.
+     *
+     * Used instead of bolt for windows where exp(z) overflows, as bolt
+     * can underflow there while bolt*exp(z) is still finite.
+     */
+    double  **logBolt;
     realA     **ztime;     //!< input data z(t) as a function of time. Required to compute ACTs
 
     /*! \brief average force estimated from average displacement, fAv=dzAv*k
@@ -335,6 +347,8 @@ static t_UmbrellaWindow * initUmbrellaWindows(int nwin)
         win[i].N        = win[i].Ntot = nullptr;
         win[i].g        = win[i].tau  = win[i].tausmooth = nullptr;
         win[i].bContrib = nullptr;
+        win[i].bolt     = nullptr;
+        win[i].logBolt  = nullptr;
         win[i].ztime    = nullptr;
         win[i].forceAv  = nullptr;
         win[i].aver     = win[i].sigma = nullptr;
@@ -370,6 +384,14 @@ static void freeUmbrellaWindows(t_UmbrellaWindow *win, int nwin)
                 sfree(win[i].bContrib[j]);
             }
         }
+        if (win[i].bolt)
+        {
+            for (j = 0; j < win[i].nPull; j++)
+            {
+                sfree(win[i].bolt[j]);
+                sfree(win[i].logBolt[j]);
+            }
+        }
         sfree(win[i].Histo);
         sfree(win[i].cum);
         sfree(win[i].k);
@@ -381,6 +403,8 @@ static void freeUmbrellaWindows(t_UmbrellaWindow *win, int nwin)
         sfree(win[i].tau);
         sfree(win[i].tausmooth);
         sfree(win[i].bContrib);
+        sfree(win[i].bolt);
+        sfree(win[i].logBolt);
         sfree(win[i].ztime);
         sfree(win[i].forceAv);
         sfree(win[i].aver);
@@ -837,7 +861,7 @@ static void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWind
                            t_UmbrellaOptions *opt)
 {
     int           i, j, k, nGrptot = 0, nContrib = 0, nTot = 0;
-    double        U, min = opt->min, dz = opt->dz, temp, ztot_half, distance, ztot, contrib1, contrib2;
+    double        contrib1, contrib2, expz;
     gmx_bool      bAnyContrib;
     static int    bFirst = 1;
     static double wham_contrib_lim;
@@ -851,9 +875,6 @@ static void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWind
         wham_contrib_lim = opt->Tolerance/nGrptot;
     }
 
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
-
     for (i = 0; i < nWindows; ++i)
     {
         if (!window[i].bContrib)
@@ -867,38 +888,24 @@ static void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWind
                 snew(window[i].bContrib[j], opt->bins);
             }
             bAnyContrib = FALSE;
+            expz        = std::exp(window[i].z[j]);
             for (k = 0; k < opt->bins; ++k)
             {
-                temp     = (1.0*k+0.5)*dz+min;
-                distance = temp - window[i].pos[j];   /* distance to umbrella center */
-                if (opt->bCycl)
-                {                                     /* in cyclic wham:             */
-                    if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                    {
-                        distance -= ztot;
-                    }
-                    else if (distance < -ztot_half)
-                    {
-                        distance += ztot;
-                    }
-                }
                 /* Note: there are two contributions to bin k in the wham equations:
                    i)  N[j]*exp(- U/(BOLTZ*opt->Temperature) + window[i].z[j])
                    ii) exp(- U/(BOLTZ*opt->Temperature))
                    where U is the umbrella potential
                    If any of these number is larger wham_contrib_lim, I set contrib=TRUE
                  */
-
-                if (!opt->bTab)
+                contrib1                 = profile[k]*window[i].bolt[j][k];
+                if (std::isfinite(expz))
                 {
-                    U = 0.5*window[i].k[j]*gmx::square(distance);       /* harmonic potential assumed. */
+                    contrib2 = window[i].N[j]*window[i].bolt[j][k]*expz;
                 }
                 else
                 {
-                    U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
+                    contrib2 = window[i].N[j]*std::exp(window[i].logBolt[j][k] + window[i].z[j]);
                 }
-                contrib1                 = profile[k]*std::exp(-U/(BOLTZ*opt->Temperature));
-                contrib2                 = window[i].N[j]*std::exp(-U/(BOLTZ*opt->Temperature) + window[i].z[j]);
                 window[i].bContrib[j][k] = (contrib1 > wham_contrib_lim || contrib2 > wham_contrib_lim);
                 bAnyContrib              = (bAnyContrib | window[i].bContrib[j][k]);
                 if (window[i].bContrib[j][k])
@@ -923,6 +930,7 @@ static void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWind
     {
         printf("Initialized rapid wham stuff (contrib tolerance %g)\n"
                "Evaluating only %d of %d expressions.\n\n", wham_contrib_lim, nContrib, nTot);
+        bFirst = 0;
     }
 
     if (opt->verbose)
@@ -930,70 +938,160 @@ static void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWind
         printf("Updated rapid wham stuff. (evaluating only %d of %d contributions)\n",
                nContrib, nTot);
     }
-    bFirst = 0;
+}
+
+/*! \brief Compute the Boltzmann factors of the umbrella potentials for all bins
+ *
+ * The WHAM iterations only need exp(-U/kT), which is independent of the
+ * iteration, so it is computed once instead of in every iteration.
+ * The exponents -U/kT are stored as well, for windows far outside
+ * min and max, where exp(-U/kT) underflows.
+ */
+static void setup_boltzmann_factors(t_UmbrellaWindow * window, int nWindows,
+                                    t_UmbrellaOptions *opt)
+{
+    double ztot      = opt->max-opt->min;
+    double ztot_half = ztot/2;
+
+    for (int i = 0; i < nWindows; ++i)
+    {
+        if (!window[i].bolt)
+        {
+            snew(window[i].bolt, window[i].nPull);
+            snew(window[i].logBolt, window[i].nPull);
+            for (int j = 0; j < window[i].nPull; ++j)
+            {
+                snew(window[i].bolt[j], opt->bins);
+                snew(window[i].logBolt[j], opt->bins);
+            }
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nWindows; ++i)
+    {
+        try
+        {
+            for (int j = 0; j < window[i].nPull; ++j)
+            {
+                for (int k = 0; k < opt->bins; ++k)
+                {
+                    double temp, distance, U;
+
+                    temp     = (1.0*k+0.5)*opt->dz+opt->min;
+                    distance = temp - window[i].pos[j];   /* distance to umbrella center */
+                    if (opt->bCycl)
+                    {                                     /* in cyclic wham:             */
+                        if (distance > ztot_half)         /*    |distance| < ztot_half   */
+                        {
+                            distance -= ztot;
+                        }
+                        else if (distance < -ztot_half)
+                        {
+                            distance += ztot;
+                        }
+                    }
+                    if (!opt->bTab)
+                    {
+                        U = 0.5*window[i].k[j]*gmx::square(distance);       /* harmonic potential assumed. */
+                    }
+                    else
+                    {
+                        U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
+                    }
+                    window[i].logBolt[j][k] = -U/(BOLTZ*opt->Temperature);
+                    window[i].bolt[j][k]    = std::exp(window[i].logBolt[j][k]);
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
 }
 
 //! Compute the PMF (one of the two main WHAM routines)
 static void calc_profile(double *profile, t_UmbrellaWindow * window, int nWindows,
                          t_UmbrellaOptions *opt, gmx_bool bExact)
 {
-    double ztot_half, ztot, min = opt->min, dz = opt->dz;
+    /* Bins are processed in blocks, with the windows in the outer loop,
+     * so the inner loops run over contiguous bins.
+     */
+    const int           blockSize = 64;
+    const int           nblock    = (opt->bins + blockSize - 1)/blockSize;
+    std::vector<double> invg, fac;
 
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
+    /* Weights and denominator prefactors invg*N*exp(z) of all pull groups */
+    for (int j = 0; j < nWindows; ++j)
+    {
+        for (int k = 0; k < window[j].nPull; ++k)
+        {
+            double ig = 1.0/window[j].g[k] * window[j].bsWeight[k];
+            invg.push_back(ig);
+            fac.push_back(ig*window[j].N[k]*std::exp(window[j].z[k]));
+        }
+    }
 
-#pragma omp parallel
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < nblock; ++b)
     {
         try
         {
-            int nthreads  = gmx_omp_get_max_threads();
-            int thread_id = gmx_omp_get_thread_num();
-            int i;
-            int i0        = thread_id*opt->bins/nthreads;
-            int i1        = std::min(opt->bins, ((thread_id+1)*opt->bins)/nthreads);
+            int    i0 = b*blockSize;
+            int    i1 = std::min(opt->bins, i0 + blockSize);
+            double num[blockSize], denom[blockSize];
+            int    jk = 0;
 
-            for (i = i0; i < i1; ++i)
+            for (int i = i0; i < i1; ++i)
             {
-                int    j, k;
-                double num, denom, invg, temp = 0, distance, U = 0;
-                num = denom = 0.;
-                for (j = 0; j < nWindows; ++j)
+                num[i - i0]   = 0;
+                denom[i - i0] = 0;
+            }
+            for (int j = 0; j < nWindows; ++j)
+            {
+                for (int k = 0; k < window[j].nPull; ++k, ++jk)
                 {
-                    for (k = 0; k < window[j].nPull; ++k)
+                    const double *histo = window[j].Histo[k];
+                    const double *bolt  = window[j].bolt[k];
+
+                    for (int i = i0; i < i1; ++i)
                     {
-                        invg = 1.0/window[j].g[k] * window[j].bsWeight[k];
-                        temp = (1.0*i+0.5)*dz+min;
-                        num += invg*window[j].Histo[k][i];
+                        num[i - i0] += invg[jk]*histo[i];
+                    }
+                    if (!std::isfinite(fac[jk]))
+                    {
+                        /* exp(z) overflows for windows far outside min and max,
+                         * fall back to evaluating exp(-U/kT + z) per bin.
+                         */
+                        const double *logBolt = window[j].logBolt[k];
 
-                        if (!(bExact || window[j].bContrib[k][i]))
+                        for (int i = i0; i < i1; ++i)
                         {
-                            continue;
-                        }
-                        distance = temp - window[j].pos[k];   /* distance to umbrella center */
-                        if (opt->bCycl)
-                        {                                     /* in cyclic wham:             */
-                            if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                            {
-                                distance -= ztot;
-                            }
-                            else if (distance < -ztot_half)
+                            if (bExact || window[j].bContrib[k][i])
                             {
-                                distance += ztot;
+                                denom[i - i0] += invg[jk]*window[j].N[k]*std::exp(logBolt[i] + window[j].z[k]);
                             }
                         }
-
-                        if (!opt->bTab)
+                    }
+                    else if (bExact)
+                    {
+                        for (int i = i0; i < i1; ++i)
                         {
-                            U = 0.5*window[j].k[k]*gmx::square(distance);       /* harmonic potential assumed. */
+                            denom[i - i0] += fac[jk]*bolt[i];
                         }
-                        else
+                    }
+                    else
+                    {
+                        const gmx_bool *bContrib = window[j].bContrib[k];
+
+                        for (int i = i0; i < i1; ++i)
                         {
-                            U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
+                            denom[i - i0] += bContrib[i] ? fac[jk]*bolt[i] : 0;
                         }
-                        denom += invg*window[j].N[k]*std::exp(-U/(BOLTZ*opt->Temperature) + window[j].z[k]);
                     }
                 }
-                profile[i] = num/denom;
+            }
+            for (int i = i0; i < i1; ++i)
+            {
+                profile[i] = num[i - i0]/denom[i - i0];
             }
         }
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
@@ -1004,60 +1102,39 @@ static void calc_profile(double *profile, t_UmbrellaWindow * window, int nWindow
 static double calc_z(double * profile, t_UmbrellaWindow * window, int nWindows,
                      t_UmbrellaOptions *opt, gmx_bool bExact)
 {
-    double min     = opt->min, dz = opt->dz, ztot_half, ztot;
     double maxglob = -1e20;
 
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
+    GMX_UNUSED_VALUE(opt);
 
 #pragma omp parallel
     {
         try
         {
-            int    nthreads  = gmx_omp_get_max_threads();
-            int    thread_id = gmx_omp_get_thread_num();
-            int    i;
-            int    i0        = thread_id*nWindows/nthreads;
-            int    i1        = std::min(nWindows, ((thread_id+1)*nWindows)/nthreads);
-            double maxloc    = -1e20;
+            double maxloc = -1e20;
 
-            for (i = i0; i < i1; ++i)
+#pragma omp for schedule(static)
+            for (int i = 0; i < nWindows; ++i)
             {
-                double total     = 0, temp, distance, U = 0;
-                int    j, k;
-
-                for (j = 0; j < window[i].nPull; ++j)
+                for (int j = 0; j < window[i].nPull; ++j)
                 {
-                    total = 0;
-                    for (k = 0; k < window[i].nBin; ++k)
+                    const double *bolt  = window[i].bolt[j];
+                    double        total = 0, temp;
+
+                    if (bExact)
                     {
-                        if (!(bExact || window[i].bContrib[j][k]))
+                        for (int k = 0; k < window[i].nBin; ++k)
                         {
-                            continue;
-                        }
-                        temp     = (1.0*k+0.5)*dz+min;
-                        distance = temp - window[i].pos[j];   /* distance to umbrella center */
-                        if (opt->bCycl)
-                        {                                     /* in cyclic wham:             */
-                            if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                            {
-                                distance -= ztot;
-                            }
-                            else if (distance < -ztot_half)
-                            {
-                                distance += ztot;
-                            }
+                            total += profile[k]*bolt[k];
                         }
+                    }
+                    else
+                    {
+                        const gmx_bool *bContrib = window[i].bContrib[j];
 
-                        if (!opt->bTab)
-                        {
-                            U = 0.5*window[i].k[j]*gmx::square(distance);       /* harmonic potential assumed. */
-                        }
-                        else
+                        for (int k = 0; k < window[i].nBin; ++k)
                         {
-                            U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
+                            total += bContrib[k] ? profile[k]*bolt[k] : 0;
                         }
-                        total += profile[k]*std::exp(-U/(BOLTZ*opt->Temperature));
                     }
                     /* Avoid floating point exception if window is far outside min and max */
                     if (total != 0.0)
@@ -1248,7 +1325,8 @@ static void copy_pullgrp_to_synthwindow(t_UmbrellaWindow *synthWindow,
     synthWindow->pos     [0] = thisWindow->pos      [pullid];
     synthWindow->z       [0] = thisWindow->z        [pullid];
     synthWindow->k       [0] = thisWindow->k        [pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib [pullid];
+    synthWindow->bolt    [0] = thisWindow->bolt     [pullid];
+    synthWindow->logBolt [0] = thisWindow->logBolt  [pullid];
     synthWindow->g       [0] = thisWindow->g        [pullid];
     synthWindow->bsWeight[0] = thisWindow->bsWeight [pullid];
 }
@@ -1399,7 +1477,8 @@ static void create_synthetic_histo(t_UmbrellaWindow *synthWindow, t_UmbrellaWind
     synthWindow->pos     [0] = thisWindow->pos[pullid];
     synthWindow->z       [0] = thisWindow->z[pullid];
     synthWindow->k       [0] = thisWindow->k[pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib[pullid];
+    synthWindow->bolt    [0] = thisWindow->bolt[pullid];
+    synthWindow->logBolt [0] = thisWindow->logBolt[pullid];
     synthWindow->g       [0] = thisWindow->g       [pullid];
     synthWindow->bsWeight[0] = thisWindow->bsWeight[pullid];
 
@@ -1603,17 +1682,53 @@ static void setRandomBsWeights(t_UmbrellaWindow *synthwin, int nAllPull, t_Umbre
     sfree(r);
 }
 
+/*! \brief Iterate the WHAM equations for one set of bootstrapped histograms
+ *
+ * Returns the number of iterations, the final maximum change is returned in \p maxchange.
+ * Progress is only printed with \p bPrintProgress, since several sets may be
+ * iterated in parallel.
+ */
+static int bootstrap_wham(double *bsProfile, const double *profile, t_UmbrellaWindow *synthWindow,
+                          int nAllPull, t_UmbrellaOptions *opt, gmx_bool bPrintProgress,
+                          double *maxchange)
+{
+    int      i      = 0;
+    gmx_bool bExact = FALSE;
+
+    *maxchange = 1e20;
+    std::memcpy(bsProfile, profile, opt->bins*sizeof(double)); /* use profile as guess */
+    do
+    {
+        if ( (i%opt->stepUpdateContrib) == 0)
+        {
+            setup_acc_wham(bsProfile, synthWindow, nAllPull, opt);
+        }
+        if (*maxchange < opt->Tolerance)
+        {
+            bExact = TRUE;
+        }
+        if (bPrintProgress && ((i%opt->stepchange) == 0 || i == 1) && i != 0)
+        {
+            printf("\t%4d) Maximum change %e\n", i, *maxchange);
+        }
+        calc_profile(bsProfile, synthWindow, nAllPull, opt, bExact);
+        i++;
+    }
+    while ( (*maxchange = calc_z(bsProfile, synthWindow, nAllPull, opt, bExact)) > opt->Tolerance || !bExact);
+
+    return i;
+}
+
 //! The main bootstrapping routine
 static void do_bootstrapping(const char *fnres, const char* fnprof, const char *fnhist,
                              const char *xlabel, char* ylabel, double *profile,
                              t_UmbrellaWindow * window, int nWindows, t_UmbrellaOptions *opt)
 {
-    t_UmbrellaWindow * synthWindow;
-    double            *bsProfile, *bsProfiles_av, *bsProfiles_av2, maxchange = 1e20, tmp, stddev;
-    int                i, j, *randomArray = nullptr, winid, pullid, ib;
+    t_UmbrellaWindow **synthWindow;
+    double           **bsProfile, *bsProfiles_av, *bsProfiles_av2, *maxchange, tmp, stddev;
+    int                i, j, *randomArray = nullptr, winid, pullid, ib, ib0, iset, nset, nrep, *niter;
     int                iAllPull, nAllPull, *allPull_winId, *allPull_pullId;
     FILE              *fp;
-    gmx_bool           bExact = FALSE;
 
     /* init random generator */
     if (opt->bsSeed == 0)
@@ -1622,9 +1737,21 @@ static void do_bootstrapping(const char *fnres, const char* fnprof, const char *
     }
     opt->rng.seed(opt->bsSeed);
 
-    snew(bsProfile,     opt->bins);
+    /* The bootstrap replicas are independent, so we iterate up to one
+       set of synthetic windows per thread in parallel. The random
+       histograms are still generated serially, so that the results do
+       not depend on the number of threads. */
+    nset = std::max(1, std::min(gmx_omp_get_max_threads(), opt->nBootStrap));
+
+    snew(bsProfile,     nset);
+    for (iset = 0; iset < nset; iset++)
+    {
+        snew(bsProfile[iset], opt->bins);
+    }
     snew(bsProfiles_av, opt->bins);
     snew(bsProfiles_av2, opt->bins);
+    snew(maxchange, nset);
+    snew(niter, nset);
 
     /* Create array of all pull groups. Note that different windows
        may have different nr of pull groups
@@ -1649,23 +1776,31 @@ static void do_bootstrapping(const char *fnres, const char* fnprof, const char *
     }
 
     /* setup stuff for synthetic windows */
-    snew(synthWindow, nAllPull);
-    for (i = 0; i < nAllPull; i++)
+    snew(synthWindow, nset);
+    for (iset = 0; iset < nset; iset++)
     {
-        synthWindow[i].nPull = 1;
-        synthWindow[i].nBin  = opt->bins;
-        snew(synthWindow[i].Histo, 1);
-        if (opt->bsMethod == bsMethod_traj || opt->bsMethod == bsMethod_trajGauss)
+        snew(synthWindow[iset], nAllPull);
+        for (i = 0; i < nAllPull; i++)
         {
-            snew(synthWindow[i].Histo[0], opt->bins);
+            t_UmbrellaWindow *synth = synthWindow[iset] + i;
+
+            synth->nPull = 1;
+            synth->nBin  = opt->bins;
+            snew(synth->Histo, 1);
+            if (opt->bsMethod == bsMethod_traj || opt->bsMethod == bsMethod_trajGauss)
+            {
+                snew(synth->Histo[0], opt->bins);
+            }
+            snew(synth->N, 1);
+            snew(synth->pos, 1);
+            snew(synth->z, 1);
+            snew(synth->k, 1);
+            snew(synth->bContrib, 1);
+            snew(synth->bolt, 1);
+            snew(synth->logBolt, 1);
+            snew(synth->g, 1);
+            snew(synth->bsWeight, 1);
         }
-        snew(synthWindow[i].N, 1);
-        snew(synthWindow[i].pos, 1);
-        snew(synthWindow[i].z, 1);
-        snew(synthWindow[i].k, 1);
-        snew(synthWindow[i].bContrib, 1);
-        snew(synthWindow[i].g, 1);
-        snew(synthWindow[i].bsWeight, 1);
     }
 
     switch (opt->bsMethod)
@@ -1677,11 +1812,14 @@ static void do_bootstrapping(const char *fnres, const char* fnprof, const char *
             break;
         case bsMethod_BayesianHist:
             /* just copy all histogams into synthWindow array */
-            for (i = 0; i < nAllPull; i++)
+            for (iset = 0; iset < nset; iset++)
             {
-                winid  = allPull_winId [i];
-                pullid = allPull_pullId[i];
-                copy_pullgrp_to_synthwindow(synthWindow+i, window+winid, pullid);
+                for (i = 0; i < nAllPull; i++)
+                {
+                    winid  = allPull_winId [i];
+                    pullid = allPull_pullId[i];
+                    copy_pullgrp_to_synthwindow(synthWindow[iset]+i, window+winid, pullid);
+                }
             }
             break;
         case bsMethod_traj:
@@ -1694,92 +1832,96 @@ static void do_bootstrapping(const char *fnres, const char* fnprof, const char *
 
     /* do bootstrapping */
     fp = xvgropen(fnprof, "Bootstrap profiles", xlabel, ylabel, opt->oenv);
-    for (ib = 0; ib < opt->nBootStrap; ib++)
+    for (ib0 = 0; ib0 < opt->nBootStrap; ib0 += nset)
     {
-        printf("  *******************************************\n"
-               "  ******** Start bootstrap nr %d ************\n"
-               "  *******************************************\n", ib+1);
-
-        switch (opt->bsMethod)
-        {
-            case bsMethod_hist:
-                /* bootstrap complete histograms from given histograms */
-                getRandomIntArray(nAllPull, opt->histBootStrapBlockLength, randomArray, &opt->rng);
-                for (i = 0; i < nAllPull; i++)
-                {
-                    winid  = allPull_winId [randomArray[i]];
-                    pullid = allPull_pullId[randomArray[i]];
-                    copy_pullgrp_to_synthwindow(synthWindow+i, window+winid, pullid);
-                }
-                break;
-            case bsMethod_BayesianHist:
-                /* keep histos, but assign random weights ("Bayesian bootstrap") */
-                setRandomBsWeights(synthWindow, nAllPull, opt);
-                break;
-            case bsMethod_traj:
-            case bsMethod_trajGauss:
-                /* create new histos from given histos, that is generate new hypothetical
-                   trajectories */
-                for (i = 0; i < nAllPull; i++)
-                {
-                    winid  = allPull_winId[i];
-                    pullid = allPull_pullId[i];
-                    create_synthetic_histo(synthWindow+i, window+winid, pullid, opt);
-                }
-                break;
-        }
+        nrep = std::min(nset, opt->nBootStrap - ib0);
 
-        /* write histos in case of verbose output */
-        if (opt->bs_verbose)
+        for (iset = 0; iset < nrep; iset++)
         {
-            print_histograms(fnhist, synthWindow, nAllPull, ib, opt, xlabel);
-        }
+            ib = ib0 + iset;
+            printf("  *******************************************\n"
+                   "  ******** Start bootstrap nr %d ************\n"
+                   "  *******************************************\n", ib+1);
 
-        /* do wham */
-        i         = 0;
-        bExact    = FALSE;
-        maxchange = 1e20;
-        std::memcpy(bsProfile, profile, opt->bins*sizeof(double)); /* use profile as guess */
-        do
-        {
-            if ( (i%opt->stepUpdateContrib) == 0)
-            {
-                setup_acc_wham(bsProfile, synthWindow, nAllPull, opt);
-            }
-            if (maxchange < opt->Tolerance)
+            switch (opt->bsMethod)
             {
-                bExact = TRUE;
+                case bsMethod_hist:
+                    /* bootstrap complete histograms from given histograms */
+                    getRandomIntArray(nAllPull, opt->histBootStrapBlockLength, randomArray, &opt->rng);
+                    for (i = 0; i < nAllPull; i++)
+                    {
+                        winid  = allPull_winId [randomArray[i]];
+                        pullid = allPull_pullId[randomArray[i]];
+                        copy_pullgrp_to_synthwindow(synthWindow[iset]+i, window+winid, pullid);
+                    }
+                    break;
+                case bsMethod_BayesianHist:
+                    /* keep histos, but assign random weights ("Bayesian bootstrap");
+                       start from the offsets of the converged profile */
+                    for (i = 0; i < nAllPull; i++)
+                    {
+                        synthWindow[iset][i].z[0] = window[allPull_winId[i]].z[allPull_pullId[i]];
+                    }
+                    setRandomBsWeights(synthWindow[iset], nAllPull, opt);
+                    break;
+                case bsMethod_traj:
+                case bsMethod_trajGauss:
+                    /* create new histos from given histos, that is generate new hypothetical
+                       trajectories */
+                    for (i = 0; i < nAllPull; i++)
+                    {
+                        winid  = allPull_winId[i];
+                        pullid = allPull_pullId[i];
+                        create_synthetic_histo(synthWindow[iset]+i, window+winid, pullid, opt);
+                    }
+                    break;
             }
-            if (((i%opt->stepchange) == 0 || i == 1) && i != 0)
+
+            /* write histos in case of verbose output */
+            if (opt->bs_verbose)
             {
-                printf("\t%4d) Maximum change %e\n", i, maxchange);
+                print_histograms(fnhist, synthWindow[iset], nAllPull, ib, opt, xlabel);
             }
-            calc_profile(bsProfile, synthWindow, nAllPull, opt, bExact);
-            i++;
         }
-        while ( (maxchange = calc_z(bsProfile, synthWindow, nAllPull, opt, bExact)) > opt->Tolerance || !bExact);
-        printf("\tConverged in %d iterations. Final maximum change %g\n", i, maxchange);
 
-        if (opt->bLog)
+        /* do wham */
+#pragma omp parallel for num_threads(nrep) schedule(static, 1)
+        for (iset = 0; iset < nrep; iset++)
         {
-            prof_normalization_and_unit(bsProfile, opt);
+            try
+            {
+                niter[iset] = bootstrap_wham(bsProfile[iset], profile, synthWindow[iset], nAllPull, opt,
+                                             nrep == 1, &maxchange[iset]);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
         }
 
-        /* symmetrize profile around z=0 */
-        if (opt->bSym)
+        for (iset = 0; iset < nrep; iset++)
         {
-            symmetrizeProfile(bsProfile, opt);
-        }
+            printf("\tBootstrap nr %d converged in %d iterations. Final maximum change %g\n",
+                   ib0 + iset + 1, niter[iset], maxchange[iset]);
 
-        /* save stuff to get average and stddev */
-        for (i = 0; i < opt->bins; i++)
-        {
-            tmp                = bsProfile[i];
-            bsProfiles_av[i]  += tmp;
-            bsProfiles_av2[i] += tmp*tmp;
-            fprintf(fp, "%e\t%e\n", (i+0.5)*opt->dz+opt->min, tmp);
+            if (opt->bLog)
+            {
+                prof_normalization_and_unit(bsProfile[iset], opt);
+            }
+
+            /* symmetrize profile around z=0 */
+            if (opt->bSym)
+            {
+                symmetrizeProfile(bsProfile[iset], opt);
+            }
+
+            /* save stuff to get average and stddev */
+            for (i = 0; i < opt->bins; i++)
+            {
+                tmp                = bsProfile[iset][i];
+                bsProfiles_av[i]  += tmp;
+                bsProfiles_av2[i] += tmp*tmp;
+                fprintf(fp, "%e\t%e\n", (i+0.5)*opt->dz+opt->min, tmp);
+            }
+            fprintf(fp, "%s\n", output_env_get_print_xvgr_codes(opt->oenv) ? "&" : "");
         }
-        fprintf(fp, "%s\n", output_env_get_print_xvgr_codes(opt->oenv) ? "&" : "");
     }
     xvgrclose(fp);
 
@@ -3696,6 +3838,9 @@ int gmx_wham(int argc, char *argv[])
         averageSigma(window, nwins);
     }
 
+    /* Boltzmann factors of the umbrella potentials, used in all WHAM iterations */
+    setup_boltzmann_factors(window, nwins, &opt);
+
     /* Get initial potential by simple integration */
     if (opt.bInitPotByIntegration)
     {
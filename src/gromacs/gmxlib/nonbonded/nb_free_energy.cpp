@@ -39,8 +39,10 @@
 #include "nb_free_energy.h"
 
 #include <cmath>
+#include <cstdint>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/gmxlib/nonbonded/nb_kernel.h"
@@ -49,8 +51,778 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/mdtypes/forcerec.h"
 #include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
+#include "gromacs/utility/alignedallocator.h"
 #include "gromacs/utility/fatalerror.h"
 
+#if GMX_SIMD_HAVE_REAL
+
+/*! \brief Returns whether the SIMD free-energy kernels support the setup in \p fr
+ *
+ * The SIMD kernels cover the Verlet-scheme setups with soft-core power 6,
+ * plain cut-off/reaction-field or (potential-shifted) Ewald electrostatics
+ * and plain Lennard-Jones with an optional potential-switch modifier.
+ * All other setups, including LJ-PME, tables and soft-core power 48,
+ * which needs double precision, use the generic kernel.
+ */
+static gmx_bool useSimdFreeEnergyKernel(const t_forcerec *fr)
+{
+    const interaction_const_t *ic = fr->ic;
+
+    return (fr->cutoff_scheme == ecutsVERLET &&
+            fr->sc_r_power == 6 &&
+            !EVDW_PME(ic->vdwtype) &&
+            (ic->eeltype == eelCUT || EEL_RF(ic->eeltype) ||
+             (EEL_PME_EWALD(ic->eeltype) && ic->coulomb_modifier != eintmodPOTSWITCH)));
+}
+
+/*! \brief Potential-switch parameters broadcast to SIMD registers */
+struct PotentialSwitchSimd
+{
+    //! Constructs the switch for cut-off \p rc and switch radius \p rsw
+    PotentialSwitchSimd(realA rc, realA rsw)
+    {
+        realA d = rc - rsw;
+
+        rSwitch = gmx::SimdReal(rsw);
+        swV3    = gmx::SimdReal(-10.0/(d*d*d));
+        swV4    = gmx::SimdReal( 15.0/(d*d*d*d));
+        swV5    = gmx::SimdReal( -6.0/(d*d*d*d*d));
+        swF2    = gmx::SimdReal(-30.0/(d*d*d));
+        swF3    = gmx::SimdReal( 60.0/(d*d*d*d));
+        swF4    = gmx::SimdReal(-30.0/(d*d*d*d*d));
+    }
+
+    gmx::SimdReal rSwitch; //!< The switch radius
+    gmx::SimdReal swV3;    //!< Potential switch coefficient for d^3
+    gmx::SimdReal swV4;    //!< Potential switch coefficient for d^4
+    gmx::SimdReal swV5;    //!< Potential switch coefficient for d^5
+    gmx::SimdReal swF2;    //!< Force switch coefficient for d^2
+    gmx::SimdReal swF3;    //!< Force switch coefficient for d^3
+    gmx::SimdReal swF4;    //!< Force switch coefficient for d^4
+};
+
+/*! \brief Applies the potential switch at soft-core distance \p rSc to \p fscal and \p v */
+static inline void gmx_simdcall
+applyPotentialSwitch(const PotentialSwitchSimd &sw,
+                     gmx::SimdReal              rSc,
+                     gmx::SimdReal             *fscal,
+                     gmx::SimdReal             *v)
+{
+    gmx::SimdReal d   = max(rSc - sw.rSwitch, gmx::setZero());
+    gmx::SimdReal d2  = d*d;
+    gmx::SimdReal s   = fma(d2*d, fma(d, fma(d, sw.swV5, sw.swV4), sw.swV3), gmx::SimdReal(1.0));
+    gmx::SimdReal ds  = d2*fma(d, fma(d, sw.swF4, sw.swF3), sw.swF2);
+
+    *fscal            = *fscal*s - rSc*(*v)*ds;
+    *v                = *v*s;
+}
+
+/*! \brief Interaction parameters of the SIMD free-energy kernels */
+struct FreeEnergyParametersSimd
+{
+    //! Sets up the parameters from the interaction constants in \p fr
+    explicit FreeEnergyParametersSimd(const t_forcerec *fr) :
+        bEwald(EEL_PME_EWALD(fr->ic->eeltype)),
+        bElecSwitch(fr->ic->coulomb_modifier == eintmodPOTSWITCH),
+        bVdwSwitch(fr->ic->vdw_modifier == eintmodPOTSWITCH),
+        rcoulomb(fr->ic->rcoulomb),
+        rvdw(fr->ic->rvdw),
+        rcutoff_max2(gmx::square(std::max(fr->ic->rcoulomb, fr->ic->rvdw))),
+        krf(fr->ic->k_rf),
+        crf(fr->ic->c_rf),
+        sh_ewald(fr->ic->sh_ewald),
+        sh_invrc6(fr->ic->sh_invrc6),
+        sh_invrc12(fr->ic->sh_invrc6*fr->ic->sh_invrc6),
+        alpha_coul(fr->sc_alphacoul),
+        alpha_vdw(fr->sc_alphavdw),
+        sigma6_def(fr->sc_sigma6_def),
+        sigma6_min(fr->sc_sigma6_min),
+        ewtabscale(fr->ic->tabq_scale),
+        ewtabhalfspace(0.5/fr->ic->tabq_scale),
+        ewtab(fr->ic->tabq_coul_FDV0),
+        elecSwitch(fr->ic->rcoulomb, fr->ic->rcoulomb_switch),
+        vdwSwitch(fr->ic->rvdw, fr->ic->rvdw_switch)
+    {
+    }
+
+    gmx_bool            bEwald;         //!< Ewald electrostatics, otherwise reaction-field
+    gmx_bool            bElecSwitch;    //!< Potential-switch modifier for Coulomb
+    gmx_bool            bVdwSwitch;     //!< Potential-switch modifier for Van der Waals
+    gmx::SimdReal       rcoulomb;       //!< Coulomb cut-off
+    gmx::SimdReal       rvdw;           //!< Van der Waals cut-off
+    gmx::SimdReal       rcutoff_max2;   //!< The maximum cut-off squared
+    gmx::SimdReal       krf;            //!< Reaction-field constant
+    gmx::SimdReal       crf;            //!< Reaction-field potential shift
+    gmx::SimdReal       sh_ewald;       //!< Ewald potential shift
+    gmx::SimdReal       sh_invrc6;      //!< LJ dispersion potential shift
+    gmx::SimdReal       sh_invrc12;     //!< LJ repulsion potential shift
+    gmx::SimdReal       alpha_coul;     //!< Soft-core alpha for Coulomb
+    gmx::SimdReal       alpha_vdw;      //!< Soft-core alpha for Van der Waals
+    gmx::SimdReal       sigma6_def;     //!< Default soft-core sigma^6
+    gmx::SimdReal       sigma6_min;     //!< Minimum soft-core sigma^6
+    gmx::SimdReal       ewtabscale;     //!< Ewald correction table scale
+    gmx::SimdReal       ewtabhalfspace; //!< Half the Ewald correction table spacing
+    const realA        *ewtab;          //!< Ewald correction table in FDV0 format
+    PotentialSwitchSimd elecSwitch;     //!< The Coulomb potential switch
+    PotentialSwitchSimd vdwSwitch;      //!< The Van der Waals potential switch
+};
+
+/*! \brief Structure-of-array buffers for the parameters of one pack of perturbed pairs */
+struct FreeEnergyPairPackSimd
+{
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t jIndex[GMX_SIMD_REAL_WIDTH];    //!< j-atom indices
+    alignas(GMX_SIMD_ALIGNMENT) realA        jValid[GMX_SIMD_REAL_WIDTH];    //!< 1 for pairs, 0 for padding
+    alignas(GMX_SIMD_ALIGNMENT) realA        jIncluded[GMX_SIMD_REAL_WIDTH]; //!< 1 for non-excluded pairs
+    alignas(GMX_SIMD_ALIGNMENT) realA        selfScale[GMX_SIMD_REAL_WIDTH]; //!< 0.5 for self-pairs, 1 otherwise
+    alignas(GMX_SIMD_ALIGNMENT) realA        qq[2][GMX_SIMD_REAL_WIDTH];     //!< Charge products for states A and B
+    alignas(GMX_SIMD_ALIGNMENT) realA        c6[2][GMX_SIMD_REAL_WIDTH];     //!< C6 for states A and B
+    alignas(GMX_SIMD_ALIGNMENT) realA        c12[2][GMX_SIMD_REAL_WIDTH];    //!< C12 for states A and B
+};
+
+/*! \brief Packs the parameters of the pairs \p k to \p k + SIMD width of i-entry \p n
+ *
+ * The last pack of an i-entry is padded with masked-out copies of the i-particle.
+ */
+static inline void
+packFreeEnergyPairs(const t_nblist         *nlist,
+                    int                     n,
+                    int                     k,
+                    const realA            *iq,
+                    const int              *nti,
+                    const t_forcerec       *fr,
+                    const t_mdatoms        *mdatoms,
+                    FreeEnergyPairPackSimd *pack)
+{
+    const int  ii    = nlist->iinr[n];
+    const int  nj1   = nlist->jindex[n + 1];
+    const int *typeA = mdatoms->typeA;
+    const int *typeB = mdatoms->typeB;
+
+    for (int l = 0; l < GMX_SIMD_REAL_WIDTH; l++)
+    {
+        const gmx_bool bValid = (k + l < nj1);
+        const int      jnr    = (bValid ? nlist->jjnr[k + l] : ii);
+
+        pack->jIndex[l]    = jnr;
+        pack->jValid[l]    = (bValid ? 1 : 0);
+        pack->jIncluded[l] = ((bValid && (nlist->excl_fep == nullptr || nlist->excl_fep[k + l])) ? 1 : 0);
+        /* A self-interaction occurs twice in the list, count it once */
+        pack->selfScale[l] = (jnr == ii ? 0.5 : 1);
+        pack->qq[0][l]     = (bValid ? iq[0]*mdatoms->chargeA[jnr] : 0);
+        pack->qq[1][l]     = (bValid ? iq[1]*mdatoms->chargeB[jnr] : 0);
+        const int tjA      = nti[0] + 2*typeA[jnr];
+        const int tjB      = nti[1] + 2*typeB[jnr];
+        pack->c6[0][l]     = fr->nbfp[tjA];
+        pack->c6[1][l]     = fr->nbfp[tjB];
+        pack->c12[0][l]    = fr->nbfp[tjA + 1];
+        pack->c12[1][l]    = fr->nbfp[tjB + 1];
+    }
+}
+
+/*! \brief Computes the soft-core sigma^6 for both states and the effective soft-core alpha's */
+static inline void gmx_simdcall
+softCoreParameters(const FreeEnergyParametersSimd &p,
+                   const gmx::SimdReal            *c6_S,
+                   const gmx::SimdReal            *c12_S,
+                   gmx::SimdReal                  *sigma6_S,
+                   gmx::SimdReal                  *alpha_coul_eff,
+                   gmx::SimdReal                  *alpha_vdw_eff)
+{
+    const gmx::SimdReal zero_S = gmx::setZero();
+
+    for (int i = 0; i < 2; i++)
+    {
+        /* c12 is stored scaled with 12.0 and c6 is scaled with 6.0 - correct for this */
+        gmx::SimdBool haveLJ = (zero_S < c6_S[i]) && (zero_S < c12_S[i]);
+        gmx::SimdReal s6_S   = max(gmx::SimdReal(0.5)*c12_S[i]*maskzInv(c6_S[i], haveLJ), p.sigma6_min);
+        sigma6_S[i]          = blend(p.sigma6_def, s6_S, haveLJ);
+    }
+
+    /* Only use soft-core if one of the states has a zero endstate */
+    gmx::SimdBool bothC12 = (zero_S < c12_S[0]) && (zero_S < c12_S[1]);
+    *alpha_coul_eff       = selectByNotMask(p.alpha_coul, bothC12);
+    *alpha_vdw_eff        = selectByNotMask(p.alpha_vdw, bothC12);
+}
+
+/*! \brief Computes the soft-core Coulomb and LJ interactions of one state
+ *
+ * \p alphaLfacCoul and \p alphaLfacVdw are the effective soft-core alpha's
+ * times the lambda factor of the state. The returned forces are dV/drC
+ * times rC^(1-p), as in the generic kernel. As in the generic kernel,
+ * interactions with zero parameters are skipped, since at r=0 without
+ * soft-core they would give 0 times infinity.
+ */
+static inline void gmx_simdcall
+softCoreInteractions(const FreeEnergyParametersSimd &p,
+                     gmx::SimdReal                   r_S,
+                     gmx::SimdReal                   rp_S,
+                     gmx::SimdBool                   softCore,
+                     gmx::SimdReal                   qq_S,
+                     gmx::SimdReal                   c6_S,
+                     gmx::SimdReal                   c12_S,
+                     gmx::SimdReal                   sigma6_S,
+                     gmx::SimdReal                   alphaLfacCoul,
+                     gmx::SimdReal                   alphaLfacVdw,
+                     gmx::SimdReal                  *vcoul_S,
+                     gmx::SimdReal                  *fscalC_S,
+                     gmx::SimdReal                  *vvdw_S,
+                     gmx::SimdReal                  *fscalV_S)
+{
+    const gmx::SimdReal onesixth_S(1.0/6.0);
+    const gmx::SimdReal onetwelfth_S(1.0/12.0);
+
+    gmx::SimdReal       rpinvC_S = inv(fma(alphaLfacCoul, sigma6_S, rp_S));
+    gmx::SimdReal       rinvC_S  = exp(log(rpinvC_S)*onesixth_S);
+    gmx::SimdReal       rC_S     = inv(rinvC_S);
+
+    gmx::SimdReal       rpinvV_S = inv(fma(alphaLfacVdw, sigma6_S, rp_S));
+    gmx::SimdReal       rinvV_S  = exp(log(rpinvV_S)*onesixth_S);
+    gmx::SimdReal       rV_S     = inv(rinvV_S);
+
+    gmx::SimdBool       computeElec;
+    if (p.bEwald)
+    {
+        /* Ewald FEP is done only on the 1/r part */
+        *vcoul_S    = qq_S*(rinvC_S - p.sh_ewald);
+        *fscalC_S   = qq_S*rinvC_S;
+        computeElec = softCore && (r_S < p.rcoulomb);
+    }
+    else
+    {
+        gmx::SimdReal krfrsqC_S = p.krf*rC_S*rC_S;
+        *vcoul_S    = qq_S*(rinvC_S + krfrsqC_S - p.crf);
+        *fscalC_S   = qq_S*(rinvC_S - gmx::SimdReal(2.0)*krfrsqC_S);
+        computeElec = softCore && (rC_S < p.rcoulomb);
+    }
+    if (p.bElecSwitch)
+    {
+        applyPotentialSwitch(p.elecSwitch, rC_S, fscalC_S, vcoul_S);
+    }
+    computeElec = computeElec && (qq_S != gmx::setZero());
+    *vcoul_S    = selectByMask(*vcoul_S, computeElec);
+    *fscalC_S   = selectByMask(*fscalC_S*rpinvC_S, computeElec);
+
+    gmx::SimdReal rinv6_S  = rpinvV_S;
+    gmx::SimdReal vvdw6_S  = c6_S*rinv6_S;
+    gmx::SimdReal vvdw12_S = c12_S*rinv6_S*rinv6_S;
+    *vvdw_S                = ((vvdw12_S - c12_S*p.sh_invrc12)*onetwelfth_S -
+                              (vvdw6_S - c6_S*p.sh_invrc6)*onesixth_S);
+    *fscalV_S              = vvdw12_S - vvdw6_S;
+    if (p.bVdwSwitch)
+    {
+        applyPotentialSwitch(p.vdwSwitch, rV_S, fscalV_S, vvdw_S);
+    }
+    gmx::SimdBool computeVdw = (softCore && (rV_S < p.rvdw) &&
+                                (c6_S != gmx::setZero() || c12_S != gmx::setZero()));
+    *vvdw_S                  = selectByMask(*vvdw_S, computeVdw);
+    *fscalV_S                = selectByMask(*fscalV_S*rpinvV_S, computeVdw);
+}
+
+/*! \brief Returns the reaction-field exclusion potential of excluded pairs in \p excluded */
+static inline gmx::SimdReal gmx_simdcall
+reactionFieldExclusionPotential(const FreeEnergyParametersSimd &p,
+                                gmx::SimdReal                   rsq_S,
+                                gmx::SimdReal                   selfScale_S,
+                                gmx::SimdBool                   excluded)
+{
+    return selectByMask((p.krf*rsq_S - p.crf)*selfScale_S, excluded);
+}
+
+/*! \brief Computes the Ewald reciprocal-space correction for pairs in \p withinCoulomb
+ *
+ * Returns the potential in \p v_lr_S and the force over r in \p f_lr_S.
+ */
+static inline void gmx_simdcall
+ewaldCorrection(const FreeEnergyParametersSimd &p,
+                gmx::SimdReal                   r_S,
+                gmx::SimdReal                   rinv_S,
+                gmx::SimdReal                   selfScale_S,
+                gmx::SimdBool                   withinCoulomb,
+                gmx::SimdReal                  *v_lr_S,
+                gmx::SimdReal                  *f_lr_S)
+{
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t ewIndex[GMX_SIMD_REAL_WIDTH];
+
+    gmx::SimdReal rs_S   = selectByMask(r_S, withinCoulomb)*p.ewtabscale;
+    gmx::SimdReal frac_S = rs_S - trunc(rs_S);
+    store(ewIndex, cvttR2I(rs_S));
+
+    gmx::SimdReal ewtabF_S, ewtabD_S, ewtabV_S, dum_S;
+    gmx::gatherLoadTranspose<4>(p.ewtab, ewIndex, &ewtabF_S, &ewtabD_S, &ewtabV_S, &dum_S);
+
+    gmx::SimdReal f_lr   = fma(frac_S, ewtabD_S, ewtabF_S);
+    gmx::SimdReal v_lr   = ewtabV_S - p.ewtabhalfspace*frac_S*(ewtabF_S + f_lr);
+    *f_lr_S              = selectByMask(f_lr*rinv_S, withinCoulomb);
+    *v_lr_S              = selectByMask(v_lr*selfScale_S, withinCoulomb);
+}
+
+/*! \brief Sets up the lambda factors for lambda values \p lambda_coul and \p lambda_vdw
+ *
+ * See the generic kernel for the definitions.
+ */
+static void
+setFreeEnergyLambdaFactors(const t_forcerec *fr,
+                           realA             lambda_coul,
+                           realA             lambda_vdw,
+                           realA            *LFC,
+                           realA            *LFV,
+                           realA            *lfac_coul,
+                           realA            *dlfac_coul,
+                           realA            *lfac_vdw,
+                           realA            *dlfac_vdw)
+{
+    const realA lam_power  = fr->sc_power;
+    const realA sc_r_power = fr->sc_r_power;
+    const realA DLF[2]     = { -1, 1 };
+
+    LFC[0] = 1 - lambda_coul;
+    LFV[0] = 1 - lambda_vdw;
+    LFC[1] = lambda_coul;
+    LFV[1] = lambda_vdw;
+    for (int i = 0; i < 2; i++)
+    {
+        lfac_coul[i]  = (lam_power == 2 ? (1-LFC[i])*(1-LFC[i]) : (1-LFC[i]));
+        dlfac_coul[i] = DLF[i]*lam_power/sc_r_power*(lam_power == 2 ? (1-LFC[i]) : 1);
+        lfac_vdw[i]   = (lam_power == 2 ? (1-LFV[i])*(1-LFV[i]) : (1-LFV[i]));
+        dlfac_vdw[i]  = DLF[i]*lam_power/sc_r_power*(lam_power == 2 ? (1-LFV[i]) : 1);
+    }
+}
+
+/*! \brief SIMD version of the free-energy kernel for the most common setups
+ *
+ * The j-entries of each i-entry are processed in packs of SIMD width.
+ * The pair parameters of both states are packed into aligned
+ * structure-of-array buffers, after which the soft-core interactions
+ * for states A and B, the reaction-field exclusion terms and the Ewald
+ * exclusion correction are computed for all pairs in the pack at once.
+ * The energy and dV/dlambda contributions and the force accumulation
+ * follow the generic kernel below exactly, only the arithmetic is done
+ * in working precision instead of partially in double.
+ */
+static void
+nb_free_energy_kernel_simd(const t_nblist * gmx_restrict    nlist,
+                           rvec * gmx_restrict              xx,
+                           rvec * gmx_restrict              ff,
+                           t_forcerec * gmx_restrict        fr,
+                           const t_mdatoms * gmx_restrict   mdatoms,
+                           nb_kernel_data_t * gmx_restrict  kernel_data,
+                           t_nrnb * gmx_restrict            nrnb)
+{
+    using gmx::SimdReal;
+    using gmx::SimdBool;
+
+    const int                   c_stateA  = 0;
+    const int                   c_stateB  = 1;
+    const int                   c_nstates = 2;
+
+    const realA                *x         = xx[0];
+    realA                      *f         = ff[0];
+    realA                      *fshift    = fr->fshift[0];
+    const realA                *shiftvec  = fr->shift_vec[0];
+    const realA                 facel     = fr->ic->epsfac;
+    realA                      *Vc        = kernel_data->energygrp_elec;
+    realA                      *Vv        = kernel_data->energygrp_vdw;
+    realA                      *dvdl      = kernel_data->dvdl;
+
+    const gmx_bool              bDoForces      = kernel_data->flags & GMX_NONBONDED_DO_FORCE;
+    const gmx_bool              bDoShiftForces = kernel_data->flags & GMX_NONBONDED_DO_SHIFTFORCE;
+    const gmx_bool              bDoPotential   = kernel_data->flags & GMX_NONBONDED_DO_POTENTIAL;
+
+    const realA                 DLF[c_nstates] = { -1, 1 };
+    realA                       LFC[c_nstates], LFV[c_nstates];
+    realA                       lfac_coul[c_nstates], dlfac_coul[c_nstates];
+    realA                       lfac_vdw[c_nstates], dlfac_vdw[c_nstates];
+
+    setFreeEnergyLambdaFactors(fr, kernel_data->lambda[efptCOUL], kernel_data->lambda[efptVDW],
+                               LFC, LFV, lfac_coul, dlfac_coul, lfac_vdw, dlfac_vdw);
+
+    const FreeEnergyParametersSimd p(fr);
+    const SimdReal                 zero_S(0.0);
+    const SimdReal                 one_S(1.0);
+
+    FreeEnergyPairPackSimd         pack;
+    alignas(GMX_SIMD_ALIGNMENT) realA jWithinCutoff[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA tx[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA ty[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA tz[GMX_SIMD_REAL_WIDTH];
+
+    double                      dvdl_coul = 0;
+    double                      dvdl_vdw  = 0;
+
+    for (int n = 0; n < nlist->nri; n++)
+    {
+        const int   is3   = 3*nlist->shift[n];
+        const int   ii    = nlist->iinr[n];
+        const int   ii3   = 3*ii;
+        const int   nj0   = nlist->jindex[n];
+        const int   nj1   = nlist->jindex[n+1];
+        const realA iq[c_nstates]  = { facel*mdatoms->chargeA[ii], facel*mdatoms->chargeB[ii] };
+        const int   nti[c_nstates] = { 2*fr->ntype*mdatoms->typeA[ii], 2*fr->ntype*mdatoms->typeB[ii] };
+
+        const SimdReal ix_S(shiftvec[is3]   + x[ii3]);
+        const SimdReal iy_S(shiftvec[is3+1] + x[ii3+1]);
+        const SimdReal iz_S(shiftvec[is3+2] + x[ii3+2]);
+
+        SimdReal    fix_S       = zero_S;
+        SimdReal    fiy_S       = zero_S;
+        SimdReal    fiz_S       = zero_S;
+        SimdReal    vctot_S     = zero_S;
+        SimdReal    vvtot_S     = zero_S;
+        SimdReal    dvdl_coul_S = zero_S;
+        SimdReal    dvdl_vdw_S  = zero_S;
+        gmx_bool    bHavePairWithinCutoff = FALSE;
+
+        for (int k = nj0; k < nj1; k += GMX_SIMD_REAL_WIDTH)
+        {
+            packFreeEnergyPairs(nlist, n, k, iq, nti, fr, mdatoms, &pack);
+
+            SimdReal jx_S, jy_S, jz_S;
+            gmx::gatherLoadUTranspose<3>(x, pack.jIndex, &jx_S, &jy_S, &jz_S);
+
+            SimdReal dx_S  = ix_S - jx_S;
+            SimdReal dy_S  = iy_S - jy_S;
+            SimdReal dz_S  = iz_S - jz_S;
+            SimdReal rsq_S = norm2(dx_S, dy_S, dz_S);
+
+            SimdBool withinCutoff = (rsq_S < p.rcutoff_max2) && (gmx::load<SimdReal>(pack.jValid) != zero_S);
+            if (!anyTrue(withinCutoff))
+            {
+                continue;
+            }
+            bHavePairWithinCutoff = TRUE;
+
+            /* The force at r=0 is zero, the potential in general not */
+            SimdBool nonZero = (zero_S < rsq_S);
+            SimdReal rinv_S  = selectByMask(invsqrt(blend(one_S, rsq_S, nonZero)), nonZero);
+            SimdReal r_S     = rsq_S*rinv_S;
+
+            SimdReal included_S = gmx::load<SimdReal>(pack.jIncluded);
+            SimdBool softCore   = withinCutoff && (included_S != zero_S);
+            SimdBool excluded   = withinCutoff && (included_S == zero_S);
+
+            SimdReal fscal_S    = zero_S;
+
+            if (anyTrue(softCore))
+            {
+                /* Avoid 1/0 for masked-out pairs at r=0 */
+                SimdReal rsqSc_S = blend(one_S, rsq_S, softCore);
+                SimdReal rpm2_S  = rsqSc_S*rsqSc_S;
+                SimdReal rp_S    = rpm2_S*rsqSc_S;
+
+                SimdReal c6_S[c_nstates], c12_S[c_nstates], sigma6_S[c_nstates];
+                SimdReal alpha_coul_eff, alpha_vdw_eff;
+                for (int i = 0; i < c_nstates; i++)
+                {
+                    c6_S[i]  = gmx::load<SimdReal>(pack.c6[i]);
+                    c12_S[i] = gmx::load<SimdReal>(pack.c12[i]);
+                }
+                softCoreParameters(p, c6_S, c12_S, sigma6_S, &alpha_coul_eff, &alpha_vdw_eff);
+
+                for (int i = 0; i < c_nstates; i++)
+                {
+                    SimdReal vcoul_S, fscalC_S, vvdw_S, fscalV_S;
+                    softCoreInteractions(p, r_S, rp_S, softCore,
+                                         gmx::load<SimdReal>(pack.qq[i]), c6_S[i], c12_S[i], sigma6_S[i],
+                                         alpha_coul_eff*SimdReal(lfac_coul[i]),
+                                         alpha_vdw_eff*SimdReal(lfac_vdw[i]),
+                                         &vcoul_S, &fscalC_S, &vvdw_S, &fscalV_S);
+
+                    SimdReal LFC_S(LFC[i]);
+                    SimdReal LFV_S(LFV[i]);
+                    SimdReal DLF_S(DLF[i]);
+
+                    vctot_S     = fma(LFC_S, vcoul_S, vctot_S);
+                    vvtot_S     = fma(LFV_S, vvdw_S, vvtot_S);
+                    fscal_S     = fma(fma(LFC_S, fscalC_S, LFV_S*fscalV_S), rpm2_S, fscal_S);
+                    dvdl_coul_S = dvdl_coul_S + vcoul_S*DLF_S + SimdReal(LFC[i]*dlfac_coul[i])*alpha_coul_eff*fscalC_S*sigma6_S[i];
+                    dvdl_vdw_S  = dvdl_vdw_S + vvdw_S*DLF_S + SimdReal(LFV[i]*dlfac_vdw[i])*alpha_vdw_eff*fscalV_S*sigma6_S[i];
+                }
+            }
+
+            /* Charge products weighted with the lambda factors for
+             * the non-soft-core terms below.
+             */
+            SimdReal qqA_S       = gmx::load<SimdReal>(pack.qq[c_stateA]);
+            SimdReal qqB_S       = gmx::load<SimdReal>(pack.qq[c_stateB]);
+            SimdReal qqL_S       = SimdReal(LFC[c_stateA])*qqA_S + SimdReal(LFC[c_stateB])*qqB_S;
+            SimdReal qqD_S       = qqB_S - qqA_S;
+            SimdReal selfScale_S = gmx::load<SimdReal>(pack.selfScale);
+
+            if (!p.bEwald && anyTrue(excluded))
+            {
+                /* Excluded pairs, only present with the Verlet scheme,
+                 * interact through the reaction-field correction without
+                 * soft-core.
+                 */
+                SimdReal vv_S = reactionFieldExclusionPotential(p, rsq_S, selfScale_S, excluded);
+                SimdReal ff_S = selectByMask(SimdReal(-2.0)*p.krf, excluded);
+
+                vctot_S     = fma(qqL_S, vv_S, vctot_S);
+                fscal_S     = fma(qqL_S, ff_S, fscal_S);
+                dvdl_coul_S = fma(qqD_S, vv_S, dvdl_coul_S);
+            }
+
+            if (p.bEwald)
+            {
+                /* Subtract the reciprocal-space Ewald component for all
+                 * pairs, see the comment in the generic kernel.
+                 */
+                SimdReal v_lr_S, f_lr_S;
+                ewaldCorrection(p, r_S, rinv_S, selfScale_S, withinCutoff && (r_S < p.rcoulomb),
+                                &v_lr_S, &f_lr_S);
+
+                vctot_S         = vctot_S - qqL_S*v_lr_S;
+                fscal_S         = fscal_S - qqL_S*f_lr_S;
+                dvdl_coul_S     = dvdl_coul_S - qqD_S*v_lr_S;
+            }
+
+            if (bDoForces)
+            {
+                fscal_S       = selectByMask(fscal_S, withinCutoff);
+                SimdReal tx_S = fscal_S*dx_S;
+                SimdReal ty_S = fscal_S*dy_S;
+                SimdReal tz_S = fscal_S*dz_S;
+                fix_S         = fix_S + tx_S;
+                fiy_S         = fiy_S + ty_S;
+                fiz_S         = fiz_S + tz_S;
+                store(tx, tx_S);
+                store(ty, ty_S);
+                store(tz, tz_S);
+                store(jWithinCutoff, selectByMask(one_S, withinCutoff));
+
+                for (int l = 0; l < GMX_SIMD_REAL_WIDTH; l++)
+                {
+                    if (jWithinCutoff[l] != 0)
+                    {
+                        const int j3 = 3*pack.jIndex[l];
+                        /* See the generic kernel for the use of atomics */
+#pragma omp atomic
+                        f[j3]     -= tx[l];
+#pragma omp atomic
+                        f[j3 + 1] -= ty[l];
+#pragma omp atomic
+                        f[j3 + 2] -= tz[l];
+                    }
+                }
+            }
+        }
+
+        dvdl_coul += reduce(dvdl_coul_S);
+        dvdl_vdw  += reduce(dvdl_vdw_S);
+
+        if (bHavePairWithinCutoff)
+        {
+            if (bDoForces)
+            {
+                const realA fix = reduce(fix_S);
+                const realA fiy = reduce(fiy_S);
+                const realA fiz = reduce(fiz_S);
+#pragma omp atomic
+                f[ii3]        += fix;
+#pragma omp atomic
+                f[ii3+1]      += fiy;
+#pragma omp atomic
+                f[ii3+2]      += fiz;
+                if (bDoShiftForces)
+                {
+#pragma omp atomic
+                    fshift[is3]   += fix;
+#pragma omp atomic
+                    fshift[is3+1] += fiy;
+#pragma omp atomic
+                    fshift[is3+2] += fiz;
+                }
+            }
+            if (bDoPotential)
+            {
+                const int   ggid  = nlist->gid[n];
+                const realA vctot = reduce(vctot_S);
+                const realA vvtot = reduce(vvtot_S);
+#pragma omp atomic
+                Vc[ggid]          += vctot;
+#pragma omp atomic
+                Vv[ggid]          += vvtot;
+            }
+        }
+    }
+
+#pragma omp atomic
+    dvdl[efptCOUL]     += dvdl_coul;
+#pragma omp atomic
+    dvdl[efptVDW]      += dvdl_vdw;
+
+    /* Estimate flops, average for free energy stuff:
+     * 12  flops per outer iteration
+     * 150 flops per inner iteration
+     */
+#pragma omp atomic
+    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->nri*12 + nlist->jindex[nlist->nri]*150);
+}
+
+/*! \brief SIMD kernel computing the perturbed energies at multiple lambda values in one pass
+ *
+ * The distances, pair parameters, soft-core sigma's, exclusion terms and
+ * Ewald corrections are computed once per pair and reused for all lambda
+ * values, only the soft-core interactions are evaluated per lambda.
+ */
+static void
+nb_free_energy_energies_simd(const t_nblist * gmx_restrict    nlist,
+                             rvec * gmx_restrict              xx,
+                             t_forcerec * gmx_restrict        fr,
+                             const t_mdatoms * gmx_restrict   mdatoms,
+                             int                              nlambda,
+                             const realA                     *lambda_coul,
+                             const realA                     *lambda_vdw,
+                             double                          *energies,
+                             t_nrnb * gmx_restrict            nrnb)
+{
+    using gmx::SimdReal;
+    using gmx::SimdBool;
+
+    const int                       c_nstates = 2;
+
+    const realA                    *x         = xx[0];
+    const realA                    *shiftvec  = fr->shift_vec[0];
+    const realA                     facel     = fr->ic->epsfac;
+
+    /* Per lambda value: LFC, LFV, lfac_coul and lfac_vdw for both states */
+    std::vector<realA>              lfac(nlambda*4*c_nstates);
+    for (int l = 0; l < nlambda; l++)
+    {
+        realA *lf = lfac.data() + l*4*c_nstates;
+        realA  dlfac_coul[c_nstates], dlfac_vdw[c_nstates];
+
+        setFreeEnergyLambdaFactors(fr, lambda_coul[l], lambda_vdw[l],
+                                   lf, lf + c_nstates, lf + 2*c_nstates, dlfac_coul, lf + 3*c_nstates, dlfac_vdw);
+    }
+
+    /* SIMD accumulation buffers for the energy at each lambda value */
+    std::vector<realA, gmx::AlignedAllocator<realA> > energyBuffer(nlambda*GMX_SIMD_REAL_WIDTH, 0);
+
+    const FreeEnergyParametersSimd  p(fr);
+    const SimdReal                  zero_S(0.0);
+    const SimdReal                  one_S(1.0);
+
+    FreeEnergyPairPackSimd          pack;
+
+    for (int n = 0; n < nlist->nri; n++)
+    {
+        const int   is3   = 3*nlist->shift[n];
+        const int   ii    = nlist->iinr[n];
+        const int   ii3   = 3*ii;
+        const int   nj0   = nlist->jindex[n];
+        const int   nj1   = nlist->jindex[n+1];
+        const realA iq[c_nstates]  = { facel*mdatoms->chargeA[ii], facel*mdatoms->chargeB[ii] };
+        const int   nti[c_nstates] = { 2*fr->ntype*mdatoms->typeA[ii], 2*fr->ntype*mdatoms->typeB[ii] };
+
+        const SimdReal ix_S(shiftvec[is3]   + x[ii3]);
+        const SimdReal iy_S(shiftvec[is3+1] + x[ii3+1]);
+        const SimdReal iz_S(shiftvec[is3+2] + x[ii3+2]);
+
+        for (int k = nj0; k < nj1; k += GMX_SIMD_REAL_WIDTH)
+        {
+            packFreeEnergyPairs(nlist, n, k, iq, nti, fr, mdatoms, &pack);
+
+            SimdReal jx_S, jy_S, jz_S;
+            gmx::gatherLoadUTranspose<3>(x, pack.jIndex, &jx_S, &jy_S, &jz_S);
+
+            SimdReal rsq_S = norm2(ix_S - jx_S, iy_S - jy_S, iz_S - jz_S);
+
+            SimdBool withinCutoff = (rsq_S < p.rcutoff_max2) && (gmx::load<SimdReal>(pack.jValid) != zero_S);
+            if (!anyTrue(withinCutoff))
+            {
+                continue;
+            }
+
+            SimdBool nonZero = (zero_S < rsq_S);
+            SimdReal rinv_S  = selectByMask(invsqrt(blend(one_S, rsq_S, nonZero)), nonZero);
+            SimdReal r_S     = rsq_S*rinv_S;
+
+            SimdReal included_S  = gmx::load<SimdReal>(pack.jIncluded);
+            SimdBool softCore    = withinCutoff && (included_S != zero_S);
+            SimdBool excluded    = withinCutoff && (included_S == zero_S);
+            SimdReal selfScale_S = gmx::load<SimdReal>(pack.selfScale);
+
+            /* The lambda independent parts */
+            SimdReal rp_S = zero_S;
+            SimdReal c6_S[c_nstates], c12_S[c_nstates], qq_S[c_nstates], sigma6_S[c_nstates];
+            SimdReal alpha_coul_eff = zero_S, alpha_vdw_eff = zero_S;
+            for (int i = 0; i < c_nstates; i++)
+            {
+                c6_S[i]  = gmx::load<SimdReal>(pack.c6[i]);
+                c12_S[i] = gmx::load<SimdReal>(pack.c12[i]);
+                qq_S[i]  = gmx::load<SimdReal>(pack.qq[i]);
+            }
+            const gmx_bool bHaveSoftCore = anyTrue(softCore);
+            if (bHaveSoftCore)
+            {
+                SimdReal rsqSc_S = blend(one_S, rsq_S, softCore);
+                rp_S             = rsqSc_S*rsqSc_S*rsqSc_S;
+                softCoreParameters(p, c6_S, c12_S, sigma6_S, &alpha_coul_eff, &alpha_vdw_eff);
+            }
+
+            /* The non-soft-core Coulomb potential, weighted per state below */
+            SimdReal vNonSc_S = zero_S;
+            if (!p.bEwald)
+            {
+                vNonSc_S = reactionFieldExclusionPotential(p, rsq_S, selfScale_S, excluded);
+            }
+            else
+            {
+                SimdReal v_lr_S, f_lr_S;
+                ewaldCorrection(p, r_S, rinv_S, selfScale_S, withinCutoff && (r_S < p.rcoulomb),
+                                &v_lr_S, &f_lr_S);
+                vNonSc_S = -v_lr_S;
+            }
+
+            for (int l = 0; l < nlambda; l++)
+            {
+                const realA *LFC       = lfac.data() + l*4*c_nstates;
+                const realA *LFV       = LFC + c_nstates;
+                const realA *lfac_coul = LFC + 2*c_nstates;
+                const realA *lfac_vdw  = LFC + 3*c_nstates;
+
+                SimdReal     v_S       = (SimdReal(LFC[0])*qq_S[0] + SimdReal(LFC[1])*qq_S[1])*vNonSc_S;
+
+                if (bHaveSoftCore)
+                {
+                    for (int i = 0; i < c_nstates; i++)
+                    {
+                        SimdReal vcoul_S, fscalC_S, vvdw_S, fscalV_S;
+                        softCoreInteractions(p, r_S, rp_S, softCore,
+                                             qq_S[i], c6_S[i], c12_S[i], sigma6_S[i],
+                                             alpha_coul_eff*SimdReal(lfac_coul[i]),
+                                             alpha_vdw_eff*SimdReal(lfac_vdw[i]),
+                                             &vcoul_S, &fscalC_S, &vvdw_S, &fscalV_S);
+
+                        v_S = fma(SimdReal(LFC[i]), vcoul_S, v_S);
+                        v_S = fma(SimdReal(LFV[i]), vvdw_S, v_S);
+                    }
+                }
+
+                realA *buffer = energyBuffer.data() + l*GMX_SIMD_REAL_WIDTH;
+                store(buffer, gmx::load<SimdReal>(buffer) + v_S);
+            }
+        }
+    }
+
+    for (int l = 0; l < nlambda; l++)
+    {
+        double energy = reduce(gmx::load<SimdReal>(energyBuffer.data() + l*GMX_SIMD_REAL_WIDTH));
+#pragma omp atomic
+        energies[l] += energy;
+    }
+
+    /* The same flop estimate as for the force kernel, per lambda */
+#pragma omp atomic
+    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlambda*(nlist->nri*12 + nlist->jindex[nlist->nri]*150));
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 void
 gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
                           rvec * gmx_restrict              xx,
@@ -138,6 +910,14 @@ gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
     const realA    six         = 6.0;
     const realA    fourtyeight = 48.0;
 
+#if GMX_SIMD_HAVE_REAL
+    if (useSimdFreeEnergyKernel(fr))
+    {
+        nb_free_energy_kernel_simd(nlist, xx, ff, fr, mdatoms, kernel_data, nrnb);
+        return;
+    }
+#endif
+
     /* Extract pointer to non-bonded interaction constants */
     const interaction_const_t *ic = fr->ic;
 
@@ -946,3 +1726,43 @@ gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
 #pragma omp atomic
     inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->nri*12 + nlist->jindex[n]*150);
 }
+
+gmx_bool
+gmx_nb_free_energy_have_multi_lambda_kernel(const t_forcerec *fr)
+{
+#if GMX_SIMD_HAVE_REAL
+    return useSimdFreeEnergyKernel(fr);
+#else
+    GMX_UNUSED_VALUE(fr);
+    return FALSE;
+#endif
+}
+
+void
+gmx_nb_free_energy_multi_lambda_kernel(const t_nblist * gmx_restrict    nlist,
+                                       rvec * gmx_restrict              xx,
+                                       t_forcerec * gmx_restrict        fr,
+                                       const t_mdatoms * gmx_restrict   mdatoms,
+                                       int                              nlambda,
+                                       const realA                     *lambda_coul,
+                                       const realA                     *lambda_vdw,
+                                       double                          *energies,
+                                       t_nrnb * gmx_restrict            nrnb)
+{
+#if GMX_SIMD_HAVE_REAL
+    if (useSimdFreeEnergyKernel(fr))
+    {
+        nb_free_energy_energies_simd(nlist, xx, fr, mdatoms, nlambda, lambda_coul, lambda_vdw, energies, nrnb);
+        return;
+    }
+#endif
+    GMX_UNUSED_VALUE(nlist);
+    GMX_UNUSED_VALUE(xx);
+    GMX_UNUSED_VALUE(mdatoms);
+    GMX_UNUSED_VALUE(nlambda);
+    GMX_UNUSED_VALUE(lambda_coul);
+    GMX_UNUSED_VALUE(lambda_vdw);
+    GMX_UNUSED_VALUE(energies);
+    GMX_UNUSED_VALUE(nrnb);
+    gmx_incons("The multi-lambda free-energy kernel does not support this setup");
+}
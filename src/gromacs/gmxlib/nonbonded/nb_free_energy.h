@@ -59,6 +59,28 @@ void
                               nb_kernel_data_t * gmx_restrict  kernel_data,
                               t_nrnb * gmx_restrict            nrnb);
 
+/* Returns whether gmx_nb_free_energy_multi_lambda_kernel supports the setup in fr */
+gmx_bool
+    gmx_nb_free_energy_have_multi_lambda_kernel(const t_forcerec *fr);
+
+/* Computes the perturbed non-bonded energies of nlist for nlambda lambda
+ * values in one pass over the list. For lambda value l, with Coulomb lambda
+ * lambda_coul[l] and Van der Waals lambda lambda_vdw[l], the sum of the
+ * Coulomb and Van der Waals energies is added to energies[l].
+ * Distances, pair parameters and lambda-independent terms are computed
+ * only once per pair. Forces and dV/dlambda are not computed.
+ */
+void
+    gmx_nb_free_energy_multi_lambda_kernel(const t_nblist * gmx_restrict    nlist,
+                                           rvec * gmx_restrict              xx,
+                                           t_forcerec * gmx_restrict        fr,
+                                           const t_mdatoms * gmx_restrict   mdatoms,
+                                           int                              nlambda,
+                                           const realA                     *lambda_coul,
+                                           const realA                     *lambda_vdw,
+                                           double                          *energies,
+                                           t_nrnb * gmx_restrict            nrnb);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,389 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the free-energy nonbonded kernels.
+ *
+ * The SIMD kernel, which is used with the Verlet scheme, and the
+ * multi-lambda energy kernel are compared to the generic kernel,
+ * which is used with the group scheme, on the same perturbed pair list.
+ *
+ * \ingroup module_gmxlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/gmxlib/nonbonded/nb_free_energy.h"
+
+#include <cmath>
+
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/gmxlib/nonbonded/nb_kernel.h"
+#include "gromacs/gmxlib/nonbonded/nonbonded.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/mdtypes/nblist.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/tables/forcetable.h"
+#include "gromacs/utility/alignedallocator.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of atoms
+const int c_numAtoms = 60;
+
+//! The number of i-atoms, each interacts with all atoms with a higher or equal index
+const int c_numIAtoms = 12;
+
+//! The number of atom types
+const int c_numTypes = 3;
+
+//! The i-entry that uses a non-zero shift vector
+const int c_shiftedIEntry = 3;
+
+//! Atom pair at distance zero that is excluded
+const int c_excludedOverlap[2] = { 4, 5 };
+
+//! Atom pair at distance zero that interacts, only used with soft-core
+const int c_interactingOverlap[2] = { 2, 7 };
+
+/*! \brief Coulomb and Van der Waals lambda values
+ *
+ * The interacting pair at r=0 is only finite with lambda < 1,
+ * since state B has no soft-core at lambda = 1.
+ */
+const std::vector<realA> c_lambdasCoul = { 0.3, 0, 0.5, 0.9, 0.7 };
+const std::vector<realA> c_lambdasVdw  = { 0.6, 0, 0.2, 0.95, 0 };  //!< See c_lambdasCoul
+
+//! Convenience typedef of electrostatics type, VdW modifier and whether to use soft-core
+typedef std::tuple<int, int, bool> FreeEnergyKernelTestParameters;
+
+//! The output of a kernel call
+struct FreeEnergyKernelOutput
+{
+    //! The Coulomb energy
+    realA             vCoul = 0;
+    //! The Van der Waals energy
+    realA             vVdw  = 0;
+    //! dV/dlambda for all lambda components
+    realA             dvdl[efptNR] = { 0 };
+    //! The forces
+    std::vector<RVec> f;
+    //! The shift forces
+    std::vector<RVec> fshift;
+};
+
+/*! \brief Test fixture for comparing the SIMD and the generic free-energy kernel
+ *
+ * All atoms are perturbed in charge and some in type. The list
+ * contains self pairs and excluded pairs, which give r=0, as well as
+ * pairs beyond the cut-off. With soft-core it also contains
+ * an interacting pair at r=0.
+ */
+class FreeEnergyKernelTest : public ::testing::TestWithParam<FreeEnergyKernelTestParameters>
+{
+    public:
+        //! Constructor
+        FreeEnergyKernelTest() :
+            ic_(), fr_(), mdatoms_(), nlist_(),
+            x_(c_numAtoms), shiftVec_(SHIFTS, RVec(0, 0, 0)),
+            chargeA_(c_numAtoms), chargeB_(c_numAtoms),
+            typeA_(c_numAtoms), typeB_(c_numAtoms),
+            nbfp_(2*c_numTypes*c_numTypes)
+        {
+            const int  eeltype     = std::get<0>(GetParam());
+            const int  vdwModifier = std::get<1>(GetParam());
+            const bool useSoftCore = std::get<2>(GetParam());
+            const bool useEwald    = EEL_PME_EWALD(eeltype);
+
+            ic_.eeltype          = eeltype;
+            ic_.coulomb_modifier = eintmodPOTSHIFT;
+            ic_.rcoulomb         = 1.0;
+            ic_.epsfac           = ONE_4PI_EPS0;
+            if (useEwald)
+            {
+                ic_.ewaldcoeff_q = 3.12;
+                ic_.sh_ewald     = std::erfc(ic_.ewaldcoeff_q*ic_.rcoulomb);
+                ic_.tabq_scale   = 500;
+                ic_.tabq_size    = static_cast<int>(ic_.rcoulomb*ic_.tabq_scale) + 2;
+                tabqF_.resize(ic_.tabq_size);
+                tabqV_.resize(ic_.tabq_size);
+                tabqFDV0_.resize(4*ic_.tabq_size);
+                table_spline3_fill_ewald_lr(tabqF_.data(), tabqV_.data(), tabqFDV0_.data(),
+                                            ic_.tabq_size, 1/ic_.tabq_scale, ic_.ewaldcoeff_q,
+                                            v_q_ewald_lr);
+                ic_.tabq_coul_F    = tabqF_.data();
+                ic_.tabq_coul_V    = tabqV_.data();
+                ic_.tabq_coul_FDV0 = tabqFDV0_.data();
+            }
+            else
+            {
+                ic_.k_rf = 0.5;
+                ic_.c_rf = 1.5;
+            }
+            ic_.vdwtype      = evdwCUT;
+            ic_.vdw_modifier = vdwModifier;
+            ic_.rvdw         = 1.0;
+            ic_.rvdw_switch  = 0.8;
+            ic_.sh_invrc6    = (vdwModifier == eintmodPOTSHIFT ? 1.0 : 0.0);
+
+            fr_.ic            = &ic_;
+            fr_.sc_alphavdw   = (useSoftCore ? 0.5 : 0);
+            fr_.sc_alphacoul  = (useSoftCore ? 0.5 : 0);
+            fr_.sc_power      = 1;
+            fr_.sc_r_power    = 6;
+            fr_.sc_sigma6_def = std::pow(0.3, 6);
+            fr_.sc_sigma6_min = std::pow(0.25, 6);
+            fr_.ntype         = c_numTypes;
+            fr_.nbfp          = nbfp_.data();
+            fr_.shift_vec     = as_rvec_array(shiftVec_.data());
+            /* Not a periodic image, but that does not matter for the kernels */
+            shiftVec_[1]      = { 0.8, 0.1, 0 };
+
+            const realA c6[c_numTypes]  = { 0.002, 0, 0.003 };
+            const realA c12[c_numTypes] = { 2e-6, 0, 3e-6 };
+            for (int a = 0; a < c_numTypes; a++)
+            {
+                for (int b = 0; b < c_numTypes; b++)
+                {
+                    C6(nbfp_, c_numTypes, a, b)  = 6*std::sqrt(c6[a]*c6[b]);
+                    C12(nbfp_, c_numTypes, a, b) = 12*std::sqrt(c12[a]*c12[b]);
+                }
+            }
+
+            DefaultRandomEngine           rng(1234);
+            UniformRealDistribution<realA> dist;
+            for (int a = 0; a < c_numAtoms; a++)
+            {
+                x_[a]       = { realA(1.6*dist(rng)), realA(1.6*dist(rng)), realA(1.6*dist(rng)) };
+                chargeA_[a] = dist(rng) - 0.5;
+                chargeB_[a] = (a % 3 == 0 ? 0 : 0.5*chargeA_[a]);
+                typeA_[a]   = a % 3;
+                typeB_[a]   = (a % 4 == 0 ? 1 : a % 3);
+            }
+            x_[c_excludedOverlap[1]] = x_[c_excludedOverlap[0]];
+            if (useSoftCore)
+            {
+                /* An atom that appears at the position of another atom */
+                x_[c_interactingOverlap[1]]       = x_[c_interactingOverlap[0]];
+                chargeA_[c_interactingOverlap[1]] = 0;
+                typeA_[c_interactingOverlap[1]]   = 1;
+            }
+            mdatoms_.chargeA = chargeA_.data();
+            mdatoms_.chargeB = chargeB_.data();
+            mdatoms_.typeA   = typeA_.data();
+            mdatoms_.typeB   = typeB_.data();
+
+            jindex_.push_back(0);
+            for (int i = 0; i < c_numIAtoms; i++)
+            {
+                iinr_.push_back(i);
+                shift_.push_back(i == c_shiftedIEntry ? 1 : CENTRAL);
+                gid_.push_back(0);
+                for (int j = i; j < c_numAtoms; j++)
+                {
+                    bool isExcluded = (j == i || j == i + 1 ||
+                                      (i == c_excludedOverlap[0] && j == c_excludedOverlap[1]));
+                    jjnr_.push_back(j);
+                    exclFep_.push_back(isExcluded ? 0 : 1);
+                }
+                jindex_.push_back(jjnr_.size());
+            }
+            nlist_.ielec    = (useEwald ? GMX_NBKERNEL_ELEC_EWALD : GMX_NBKERNEL_ELEC_REACTIONFIELD);
+            nlist_.ivdw     = GMX_NBKERNEL_VDW_LENNARDJONES;
+            nlist_.nri      = iinr_.size();
+            nlist_.iinr     = iinr_.data();
+            nlist_.jindex   = jindex_.data();
+            nlist_.jjnr     = jjnr_.data();
+            nlist_.shift    = shift_.data();
+            nlist_.gid      = gid_.data();
+            nlist_.excl_fep = exclFep_.data();
+        }
+
+        /*! \brief Runs the free-energy kernel
+         *
+         * The kernel dispatches to the SIMD kernel with the Verlet scheme,
+         * when supported, and uses the generic kernel with the group scheme.
+         */
+        FreeEnergyKernelOutput runKernel(int cutoffScheme, realA lambdaCoul, realA lambdaVdw)
+        {
+            FreeEnergyKernelOutput output;
+            output.f.resize(c_numAtoms, RVec(0, 0, 0));
+            output.fshift.resize(SHIFTS, RVec(0, 0, 0));
+
+            realA lambda[efptNR] = { 0 };
+            lambda[efptCOUL] = lambdaCoul;
+            lambda[efptVDW]  = lambdaVdw;
+
+            nb_kernel_data_t kernelData = {};
+            kernelData.flags          = GMX_NONBONDED_DO_FORCE | GMX_NONBONDED_DO_SHIFTFORCE | GMX_NONBONDED_DO_POTENTIAL;
+            kernelData.lambda         = lambda;
+            kernelData.dvdl           = output.dvdl;
+            kernelData.energygrp_elec = &output.vCoul;
+            kernelData.energygrp_vdw  = &output.vVdw;
+
+            fr_.cutoff_scheme = cutoffScheme;
+            fr_.fshift        = as_rvec_array(output.fshift.data());
+
+            t_nrnb nrnb;
+            init_nrnb(&nrnb);
+            gmx_nb_free_energy_kernel(&nlist_, as_rvec_array(x_.data()), as_rvec_array(output.f.data()),
+                                      &fr_, &mdatoms_, &kernelData, &nrnb);
+
+            return output;
+        }
+
+        //! The interaction constants
+        interaction_const_t                     ic_;
+        //! The force record, only the fields used by the kernels are set
+        t_forcerec                              fr_;
+        //! The atom data, only charges and types are set
+        t_mdatoms                               mdatoms_;
+        //! The perturbed pair list
+        t_nblist                                nlist_;
+        //! The positions
+        std::vector<RVec>                       x_;
+        //! The shift vectors
+        std::vector<RVec>                       shiftVec_;
+        //! Charges and types in states A and B
+        std::vector<realA>                       chargeA_, chargeB_;
+        std::vector<int>                        typeA_, typeB_; //!< See chargeA_
+        //! The LJ parameters
+        std::vector<realA>                       nbfp_;
+        //! The Ewald correction tables
+        std::vector<realA, AlignedAllocator<realA> > tabqF_, tabqV_, tabqFDV0_;
+        //! Storage for the pair list
+        std::vector<int>                        iinr_, jindex_, jjnr_, shift_, gid_;
+        std::vector<char>                       exclFep_; //!< See iinr_
+};
+
+TEST_P(FreeEnergyKernelTest, SimdKernelMatchesGenericKernel)
+{
+    for (size_t l = 0; l < c_lambdasCoul.size(); l++)
+    {
+        SCOPED_TRACE(formatString("for lambda coul %g vdw %g", c_lambdasCoul[l], c_lambdasVdw[l]));
+
+        FreeEnergyKernelOutput ref = runKernel(ecutsGROUP, c_lambdasCoul[l], c_lambdasVdw[l]);
+        FreeEnergyKernelOutput out = runKernel(ecutsVERLET, c_lambdasCoul[l], c_lambdasVdw[l]);
+
+        realA fMax = 0;
+        for (const RVec &f : ref.f)
+        {
+            fMax = std::max(fMax, norm(f));
+        }
+        /* Check that the test setup is sane */
+        ASSERT_GT(fMax, 1);
+        ASSERT_TRUE(std::isfinite(ref.vCoul) && std::isfinite(ref.vVdw));
+
+        const double           relTol     = (GMX_DOUBLE ? 1e-8 : 1e-5);
+        FloatingPointTolerance vTolerance = relativeToleranceAsFloatingPoint(std::fabs(ref.vCoul) + std::fabs(ref.vVdw), relTol);
+        FloatingPointTolerance fTolerance = relativeToleranceAsFloatingPoint(fMax, relTol);
+
+        EXPECT_REAL_EQ_TOL(ref.vCoul, out.vCoul, vTolerance);
+        EXPECT_REAL_EQ_TOL(ref.vVdw, out.vVdw, vTolerance);
+        EXPECT_REAL_EQ_TOL(ref.dvdl[efptCOUL], out.dvdl[efptCOUL], vTolerance);
+        EXPECT_REAL_EQ_TOL(ref.dvdl[efptVDW], out.dvdl[efptVDW], vTolerance);
+        for (int a = 0; a < c_numAtoms; a++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(ref.f[a][d], out.f[a][d], fTolerance) << formatString("for f of atom %d dim %d", a, d);
+            }
+        }
+        for (int s = 0; s < SHIFTS; s++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(ref.fshift[s][d], out.fshift[s][d], fTolerance) << formatString("for shift force %d dim %d", s, d);
+            }
+        }
+    }
+}
+
+TEST_P(FreeEnergyKernelTest, MultiLambdaKernelMatchesPerLambdaKernel)
+{
+    fr_.cutoff_scheme = ecutsVERLET;
+    if (!gmx_nb_free_energy_have_multi_lambda_kernel(&fr_))
+    {
+        return;
+    }
+
+    const int           numLambdas = c_lambdasCoul.size();
+    std::vector<double> energies(numLambdas, 0);
+
+    t_nrnb              nrnb;
+    init_nrnb(&nrnb);
+    gmx_nb_free_energy_multi_lambda_kernel(&nlist_, as_rvec_array(x_.data()), &fr_, &mdatoms_,
+                                           numLambdas, c_lambdasCoul.data(), c_lambdasVdw.data(),
+                                           energies.data(), &nrnb);
+
+    for (int l = 0; l < numLambdas; l++)
+    {
+        FreeEnergyKernelOutput ref = runKernel(ecutsGROUP, c_lambdasCoul[l], c_lambdasVdw[l]);
+
+        FloatingPointTolerance tolerance = relativeToleranceAsFloatingPoint(std::fabs(ref.vCoul) + std::fabs(ref.vVdw),
+                                                                            GMX_DOUBLE ? 1e-8 : 1e-5);
+        EXPECT_REAL_EQ_TOL(ref.vCoul + ref.vVdw, energies[l], tolerance)
+        << formatString("for lambda coul %g vdw %g", c_lambdasCoul[l], c_lambdasVdw[l]);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithParameters, FreeEnergyKernelTest,
+                            ::testing::Combine(::testing::Values(eelRF, eelPME),
+                                                   ::testing::Values(eintmodPOTSHIFT, eintmodPOTSWITCH),
+                                                   ::testing::Bool()));
+
+} // namespace
+} // namespace
+} // namespace
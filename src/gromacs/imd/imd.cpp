@@ -54,6 +54,11 @@
 #include <errno.h>
 #include <string.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #if GMX_NATIVE_WINDOWS
 #include <windows.h>
 #else
@@ -83,6 +88,7 @@
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/smalloc.h"
 
 /*! \brief How long shall we wait in seconds until we check for a connection again? */
@@ -133,6 +139,8 @@ typedef struct
 } IMDHeader;
 
 
+class ImdSendThread;
+
 /*! \internal
  * \brief IMD (interactive molecular dynamics) main data structure.
  *
@@ -183,10 +191,12 @@ typedef struct t_gmx_IMD
     rvec           *f;               /**< The IMD pulling forces.                     */
 
     char           *forcesendbuf;    /**< Buffer for force sending.                   */
-    char           *coordsendbuf;    /**< Buffer for coordinate sending.              */
-    char           *energysendbuf;   /**< Send buffer for energies.                   */
     rvec           *sendxbuf;        /**< Buffer to make molecules whole before
                                           sending.                                    */
+    ImdSendThread  *sendThread;      /**< Writes frames to the client in the
+                                          background, master only.                    */
+    int             nframesDropped;  /**< Frames not sent because the client was
+                                          still busy receiving the previous one.      */
 
     t_block         mols;            /**< Molecules block in IMD group.               */
 
@@ -339,8 +349,8 @@ static int imd_handshake(IMDSocket *socket)
 }
 
 
-/*! \brief Send energies using the energy block and the send buffer. */
-static int imd_send_energies(IMDSocket *socket, const IMDEnergyBlock *energies, char *buffer)
+/*! \brief Packs the energy record with its header into buffer, returns the number of bytes written. */
+static gmx_int32_t imd_pack_energies(const IMDEnergyBlock *energies, char *buffer)
 {
     gmx_int32_t recsize;
 
@@ -349,7 +359,7 @@ static int imd_send_energies(IMDSocket *socket, const IMDEnergyBlock *energies,
     fill_header((IMDHeader *) buffer, IMD_ENERGIES, 1);
     memcpy(buffer + HEADERSIZE, energies, sizeof(IMDEnergyBlock));
 
-    return (imd_write_multiple(socket, buffer, recsize) != recsize);
+    return recsize;
 }
 
 
@@ -434,16 +444,15 @@ void dd_make_local_IMD_atoms(gmx_bool bIMD, gmx_domdec_t *dd, t_IMD *imd)
 
 
 #ifdef GMX_IMD
-/*! \brief Send positions from rvec.
+/*! \brief Packs positions from rvec with their header into buffer.
  *
- * We need a separate send buffer and conversion to Angstrom.
+ * Positions are converted to Angstrom. Returns the number of bytes written.
  */
-static int imd_send_rvecs(IMDSocket *socket, int nat, rvec *x, char *buffer)
+static gmx_int32_t imd_pack_rvecs(int nat, rvec *x, char *buffer)
 {
     gmx_int32_t size;
     int         i;
-    float       sendx[3];
-    int         tuplesize = 3 * sizeof(float);
+    float      *sendx;
 
 
     /* Required size for the send buffer */
@@ -451,18 +460,119 @@ static int imd_send_rvecs(IMDSocket *socket, int nat, rvec *x, char *buffer)
 
     /* Prepare header */
     fill_header((IMDHeader *) buffer, IMD_FCOORDS, (gmx_int32_t) nat);
+    sendx = reinterpret_cast<float *>(buffer + HEADERSIZE);
     for (i = 0; i < nat; i++)
     {
-        sendx[0] = (float) x[i][0] * NM2A;
-        sendx[1] = (float) x[i][1] * NM2A;
-        sendx[2] = (float) x[i][2] * NM2A;
-        memcpy(buffer + HEADERSIZE + i * tuplesize, sendx, tuplesize);
+        sendx[3*i    ] = (float) x[i][0] * NM2A;
+        sendx[3*i + 1] = (float) x[i][1] * NM2A;
+        sendx[3*i + 2] = (float) x[i][2] * NM2A;
     }
 
-    return (imd_write_multiple(socket, buffer, size) != size);
+    return size;
 }
 
 
+/*! \internal
+ * \brief Writes IMD frames to the client socket on a separate thread.
+ *
+ * The master packs the energies and positions of an IMD step into the
+ * frame buffer and hands it over with post(), which returns immediately.
+ * The socket write then overlaps with the following MD steps. When the
+ * client has not yet received the previous frame, the new frame is dropped
+ * instead of blocking the simulation, so a slow client only lowers the
+ * frame rate it sees.
+ */
+class ImdSendThread
+{
+    public:
+        //! Starts the send thread, \p frameSize is the maximum size of a frame.
+        explicit ImdSendThread(size_t frameSize)
+            : frame_(frameSize), sending_(frameSize), socket_(nullptr), sendSize_(0),
+              bBusy_(false), bFailed_(false), bStop_(false)
+        {
+            thread_ = std::thread(&ImdSendThread::run, this);
+        }
+        ~ImdSendThread()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                bStop_ = true;
+            }
+            condition_.notify_all();
+            thread_.join();
+        }
+        //! Returns whether the previous frame has been written, i.e. whether post() will accept a frame.
+        bool isIdle()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return !bBusy_;
+        }
+        //! Returns the buffer to pack the next frame into, only valid while idle.
+        char *frameBuffer() { return frame_.data(); }
+        //! Hands over the first \p size bytes of the frame buffer to be written to \p socket.
+        void post(IMDSocket *socket, size_t size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                GMX_ASSERT(!bBusy_, "Can only post IMD frames while the send thread is idle");
+                std::swap(frame_, sending_);
+                socket_   = socket;
+                sendSize_ = size;
+                bBusy_    = true;
+            }
+            condition_.notify_all();
+        }
+        //! Blocks until the last posted frame has been written, needed before closing the socket.
+        void waitUntilIdle()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]{ return !bBusy_; });
+        }
+        //! Returns whether a write failed since the last call, and clears the flag.
+        bool checkAndClearFailure()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bool                        bFailed = bFailed_;
+            bFailed_ = false;
+            return bFailed;
+        }
+
+    private:
+        //! Thread main loop, writes posted frames until stopped.
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                condition_.wait(lock, [this]{ return bBusy_ || bStop_; });
+                if (!bBusy_)
+                {
+                    return;
+                }
+                IMDSocket  *socket = socket_;
+                gmx_int32_t size   = static_cast<gmx_int32_t>(sendSize_);
+                lock.unlock();
+                bool        bOk    = (imd_write_multiple(socket, sending_.data(), size) == size);
+                lock.lock();
+                bFailed_ = bFailed_ || !bOk;
+                bBusy_   = false;
+                condition_.notify_all();
+            }
+        }
+
+        std::vector<char>       frame_;     //!< Buffer the master packs the next frame into.
+        std::vector<char>       sending_;   //!< Buffer currently being written.
+        IMDSocket              *socket_;    //!< Socket to write sending_ to.
+        size_t                  sendSize_;  //!< Number of bytes of sending_ to write.
+        bool                    bBusy_;     //!< Whether a frame is being written.
+        bool                    bFailed_;   //!< Whether a write failed.
+        bool                    bStop_;     //!< Whether the thread should exit.
+        std::mutex              mutex_;     //!< Protects the members above.
+        std::condition_variable condition_; //!< Signals posted and finished frames.
+        std::thread             thread_;    //!< The send thread.
+};
+
+
 /*! \brief Initializes the IMD private data. */
 static t_gmx_IMD_setup* imd_create(int imdatoms, int nstimddef, int imdport)
 {
@@ -547,6 +657,13 @@ static void imd_disconnect(t_gmx_IMD_setup *IMDsetup)
     /* Write out any buffered pulling data */
     fflush(IMDsetup->outf);
 
+    /* The send thread must not write to a socket that we destroy */
+    if (IMDsetup->sendThread)
+    {
+        IMDsetup->sendThread->waitUntilIdle();
+        IMDsetup->sendThread->checkAndClearFailure();
+    }
+
     /* we first try to shut down the clientsocket */
     imdsock_shutdown(IMDsetup->clientsocket);
     if (!imdsock_destroy(IMDsetup->clientsocket))
@@ -1034,6 +1151,18 @@ void IMD_finalize(gmx_bool bIMD, t_IMD *imd)
 {
     if (bIMD)
     {
+#ifdef GMX_IMD
+        if (imd->setup->sendThread)
+        {
+            if (imd->setup->nframesDropped > 0)
+            {
+                fprintf(stderr, "%s %d frames were not sent because the client was busy receiving.\n",
+                        IMDstr, imd->setup->nframesDropped);
+            }
+            delete imd->setup->sendThread;
+            imd->setup->sendThread = nullptr;
+        }
+#endif
         if (imd->setup->outf)
         {
             gmx_fio_fclose(imd->setup->outf);
@@ -1402,9 +1531,8 @@ void init_IMD(t_inputrec             *ir,
     /* read environment on master and prepare socket for incoming connections */
     if (MASTER(cr))
     {
-        /* we allocate memory for our IMD energy structure */
+        /* Size of the IMD energy record with its header */
         gmx_int32_t recsize = HEADERSIZE + sizeof(IMDEnergyBlock);
-        snew(IMDsetup->energysendbuf, recsize);
 
         /* Shall we wait for a connection? */
         if (options.wait)
@@ -1431,7 +1559,9 @@ void init_IMD(t_inputrec             *ir,
         snew(IMDsetup->sendxbuf, IMDsetup->nat);
         snew(IMDsetup->energies, 1);
         bufxsize = HEADERSIZE + 3 * sizeof(float) * IMDsetup->nat;
-        snew(IMDsetup->coordsendbuf, bufxsize);
+
+        /* A frame holds the energies followed by the positions */
+        IMDsetup->sendThread = new ImdSendThread(recsize + bufxsize);
     }
 
     /* do we allow interactive pulling? If so let the other nodes know. */
@@ -1602,23 +1732,32 @@ void IMD_fill_energy_record(gmx_bool bIMD, t_IMD *imd, gmx_enerdata_t *enerd,
 void IMD_send_positions(t_IMD *imd)
 {
 #ifdef GMX_IMD
-    t_gmx_IMD *IMDsetup;
+    t_gmx_IMD     *IMDsetup;
+    ImdSendThread *sendThread;
 
 
-    IMDsetup = imd->setup;
+    IMDsetup   = imd->setup;
+    sendThread = IMDsetup->sendThread;
 
     if (IMDsetup->clientsocket)
     {
-
-        if (imd_send_energies(IMDsetup->clientsocket, IMDsetup->energies, IMDsetup->energysendbuf))
+        if (sendThread->checkAndClearFailure())
         {
-            imd_fatal(IMDsetup, "Error sending updated energies. Disconnecting client.\n");
+            imd_fatal(IMDsetup, "Error sending updated energies and positions. Disconnecting client.\n");
+            return;
         }
 
-        if (imd_send_rvecs(IMDsetup->clientsocket, IMDsetup->nat, IMDsetup->xa, IMDsetup->coordsendbuf))
+        /* Drop this frame if the client is still receiving the previous one */
+        if (!sendThread->isIdle())
         {
-            imd_fatal(IMDsetup, "Error sending updated positions. Disconnecting client.\n");
+            IMDsetup->nframesDropped++;
+            return;
         }
+
+        char       *buffer = sendThread->frameBuffer();
+        gmx_int32_t size   = imd_pack_energies(IMDsetup->energies, buffer);
+        size += imd_pack_rvecs(IMDsetup->nat, IMDsetup->xa, buffer + size);
+        sendThread->post(IMDsetup->clientsocket, size);
     }
 #else
     gmx_incons("IMD_send_positions called without IMD support.");
@@ -68,6 +68,7 @@
 #include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/real.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -419,6 +420,203 @@ realA bonds(int nbonds,
     return vtot;
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/* Adds the shift forces of the SIMD lanes with interactions over periodic
+ * boundaries.
+ *
+ * The SIMD kernels apply PBC corrections to the distance vectors without
+ * determining shift indices. For the lanes flagged in shifted, we here
+ * determine the shift of the nother atoms ao[] relative to the central
+ * atom ac and add the forces on these atoms, stored as x, y and z blocks
+ * of GMX_SIMD_REAL_WIDTH in fo[], to the shift forces. Since the forces
+ * of an interaction sum to zero, lanes without PBC correction do not
+ * contribute to the shift forces.
+ */
+static void
+add_shift_forces_pbc_lanes(const t_pbc *pbc, const rvec x[], rvec fshift[],
+                           const realA *shifted, const int *ac,
+                           int nother, const int * const ao[], const realA * const fo[])
+{
+    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        if (shifted[s] == 0)
+        {
+            continue;
+        }
+        for (int a = 0; a < nother; a++)
+        {
+            rvec dx;
+            int  t = pbc_dx_aiuc(pbc, x[ao[a][s]], x[ac[s]], dx);
+
+            if (t != CENTRAL)
+            {
+                for (int m = 0; m < DIM; m++)
+                {
+                    fshift[t][m]       += fo[a][m*GMX_SIMD_REAL_WIDTH + s];
+                    fshift[CENTRAL][m] -= fo[a][m*GMX_SIMD_REAL_WIDTH + s];
+                }
+            }
+        }
+    }
+}
+
+/* Stores the force f?_S in fo for use with add_shift_forces_pbc_lanes */
+static gmx_inline void gmx_simdcall
+store_lane_forces(SimdReal fx_S, SimdReal fy_S, SimdReal fz_S, realA *fo)
+{
+    store(fo + 0*GMX_SIMD_REAL_WIDTH, fx_S);
+    store(fo + 1*GMX_SIMD_REAL_WIDTH, fy_S);
+    store(fo + 2*GMX_SIMD_REAL_WIDTH, fz_S);
+}
+
+/* Returns whether the PBC corrected vector d?_S differs from the raw one r?_S */
+static gmx_inline SimdBool gmx_simdcall
+pbc_corrected(SimdReal dx_S, SimdReal dy_S, SimdReal dz_S,
+              SimdReal rx_S, SimdReal ry_S, SimdReal rz_S)
+{
+    return (dx_S != rx_S) || (dy_S != ry_S) || (dz_S != rz_S);
+}
+
+/* As bonds, but using SIMD to calculate many bonds at once.
+ * With calcEnerVir, returns the energy and adds the shift forces,
+ * this requires that no graph is used. Without, fshift is not used
+ * and 0 is returned.
+ */
+template<bool calcEnerVir>
+static realA
+bonds_simd_template(int nbonds,
+                    const t_iatom forceatoms[], const t_iparams forceparams[],
+                    const rvec x[], rvec4 f[], rvec fshift[],
+                    const t_pbc *pbc)
+{
+    const int            nfa1 = 3;
+    int                  i, iu, s;
+    int                  type;
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t ai[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t aj[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA        coeff[2*GMX_SIMD_REAL_WIDTH];
+    SimdReal             xi_S, yi_S, zi_S;
+    SimdReal             xj_S, yj_S, zj_S;
+    SimdReal             k_S, b0_S;
+    SimdReal             dx_S, dy_S, dz_S;
+    SimdReal             dr2_S, invdr_S, ddr_S;
+    SimdReal             fbond_S;
+    SimdReal             f_ix_S, f_iy_S, f_iz_S;
+    SimdReal             vtot_S = setZero();
+    alignas(GMX_SIMD_ALIGNMENT) realA        pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA        shifted[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA        f_i[DIM*GMX_SIMD_REAL_WIDTH];
+    const int           *ao[1]  = { ai };
+    const realA         *fo[1]  = { f_i };
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of bonds times nfa1, here we step GMX_SIMD_REAL_WIDTH bonds */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH bonds.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s*nfa1 < nbonds)
+            {
+                coeff[s]                     = forceparams[type].harmonic.krA;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = forceparams[type].harmonic.rA;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                coeff[s]                     = 0;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = 0;
+            }
+        }
+
+        gatherLoadUTranspose<3>(reinterpret_cast<const realA *>(x), ai, &xi_S, &yi_S, &zi_S);
+        gatherLoadUTranspose<3>(reinterpret_cast<const realA *>(x), aj, &xj_S, &yj_S, &zj_S);
+        dx_S      = xi_S - xj_S;
+        dy_S      = yi_S - yj_S;
+        dz_S      = zi_S - zj_S;
+
+        k_S       = load<SimdReal>(coeff);
+        b0_S      = load<SimdReal>(coeff+GMX_SIMD_REAL_WIDTH);
+
+        pbc_correct_dx_simd(&dx_S, &dy_S, &dz_S, pbc_simd);
+
+        if (calcEnerVir && pbc)
+        {
+            SimdBool shifted_S = pbc_corrected(dx_S, dy_S, dz_S, xi_S - xj_S, yi_S - yj_S, zi_S - zj_S);
+            store(shifted, selectByMask(SimdReal(1.0), shifted_S));
+        }
+
+        dr2_S     = norm2(dx_S, dy_S, dz_S);
+        /* As in bonds, we skip bonds of zero length */
+        invdr_S   = maskzInvsqrt(dr2_S, setZero() < dr2_S);
+        ddr_S     = dr2_S * invdr_S - b0_S;
+
+        if (calcEnerVir)
+        {
+            vtot_S = vtot_S + selectByMask(SimdReal(0.5) * k_S * ddr_S * ddr_S, setZero() < dr2_S);
+        }
+
+        fbond_S   = -k_S * ddr_S * invdr_S;
+
+        f_ix_S    = fbond_S * dx_S;
+        f_iy_S    = fbond_S * dy_S;
+        f_iz_S    = fbond_S * dz_S;
+
+        transposeScatterIncrU<4>(reinterpret_cast<realA *>(f), ai, f_ix_S, f_iy_S, f_iz_S);
+        transposeScatterDecrU<4>(reinterpret_cast<realA *>(f), aj, f_ix_S, f_iy_S, f_iz_S);
+
+        if (calcEnerVir && pbc && anyTrue(load<SimdReal>(shifted) != setZero()))
+        {
+            store_lane_forces(f_ix_S, f_iy_S, f_iz_S, f_i);
+            add_shift_forces_pbc_lanes(pbc, x, fshift, shifted, aj, 1, ao, fo);
+        }
+    }
+
+    return calcEnerVir ? reduce(vtot_S) : 0;
+}
+
+void
+bonds_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  realA gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    bonds_simd_template<false>(nbonds, forceatoms, forceparams, x, f, nullptr, pbc);
+}
+
+realA
+bonds_simd(int nbonds,
+           const t_iatom forceatoms[], const t_iparams forceparams[],
+           const rvec x[], rvec4 f[], rvec fshift[],
+           const t_pbc *pbc, const t_graph gmx_unused *g,
+           realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+           const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+           int gmx_unused *global_atom_index)
+{
+    GMX_ASSERT(g == nullptr, "The SIMD bonded kernels do not support a graph");
+
+    return bonds_simd_template<true>(nbonds, forceatoms, forceparams, x, f, fshift, pbc);
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 realA restraint_bonds(int nbonds,
                      const t_iatom forceatoms[], const t_iparams forceparams[],
                      const rvec x[], rvec4 f[], rvec fshift[],
@@ -968,16 +1166,16 @@ realA angles(int nbonds,
 #if GMX_SIMD_HAVE_REAL
 
 /* As angles, but using SIMD to calculate many angles at once.
- * This routines does not calculate energies and shift forces.
+ * With calcEnerVir, returns the energy and adds the shift forces,
+ * this requires that no graph is used. Without, fshift is not used
+ * and 0 is returned.
  */
-void
-angles_noener_simd(int nbonds,
-                   const t_iatom forceatoms[], const t_iparams forceparams[],
-                   const rvec x[], rvec4 f[],
-                   const t_pbc *pbc, const t_graph gmx_unused *g,
-                   realA gmx_unused lambda,
-                   const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-                   int gmx_unused *global_atom_index)
+template<bool calcEnerVir>
+static realA
+angles_simd_template(int nbonds,
+                     const t_iatom forceatoms[], const t_iparams forceparams[],
+                     const rvec x[], rvec4 f[], rvec fshift[],
+                     const t_pbc *pbc)
 {
     const int            nfa1 = 4;
     int                  i, iu, s;
@@ -1005,7 +1203,13 @@ angles_noener_simd(int nbonds,
     SimdReal             cik_S, cii_S, ckk_S;
     SimdReal             f_ix_S, f_iy_S, f_iz_S;
     SimdReal             f_kx_S, f_ky_S, f_kz_S;
+    SimdReal             vtot_S = setZero();
     alignas(GMX_SIMD_ALIGNMENT) realA    pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA    shifted[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA    f_i[DIM*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA    f_k[DIM*GMX_SIMD_REAL_WIDTH];
+    const int           *ao[2]  = { ai, ak };
+    const realA         *fo[2]  = { f_i, f_k };
 
     set_pbc_simd(pbc, pbc_simd);
 
@@ -1058,6 +1262,13 @@ angles_noener_simd(int nbonds,
         pbc_correct_dx_simd(&rijx_S, &rijy_S, &rijz_S, pbc_simd);
         pbc_correct_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, pbc_simd);
 
+        if (calcEnerVir && pbc)
+        {
+            SimdBool shifted_S = (pbc_corrected(rijx_S, rijy_S, rijz_S, xi_S - xj_S, yi_S - yj_S, zi_S - zj_S) ||
+                                  pbc_corrected(rkjx_S, rkjy_S, rkjz_S, xk_S - xj_S, yk_S - yj_S, zk_S - zj_S));
+            store(shifted, selectByMask(SimdReal(1.0), shifted_S));
+        }
+
         rij_rkj_S = iprod(rijx_S, rijy_S, rijz_S,
                           rkjx_S, rkjy_S, rkjz_S);
 
@@ -1085,6 +1296,11 @@ angles_noener_simd(int nbonds,
         st_S      = k_S * (theta0_S - theta_S) * invsin_S;
         sth_S     = st_S * cos_S;
 
+        if (calcEnerVir)
+        {
+            vtot_S = vtot_S + SimdReal(0.5) * k_S * (theta_S - theta0_S) * (theta_S - theta0_S);
+        }
+
         cik_S     = st_S  * nrij_1_S * nrkj_1_S;
         cii_S     = sth_S * nrij_1_S * nrij_1_S;
         ckk_S     = sth_S * nrkj_1_S * nrkj_1_S;
@@ -1105,7 +1321,42 @@ angles_noener_simd(int nbonds,
         transposeScatterIncrU<4>(reinterpret_cast<realA *>(f), ai, f_ix_S, f_iy_S, f_iz_S);
         transposeScatterDecrU<4>(reinterpret_cast<realA *>(f), aj, f_ix_S + f_kx_S, f_iy_S + f_ky_S, f_iz_S + f_kz_S);
         transposeScatterIncrU<4>(reinterpret_cast<realA *>(f), ak, f_kx_S, f_ky_S, f_kz_S);
+
+        if (calcEnerVir && pbc && anyTrue(load<SimdReal>(shifted) != setZero()))
+        {
+            store_lane_forces(f_ix_S, f_iy_S, f_iz_S, f_i);
+            store_lane_forces(f_kx_S, f_ky_S, f_kz_S, f_k);
+            add_shift_forces_pbc_lanes(pbc, x, fshift, shifted, aj, 2, ao, fo);
+        }
     }
+
+    return calcEnerVir ? reduce(vtot_S) : 0;
+}
+
+void
+angles_noener_simd(int nbonds,
+                   const t_iatom forceatoms[], const t_iparams forceparams[],
+                   const rvec x[], rvec4 f[],
+                   const t_pbc *pbc, const t_graph gmx_unused *g,
+                   realA gmx_unused lambda,
+                   const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                   int gmx_unused *global_atom_index)
+{
+    angles_simd_template<false>(nbonds, forceatoms, forceparams, x, f, nullptr, pbc);
+}
+
+realA
+angles_simd(int nbonds,
+            const t_iatom forceatoms[], const t_iparams forceparams[],
+            const rvec x[], rvec4 f[], rvec fshift[],
+            const t_pbc *pbc, const t_graph gmx_unused *g,
+            realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+            const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+            int gmx_unused *global_atom_index)
+{
+    GMX_ASSERT(g == nullptr, "The SIMD bonded kernels do not support a graph");
+
+    return angles_simd_template<true>(nbonds, forceatoms, forceparams, x, f, fshift, pbc);
 }
 
 #endif // GMX_SIMD_HAVE_REAL
@@ -1551,6 +1802,8 @@ realA dih_angle(const rvec xi, const rvec xj, const rvec xk, const rvec xl,
 /* As dih_angle above, but calculates 4 dihedral angles at once using SIMD,
  * also calculates the pre-factor required for the dihedral force update.
  * Note that bv and buf should be register aligned.
+ * When pbcShifted_S is not nullptr, it returns which of the dihedrals
+ * had one or more distance vectors corrected for PBC.
  */
 static gmx_inline void
 dih_angle_simd(const rvec *x,
@@ -1562,7 +1815,8 @@ dih_angle_simd(const rvec *x,
                SimdReal *nrkj_m2_S,
                SimdReal *nrkj_n2_S,
                SimdReal *p_S,
-               SimdReal *q_S)
+               SimdReal *q_S,
+               SimdBool *pbcShifted_S = nullptr)
 {
     SimdReal xi_S, yi_S, zi_S;
     SimdReal xj_S, yj_S, zj_S;
@@ -1608,6 +1862,13 @@ dih_angle_simd(const rvec *x,
     pbc_correct_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, pbc_simd);
     pbc_correct_dx_simd(&rklx_S, &rkly_S, &rklz_S, pbc_simd);
 
+    if (pbcShifted_S != nullptr)
+    {
+        *pbcShifted_S = (pbc_corrected(rijx_S, rijy_S, rijz_S, xi_S - xj_S, yi_S - yj_S, zi_S - zj_S) ||
+                         pbc_corrected(rkjx_S, rkjy_S, rkjz_S, xk_S - xj_S, yk_S - yj_S, zk_S - zj_S) ||
+                         pbc_corrected(rklx_S, rkly_S, rklz_S, xk_S - xl_S, yk_S - yl_S, zk_S - zl_S));
+    }
+
     cprod(rijx_S, rijy_S, rijz_S,
           rkjx_S, rkjy_S, rkjz_S,
           mx_S, my_S, mz_S);
@@ -1795,6 +2056,34 @@ do_dih_fup_noshiftf_simd(const int *ai, const int *aj, const int *ak, const int
     transposeScatterIncrU<4>(reinterpret_cast<realA *>(f), ak, f_k_x, f_k_y, f_k_z);
     transposeScatterDecrU<4>(reinterpret_cast<realA *>(f), al, mf_l_x, mf_l_y, mf_l_z);
 }
+
+/* Adds the shift forces for the dihedrals in the lanes flagged in shifted,
+ * the arguments are as for do_dih_fup_noshiftf_simd.
+ */
+static void
+do_dih_fup_shiftf_simd(const int *ai, const int *aj, const int *ak, const int *al,
+                       SimdReal p, SimdReal q,
+                       SimdReal f_i_x,  SimdReal f_i_y,  SimdReal f_i_z,
+                       SimdReal mf_l_x, SimdReal mf_l_y, SimdReal mf_l_z,
+                       const realA *shifted,
+                       const t_pbc *pbc, const rvec x[], rvec fshift[])
+{
+    alignas(GMX_SIMD_ALIGNMENT) realA f_i[DIM*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA f_k[DIM*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA f_l[DIM*GMX_SIMD_REAL_WIDTH];
+    const int                        *ao[3] = { ai, ak, al };
+    const realA                      *fo[3] = { f_i, f_k, f_l };
+
+    SimdReal                          sx = p * f_i_x + q * mf_l_x;
+    SimdReal                          sy = p * f_i_y + q * mf_l_y;
+    SimdReal                          sz = p * f_i_z + q * mf_l_z;
+
+    store_lane_forces(f_i_x, f_i_y, f_i_z, f_i);
+    store_lane_forces(mf_l_x - sx, mf_l_y - sy, mf_l_z - sz, f_k);
+    store_lane_forces(-mf_l_x, -mf_l_y, -mf_l_z, f_l);
+
+    add_shift_forces_pbc_lanes(pbc, x, fshift, shifted, aj, 3, ao, fo);
+}
 #endif // GMX_SIMD_HAVE_REAL
 
 static realA dopdihs(realA cpA, realA cpB, realA phiA, realA phiB, int mult,
@@ -1982,15 +2271,15 @@ pdihs_noener(int nbonds,
 
 #if GMX_SIMD_HAVE_REAL
 
-/* As pdihs_noner above, but using SIMD to calculate many dihedrals at once */
-void
-pdihs_noener_simd(int nbonds,
-                  const t_iatom forceatoms[], const t_iparams forceparams[],
-                  const rvec x[], rvec4 f[],
-                  const t_pbc *pbc, const t_graph gmx_unused *g,
-                  realA gmx_unused lambda,
-                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-                  int gmx_unused *global_atom_index)
+/* As pdihs_noner above, but using SIMD to calculate many dihedrals at once.
+ * With calcEnerVir, also returns the energy and adds the shift forces.
+ */
+template<bool calcEnerVir>
+static realA
+pdihs_simd_template(int nbonds,
+                    const t_iatom forceatoms[], const t_iparams forceparams[],
+                    const rvec x[], rvec4 f[], rvec fshift[],
+                    const t_pbc *pbc)
 {
     const int             nfa1 = 5;
     int                   i, iu, s;
@@ -2011,7 +2300,10 @@ pdihs_noener_simd(int nbonds,
     SimdReal              sin_S, cos_S;
     SimdReal              mddphi_S;
     SimdReal              sf_i_S, msf_l_S;
+    SimdReal              vtot_S = setZero();
+    SimdBool              shifted_S;
     alignas(GMX_SIMD_ALIGNMENT) realA            pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA            shifted[GMX_SIMD_REAL_WIDTH];
 
     /* Extract aligned pointer for parameters and variables */
     cp    = buf + 0*GMX_SIMD_REAL_WIDTH;
@@ -2062,7 +2354,8 @@ pdihs_noener_simd(int nbonds,
                        &nx_S, &ny_S, &nz_S,
                        &nrkj_m2_S,
                        &nrkj_n2_S,
-                       &p_S, &q_S);
+                       &p_S, &q_S,
+                       (calcEnerVir && pbc) ? &shifted_S : nullptr);
 
         cp_S     = load<SimdReal>(cp);
         phi0_S   = load<SimdReal>(phi0) * deg2rad_S;
@@ -2073,6 +2366,10 @@ pdihs_noener_simd(int nbonds,
         /* Calculate GMX_SIMD_REAL_WIDTH sines at once */
         sincos(mdphi_S, &sin_S, &cos_S);
         mddphi_S = cp_S * mult_S * sin_S;
+        if (calcEnerVir)
+        {
+            vtot_S = vtot_S + cp_S + cp_S * cos_S;
+        }
         sf_i_S   = mddphi_S * nrkj_m2_S;
         msf_l_S  = mddphi_S * nrkj_n2_S;
 
@@ -2091,9 +2388,48 @@ pdihs_noener_simd(int nbonds,
                                  mx_S, my_S, mz_S,
                                  nx_S, ny_S, nz_S,
                                  f);
+
+        if (calcEnerVir && pbc && anyTrue(shifted_S))
+        {
+            store(shifted, selectByMask(SimdReal(1.0), shifted_S));
+            do_dih_fup_shiftf_simd(ai, aj, ak, al,
+                                   p_S, q_S,
+                                   mx_S, my_S, mz_S,
+                                   nx_S, ny_S, nz_S,
+                                   shifted, pbc, x, fshift);
+        }
     }
+
+    return calcEnerVir ? reduce(vtot_S) : 0;
+}
+
+void
+pdihs_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  realA gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    pdihs_simd_template<false>(nbonds, forceatoms, forceparams, x, f, nullptr, pbc);
+}
+
+realA
+pdihs_simd(int nbonds,
+           const t_iatom forceatoms[], const t_iparams forceparams[],
+           const rvec x[], rvec4 f[], rvec fshift[],
+           const t_pbc *pbc, const t_graph gmx_unused *g,
+           realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+           const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+           int gmx_unused *global_atom_index)
+{
+    GMX_ASSERT(g == nullptr, "The SIMD bonded kernels do not support a graph");
+
+    return pdihs_simd_template<true>(nbonds, forceatoms, forceparams, x, f, fshift, pbc);
 }
 
+
 /* This is mostly a copy of pdihs_noener_simd above, but with using
  * the RB potential instead of a harmonic potential.
  * This function can replace rbdihs() when no energy and virial are needed.
@@ -2298,6 +2634,160 @@ realA idihs(int nbonds,
     return vtot;
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/* As idihs, but using SIMD to calculate many dihedrals at once.
+ * With calcEnerVir, also returns the energy and adds the shift forces.
+ */
+template<bool calcEnerVir>
+static realA
+idihs_simd_template(int nbonds,
+                    const t_iatom forceatoms[], const t_iparams forceparams[],
+                    const rvec x[], rvec4 f[], rvec fshift[],
+                    const t_pbc *pbc)
+{
+    const int             nfa1 = 5;
+    int                   i, iu, s;
+    int                   type;
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ai[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    aj[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ak[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    al[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA            coeff[2*GMX_SIMD_REAL_WIDTH];
+    SimdReal              deg2rad_S(DEG2RAD);
+    SimdReal              twopi_S(2*M_PI);
+    SimdReal              inv_twopi_S(1.0/(2*M_PI));
+    SimdReal              p_S, q_S;
+    SimdReal              k_S, phi0_S, phi_S, dp_S;
+    SimdReal              mx_S, my_S, mz_S;
+    SimdReal              nx_S, ny_S, nz_S;
+    SimdReal              nrkj_m2_S, nrkj_n2_S;
+    SimdReal              mddphi_S;
+    SimdReal              sf_i_S, msf_l_S;
+    SimdReal              vtot_S = setZero();
+    SimdBool              shifted_S;
+    alignas(GMX_SIMD_ALIGNMENT) realA            pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA            shifted[GMX_SIMD_REAL_WIDTH];
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms quadruplets for GMX_SIMD_REAL_WIDTH dihedrals.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+            al[s] = forceatoms[iu+4];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s*nfa1 < nbonds)
+            {
+                coeff[s]                     = forceparams[type].harmonic.krA;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = forceparams[type].harmonic.rA;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                coeff[s]                     = 0;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = 0;
+            }
+        }
+
+        /* Caclulate GMX_SIMD_REAL_WIDTH dihedral angles at once */
+        dih_angle_simd(x, ai, aj, ak, al, pbc_simd,
+                       &phi_S,
+                       &mx_S, &my_S, &mz_S,
+                       &nx_S, &ny_S, &nz_S,
+                       &nrkj_m2_S,
+                       &nrkj_n2_S,
+                       &p_S, &q_S,
+                       (calcEnerVir && pbc) ? &shifted_S : nullptr);
+
+        k_S      = load<SimdReal>(coeff);
+        phi0_S   = load<SimdReal>(coeff+GMX_SIMD_REAL_WIDTH) * deg2rad_S;
+
+        /* As make_dp_periodic, put phi - phi0 in [-pi,pi] */
+        dp_S     = phi_S - phi0_S;
+        dp_S     = dp_S - twopi_S * round(dp_S * inv_twopi_S);
+
+        if (calcEnerVir)
+        {
+            vtot_S = vtot_S + SimdReal(0.5) * k_S * dp_S * dp_S;
+        }
+
+        mddphi_S = -k_S * dp_S;
+        sf_i_S   = mddphi_S * nrkj_m2_S;
+        msf_l_S  = mddphi_S * nrkj_n2_S;
+
+        /* After this m?_S will contain f[i] */
+        mx_S     = sf_i_S * mx_S;
+        my_S     = sf_i_S * my_S;
+        mz_S     = sf_i_S * mz_S;
+
+        /* After this m?_S will contain -f[l] */
+        nx_S     = msf_l_S * nx_S;
+        ny_S     = msf_l_S * ny_S;
+        nz_S     = msf_l_S * nz_S;
+
+        do_dih_fup_noshiftf_simd(ai, aj, ak, al,
+                                 p_S, q_S,
+                                 mx_S, my_S, mz_S,
+                                 nx_S, ny_S, nz_S,
+                                 f);
+
+        if (calcEnerVir && pbc && anyTrue(shifted_S))
+        {
+            store(shifted, selectByMask(SimdReal(1.0), shifted_S));
+            do_dih_fup_shiftf_simd(ai, aj, ak, al,
+                                   p_S, q_S,
+                                   mx_S, my_S, mz_S,
+                                   nx_S, ny_S, nz_S,
+                                   shifted, pbc, x, fshift);
+        }
+    }
+
+    return calcEnerVir ? reduce(vtot_S) : 0;
+}
+
+void
+idihs_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  realA gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    idihs_simd_template<false>(nbonds, forceatoms, forceparams, x, f, nullptr, pbc);
+}
+
+realA
+idihs_simd(int nbonds,
+           const t_iatom forceatoms[], const t_iparams forceparams[],
+           const rvec x[], rvec4 f[], rvec fshift[],
+           const t_pbc *pbc, const t_graph gmx_unused *g,
+           realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+           const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+           int gmx_unused *global_atom_index)
+{
+    GMX_ASSERT(g == nullptr, "The SIMD bonded kernels do not support a graph");
+
+    return idihs_simd_template<true>(nbonds, forceatoms, forceparams, x, f, fshift, pbc);
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 static realA low_angres(int nbonds,
                        const t_iatom forceatoms[], const t_iparams forceparams[],
                        const rvec x[], rvec4 f[], rvec fshift[],
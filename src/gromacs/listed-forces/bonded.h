@@ -123,6 +123,19 @@ void
 
 /* TODO these declarations should be internal to the module */
 
+/* As bonds(), but using SIMD to calculate many bonds at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+    bonds_noener_simd(int nbonds,
+                      const t_iatom forceatoms[], const t_iparams forceparams[],
+                      const rvec x[], rvec4 f[],
+                      const struct t_pbc *pbc,
+                      const struct t_graph gmx_unused *g,
+                      realA gmx_unused lambda,
+                      const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                      int gmx_unused *global_atom_index);
+
 /* As angles(), but using SIMD to calculate many angles at once.
  * This routines does not calculate energies and shift forces.
  */
@@ -158,6 +171,19 @@ void
                       const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
                       int gmx_unused *global_atom_index);
 
+/* As idihs(), but using SIMD to calculate many dihedrals at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+    idihs_noener_simd(int nbonds,
+                      const t_iatom forceatoms[], const t_iparams forceparams[],
+                      const rvec x[], rvec4 f[],
+                      const struct t_pbc *pbc,
+                      const struct t_graph gmx_unused *g,
+                      realA gmx_unused lambda,
+                      const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                      int gmx_unused *global_atom_index);
+
 /* As rbdihs(), when not needing energy or shift force, using SIMD to calculate many dihedrals at once. */
 void
     rbdihs_noener_simd(int nbonds,
@@ -169,6 +195,42 @@ void
                        const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
                        int gmx_unused *global_atom_index);
 
+/* SIMD versions of bonds(), angles(), pdihs() and idihs() which do
+ * compute energies and shift forces. These only support the A-state
+ * parameters without perturbation and require g == nullptr.
+ */
+realA bonds_simd(int nbonds,
+                 const t_iatom forceatoms[], const t_iparams forceparams[],
+                 const rvec x[], rvec4 f[], rvec fshift[],
+                 const struct t_pbc *pbc, const struct t_graph gmx_unused *g,
+                 realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+                 const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                 int gmx_unused *global_atom_index);
+
+realA angles_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[], rvec fshift[],
+                  const struct t_pbc *pbc, const struct t_graph gmx_unused *g,
+                  realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index);
+
+realA pdihs_simd(int nbonds,
+                 const t_iatom forceatoms[], const t_iparams forceparams[],
+                 const rvec x[], rvec4 f[], rvec fshift[],
+                 const struct t_pbc *pbc, const struct t_graph gmx_unused *g,
+                 realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+                 const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                 int gmx_unused *global_atom_index);
+
+realA idihs_simd(int nbonds,
+                 const t_iatom forceatoms[], const t_iparams forceparams[],
+                 const rvec x[], rvec4 f[], rvec fshift[],
+                 const struct t_pbc *pbc, const struct t_graph gmx_unused *g,
+                 realA gmx_unused lambda, realA gmx_unused *dvdlambda,
+                 const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                 int gmx_unused *global_atom_index);
+
 //! \endcond
 
 #endif
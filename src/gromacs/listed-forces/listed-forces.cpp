@@ -112,6 +112,20 @@ zero_thread_output(struct bonded_threading_t *bt, int thread)
         }
     }
 
+    /* Clear the blocks of the shared buffer owned by this thread */
+    for (int i = 0; i < f_t->nblock_owned; i++)
+    {
+        int a0 = f_t->block_index_owned[i]*reduction_block_size;
+        int a1 = a0 + reduction_block_size;
+        for (int a = a0; a < a1; a++)
+        {
+            for (int d = 0; d < nelem_fa; d++)
+            {
+                bt->f_direct[a][d] = 0;
+            }
+        }
+    }
+
     for (int i = 0; i < SHIFTS; i++)
     {
         clear_rvec(f_t->fshift[i]);
@@ -164,10 +178,14 @@ reduce_thread_forces(int n, rvec *f,
         try
         {
             int    ind = bt->block_index[b];
-            rvec4 *fp[MAX_BONDED_THREADS];
+            rvec4 *fp[MAX_BONDED_THREADS + 1];
 
-            /* Determine which threads contribute to this block */
+            /* Determine which buffers contribute to this block */
             int nfb = 0;
+            if (bt->block_owner[ind] >= 0)
+            {
+                fp[nfb++] = bt->f_direct;
+            }
             for (int ft = 0; ft < bt->nthreads; ft++)
             {
                 if (bitmask_is_set(bt->mask[ind], ft))
@@ -254,16 +272,32 @@ reduce_thread_output(int n, rvec *f, rvec *fshift,
     }
 }
 
-/*! \brief Calculate one element of the list of bonded interactions
-    for this thread */
+#if GMX_SIMD_HAVE_REAL
+/*! \brief Returns the SIMD kernel computing energies and shift forces
+ * for \p ftype, or nullptr when there is none */
+static t_ifunc *
+simdKernelWithEnergy(int ftype)
+{
+    switch (ftype)
+    {
+        case F_BONDS:  return bonds_simd;
+        case F_ANGLES: return angles_simd;
+        case F_PDIHS:  return pdihs_simd;
+        case F_IDIHS:  return idihs_simd;
+        default:       return nullptr;
+    }
+}
+#endif
+
+/*! \brief Calculate the bonded interactions of type ftype stored
+    in iatoms range nb0 to nb1 */
 static realA
-calc_one_bond(int thread,
-              int ftype, const t_idef *idef,
+calc_one_bond(int ftype, const t_idef *idef,
+              int nb0, int nb1,
               const rvec x[], rvec4 f[], rvec fshift[],
               const t_forcerec *fr,
               const t_pbc *pbc, const t_graph *g,
               gmx_grppairener_t *grpp,
-              t_nrnb *nrnb,
               const realA *lambda, realA *dvdl,
               const t_mdatoms *md, t_fcdata *fcd,
               gmx_bool bCalcEnerVir,
@@ -273,10 +307,10 @@ calc_one_bond(int thread,
     bool bUseSIMD = fr->use_simd_kernels;
 #endif
 
-    int      nat1, nbonds, efptFTYPE;
+    int      efptFTYPE;
     realA     v = 0;
     t_iatom *iatoms;
-    int      nb0, nbn;
+    int      nbn;
 
     if (IS_RESTRAINT_TYPE(ftype))
     {
@@ -291,12 +325,9 @@ calc_one_bond(int thread,
     const bool useFreeEnergy     = (idef->ilsort == ilsortFE_SORTED && idef->il[ftype].nr_nonperturbed < idef->il[ftype].nr);
     const bool computeForcesOnly = (!bCalcEnerVir && !useFreeEnergy);
 
-    nat1      = interaction_function[ftype].nratoms + 1;
-    nbonds    = idef->il[ftype].nr/nat1;
     iatoms    = idef->il[ftype].iatoms;
 
-    nb0 = idef->il_thread_division[ftype*(idef->nthreads+1)+thread];
-    nbn = idef->il_thread_division[ftype*(idef->nthreads+1)+thread+1] - nb0;
+    nbn       = nb1 - nb0;
 
     if (!isPairInteraction(ftype))
     {
@@ -313,6 +344,17 @@ calc_one_bond(int thread,
                           md, fcd, global_atom_index);
         }
 #if GMX_SIMD_HAVE_REAL
+        else if (ftype == F_BONDS && bUseSIMD && computeForcesOnly)
+        {
+            /* No energies, shift forces, dvdl */
+            bonds_noener_simd(nbn, idef->il[ftype].iatoms+nb0,
+                              idef->iparams,
+                              x, f,
+                              pbc, g, lambda[efptFTYPE], md, fcd,
+                              global_atom_index);
+            v = 0;
+        }
+
         else if (ftype == F_ANGLES && bUseSIMD && computeForcesOnly)
         {
             /* No energies, shift forces, dvdl */
@@ -369,6 +411,26 @@ calc_one_bond(int thread,
                                global_atom_index);
             v = 0;
         }
+        else if (ftype == F_IDIHS && bUseSIMD && computeForcesOnly)
+        {
+            /* No energies, shift forces, dvdl */
+            idihs_noener_simd(nbn, idef->il[ftype].iatoms+nb0,
+                              idef->iparams,
+                              x, f,
+                              pbc, g, lambda[efptFTYPE], md, fcd,
+                              global_atom_index);
+            v = 0;
+        }
+        else if (bUseSIMD && !useFreeEnergy && g == nullptr &&
+                 simdKernelWithEnergy(ftype) != nullptr)
+        {
+            /* Energies and shift forces, no dvdl without perturbation */
+            v = simdKernelWithEnergy(ftype)(nbn, iatoms+nb0,
+                                            idef->iparams,
+                                            x, f, fshift,
+                                            pbc, g, lambda[efptFTYPE], &(dvdl[efptFTYPE]),
+                                            md, fcd, global_atom_index);
+        }
 #endif
         else
         {
@@ -390,11 +452,6 @@ calc_one_bond(int thread,
         v = 0;
     }
 
-    if (thread == 0)
-    {
-        inc_nrnb(nrnb, interaction_function[ftype].nrnb_ind, nbonds);
-    }
-
     return v;
 }
 
@@ -464,12 +521,39 @@ calcBondedForces(const t_idef     *idef,
             {
                 if (idef->il[ftype].nr > 0 && ftype_is_bonded_potential(ftype))
                 {
-                    v = calc_one_bond(thread, ftype, idef, x,
-                                      ft, fshift, fr, pbc_null, g, grpp,
-                                      nrnb, lambda, dvdlt,
-                                      md, fcd, bCalcEnerVir,
-                                      global_atom_index);
-                    epot[ftype] += v;
+                    const int *division = idef->il_thread_division + ftype*(idef->nthreads + 1);
+                    const int  nb0      = division[thread];
+                    const int  nb1      = division[thread + 1];
+                    const int  nbDirect = bt->f_t[thread].il_direct_end[ftype];
+
+                    /* The interactions within our owned blocks write
+                     * directly into the shared buffer, the others into
+                     * our thread local buffer.
+                     */
+                    if (nbDirect > nb0)
+                    {
+                        v = calc_one_bond(ftype, idef, nb0, nbDirect, x,
+                                          bt->f_direct, fshift, fr, pbc_null, g, grpp,
+                                          lambda, dvdlt,
+                                          md, fcd, bCalcEnerVir,
+                                          global_atom_index);
+                        epot[ftype] += v;
+                    }
+                    if (nb1 > nbDirect)
+                    {
+                        v = calc_one_bond(ftype, idef, nbDirect, nb1, x,
+                                          ft, fshift, fr, pbc_null, g, grpp,
+                                          lambda, dvdlt,
+                                          md, fcd, bCalcEnerVir,
+                                          global_atom_index);
+                        epot[ftype] += v;
+                    }
+
+                    if (thread == 0)
+                    {
+                        inc_nrnb(nrnb, interaction_function[ftype].nrnb_ind,
+                                 idef->il[ftype].nr/(interaction_function[ftype].nratoms + 1));
+                    }
                 }
             }
         }
@@ -602,19 +686,18 @@ void calc_listed_lambda(const t_idef *idef,
                         const rvec x[],
                         const t_forcerec *fr,
                         const struct t_pbc *pbc, const struct t_graph *g,
-                        gmx_grppairener_t *grpp, realA *epot, t_nrnb *nrnb,
+                        gmx_enerdata_t *enerd, t_nrnb *nrnb,
+                        const t_lambda *fepvals,
                         const realA *lambda,
                         const t_mdatoms *md,
                         t_fcdata *fcd,
                         int *global_atom_index)
 {
-    int           ftype, nr_nonperturbed, nr;
     realA          v;
     realA          dvdl_dum[efptNR] = {0};
     rvec4        *f;
     rvec         *fshift;
     const  t_pbc *pbc_null;
-    t_idef        idef_fe;
 
     if (fr->bMolPBC)
     {
@@ -625,45 +708,52 @@ void calc_listed_lambda(const t_idef *idef,
         pbc_null = nullptr;
     }
 
-    /* Copy the whole idef, so we can modify the contents locally */
-    idef_fe          = *idef;
-    idef_fe.nthreads = 1;
-    snew(idef_fe.il_thread_division, F_NRE*(idef_fe.nthreads+1));
-
-    /* We already have the forces, so we use temp buffers here */
+    /* We already have the forces, so we use temp buffers here.
+     * The forces are not used, so the buffers are shared by all
+     * lambda values and never need to be cleared again.
+     */
     snew(f, fr->natoms_force);
     snew(fshift, SHIFTS);
 
-    /* Loop over all bonded force types to calculate the bonded energies */
-    for (ftype = 0; (ftype < F_NRE); ftype++)
+    for (int i = 0; i < enerd->n_lambda; i++)
     {
-        if (ftype_is_bonded_potential(ftype))
+        realA lam_i[efptNR];
+
+        for (int j = 0; j < efptNR; j++)
         {
-            /* Set the work range of thread 0 to the perturbed bondeds only */
-            nr_nonperturbed                       = idef->il[ftype].nr_nonperturbed;
-            nr                                    = idef->il[ftype].nr;
-            idef_fe.il_thread_division[ftype*2+0] = nr_nonperturbed;
-            idef_fe.il_thread_division[ftype*2+1] = nr;
+            lam_i[j] = (i == 0 ? lambda[j] : fepvals->all_lambda[j][i-1]);
+        }
 
-            /* This is only to get the flop count correct */
-            idef_fe.il[ftype].nr = nr - nr_nonperturbed;
+        reset_foreign_enerdata(enerd);
 
-            if (nr - nr_nonperturbed > 0)
+        /* Loop over all bonded force types to calculate the energies
+         * of the perturbed bondeds
+         */
+        for (int ftype = 0; ftype < F_NRE; ftype++)
+        {
+            int nr_nonperturbed = idef->il[ftype].nr_nonperturbed;
+            int nr              = idef->il[ftype].nr;
+
+            if (ftype_is_bonded_potential(ftype) && nr > nr_nonperturbed)
             {
-                v = calc_one_bond(0, ftype, &idef_fe,
+                v = calc_one_bond(ftype, idef, nr_nonperturbed, nr,
                                   x, f, fshift, fr, pbc_null, g,
-                                  grpp, nrnb, lambda, dvdl_dum,
+                                  &enerd->foreign_grpp, lam_i, dvdl_dum,
                                   md, fcd, TRUE,
                                   global_atom_index);
-                epot[ftype] += v;
+                enerd->foreign_term[ftype] += v;
+
+                inc_nrnb(nrnb, interaction_function[ftype].nrnb_ind,
+                         (nr - nr_nonperturbed)/(interaction_function[ftype].nratoms + 1));
             }
         }
+
+        sum_epot(&enerd->foreign_grpp, enerd->foreign_term);
+        enerd->enerpart_lambda[i] += enerd->foreign_term[F_EPOT];
     }
 
     sfree(fshift);
     sfree(f);
-
-    sfree(idef_fe.il_thread_division);
 }
 
 void
@@ -720,20 +810,8 @@ do_force_listed(struct gmx_wallcycle        *wcycle,
             {
                 gmx_incons("The bonded interactions are not sorted for free energy");
             }
-            for (int i = 0; i < enerd->n_lambda; i++)
-            {
-                realA lam_i[efptNR];
-
-                reset_foreign_enerdata(enerd);
-                for (int j = 0; j < efptNR; j++)
-                {
-                    lam_i[j] = (i == 0 ? lambda[j] : fepvals->all_lambda[j][i-1]);
-                }
-                calc_listed_lambda(idef, x, fr, pbc, graph, &(enerd->foreign_grpp), enerd->foreign_term, nrnb, lam_i, md,
-                                   fcd, global_atom_index);
-                sum_epot(&(enerd->foreign_grpp), enerd->foreign_term);
-                enerd->enerpart_lambda[i] += enerd->foreign_term[F_EPOT];
-            }
+            calc_listed_lambda(idef, x, fr, pbc, graph, enerd, nrnb, fepvals, lambda, md,
+                               fcd, global_atom_index);
             wallcycle_sub_stop(wcycle, ewcsLISTED_FEP);
         }
     }
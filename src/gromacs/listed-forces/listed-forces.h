@@ -115,14 +115,18 @@ void calc_listed(const t_commrec *cr,
                  int force_flags);
 
 /*! \brief As calc_listed(), but only determines the potential energy
- * for the perturbed interactions.
+ * for the perturbed interactions, for all foreign lambda values.
  *
+ * The energy for each lambda value is added to enerd->enerpart_lambda.
+ * The set-up of the perturbed work ranges and the temporary force buffers
+ * are shared by all lambda values.
  * The shift forces in fr are not affected. */
 void calc_listed_lambda(const t_idef *idef,
                         const rvec x[],
                         const t_forcerec *fr,
                         const struct t_pbc *pbc, const struct t_graph *g,
-                        gmx_grppairener_t *grpp, realA *epot, t_nrnb *nrnb,
+                        gmx_enerdata_t *enerd, t_nrnb *nrnb,
+                        const t_lambda *fepvals,
                         const realA *lambda,
                         const t_mdatoms *md,
                         struct t_fcdata *fcd, int *global_atom_index);
@@ -56,15 +56,25 @@
 static const int reduction_block_size = 32; /**< Force buffer block size in atoms*/
 static const int reduction_block_bits =  5; /**< log2(reduction_block_size) */
 
-/*! \internal \brief struct with output for bonded forces, used per thread */
+/*! \internal \brief struct with output for bonded forces, used per thread
+ *
+ * Interactions of which all atoms are in blocks owned by this thread,
+ * i.e. blocks no other thread touches, write directly into the shared
+ * buffer bonded_threading_t::f_direct. Only the remaining interactions,
+ * which are at the boundaries with the other threads, use f. So only
+ * the blocks of f touched by those are cleared and reduced.
+ */
 typedef struct
 {
-    rvec4            *f;            /**< Force array */
-    int               f_nalloc;     /**< Allocation size of f */
-    gmx_bitmask_t    *mask;         /**< Mask for marking which parts of f are filled, working array for constructing mask in bonded_threading_t */
-    int               nblock_used;  /**< Number of blocks touched by our thread */
-    int              *block_index;  /**< Index to touched blocks, size nblock_used */
-    int               block_nalloc; /**< Allocation size of f (*reduction_block_size), mask_index, mask */
+    rvec4            *f;                   /**< Force array for the boundary interactions, only touched blocks are used */
+    int               f_nalloc;            /**< Allocation size of f */
+    gmx_bitmask_t    *mask;                /**< Mask for marking which parts of f are filled, working array for constructing mask in bonded_threading_t */
+    int               nblock_used;         /**< Number of blocks of f touched by our thread */
+    int              *block_index;         /**< Index to touched blocks, size nblock_used */
+    int               block_nalloc;        /**< Allocation size of mask, block_index, block_index_owned */
+    int               nblock_owned;        /**< Number of blocks of f_direct owned by our thread */
+    int              *block_index_owned;   /**< Index to owned blocks, size nblock_owned */
+    int               il_direct_end[F_NRE]; /**< Per type, the end in iatoms of our interactions using f_direct */
 
     rvec             *fshift;       /**< Shift force array, size SHIFTS */
     realA              ener[F_NRE];  /**< Energy array */
@@ -81,8 +91,11 @@ struct bonded_threading_t
     f_thread_t    *f_t;          /**< Force/enegry data per thread, size nthreads */
     int            nblock_used;  /**< The number of force blocks to reduce */
     int           *block_index;  /**< Index of size nblock_used into mask */
-    gmx_bitmask_t *mask;         /**< Mask array, one element corresponds to a block of reduction_block_size atoms of the force array, bit corresponding to thread indices set if a thread writes to that block */
-    int            block_nalloc; /**< Allocation size of block_index and mask */
+    gmx_bitmask_t *mask;         /**< Mask array, one element corresponds to a block of reduction_block_size atoms of the force array, bit corresponding to thread indices set if a thread writes to that block in its own buffer */
+    int           *block_owner;  /**< The thread owning each block of f_direct, -1 when not owned */
+    int            block_nalloc; /**< Allocation size of block_index, mask and block_owner */
+    rvec4         *f_direct;     /**< Force buffer shared by all threads for interactions within owned blocks */
+    int            f_direct_nalloc; /**< Allocation size of f_direct */
 
     bool           haveBondeds;  /**< true if we have and thus need to reduce bonded forces */
 
@@ -52,6 +52,7 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/listed-forces/listed-forces.h"
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
@@ -187,6 +188,107 @@ static void divide_bondeds_by_locality(int                 ntype,
     }
 }
 
+/*! \brief Returns whether the interactions of type ftype can be reordered
+ *
+ * Restraints and other types with state or labels connecting interactions
+ * should keep their order.
+ */
+static bool bondedTypeCanBeSorted(int ftype)
+{
+    switch (ftype)
+    {
+        case F_BONDS:
+        case F_G96BONDS:
+        case F_HARMONIC:
+        case F_ANGLES:
+        case F_G96ANGLES:
+        case F_UREY_BRADLEY:
+        case F_PDIHS:
+        case F_PIDIHS:
+        case F_IDIHS:
+        case F_RBDIHS:
+        case F_FOURDIHS:
+        case F_CMAP:
+        case F_LJ14:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*! \brief Stable sorts interactions [start, end) in \p il by their first atom
+ *
+ * This makes the atoms accessed by consecutive interactions, and thus
+ * by the SIMD lanes in the bonded kernels, local in memory and gives
+ * divide_bondeds_by_locality() the ordering it assumes.
+ * \p perm and \p buf are work buffers.
+ */
+static void sort_ilist_range_by_first_atom(t_ilist *il, int nral,
+                                           int start, int end,
+                                           std::vector<int>     *perm,
+                                           std::vector<t_iatom> *buf)
+{
+    const int      nat1   = 1 + nral;
+    const t_iatom *iatoms = il->iatoms;
+    const int      n      = (end - start)/nat1;
+
+    bool           sorted = true;
+    for (int i = start + nat1; i < end && sorted; i += nat1)
+    {
+        sorted = (iatoms[i + 1] >= iatoms[i + 1 - nat1]);
+    }
+    if (sorted)
+    {
+        return;
+    }
+
+    perm->resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        (*perm)[i] = start + i*nat1;
+    }
+    std::stable_sort(perm->begin(), perm->end(),
+                     [iatoms](int a, int b) { return iatoms[a + 1] < iatoms[b + 1]; });
+
+    buf->assign(iatoms + start, iatoms + end);
+    for (int i = 0; i < n; i++)
+    {
+        std::copy_n(buf->data() + (*perm)[i] - start, nat1,
+                    il->iatoms + start + i*nat1);
+    }
+}
+
+/*! \brief Sorts the bonded interactions that allow reordering on atom index
+ *
+ * With free-energy sorted lists, the non-perturbed and perturbed parts
+ * are sorted separately.
+ */
+static void sort_bondeds_by_first_atom(t_idef *idef)
+{
+    std::vector<int>     perm;
+    std::vector<t_iatom> buf;
+
+    for (int f = 0; f < F_NRE; f++)
+    {
+        t_ilist *il = &idef->il[f];
+
+        if (!bondedTypeCanBeSorted(f) || il->nr == 0)
+        {
+            continue;
+        }
+
+        if (idef->ilsort == ilsortFE_SORTED)
+        {
+            sort_ilist_range_by_first_atom(il, NRAL(f), 0, il->nr_nonperturbed, &perm, &buf);
+            sort_ilist_range_by_first_atom(il, NRAL(f), il->nr_nonperturbed, il->nr, &perm, &buf);
+        }
+        else
+        {
+            sort_ilist_range_by_first_atom(il, NRAL(f), 0, il->nr, &perm, &buf);
+        }
+    }
+}
+
 //! Divides bonded interactions over threads
 static void divide_bondeds_over_threads(t_idef *idef,
                                         int     nthread,
@@ -310,12 +412,17 @@ static void divide_bondeds_over_threads(t_idef *idef,
     }
 }
 
-//! Construct a reduction mask for which parts (blocks) of the force array are touched on which thread task
+/*! \brief Construct a reduction mask for which parts (blocks) of the force array are touched on which thread task
+ *
+ * With \p boundaryOnly, only the interactions writing to the thread
+ * local buffer, i.e. those after il_direct_end, are considered.
+ */
 static void
 calc_bonded_reduction_mask(int natoms,
                            f_thread_t *f_thread,
                            const t_idef *idef,
-                           int thread, int nthread)
+                           int thread, int nthread,
+                           bool boundaryOnly)
 {
     static_assert(BITMASK_SIZE == GMX_OPENMP_MAX_THREADS, "For the error message below we assume these two are equal.");
 
@@ -333,10 +440,9 @@ calc_bonded_reduction_mask(int natoms,
     if (nblock > f_thread->block_nalloc)
     {
         f_thread->block_nalloc = over_alloc_large(nblock);
-        srenew(f_thread->mask,        f_thread->block_nalloc);
-        srenew(f_thread->block_index, f_thread->block_nalloc);
-        sfree_aligned(f_thread->f);
-        snew_aligned(f_thread->f,     f_thread->block_nalloc*reduction_block_size, 128);
+        srenew(f_thread->mask,              f_thread->block_nalloc);
+        srenew(f_thread->block_index,       f_thread->block_nalloc);
+        srenew(f_thread->block_index_owned, f_thread->block_nalloc);
     }
 
     gmx_bitmask_t *mask = f_thread->mask;
@@ -358,6 +464,11 @@ calc_bonded_reduction_mask(int natoms,
                 int nb0 = idef->il_thread_division[ftype*(nthread + 1) + thread];
                 int nb1 = idef->il_thread_division[ftype*(nthread + 1) + thread + 1];
 
+                if (boundaryOnly)
+                {
+                    nb0 = f_thread->il_direct_end[ftype];
+                }
+
                 for (int i = nb0; i < nb1; i += nat1)
                 {
                     for (int a = 1; a < nat1; a++)
@@ -373,13 +484,99 @@ calc_bonded_reduction_mask(int natoms,
      * force buffer clearing.
      */
     f_thread->nblock_used = 0;
+    int blockMax          = -1;
     for (int b = 0; b < nblock; b++)
     {
         if (bitmask_is_set(mask[b], thread))
         {
             f_thread->block_index[f_thread->nblock_used++] = b;
+            blockMax = b;
         }
     }
+
+    if (boundaryOnly && (blockMax + 1)*reduction_block_size > f_thread->f_nalloc)
+    {
+        /* We only ever access the touched blocks, which we clear
+         * every step, so we do not need to initialize the buffer.
+         * This also means that only the memory pages of blocks
+         * that are actually used by our thread get mapped.
+         */
+        f_thread->f_nalloc = over_alloc_large(blockMax + 1)*reduction_block_size;
+        sfree_aligned(f_thread->f);
+        f_thread->f = static_cast<rvec4 *>(save_malloc_aligned("f", __FILE__, __LINE__,
+                                                               f_thread->f_nalloc, sizeof(rvec4), 128));
+    }
+}
+
+/*! \brief Returns whether ftype can write to the shared force buffer
+ *
+ * Only types which we can reorder and which have no perturbed
+ * interactions, since these need to stay at the end, are used.
+ */
+static bool canUseDirectForceBuffer(const t_idef *idef, int ftype)
+{
+    return (bondedTypeCanBeSorted(ftype) &&
+            !(idef->ilsort == ilsortFE_SORTED &&
+              idef->il[ftype].nr_nonperturbed < idef->il[ftype].nr));
+}
+
+/*! \brief Moves the interactions of thread within its owned blocks to the front
+ *
+ * An interaction is owned by a thread when all its atoms are in blocks
+ * no other thread touches. These interactions can write directly into
+ * the shared force buffer. The order within both parts is preserved.
+ * The end of the owned part is stored in f_thread->il_direct_end.
+ */
+static void
+split_owned_bondeds(t_idef *idef, const int *block_owner,
+                    f_thread_t *f_thread, int thread, int nthread)
+{
+    std::vector<t_iatom> boundary;
+
+    for (int ftype = 0; ftype < F_NRE; ftype++)
+    {
+        if (!ftype_is_bonded_potential(ftype))
+        {
+            continue;
+        }
+
+        int nb0 = idef->il_thread_division[ftype*(nthread + 1) + thread];
+        int nb1 = idef->il_thread_division[ftype*(nthread + 1) + thread + 1];
+
+        f_thread->il_direct_end[ftype] = nb0;
+
+        if (nb1 == nb0 || !canUseDirectForceBuffer(idef, ftype))
+        {
+            continue;
+        }
+
+        const int nat1   = interaction_function[ftype].nratoms + 1;
+        t_iatom  *iatoms = idef->il[ftype].iatoms;
+        int       nowned = nb0;
+
+        boundary.clear();
+        for (int i = nb0; i < nb1; i += nat1)
+        {
+            bool owned = true;
+            for (int a = 1; a < nat1; a++)
+            {
+                owned = owned && (block_owner[iatoms[i + a] >> reduction_block_bits] == thread);
+            }
+            if (owned)
+            {
+                /* Move down, we only ever move over interactions already copied */
+                std::copy_n(iatoms + i, nat1, iatoms + nowned);
+                nowned += nat1;
+            }
+            else
+            {
+                boundary.insert(boundary.end(), iatoms + i, iatoms + i + nat1);
+            }
+        }
+        std::copy(boundary.begin(), boundary.end(), iatoms + nowned);
+
+        f_thread->il_direct_end[ftype] = nowned;
+    }
 }
 
 void setup_bonded_threading(t_forcerec *fr, t_idef *idef)
@@ -389,6 +586,11 @@ void setup_bonded_threading(t_forcerec *fr, t_idef *idef)
 
     assert(bt->nthreads >= 1);
 
+    /* Order the interactions on atom index, which we need for efficient
+     * SIMD kernels and for good locality of the division over threads.
+     */
+    sort_bondeds_by_first_atom(idef);
+
     /* Divide the bonded interaction over the threads */
     divide_bondeds_over_threads(idef,
                                 bt->nthreads,
@@ -410,22 +612,78 @@ void setup_bonded_threading(t_forcerec *fr, t_idef *idef)
         try
         {
             calc_bonded_reduction_mask(fr->natoms_force, &bt->f_t[t],
-                                       idef, t, bt->nthreads);
+                                       idef, t, bt->nthreads, false);
         }
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
-    /* Reduce the masks over the threads and determine which blocks
-     * we need to reduce over.
-     */
     int nblock_tot = (fr->natoms_force + reduction_block_size - 1) >> reduction_block_bits;
     if (nblock_tot > bt->block_nalloc)
     {
         bt->block_nalloc = over_alloc_large(nblock_tot);
         srenew(bt->block_index, bt->block_nalloc);
         srenew(bt->mask,        bt->block_nalloc);
+        srenew(bt->block_owner, bt->block_nalloc);
+    }
+    if (nblock_tot*reduction_block_size > bt->f_direct_nalloc)
+    {
+        /* As for the thread buffers, only the owned blocks are cleared
+         * and used, so we do not need to initialize.
+         */
+        bt->f_direct_nalloc = bt->block_nalloc*reduction_block_size;
+        sfree_aligned(bt->f_direct);
+        bt->f_direct = static_cast<rvec4 *>(save_malloc_aligned("f_direct", __FILE__, __LINE__,
+                                                                bt->f_direct_nalloc, sizeof(rvec4), 128));
     }
-    bt->nblock_used = 0;
+
+    /* Assign the blocks touched by a single thread only to that thread */
+    for (int t = 0; t < bt->nthreads; t++)
+    {
+        bt->f_t[t].nblock_owned = 0;
+    }
+    for (int b = 0; b < nblock_tot; b++)
+    {
+        int owner  = -1;
+        int ntouch = 0;
+        for (int t = 0; t < bt->nthreads; t++)
+        {
+            if (bitmask_is_set(bt->f_t[t].mask[b], t))
+            {
+                owner = t;
+                ntouch++;
+            }
+        }
+        bt->block_owner[b] = (ntouch == 1 ? owner : -1);
+        if (bt->block_owner[b] >= 0)
+        {
+            f_thread_t *f_t = &bt->f_t[bt->block_owner[b]];
+
+            f_t->block_index_owned[f_t->nblock_owned++] = b;
+        }
+    }
+
+    /* Move the interactions within owned blocks to the front of the range
+     * of each thread and determine which blocks the remaining boundary
+     * interactions contribute to.
+     */
+#pragma omp parallel for num_threads(bt->nthreads) schedule(static)
+    for (int t = 0; t < bt->nthreads; t++)
+    {
+        try
+        {
+            split_owned_bondeds(idef, bt->block_owner, &bt->f_t[t], t, bt->nthreads);
+
+            calc_bonded_reduction_mask(fr->natoms_force, &bt->f_t[t],
+                                       idef, t, bt->nthreads, true);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    /* Reduce the masks over the threads and determine which blocks
+     * we need to reduce over.
+     */
+    int nblock_owned = 0;
+    bt->nblock_used  = 0;
     for (int b = 0; b < nblock_tot; b++)
     {
         gmx_bitmask_t *mask = &bt->mask[b];
@@ -436,7 +694,11 @@ void setup_bonded_threading(t_forcerec *fr, t_idef *idef)
         {
             bitmask_union(mask, bt->f_t[t].mask[b]);
         }
-        if (!bitmask_is_zero(*mask))
+        if (bt->block_owner[b] >= 0)
+        {
+            nblock_owned++;
+        }
+        if (!bitmask_is_zero(*mask) || bt->block_owner[b] >= 0)
         {
             bt->block_index[bt->nblock_used++] = b;
         }
@@ -462,18 +724,18 @@ void setup_bonded_threading(t_forcerec *fr, t_idef *idef)
                                                        *mask+BITMASK_ALEN,
                                                        "", gmx::StringFormatter("%x"));
 #endif
-                fprintf(debug, "block %d flags %s count %d\n",
-                        b, flags.c_str(), c);
+                fprintf(debug, "block %d flags %s count %d owner %d\n",
+                        b, flags.c_str(), c, bt->block_owner[b]);
             }
         }
     }
     if (debug)
     {
-        fprintf(debug, "Number of %d atom blocks to reduce: %d\n",
-                reduction_block_size, bt->nblock_used);
-        fprintf(debug, "Reduction density %.2f for touched blocks only %.2f\n",
+        fprintf(debug, "Number of %d atom blocks to reduce: %d, owned by one thread: %d\n",
+                reduction_block_size, bt->nblock_used, nblock_owned);
+        fprintf(debug, "Reduction density of thread buffers %.2f for touched blocks only %.2f\n",
                 ctot*reduction_block_size/(double)fr->natoms_force,
-                ctot/(double)bt->nblock_used);
+                ctot/(double)std::max(bt->nblock_used, 1));
     }
 }
 
@@ -518,8 +780,11 @@ void init_bonded_threading(FILE *fplog, int nenergrp,
 
     bt->nblock_used  = 0;
     bt->block_index  = nullptr;
-    bt->mask         = nullptr;
-    bt->block_nalloc = 0;
+    bt->mask            = nullptr;
+    bt->block_owner     = nullptr;
+    bt->block_nalloc    = 0;
+    bt->f_direct        = nullptr;
+    bt->f_direct_nalloc = 0;
 
     /* The optimal value after which to switch from uniform to localized
      * bonded interaction distribution is 3, 4 or 5 depending on the system
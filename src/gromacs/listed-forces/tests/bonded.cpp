@@ -45,13 +45,24 @@
 
 #include <cmath>
 
+#include <algorithm>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/stringutil.h"
 
 #include "testutils/refdata.h"
 #include "testutils/testasserts.h"
@@ -273,6 +284,228 @@ TEST_F (BondedTest, IfuncProperDihedralsPbcXyz)
     testIfunc(F_PDIHS, iatoms, &iparams, epbcXYZ);
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+//! Signature of the SIMD bonded kernels without energies and shift forces
+typedef void NoEnerKernel (int nbonds,
+                           const t_iatom forceatoms[], const t_iparams forceparams[],
+                           const rvec x[], rvec4 f[],
+                           const struct t_pbc *pbc, const struct t_graph *g,
+                           realA lambda,
+                           const t_mdatoms *md, t_fcdata *fcd,
+                           int *global_atom_index);
+
+//! Returns the SIMD kernel with energies and shift forces for \p ftype
+t_ifunc *simdKernel(int ftype)
+{
+    switch (ftype)
+    {
+        case F_BONDS:  return bonds_simd;
+        case F_ANGLES: return angles_simd;
+        case F_PDIHS:  return pdihs_simd;
+        default:       return idihs_simd;
+    }
+}
+
+//! Returns the SIMD kernel without energies and shift forces for \p ftype
+NoEnerKernel *simdNoEnerKernel(int ftype)
+{
+    switch (ftype)
+    {
+        case F_BONDS:  return bonds_noener_simd;
+        case F_ANGLES: return angles_noener_simd;
+        case F_PDIHS:  return pdihs_noener_simd;
+        default:       return idihs_noener_simd;
+    }
+}
+
+//! The kinds of periodic boundary conditions for the SIMD kernel tests
+enum class SimdTestPbc
+{
+    None, Rectangular, Triclinic
+};
+
+//! The interaction type, the PBC and the number of interactions
+typedef std::tuple<int, SimdTestPbc, int> BondedSimdTestParameters;
+
+/*! \brief Test fixture comparing the SIMD bonded kernels with the scalar ones
+ *
+ * The interactions run along a helical chain of atoms, which with PBC
+ * is put in a small box, so many interactions cross periodic boundaries
+ * and contribute to the shift forces.
+ */
+class BondedSimdTest : public ::testing::TestWithParam<BondedSimdTestParameters>
+{
+    public:
+        //! The number of parameter types used
+        static const int c_numTypes = 3;
+
+        //! Constructor
+        BondedSimdTest() :
+            ftype_(std::get<0>(GetParam())),
+            pbcType_(std::get<1>(GetParam())),
+            numInteractions_(std::get<2>(GetParam())),
+            numAtoms_(numInteractions_ + NRAL(ftype_) - 1),
+            iparams_(c_numTypes)
+        {
+            /* The SIMD gathers can read beyond the last atom */
+            x_.resize(numAtoms_ + 1, { 0, 0, 0 });
+
+            DefaultRandomEngine            rng(4321);
+            UniformRealDistribution<realA> dist;
+            for (int a = 0; a < numAtoms_; a++)
+            {
+                x_[a][XX] = -0.05 + 0.1*a + 0.04*(dist(rng) - 0.5);
+                x_[a][YY] = 0.05 + 0.1*std::cos(2.0*a) + 0.04*(dist(rng) - 0.5);
+                x_[a][ZZ] = 0.05 + 0.1*std::sin(2.0*a) + 0.04*(dist(rng) - 0.5);
+            }
+
+            clear_mat(box_);
+            box_[XX][XX] = 1.5;
+            box_[YY][YY] = 1.6;
+            box_[ZZ][ZZ] = 1.7;
+            if (pbcType_ == SimdTestPbc::Triclinic)
+            {
+                box_[YY][XX] =  0.3;
+                box_[ZZ][XX] = -0.2;
+                box_[ZZ][YY] =  0.4;
+            }
+            if (pbcType_ != SimdTestPbc::None)
+            {
+                put_atoms_in_box(epbcXYZ, box_, arrayRefFromArray(x_.data(), numAtoms_));
+            }
+
+            for (int t = 0; t < c_numTypes; t++)
+            {
+                switch (ftype_)
+                {
+                    case F_BONDS:
+                        iparams_[t].harmonic = { 0.12f + 0.02f*t, 2e5f + 1e5f*t, 0.12f + 0.02f*t, 2e5f + 1e5f*t };
+                        break;
+                    case F_ANGLES:
+                        iparams_[t].harmonic = { 100.0f + 5*t, 400.0f + 100*t, 100.0f + 5*t, 400.0f + 100*t };
+                        break;
+                    case F_PDIHS:
+                        iparams_[t].pdihs    = { -60.0f + 50*t, 5.0f + 3*t, 1 + t, -60.0f + 50*t, 5.0f + 3*t };
+                        break;
+                    default:
+                        iparams_[t].harmonic = { -5.0f + 10*t, 100.0f + 50*t, -5.0f + 10*t, 100.0f + 50*t };
+                        break;
+                }
+            }
+
+            for (int i = 0; i < numInteractions_; i++)
+            {
+                iatoms_.push_back(i % c_numTypes);
+                for (int a = 0; a < NRAL(ftype_); a++)
+                {
+                    iatoms_.push_back(i + a);
+                }
+            }
+        }
+
+        //! Compares the SIMD kernels with the scalar kernel
+        void checkKernels()
+        {
+            t_pbc  pbc;
+            t_pbc *pbcPtr = nullptr;
+            if (pbcType_ != SimdTestPbc::None)
+            {
+                set_pbc(&pbc, epbcXYZ, box_);
+                pbcPtr = &pbc;
+            }
+            const rvec *x = as_rvec_array(x_.data());
+
+            std::vector<rvec4> fRef(numAtoms_);
+            rvec               fshiftRef[SHIFTS];
+            clear_rvecs(SHIFTS, fshiftRef);
+            realA              dvdl = 0;
+            realA              vRef = interaction_function[ftype_].ifunc(iatoms_.size(), iatoms_.data(), iparams_.data(),
+                                                                         x, fRef.data(), fshiftRef, pbcPtr, nullptr,
+                                                                         0, &dvdl, nullptr, nullptr, nullptr);
+
+            std::vector<rvec4> fSimd(numAtoms_);
+            rvec               fshiftSimd[SHIFTS];
+            clear_rvecs(SHIFTS, fshiftSimd);
+            realA              vSimd = simdKernel(ftype_)(iatoms_.size(), iatoms_.data(), iparams_.data(),
+                                                          x, fSimd.data(), fshiftSimd, pbcPtr, nullptr,
+                                                          0, &dvdl, nullptr, nullptr, nullptr);
+
+            std::vector<rvec4> fNoEner(numAtoms_);
+            simdNoEnerKernel(ftype_)(iatoms_.size(), iatoms_.data(), iparams_.data(),
+                                     x, fNoEner.data(), pbcPtr, nullptr,
+                                     0, nullptr, nullptr, nullptr);
+
+            /* Check that the test setup is sane */
+            realA forceScale = 0;
+            for (int a = 0; a < numAtoms_; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    forceScale = std::max(forceScale, std::abs(fRef[a][d]));
+                }
+            }
+            ASSERT_GT(forceScale, 1);
+            bool haveShiftedInteractions = false;
+            for (int s = 0; s < SHIFTS; s++)
+            {
+                haveShiftedInteractions = haveShiftedInteractions || (s != CENTRAL && norm2(fshiftRef[s]) > 0);
+            }
+            ASSERT_EQ(pbcType_ != SimdTestPbc::None, haveShiftedInteractions);
+
+            const realA tolerance = (GMX_DOUBLE ? 1e-10 : 1e-5);
+            EXPECT_REAL_EQ_TOL(vRef, vSimd, test::relativeToleranceAsFloatingPoint(std::max(std::abs(vRef), static_cast<realA>(1)), tolerance));
+            for (int a = 0; a < numAtoms_; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(fRef[a][d], fSimd[a][d], test::relativeToleranceAsFloatingPoint(forceScale, tolerance))
+                    << formatString("for the force on atom %d dim %d", a, d);
+                    EXPECT_REAL_EQ_TOL(fRef[a][d], fNoEner[a][d], test::relativeToleranceAsFloatingPoint(forceScale, tolerance))
+                    << formatString("for the force without energy on atom %d dim %d", a, d);
+                }
+            }
+            for (int s = 0; s < SHIFTS; s++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(fshiftRef[s][d], fshiftSimd[s][d], test::relativeToleranceAsFloatingPoint(numInteractions_*forceScale, tolerance))
+                    << formatString("for shift force %d dim %d", s, d);
+                }
+            }
+        }
+
+        //! The interaction type
+        int                    ftype_;
+        //! The kind of PBC
+        SimdTestPbc            pbcType_;
+        //! The number of interactions
+        int                    numInteractions_;
+        //! The number of atoms
+        int                    numAtoms_;
+        //! The coordinates, padded for the SIMD gathers
+        std::vector<RVec>      x_;
+        //! The box
+        matrix                 box_;
+        //! The interaction parameters
+        std::vector<t_iparams> iparams_;
+        //! The interaction atom list
+        std::vector<t_iatom>   iatoms_;
+};
+
+TEST_P(BondedSimdTest, MatchesScalarKernel)
+{
+    checkKernels();
+}
+
+/* The interaction counts are not multiples of the SIMD width */
+INSTANTIATE_TEST_CASE_P(SimdKernels, BondedSimdTest,
+                            ::testing::Combine(::testing::Values(F_BONDS, F_ANGLES, F_PDIHS, F_IDIHS),
+                                               ::testing::Values(SimdTestPbc::None, SimdTestPbc::Rectangular, SimdTestPbc::Triclinic),
+                                               ::testing::Values(1, 7, 37)));
+
+#endif // GMX_SIMD_HAVE_REAL
+
 }
 
 }
@@ -0,0 +1,506 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for calc_listed and calc_listed_lambda.
+ *
+ * calc_listed_lambda evaluates all foreign lambda values in one call.
+ * Its energies are compared to calling the bonded functions on the
+ * perturbed interactions once per lambda value.
+ *
+ * calc_listed sorts the interactions and can use SIMD kernels. Its
+ * forces, shift forces and energies are compared to calling the scalar
+ * bonded functions on the unsorted interactions and the results with
+ * multiple threads are compared to those with a single thread.
+ *
+ * \ingroup module_listed-forces
+ */
+#include "gmxpre.h"
+
+#include "gromacs/listed-forces/listed-forces.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/listed-forces/listed-internal.h"
+#include "gromacs/listed-forces/manage-threading.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/force.h"
+#include "gromacs/mdlib/force_flags.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdtypes/fcdata.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformintdistribution.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of atoms
+const int c_numAtoms = 5;
+
+//! The bonded lambda value of the current state
+const realA c_lambdaBonded = 0.3;
+
+//! The foreign bonded lambda values
+const std::vector<double> c_foreignLambdasBonded = { 0, 0.25, 0.5, 0.8, 1 };
+
+/*! \brief Test fixture for the foreign-lambda energies of listed interactions
+ *
+ * There are bonds, angles and proper dihedrals. The bonds and angles
+ * start with a non-perturbed interaction, which should not contribute
+ * to the foreign energies.
+ */
+class ListedLambdaTest : public ::testing::Test
+{
+    public:
+        //! Constructor
+        ListedLambdaTest() :
+            x_({ { 0.0, 0.0, 0.0 }, { 0.11, 0.02, 0.0 }, { 0.15, 0.13, 0.01 },
+                 { 0.27, 0.16, 0.09 }, { 0.31, 0.28, 0.05 } }),
+            iparams_(5), idef_(), fr_(), fepvals_(), enerd_()
+        {
+            /* Non-perturbed and perturbed bond */
+            iparams_[0].harmonic = { 0.1, 2e5, 0.1, 2e5 };
+            iparams_[1].harmonic = { 0.12, 3e5, 0.15, 1e5 };
+            /* Non-perturbed and perturbed angle */
+            iparams_[2].harmonic = { 109.5, 400, 109.5, 400 };
+            iparams_[3].harmonic = { 110, 300, 120, 500 };
+            /* Perturbed proper dihedral */
+            iparams_[4].pdihs    = { 10, 5, 3, 50, 2 };
+
+            iatoms_[F_BONDS]  = { 0, 0, 1, 1, 1, 2, 1, 2, 3 };
+            iatoms_[F_ANGLES] = { 2, 0, 1, 2, 3, 1, 2, 3, 3, 2, 3, 4 };
+            iatoms_[F_PDIHS]  = { 4, 0, 1, 2, 3, 4, 1, 2, 3, 4 };
+            const int numNonPerturbed[] = { 1, 1, 0 };
+
+            idef_.ntypes  = iparams_.size();
+            idef_.iparams = iparams_.data();
+            idef_.ilsort  = ilsortFE_SORTED;
+            int       i   = 0;
+            for (int ftype : { F_BONDS, F_ANGLES, F_PDIHS })
+            {
+                idef_.il[ftype].nr              = iatoms_[ftype].size();
+                idef_.il[ftype].nr_nonperturbed = numNonPerturbed[i++]*(1 + NRAL(ftype));
+                idef_.il[ftype].iatoms          = iatoms_[ftype].data();
+            }
+
+            fr_.efep         = efepYES;
+            fr_.bMolPBC      = FALSE;
+            fr_.natoms_force = c_numAtoms;
+
+            foreignLambdas_.assign(efptNR, c_foreignLambdasBonded);
+            for (int j = 0; j < efptNR; j++)
+            {
+                allLambdas_.push_back(foreignLambdas_[j].data());
+            }
+            fepvals_.n_lambda   = c_foreignLambdasBonded.size();
+            fepvals_.all_lambda = allLambdas_.data();
+
+            init_enerdata(1, fepvals_.n_lambda, &enerd_);
+        }
+
+        ~ListedLambdaTest()
+        {
+            destroy_enerdata(&enerd_);
+        }
+
+        //! Returns the energy of the perturbed interactions at bonded lambda \p lambda
+        realA perturbedEnergy(realA lambda)
+        {
+            std::vector<rvec4> f(c_numAtoms);
+            rvec               fshift[SHIFTS];
+            realA              dvdl   = 0;
+            realA              energy = 0;
+            for (int ftype : { F_BONDS, F_ANGLES, F_PDIHS })
+            {
+                const t_ilist &il = idef_.il[ftype];
+                energy += interaction_function[ftype].ifunc(il.nr - il.nr_nonperturbed,
+                                                            il.iatoms + il.nr_nonperturbed,
+                                                            idef_.iparams,
+                                                            as_rvec_array(x_.data()), f.data(), fshift,
+                                                            nullptr, nullptr,
+                                                            lambda, &dvdl,
+                                                            nullptr, nullptr, nullptr);
+            }
+            return energy;
+        }
+
+        //! The positions
+        std::vector<RVec>                x_;
+        //! The interaction parameters
+        std::vector<t_iparams>           iparams_;
+        //! The interaction atom lists
+        std::vector<t_iatom>             iatoms_[F_NRE];
+        //! The interaction definitions
+        t_idef                           idef_;
+        //! The force record, only the fields used by calc_listed_lambda are set
+        t_forcerec                       fr_;
+        //! Storage for the foreign lambda values of all components
+        std::vector<std::vector<double> > foreignLambdas_;
+        //! Pointers to the foreign lambda values of all components
+        std::vector<double *>            allLambdas_;
+        //! The free-energy parameters
+        t_lambda                         fepvals_;
+        //! The energy data
+        gmx_enerdata_t                   enerd_;
+};
+
+TEST_F(ListedLambdaTest, ForeignEnergiesMatchPerLambdaEvaluation)
+{
+    realA lambda[efptNR];
+    for (int j = 0; j < efptNR; j++)
+    {
+        lambda[j] = c_lambdaBonded;
+    }
+
+    t_nrnb nrnb;
+    init_nrnb(&nrnb);
+    calc_listed_lambda(&idef_, as_rvec_array(x_.data()), &fr_, nullptr, nullptr,
+                       &enerd_, &nrnb, &fepvals_, lambda, nullptr, nullptr, nullptr);
+
+    ASSERT_EQ(1 + fepvals_.n_lambda, enerd_.n_lambda);
+    for (int i = 0; i < enerd_.n_lambda; i++)
+    {
+        realA lambdaBonded = (i == 0 ? c_lambdaBonded : c_foreignLambdasBonded[i - 1]);
+        realA ref          = perturbedEnergy(lambdaBonded);
+
+        /* Check that the test setup is sane */
+        ASSERT_GT(ref, 1);
+        EXPECT_REAL_EQ_TOL(ref, enerd_.enerpart_lambda[i], relativeToleranceAsFloatingPoint(ref, GMX_DOUBLE ? 1e-10 : 1e-5))
+        << formatString("for bonded lambda %g", lambdaBonded);
+    }
+}
+
+//! The number of atoms in the chain for the calc_listed tests
+const int c_numChainAtoms = 200;
+
+//! The interaction types in the calc_listed tests
+const int c_chainFtypes[] = { F_BONDS, F_ANGLES, F_PDIHS, F_IDIHS };
+
+/*! \brief Test fixture for calc_listed on a chain of atoms
+ *
+ * The chain has bonds, angles and proper and improper dihedrals.
+ * A few extra bonds connect atoms far apart along the chain.
+ * The chain is put in the box, so many interactions cross periodic
+ * boundaries. The interactions are stored in random order,
+ * so calc_listed needs to sort them.
+ */
+class CalcListedTest : public ::testing::Test
+{
+    public:
+        //! Constructor
+        CalcListedTest() :
+            x_(c_numChainAtoms + 1, { 0, 0, 0 }), iparams_(5), idef_(), fr_(),
+            numThreadsSaved_(gmx_omp_nthreads_get(emntBonded))
+        {
+            /* x_ has one extra element, as the SIMD gathers can read beyond the last atom */
+            DefaultRandomEngine            rng(1357);
+            UniformRealDistribution<realA> dist;
+            for (int a = 0; a < c_numChainAtoms; a++)
+            {
+                x_[a][XX] = 0.1*a + 0.04*(dist(rng) - 0.5);
+                x_[a][YY] = 0.1*std::cos(2.0*a) + 0.04*(dist(rng) - 0.5);
+                x_[a][ZZ] = 0.1*std::sin(2.0*a) + 0.04*(dist(rng) - 0.5);
+            }
+            clear_mat(box_);
+            box_[XX][XX] = 2.5;
+            box_[YY][YY] = 2.6;
+            box_[ZZ][ZZ] = 2.7;
+            put_atoms_in_box(epbcXYZ, box_, arrayRefFromArray(x_.data(), c_numChainAtoms));
+            set_pbc(&pbc_, epbcXYZ, box_);
+
+            /* Chain bond, long range bond, angle, proper and improper dihedral */
+            iparams_[0].harmonic = { 0.15, 2e5, 0.15, 2e5 };
+            iparams_[1].harmonic = { 0.5, 1e3, 0.5, 1e3 };
+            iparams_[2].harmonic = { 105, 400, 105, 400 };
+            iparams_[3].pdihs    = { 30, 5, 3, 30, 5 };
+            iparams_[4].harmonic = { 10, 100, 10, 100 };
+
+            std::vector< std::vector<t_iatom> > interactions[F_NRE];
+            for (int i = 0; i + 1 < c_numChainAtoms; i++)
+            {
+                interactions[F_BONDS].push_back({ 0, i, i + 1 });
+            }
+            for (int i = 0; i + 100 < c_numChainAtoms; i += 25)
+            {
+                interactions[F_BONDS].push_back({ 1, i, i + 100 });
+            }
+            for (int i = 0; i + 2 < c_numChainAtoms; i++)
+            {
+                interactions[F_ANGLES].push_back({ 2, i, i + 1, i + 2 });
+            }
+            for (int i = 0; i + 3 < c_numChainAtoms; i++)
+            {
+                interactions[F_PDIHS].push_back({ 3, i, i + 1, i + 2, i + 3 });
+            }
+            for (int i = 0; i + 3 < c_numChainAtoms; i += 3)
+            {
+                interactions[F_IDIHS].push_back({ 4, i + 1, i, i + 2, i + 3 });
+            }
+
+            DefaultRandomEngine shuffleRng(2468);
+            for (int ftype : c_chainFtypes)
+            {
+                std::vector< std::vector<t_iatom> > &list = interactions[ftype];
+                for (int i = list.size() - 1; i > 0; i--)
+                {
+                    UniformIntDistribution<int> intDist(0, i);
+                    std::swap(list[i], list[intDist(shuffleRng)]);
+                }
+                for (const auto &interaction : list)
+                {
+                    iatoms_[ftype].insert(iatoms_[ftype].end(), interaction.begin(), interaction.end());
+                }
+            }
+
+            idef_.ntypes  = iparams_.size();
+            idef_.iparams = iparams_.data();
+            idef_.ilsort  = ilsortNO_FE;
+
+            fr_.efep         = efepNO;
+            fr_.bMolPBC      = TRUE;
+            fr_.natoms_force = c_numChainAtoms;
+            snew(fr_.fshift, SHIFTS);
+        }
+
+        ~CalcListedTest()
+        {
+            sfree(fr_.fshift);
+            sfree(idef_.il_thread_division);
+            gmx_omp_nthreads_set(emntBonded, numThreadsSaved_);
+        }
+
+        //! Computes the forces, shift forces and energies with the scalar kernels on the unsorted interactions
+        void calcReference(std::vector<RVec> *f, std::vector<RVec> *fshift, std::vector<realA> *energies)
+        {
+            std::vector<rvec4> f4(c_numChainAtoms);
+            fshift->assign(SHIFTS, { 0, 0, 0 });
+            energies->assign(F_NRE, 0);
+            for (int ftype : c_chainFtypes)
+            {
+                realA dvdl = 0;
+                (*energies)[ftype] = interaction_function[ftype].ifunc(iatoms_[ftype].size(), iatoms_[ftype].data(),
+                                                                       iparams_.data(),
+                                                                       as_rvec_array(x_.data()), f4.data(),
+                                                                       as_rvec_array(fshift->data()),
+                                                                       &pbc_, nullptr, 0, &dvdl,
+                                                                       nullptr, nullptr, nullptr);
+            }
+            f->resize(c_numChainAtoms);
+            for (int a = 0; a < c_numChainAtoms; a++)
+            {
+                copy_rvec(f4[a], (*f)[a]);
+            }
+        }
+
+        /*! \brief Computes the forces, shift forces and energies with calc_listed using \p numThreads threads
+         *
+         * The interactions are copied to idef_, which calc_listed
+         * sorts and divides over the threads.
+         */
+        void calcListed(int numThreads, bool useSimd, std::vector<RVec> *f, std::vector<RVec> *fshift, std::vector<realA> *energies)
+        {
+            gmx_omp_nthreads_set(emntBonded, numThreads);
+            init_bonded_threading(nullptr, 1, &fr_.bonded_threading);
+            fr_.use_simd_kernels = useSimd;
+
+            for (int ftype : c_chainFtypes)
+            {
+                sortedIatoms_[ftype]   = iatoms_[ftype];
+                idef_.il[ftype].nr     = sortedIatoms_[ftype].size();
+                idef_.il[ftype].iatoms = sortedIatoms_[ftype].data();
+            }
+            setup_bonded_threading(&fr_, &idef_);
+
+            gmx_enerdata_t enerd;
+            init_enerdata(1, 0, &enerd);
+            t_nrnb         nrnb;
+            init_nrnb(&nrnb);
+            t_fcdata       fcd            = t_fcdata();
+            realA          lambda[efptNR] = { 0 };
+            clear_rvecs(SHIFTS, fr_.fshift);
+            f->assign(c_numChainAtoms, { 0, 0, 0 });
+            calc_listed(nullptr, nullptr, &idef_, as_rvec_array(x_.data()), nullptr,
+                        as_rvec_array(f->data()), nullptr, &fr_, &pbc_, &pbc_, nullptr,
+                        &enerd, &nrnb, lambda, nullptr, &fcd, nullptr,
+                        GMX_FORCE_ENERGY | GMX_FORCE_VIRIAL);
+
+            fshift->assign(fr_.fshift, fr_.fshift + SHIFTS);
+            energies->assign(enerd.term, enerd.term + F_NRE);
+            destroy_enerdata(&enerd);
+        }
+
+        //! Checks that \p f, \p fshift and \p energies match the reference values
+        void checkResults(const std::vector<RVec> &fRef, const std::vector<RVec> &fshiftRef, const std::vector<realA> &energiesRef,
+                          const std::vector<RVec> &f, const std::vector<RVec> &fshift, const std::vector<realA> &energies)
+        {
+            realA forceScale = 0;
+            for (const RVec &force : fRef)
+            {
+                forceScale = std::max(forceScale, norm(force));
+            }
+            /* Check that the test setup is sane */
+            ASSERT_GT(forceScale, 1);
+
+            const realA tolerance = (GMX_DOUBLE ? 1e-10 : 1e-5);
+            for (int ftype : c_chainFtypes)
+            {
+                EXPECT_REAL_EQ_TOL(energiesRef[ftype], energies[ftype], relativeToleranceAsFloatingPoint(energiesRef[ftype], tolerance))
+                << formatString("for %s", interaction_function[ftype].longname);
+            }
+            for (int a = 0; a < c_numChainAtoms; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(fRef[a][d], f[a][d], relativeToleranceAsFloatingPoint(forceScale, tolerance))
+                    << formatString("for the force on atom %d dim %d", a, d);
+                }
+            }
+            for (int s = 0; s < SHIFTS; s++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(fshiftRef[s][d], fshift[s][d], relativeToleranceAsFloatingPoint(10*forceScale, tolerance))
+                    << formatString("for shift force %d dim %d", s, d);
+                }
+            }
+        }
+
+        //! The positions, padded for the SIMD gathers
+        std::vector<RVec>      x_;
+        //! The box
+        matrix                 box_;
+        //! The PBC setup
+        t_pbc                  pbc_;
+        //! The interaction parameters
+        std::vector<t_iparams> iparams_;
+        //! The interaction atom lists, in random order
+        std::vector<t_iatom>   iatoms_[F_NRE];
+        //! The interaction atom lists in idef_, which calc_listed reorders
+        std::vector<t_iatom>   sortedIatoms_[F_NRE];
+        //! The interaction definitions
+        t_idef                 idef_;
+        //! The force record, only the fields used by calc_listed are set
+        t_forcerec             fr_;
+        //! The number of bonded threads to restore after the test
+        int                    numThreadsSaved_;
+};
+
+TEST_F(CalcListedTest, SortingKeepsForcesAndEnergies)
+{
+    std::vector<RVec>  fRef, fshiftRef;
+    std::vector<realA> energiesRef;
+    calcReference(&fRef, &fshiftRef, &energiesRef);
+
+    for (bool useSimd : { false, true })
+    {
+        SCOPED_TRACE(useSimd ? "with SIMD kernels" : "without SIMD kernels");
+
+        std::vector<RVec>  f, fshift;
+        std::vector<realA> energies;
+        calcListed(1, useSimd, &f, &fshift, &energies);
+
+        for (int ftype : c_chainFtypes)
+        {
+            const int nral = NRAL(ftype);
+            for (size_t i = 1 + nral; i < sortedIatoms_[ftype].size(); i += 1 + nral)
+            {
+                ASSERT_LE(sortedIatoms_[ftype][i + 1 - (1 + nral)], sortedIatoms_[ftype][i + 1])
+                << formatString("%s should be sorted on their first atom", interaction_function[ftype].longname);
+            }
+        }
+
+        checkResults(fRef, fshiftRef, energiesRef, f, fshift, energies);
+    }
+}
+
+TEST_F(CalcListedTest, ThreadsGiveSameResults)
+{
+    std::vector<RVec>  fRef, fshiftRef;
+    std::vector<realA> energiesRef;
+    calcListed(1, true, &fRef, &fshiftRef, &energiesRef);
+
+    /* With more than 4 threads, the interactions are divided by locality */
+    for (int numThreads : { 2, 3, 4, 6 })
+    {
+        SCOPED_TRACE(formatString("with %d threads", numThreads));
+
+        std::vector<RVec>  f, fshift;
+        std::vector<realA> energies;
+        calcListed(numThreads, true, &f, &fshift, &energies);
+
+        /* Check that we test both direct and reduced force output */
+        const bonded_threading_t *bt        = fr_.bonded_threading;
+        const int                 numBlocks = (c_numChainAtoms + reduction_block_size - 1) >> reduction_block_bits;
+        int                       numOwned  = 0;
+        for (int b = 0; b < numBlocks; b++)
+        {
+            if (bt->block_owner[b] >= 0)
+            {
+                numOwned++;
+            }
+        }
+        ASSERT_GT(numOwned, 0);
+        ASSERT_LT(numOwned, numBlocks);
+
+        checkResults(fRef, fshiftRef, energiesRef, f, fshift, energies);
+    }
+}
+
+} // namespace
+} // namespace
+} // namespace
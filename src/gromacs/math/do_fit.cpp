@@ -42,6 +42,8 @@
 
 #include <cmath>
 
+#include <algorithm>
+
 #include "gromacs/linearalgebra/nrjac.h"
 #include "gromacs/math/functions.h"
 #include "gromacs/math/utilities.h"
@@ -292,6 +294,114 @@ void do_fit(int natoms, realA *w_rls, const rvec *xp, rvec *x)
     do_fit_ndim(3, natoms, w_rls, xp, x);
 }
 
+/*! \brief Returns the determinant of the 4x4 matrix k without row skipRow and column skipCol */
+static double det3_minor(const double k[4][4], int skipRow, int skipCol)
+{
+    int r[3], c[3], nr = 0, nc = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (i != skipRow)
+        {
+            r[nr++] = i;
+        }
+        if (i != skipCol)
+        {
+            c[nc++] = i;
+        }
+    }
+
+    return
+        k[r[0]][c[0]]*(k[r[1]][c[1]]*k[r[2]][c[2]] - k[r[1]][c[2]]*k[r[2]][c[1]]) -
+        k[r[0]][c[1]]*(k[r[1]][c[0]]*k[r[2]][c[2]] - k[r[1]][c[2]]*k[r[2]][c[0]]) +
+        k[r[0]][c[2]]*(k[r[1]][c[0]]*k[r[2]][c[1]] - k[r[1]][c[1]]*k[r[2]][c[0]]);
+}
+
+realA rmsdev_fit(int natoms, const realA *w_rls, const rvec *xp, const rvec *x)
+{
+    double s[DIM][DIM] = {{0}};
+    double g, wtot;
+
+    /* Weighted correlation matrix and inner products */
+    g    = 0;
+    wtot = 0;
+    for (int n = 0; n < natoms; n++)
+    {
+        double w = (w_rls != nullptr) ? w_rls[n] : 1.0;
+
+        if (w == 0)
+        {
+            continue;
+        }
+        for (int c = 0; c < DIM; c++)
+        {
+            double wx = w*x[n][c];
+
+            for (int r = 0; r < DIM; r++)
+            {
+                s[c][r] += wx*xp[n][r];
+            }
+            g += wx*x[n][c] + w*static_cast<double>(xp[n][c])*xp[n][c];
+        }
+        wtot += w;
+    }
+    if (wtot == 0)
+    {
+        return 0;
+    }
+
+    /* The symmetric, traceless key matrix, its largest eigenvalue is
+     * the maximal value of sum_i w_i xp_i.(R x_i) over all rotations R.
+     */
+    double k[4][4];
+    k[0][0] =  s[XX][XX] + s[YY][YY] + s[ZZ][ZZ];
+    k[1][1] =  s[XX][XX] - s[YY][YY] - s[ZZ][ZZ];
+    k[2][2] = -s[XX][XX] + s[YY][YY] - s[ZZ][ZZ];
+    k[3][3] = -s[XX][XX] - s[YY][YY] + s[ZZ][ZZ];
+    k[0][1] = k[1][0] = s[YY][ZZ] - s[ZZ][YY];
+    k[0][2] = k[2][0] = s[ZZ][XX] - s[XX][ZZ];
+    k[0][3] = k[3][0] = s[XX][YY] - s[YY][XX];
+    k[1][2] = k[2][1] = s[XX][YY] + s[YY][XX];
+    k[1][3] = k[3][1] = s[ZZ][XX] + s[XX][ZZ];
+    k[2][3] = k[3][2] = s[YY][ZZ] + s[ZZ][YY];
+
+    /* Characteristic polynomial P(l) = l^4 + c2 l^2 + c1 l + c0 */
+    double c2 = 0, c1 = 0, c0 = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            c2 -= 0.5*k[i][j]*k[i][j];
+        }
+        c1 -= det3_minor(k, i, i);
+        c0 += ((i % 2 == 0) ? 1 : -1)*k[0][i]*det3_minor(k, 0, i);
+    }
+
+    /* Newton iteration from the upper bound g/2 converges to the largest root */
+    double lambda = 0.5*g;
+    for (int iter = 0; iter < 50; iter++)
+    {
+        double l2      = lambda*lambda;
+        double p       = (l2 + c2)*l2 + c1*lambda + c0;
+        double dp      = 4*l2*lambda + 2*c2*lambda + c1;
+        double lambda0 = lambda;
+
+        if (dp == 0)
+        {
+            break;
+        }
+        lambda -= p/dp;
+        if (std::fabs(lambda - lambda0) <= 1e-11*std::fabs(lambda))
+        {
+            break;
+        }
+    }
+
+    double msd = (g - 2*lambda)/wtot;
+
+    return std::sqrt(std::max(msd, 0.0));
+}
+
 void reset_x_ndim(int ndim, int ncm, const int *ind_cm,
                   int nreset, const int *ind_reset,
                   rvec x[], const realA mass[])
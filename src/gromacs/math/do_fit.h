@@ -86,6 +86,16 @@ void do_fit_ndim(int ndim, int natoms, realA *w_rls, const rvec *xp, rvec *x);
 void do_fit(int natoms, realA *w_rls, const rvec *xp, rvec *x);
 /* Calls do_fit with ndim=3, thus fitting in 3D */
 
+realA rmsdev_fit(int natoms, const realA *w_rls, const rvec *xp, const rvec *x);
+/* Returns the weighted RMS deviation between x and xp after a least squares
+ * fit of x to xp, i.e. the same value as do_fit() followed by rmsdev() with
+ * the same weights, without rotating x. The minimal deviation is obtained
+ * from the largest eigenvalue of the 4x4 quaternion key matrix, found by
+ * Newton iteration on its characteristic polynomial (QCP method, Theobald,
+ * Acta Cryst. A 61, 478 (2005)). As for do_fit(), both xp and x should be
+ * centered round the origin. w_rls can be NULL for unit weights.
+ */
+
 void reset_x_ndim(int ndim, int ncm, const int *ind_cm,
                   int nreset, const int *ind_reset,
                   rvec x[], const realA mass[]);
@@ -0,0 +1,175 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the RMSD after a least-squares fit.
+ *
+ * rmsdev_fit() is compared to rotating a copy of the structure with
+ * do_fit() followed by rmsdev().
+ *
+ * \ingroup module_math
+ */
+#include "gmxpre.h"
+
+#include "gromacs/math/do_fit.h"
+
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of atoms
+const int c_numAtoms = 50;
+
+//! The weights to use in the fit
+enum class FitWeights
+{
+    None,          //!< Pass no weights, i.e. unit weights
+    Masses,        //!< Atom masses
+    MassesAndZeros //!< Atom masses, with some atoms excluded from the fit
+};
+
+//! Convenience typedef of the weights and the size of the random displacements
+typedef std::tuple<FitWeights, double> RmsdevFitTestParameters;
+
+/*! \brief Test fixture for comparing rmsdev_fit() with do_fit() and rmsdev()
+ *
+ * The structure x is a rotated copy of the reference structure xp
+ * with random displacements, both are centered on their weighted
+ * center of mass.
+ */
+class RmsdevFitTest : public ::testing::TestWithParam<RmsdevFitTestParameters>
+{
+    public:
+        //! Constructor
+        RmsdevFitTest() : xp_(c_numAtoms), x_(c_numAtoms), weights_(c_numAtoms, 1)
+        {
+            const FitWeights fitWeights   = std::get<0>(GetParam());
+            const double     displacement = std::get<1>(GetParam());
+
+            DefaultRandomEngine            rng(1234);
+            UniformRealDistribution<realA> dist;
+
+            if (fitWeights != FitWeights::None)
+            {
+                for (int i = 0; i < c_numAtoms; i++)
+                {
+                    weights_[i] = (i % 3 == 0 ? 1.008 : 12.011 + 4*dist(rng));
+                    if (fitWeights == FitWeights::MassesAndZeros && i % 7 == 0)
+                    {
+                        weights_[i] = 0;
+                    }
+                }
+            }
+
+            /* A rotation of about 0.8 rad around (1,2,3) */
+            matrix rot = { { 0.7606, -0.4359, 0.4811 }, { 0.5635, 0.8154, -0.1324 }, { -0.3346, 0.3808, 0.8620 } };
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                xp_[i] = { 2*dist(rng) - 1, 2*dist(rng) - 1, 2*dist(rng) - 1 };
+                RVec xRotated;
+                mvmul(rot, xp_[i], xRotated);
+                for (int d = 0; d < DIM; d++)
+                {
+                    x_[i][d] = xRotated[d] + realA(displacement*(2*dist(rng) - 1));
+                }
+            }
+            reset_x(c_numAtoms, nullptr, c_numAtoms, nullptr, as_rvec_array(xp_.data()), weights_.data());
+            reset_x(c_numAtoms, nullptr, c_numAtoms, nullptr, as_rvec_array(x_.data()), weights_.data());
+        }
+
+        //! Returns the weights to pass to rmsdev_fit()
+        const realA *fitWeights() const
+        {
+            return (std::get<0>(GetParam()) == FitWeights::None ? nullptr : weights_.data());
+        }
+
+        //! The reference structure
+        std::vector<RVec>  xp_;
+        //! The structure to fit
+        std::vector<RVec>  x_;
+        //! The weights, all ones for FitWeights::None
+        std::vector<realA> weights_;
+};
+
+TEST_P(RmsdevFitTest, MatchesDoFitAndRmsdev)
+{
+    std::vector<RVec> xFitted(x_);
+    do_fit(c_numAtoms, weights_.data(), as_rvec_array(xp_.data()), as_rvec_array(xFitted.data()));
+    realA             ref = rmsdev(c_numAtoms, weights_.data(), as_rvec_array(xFitted.data()), as_rvec_array(xp_.data()));
+
+    realA             rmsd = rmsdev_fit(c_numAtoms, fitWeights(), as_rvec_array(xp_.data()), as_rvec_array(x_.data()));
+
+    /* The coordinates are of order 1 */
+    EXPECT_REAL_EQ_TOL(ref, rmsd, relativeToleranceAsFloatingPoint(1, GMX_DOUBLE ? 1e-9 : 1e-5));
+    /* The fit can only lower the RMSD */
+    EXPECT_LE(rmsd, rmsdev(c_numAtoms, weights_.data(), as_rvec_array(x_.data()), as_rvec_array(xp_.data())));
+}
+
+TEST_P(RmsdevFitTest, DoesNotModifyCoordinates)
+{
+    std::vector<RVec> xp(xp_), x(x_);
+    rmsdev_fit(c_numAtoms, fitWeights(), as_rvec_array(xp.data()), as_rvec_array(x.data()));
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(xp_[i][d], xp[i][d]);
+            EXPECT_EQ(x_[i][d], x[i][d]);
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithParameters, RmsdevFitTest,
+                            ::testing::Combine(::testing::Values(FitWeights::None, FitWeights::Masses, FitWeights::MassesAndZeros),
+                                                   ::testing::Values(0.0, 0.01, 0.3)));
+
+} // namespace
+} // namespace
+} // namespace
@@ -128,6 +128,11 @@ typedef struct gmx_lincsdata {
     int             atf_nalloc;   /* allocation size of atf */
     gmx_bool        bTaskDep;     /* are the LINCS tasks interdependent? */
     gmx_bool        bTaskDepTri;  /* are there triangle constraints that cross task borders? */
+    gmx_bool        bMoreThanTwoSeq; /* are there more than two sequential constraints? */
+    int            *con_cluster;   /* the coupled cluster index for each topology constraint */
+    int            *cluster_index; /* the index into cluster_con for each cluster */
+    int            *cluster_con;   /* the topology constraint indices sorted by cluster */
+    int             cluster_nalloc; /* allocation size of the cluster arrays */
     /* arrays for temporary storage in the LINCS algorithm */
     rvec           *tmpv;
     realA           *tmpncc;
@@ -151,6 +156,13 @@ static const int simd_width = 1;
    AlignedAllocator, which currently forces 128 byte alignment. */
 static const int align_bytes = 128;
 
+/* With coupled constraints, we assign complete clusters of coupled
+ * constraints to a single task when a cluster is not larger than
+ * the target number of constraints per task divided by this factor.
+ * This limits the load imbalance to about 1/8.
+ */
+static const int c_clusterTaskSizeFactor = 8;
+
 realA *lincs_rmsd_data(struct gmx_lincsdata *lincsd)
 {
     return lincsd->rmsd_data;
@@ -168,6 +180,11 @@ realA lincs_rmsd(struct gmx_lincsdata *lincsd)
     }
 }
 
+gmx_bool lincs_tasks_are_dependent(struct gmx_lincsdata *lincsd)
+{
+    return lincsd->bTaskDep;
+}
+
 /* Do a set of nrec LINCS matrix multiplications.
  * This function will return with up to date thread-local
  * constraint data, without an OpenMP barrier.
@@ -1478,14 +1495,17 @@ gmx_lincsdata_t init_lincs(FILE *fplog, const gmx_mtop_t *mtop,
     /* LINCS can run on any number of threads.
      * Currently the number is fixed for the whole simulation,
      * but it could be set in set_lincs().
-     * The current constraint to task assignment code can create independent
-     * tasks only when not more than two constraints are connected sequentially.
+     * With not more than two constraints connected sequentially, the task
+     * assignment code always creates independent tasks. Otherwise it
+     * tries to assign complete clusters of coupled constraints to tasks
+     * and set_lincs() checks whether the tasks are dependent.
      */
-    li->ntask    = gmx_omp_nthreads_get(emntLINCS);
-    li->bTaskDep = (li->ntask > 1 && bMoreThanTwoSeq);
+    li->ntask           = gmx_omp_nthreads_get(emntLINCS);
+    li->bMoreThanTwoSeq = bMoreThanTwoSeq;
+    li->bTaskDep        = (li->ntask > 1 && bMoreThanTwoSeq);
     if (debug)
     {
-        fprintf(debug, "LINCS: using %d threads, tasks are %sdependent\n",
+        fprintf(debug, "LINCS: using %d threads, tasks can be %sdependent\n",
                 li->ntask, li->bTaskDep ? "" : "in");
     }
     if (li->ntask == 1)
@@ -1845,6 +1865,122 @@ static void check_assign_triangle(struct gmx_lincsdata *li,
     }
 }
 
+/* Determines the clusters of coupled constraints, i.e. the connected
+ * components of the constraint coupling graph, using a breadth-first
+ * search. Returns the number of constraints in the largest cluster.
+ */
+static int set_constraint_clusters(struct gmx_lincsdata *li,
+                                   int ncon, const t_iatom *iatom,
+                                   const t_blocka *at2con)
+{
+    int con, ncluster, n, size_max;
+
+    if (ncon > li->cluster_nalloc)
+    {
+        li->cluster_nalloc = over_alloc_dd(ncon);
+        srenew(li->con_cluster, li->cluster_nalloc);
+        srenew(li->cluster_index, li->cluster_nalloc + 1);
+        srenew(li->cluster_con, li->cluster_nalloc);
+    }
+
+    for (con = 0; con < ncon; con++)
+    {
+        li->con_cluster[con] = -1;
+    }
+
+    ncluster = 0;
+    n        = 0;
+    size_max = 0;
+    for (con = 0; con < ncon; con++)
+    {
+        if (li->con_cluster[con] >= 0)
+        {
+            continue;
+        }
+
+        /* Start a new cluster, cluster_con also serves as the search queue */
+        li->cluster_index[ncluster] = n;
+        li->con_cluster[con]        = ncluster;
+        li->cluster_con[n++]        = con;
+        for (int q = li->cluster_index[ncluster]; q < n; q++)
+        {
+            int c = li->cluster_con[q];
+
+            for (int end = 0; end < 2; end++)
+            {
+                int a = iatom[3*c + 1 + end];
+
+                for (int k = at2con->index[a]; k < at2con->index[a + 1]; k++)
+                {
+                    int cc = at2con->a[k];
+
+                    if (li->con_cluster[cc] == -1)
+                    {
+                        li->con_cluster[cc]  = ncluster;
+                        li->cluster_con[n++] = cc;
+                    }
+                }
+            }
+        }
+        size_max = std::max(size_max, n - li->cluster_index[ncluster]);
+        ncluster++;
+    }
+    li->cluster_index[ncluster] = n;
+
+    return size_max;
+}
+
+/* Assign all constraints in cluster to the current task */
+static void assign_cluster(struct gmx_lincsdata *li,
+                           const t_iatom *iatom,
+                           const t_idef *idef,
+                           int bDynamics,
+                           int cluster,
+                           const t_blocka *at2con)
+{
+    for (int q = li->cluster_index[cluster]; q < li->cluster_index[cluster + 1]; q++)
+    {
+        int cc = li->cluster_con[q];
+
+        if (li->con_index[cc] == -1)
+        {
+            int  type;
+            realA lenA, lenB;
+
+            type = iatom[cc*3];
+            lenA = idef->iparams[type].constr.dA;
+            lenB = idef->iparams[type].constr.dB;
+
+            if (bDynamics || lenA != 0 || lenB != 0)
+            {
+                assign_constraint(li, cc, iatom[3*cc + 1], iatom[3*cc + 2], lenA, lenB, at2con);
+            }
+        }
+    }
+}
+
+/* Returns whether any constraint is coupled to a constraint in another task */
+static gmx_bool lincs_tasks_are_coupled(const struct gmx_lincsdata *li)
+{
+    for (int th = 0; th < li->ntask; th++)
+    {
+        const lincs_task_t *li_task = &li->task[th];
+
+        for (int b = li_task->b0; b < li_task->b1; b++)
+        {
+            for (int n = li->blnr[b]; n < li->blnr[b + 1]; n++)
+            {
+                if (li->blbnb[n] < li_task->b0 || li->blbnb[n] >= li_task->b1)
+                {
+                    return TRUE;
+                }
+            }
+        }
+    }
+
+    return FALSE;
+}
+
 static void set_matrix_indices(struct gmx_lincsdata *li,
                                const lincs_task_t   *li_task,
                                const t_blocka       *at2con,
@@ -2012,6 +2148,29 @@ void set_lincs(const t_idef         *idef,
         li->con_index[con] = -1;
     }
 
+    /* With coupled constraints, we assign complete clusters of coupled
+     * constraints to tasks when they are small compared to the task size.
+     * Then the tasks are independent and the matrix expansion and the atom
+     * updates need no barriers. Larger clusters are divided over tasks.
+     */
+    gmx_bool bAssignClusters   = (li->ntask > 1 && li->bMoreThanTwoSeq);
+    gmx_bool bHaveLargeCluster = bAssignClusters;
+    int      cluster_size_max  = 0;
+    if (bAssignClusters)
+    {
+        int size_max;
+
+        /* The tasks might be dependent until we have checked the new
+         * assignment, the previous partitioning might have had
+         * independent tasks.
+         */
+        li->bTaskDep = TRUE;
+
+        size_max          = set_constraint_clusters(li, ncon_tot, iatom, &at2con);
+        cluster_size_max  = ncon_target/c_clusterTaskSizeFactor;
+        bHaveLargeCluster = (size_max > cluster_size_max);
+    }
+
     con = 0;
     for (th = 0; th < li->ntask; th++)
     {
@@ -2026,7 +2185,7 @@ void set_lincs(const t_idef         *idef,
          * Triangle constraints can also increase the count, but there are
          * relatively few of those, so we usually expect to get ncon_target.
          */
-        if (li->bTaskDep)
+        if (bHaveLargeCluster)
         {
             /* We round ncon_target to a multiple of GMX_SIMD_WIDTH,
              * since otherwise a lot of operations can be wasted.
@@ -2036,6 +2195,13 @@ void set_lincs(const t_idef         *idef,
             ncon_target = ((ncon_assign*(th + 1))/li->ntask - li->nc_real + GMX_SIMD_REAL_WIDTH - 1) & ~(GMX_SIMD_REAL_WIDTH - 1);
         }
 #endif  // GMX_SIMD==2 && GMX_SIMD_HAVE_REAL
+        if (bAssignClusters && !bHaveLargeCluster)
+        {
+            /* Correct for the excess constraints pulled in with
+             * the clusters assigned to the previous tasks.
+             */
+            ncon_target = (ncon_assign*(th + 1))/li->ntask - li->nc_real;
+        }
 
         /* Continue filling the arrays where we left off with the previous task,
          * including padding for SIMD.
@@ -2054,12 +2220,21 @@ void set_lincs(const t_idef         *idef,
                 a2     = iatom[3*con + 2];
                 lenA   = idef->iparams[type].constr.dA;
                 lenB   = idef->iparams[type].constr.dB;
+                if (bAssignClusters &&
+                    li->cluster_index[li->con_cluster[con] + 1] - li->cluster_index[li->con_cluster[con]] <= cluster_size_max)
+                {
+                    /* Assign the complete cluster to our task,
+                     * this also handles flexible constraints.
+                     */
+                    assign_cluster(li, iatom, idef, bDynamics,
+                                   li->con_cluster[con], &at2con);
+                }
                 /* Skip the flexible constraints when not doing dynamics */
-                if (bDynamics || lenA != 0 || lenB != 0)
+                else if (bDynamics || lenA != 0 || lenB != 0)
                 {
                     assign_constraint(li, con, a1, a2, lenA, lenB, &at2con);
 
-                    if (li->ntask > 1 && !li->bTaskDep)
+                    if (li->ntask > 1 && !li->bMoreThanTwoSeq)
                     {
                         /* We can generate independent tasks. Check if we
                          * need to assign connected constraints to our task.
@@ -2154,6 +2329,18 @@ void set_lincs(const t_idef         *idef,
 
     done_blocka(&at2con);
 
+    if (bAssignClusters)
+    {
+        /* Check if we managed to make the tasks independent */
+        li->bTaskDep = lincs_tasks_are_coupled(li);
+
+        if (debug)
+        {
+            fprintf(debug, "LINCS: largest cluster size allowed in one task %d, tasks are %sdependent\n",
+                    cluster_size_max, li->bTaskDep ? "" : "in");
+        }
+    }
+
     if (cr->dd == nullptr)
     {
         /* Since the matrix is static, we should free some memory */
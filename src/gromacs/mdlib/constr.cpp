@@ -502,19 +502,12 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
                             clear_mat(constr->vir_r_m_dr_th[th]);
                         }
 
-                        int start_th = (nsettle* th   )/nth;
-                        int end_th   = (nsettle*(th+1))/nth;
-
-                        if (start_th >= 0 && end_th - start_th > 0)
-                        {
-                            settle_proj(constr->settled, econq,
-                                        end_th-start_th,
-                                        settle->iatoms+start_th*(1+NRAL(F_SETTLE)),
-                                        pbc_null,
-                                        x,
-                                        xprime, min_proj, calcvir_atom_end,
-                                        th == 0 ? vir_r_m_dr : constr->vir_r_m_dr_th[th]);
-                        }
+                        settle_proj(constr->settled, econq,
+                                    nth, th,
+                                    pbc_null,
+                                    x,
+                                    xprime, min_proj, calcvir_atom_end,
+                                    th == 0 ? vir_r_m_dr : constr->vir_r_m_dr_th[th]);
                     }
                     GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
                 }
@@ -141,13 +141,15 @@ void csettle(gmx_settledata_t    settled,          /* The SETTLE structure */
  */
 
 void settle_proj(gmx_settledata_t settled, int econq,
-                 int nsettle, t_iatom iatoms[],
+                 int nthread, int thread,   /* The number of threads and our thread index */
                  const struct t_pbc *pbc,   /* PBC data pointer, can be NULL  */
-                 rvec x[],
-                 rvec *der, rvec *derp,
+                 const rvec x[],
+                 const rvec *der, rvec *derp,
                  int CalcVirAtomEnd, tensor vir_r_m_dder);
 /* Analytical algorithm to subtract the components of derivatives
  * of coordinates working on settle type constraint.
+ * Uses SIMD intrinsics for complete SIMD-width packs of settles.
+ * Can be called on any number of threads.
  */
 
 void cshake(const int iatom[], int ncon, int *nnit, int maxnit,
@@ -263,6 +265,9 @@ realA *lincs_rmsd_data(gmx_lincsdata_t lincsd);
 realA lincs_rmsd(gmx_lincsdata_t lincsd);
 /* Return the RMSD of the constraint */
 
+gmx_bool lincs_tasks_are_dependent(gmx_lincsdata_t lincsd);
+/* Return whether the LINCS tasks are coupled and need to synchronize */
+
 gmx_lincsdata_t init_lincs(FILE *fplog, const gmx_mtop_t *mtop,
                            int nflexcon_global, const t_blocka *at2con,
                            gmx_bool bPLINCS, int nIter, int nProjOrder);
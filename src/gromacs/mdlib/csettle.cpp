@@ -301,113 +301,257 @@ void settle_set_constraints(gmx_settledata_t  settled,
     }
 }
 
-void settle_proj(gmx_settledata_t settled, int econq,
-                 int nsettle, t_iatom iatoms[],
-                 const t_pbc *pbc,
-                 rvec x[],
-                 rvec *der, rvec *derp,
-                 int calcvir_atom_end, tensor vir_r_m_dder)
+/* The projection code, templated for realA/SimdReal and for optimization.
+ * Since the corrections are subtracted from derp, the index range should
+ * not contain padding settles, i.e. only complete packs of settles.
+ */
+template<typename T, int packSize,
+         typename TypePbc,
+         bool bCalcVirial>
+static void settleProjTemplate(const gmx_settledata_t settled,
+                               const settleparam_t   *p,
+                               int settleStart, int settleEnd,
+                               const TypePbc pbc,
+                               const realA *x,
+                               const realA *der, realA *derp,
+                               int calcvir_atom_end, tensor vir_r_m_dder)
 {
     /* Settle for projection out constraint components
      * of derivatives of the coordinates.
      * Berk Hess 2008-1-10
      */
 
-    settleparam_t *p;
-    realA           imO, imH, dOH, dHH, invdOH, invdHH;
-    matrix         invmat;
-    int            i, m, m2, ow1, hw2, hw3;
-    rvec           roh2, roh3, rhh, dc, fc;
+    assert(settleStart % packSize == 0);
 
-    calcvir_atom_end *= DIM;
+    T imO    = T(p->imO);
+    T imH    = T(p->imH);
+    T dOH    = T(p->dOH);
+    T dHH    = T(p->dHH);
+    T invdOH = T(p->invdOH);
+    T invdHH = T(p->invdHH);
 
-    if (econq == econqForce)
+    T invmat[DIM][DIM];
+    T sum_r_m_dder[DIM][DIM];
+
+    for (int d2 = 0; d2 < DIM; d2++)
     {
-        p = &settled->mass1;
+        for (int d = 0; d < DIM; d++)
+        {
+            invmat[d2][d] = T(p->invmat[d2][d]);
+            if (bCalcVirial)
+            {
+                sum_r_m_dder[d2][d] = T(0);
+            }
+        }
     }
-    else
+
+    for (int i = settleStart; i < settleEnd; i += packSize)
     {
-        p = &settled->massw;
-    }
-    imO    = p->imO;
-    imH    = p->imH;
-    copy_mat(p->invmat, invmat);
-    dOH    = p->dOH;
-    dHH    = p->dHH;
-    invdOH = p->invdOH;
-    invdHH = p->invdHH;
-
-#ifdef PRAGMAS
-#pragma ivdep
-#endif
+        const int *ow1 = settled->ow1 + i;
+        const int *hw2 = settled->hw2 + i;
+        const int *hw3 = settled->hw3 + i;
 
-    const int nral1 = 1 + NRAL(F_SETTLE);
+        T          x_ow1[DIM], x_hw2[DIM], x_hw3[DIM];
 
-    for (i = 0; i < nsettle; i++)
-    {
-        ow1 = iatoms[i*nral1 + 1];
-        hw2 = iatoms[i*nral1 + 2];
-        hw3 = iatoms[i*nral1 + 3];
+        gatherLoadUTranspose<3>(x, ow1, &x_ow1[XX], &x_ow1[YY], &x_ow1[ZZ]);
+        gatherLoadUTranspose<3>(x, hw2, &x_hw2[XX], &x_hw2[YY], &x_hw2[ZZ]);
+        gatherLoadUTranspose<3>(x, hw3, &x_hw3[XX], &x_hw3[YY], &x_hw3[ZZ]);
 
-        if (pbc == nullptr)
-        {
-            rvec_sub(x[ow1], x[hw2], roh2);
-            rvec_sub(x[ow1], x[hw3], roh3);
-            rvec_sub(x[hw2], x[hw3], rhh);
-        }
-        else
+        T roh2[DIM], roh3[DIM], rhh[DIM];
+
+        pbc_dx_aiuc(pbc, x_ow1, x_hw2, roh2);
+        pbc_dx_aiuc(pbc, x_ow1, x_hw3, roh3);
+        pbc_dx_aiuc(pbc, x_hw2, x_hw3, rhh);
+        for (int d = 0; d < DIM; d++)
         {
-            pbc_dx_aiuc(pbc, x[ow1], x[hw2], roh2);
-            pbc_dx_aiuc(pbc, x[ow1], x[hw3], roh3);
-            pbc_dx_aiuc(pbc, x[hw2], x[hw3], rhh);
+            roh2[d] = roh2[d]*invdOH;
+            roh3[d] = roh3[d]*invdOH;
+            rhh[d]  = rhh[d]*invdHH;
         }
-        svmul(invdOH, roh2, roh2);
-        svmul(invdOH, roh3, roh3);
-        svmul(invdHH, rhh, rhh);
         /* 18 flops */
 
+        T der_ow1[DIM], der_hw2[DIM], der_hw3[DIM];
+
+        gatherLoadUTranspose<3>(der, ow1, &der_ow1[XX], &der_ow1[YY], &der_ow1[ZZ]);
+        gatherLoadUTranspose<3>(der, hw2, &der_hw2[XX], &der_hw2[YY], &der_hw2[ZZ]);
+        gatherLoadUTranspose<3>(der, hw3, &der_hw3[XX], &der_hw3[YY], &der_hw3[ZZ]);
+
         /* Determine the projections of der on the bonds */
-        clear_rvec(dc);
-        for (m = 0; m < DIM; m++)
+        T dc[DIM];
+        for (int c = 0; c < DIM; c++)
         {
-            dc[0] += (der[ow1][m] - der[hw2][m])*roh2[m];
-            dc[1] += (der[ow1][m] - der[hw3][m])*roh3[m];
-            dc[2] += (der[hw2][m] - der[hw3][m])*rhh [m];
+            dc[c] = T(0);
+        }
+        for (int d = 0; d < DIM; d++)
+        {
+            dc[0] = dc[0] + (der_ow1[d] - der_hw2[d])*roh2[d];
+            dc[1] = dc[1] + (der_ow1[d] - der_hw3[d])*roh3[d];
+            dc[2] = dc[2] + (der_hw2[d] - der_hw3[d])*rhh[d];
         }
         /* 27 flops */
 
         /* Determine the correction for the three bonds */
-        mvmul(invmat, dc, fc);
+        T fc[DIM];
+        for (int c = 0; c < DIM; c++)
+        {
+            fc[c] = invmat[c][0]*dc[0] + invmat[c][1]*dc[1] + invmat[c][2]*dc[2];
+        }
         /* 15 flops */
 
         /* Subtract the corrections from derp */
-        for (m = 0; m < DIM; m++)
+        T dp_ow1[DIM], dp_hw2[DIM], dp_hw3[DIM];
+        for (int d = 0; d < DIM; d++)
         {
-            derp[ow1][m] -= imO*( fc[0]*roh2[m] + fc[1]*roh3[m]);
-            derp[hw2][m] -= imH*(-fc[0]*roh2[m] + fc[2]*rhh [m]);
-            derp[hw3][m] -= imH*(-fc[1]*roh3[m] - fc[2]*rhh [m]);
+            dp_ow1[d] = imO*( fc[0]*roh2[d] + fc[1]*roh3[d]);
+            dp_hw2[d] = imH*(-fc[0]*roh2[d] + fc[2]*rhh[d]);
+            dp_hw3[d] = imH*(-fc[1]*roh3[d] - fc[2]*rhh[d]);
         }
-
+        transposeScatterDecrU<3>(derp, ow1, dp_ow1[XX], dp_ow1[YY], dp_ow1[ZZ]);
+        transposeScatterDecrU<3>(derp, hw2, dp_hw2[XX], dp_hw2[YY], dp_hw2[ZZ]);
+        transposeScatterDecrU<3>(derp, hw3, dp_hw3[XX], dp_hw3[YY], dp_hw3[ZZ]);
         /* 45 flops */
 
-        if (ow1 < calcvir_atom_end)
+        if (bCalcVirial)
         {
             /* Determining r \dot m der is easy,
              * since fc contains the mass weighted corrections for der.
+             * We only count the contributions of settles with a home oxygen.
              */
+            realA filterArray[packSize];
+            for (int j = 0; j < packSize; j++)
+            {
+                filterArray[j] = (ow1[j] < calcvir_atom_end ? 1 : 0);
+            }
+            T filter = loadU<T>(filterArray);
+            T fc0    = filter*dOH*fc[0];
+            T fc1    = filter*dOH*fc[1];
+            T fc2    = filter*dHH*fc[2];
 
-            for (m = 0; m < DIM; m++)
+            for (int d2 = 0; d2 < DIM; d2++)
             {
-                for (m2 = 0; m2 < DIM; m2++)
+                for (int d = 0; d < DIM; d++)
                 {
-                    vir_r_m_dder[m][m2] +=
-                        dOH*roh2[m]*roh2[m2]*fc[0] +
-                        dOH*roh3[m]*roh3[m2]*fc[1] +
-                        dHH*rhh [m]*rhh [m2]*fc[2];
+                    sum_r_m_dder[d2][d] = sum_r_m_dder[d2][d] +
+                        roh2[d2]*roh2[d]*fc0 +
+                        roh3[d2]*roh3[d]*fc1 +
+                        rhh[d2]*rhh[d]*fc2;
                 }
             }
         }
     }
+
+    if (bCalcVirial)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                vir_r_m_dder[d2][d] += reduce(sum_r_m_dder[d2][d]);
+            }
+        }
+    }
+}
+
+/* Wrapper template function that instantiates the projection template
+ * with the virial boolean.
+ */
+template<typename T, int packSize, typename TypePbc>
+static void settleProjTemplateWrapper(const gmx_settledata_t settled,
+                                      const settleparam_t   *p,
+                                      int settleStart, int settleEnd,
+                                      const TypePbc pbc,
+                                      const realA *x,
+                                      const realA *der, realA *derp,
+                                      int calcvir_atom_end, tensor vir_r_m_dder)
+{
+    if (calcvir_atom_end > 0)
+    {
+        settleProjTemplate<T, packSize, TypePbc, true>
+            (settled, p, settleStart, settleEnd, pbc,
+            x, der, derp, calcvir_atom_end, vir_r_m_dder);
+    }
+    else
+    {
+        settleProjTemplate<T, packSize, TypePbc, false>
+            (settled, p, settleStart, settleEnd, pbc,
+            x, der, derp, calcvir_atom_end, vir_r_m_dder);
+    }
+}
+
+void settle_proj(gmx_settledata_t settled, int econq,
+                 int nthread, int thread,
+                 const t_pbc *pbc,
+                 const rvec x[],
+                 const rvec *der, rvec *derp,
+                 int calcvir_atom_end, tensor vir_r_m_dder)
+{
+#if GMX_SIMD_HAVE_REAL
+    const int pack_size = GMX_SIMD_REAL_WIDTH;
+#else
+    const int pack_size = 1;
+#endif
+
+    const settleparam_t *p;
+
+    if (econq == econqForce)
+    {
+        p = &settled->mass1;
+    }
+    else
+    {
+        p = &settled->massw;
+    }
+
+    /* We assign settles to threads in groups of pack_size */
+    int numSettlePacks = (settled->nsettle + pack_size - 1)/pack_size;
+    int settleStart    = ((numSettlePacks* thread      + nthread - 1)/nthread)*pack_size;
+    int settleEnd      = ((numSettlePacks*(thread + 1) + nthread - 1)/nthread)*pack_size;
+    settleEnd          = std::min(settleEnd, settled->nsettle);
+
+    /* The SIMD code can only handle complete packs, since padding
+     * settles would subtract their corrections multiple times.
+     */
+    int settleEndSimd  = settleStart;
+#if GMX_SIMD_HAVE_REAL
+    if (settled->bUseSimd)
+    {
+        settleEndSimd = std::max(settleStart, (settleEnd/pack_size)*pack_size);
+
+        alignas(GMX_SIMD_ALIGNMENT) realA    pbcSimd[9*GMX_SIMD_REAL_WIDTH];
+        set_pbc_simd(pbc, pbcSimd);
+
+        settleProjTemplateWrapper<SimdReal, GMX_SIMD_REAL_WIDTH,
+                                  const realA *>(settled, p,
+                                                settleStart, settleEndSimd,
+                                                pbcSimd,
+                                                x[0], der[0], derp[0],
+                                                calcvir_atom_end, vir_r_m_dder);
+    }
+#endif
+
+    if (settleEndSimd < settleEnd)
+    {
+        /* This construct is needed because pbc_dx_aiuc doesn't accept pbc=NULL */
+        t_pbc        pbcNo;
+        const t_pbc *pbcNonNull;
+
+        if (pbc != nullptr)
+        {
+            pbcNonNull = pbc;
+        }
+        else
+        {
+            set_pbc(&pbcNo, epbcNONE, nullptr);
+            pbcNonNull = &pbcNo;
+        }
+
+        settleProjTemplateWrapper<realA, 1,
+                                  const t_pbc *>(settled, p,
+                                                 settleEndSimd, settleEnd,
+                                                 pbcNonNull,
+                                                 x[0], der[0], derp[0],
+                                                 calcvir_atom_end, vir_r_m_dder);
+    }
 }
 
 
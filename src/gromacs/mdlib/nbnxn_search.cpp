@@ -2905,11 +2905,24 @@ static void combine_nblists(int nnbl, nbnxn_pairlist_t **nbl,
     }
 }
 
+/* Returns the cost estimate, in pairs, of a perturbed i-entry with nrj pairs.
+ * The SIMD free-energy kernel processes the pairs of an i-entry in packs
+ * of SIMD width, so a partially filled pack costs as much as a full one.
+ */
+static int fep_ientry_cost(int nrj)
+{
+#if GMX_SIMD_HAVE_REAL
+    return ((nrj + GMX_SIMD_REAL_WIDTH - 1)/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+#else
+    return nrj;
+#endif
+}
+
 static void balance_fep_lists(const nbnxn_search_t  nbs,
                               nbnxn_pairlist_set_t *nbl_lists)
 {
     int       nnbl;
-    int       nri_tot, nrj_tot, nrj_target;
+    int       nri_tot, nrj_tot, cost_tot, cost_target, cost_dest;
     int       th_dest;
     t_nblist *nbld;
 
@@ -2922,15 +2935,22 @@ static void balance_fep_lists(const nbnxn_search_t  nbs,
     }
 
     /* Count the total i-lists and pairs */
-    nri_tot = 0;
-    nrj_tot = 0;
+    nri_tot  = 0;
+    nrj_tot  = 0;
+    cost_tot = 0;
     for (int th = 0; th < nnbl; th++)
     {
-        nri_tot += nbl_lists->nbl_fep[th]->nri;
-        nrj_tot += nbl_lists->nbl_fep[th]->nrj;
+        const t_nblist *nbl = nbl_lists->nbl_fep[th];
+
+        nri_tot += nbl->nri;
+        nrj_tot += nbl->nrj;
+        for (int i = 0; i < nbl->nri; i++)
+        {
+            cost_tot += fep_ientry_cost(nbl->jindex[i+1] - nbl->jindex[i]);
+        }
     }
 
-    nrj_target = (nrj_tot + nnbl - 1)/nnbl;
+    cost_target = (cost_tot + nnbl - 1)/nnbl;
 
     assert(gmx_omp_nthreads_get(emntNonbonded) == nnbl);
 
@@ -2964,8 +2984,9 @@ static void balance_fep_lists(const nbnxn_search_t  nbs,
     }
 
     /* Loop over the source lists and assign and copy i-entries */
-    th_dest = 0;
-    nbld    = nbs->work[th_dest].nbl_fep;
+    th_dest   = 0;
+    nbld      = nbs->work[th_dest].nbl_fep;
+    cost_dest = 0;
     for (int th = 0; th < nnbl; th++)
     {
         t_nblist *nbls;
@@ -2974,20 +2995,22 @@ static void balance_fep_lists(const nbnxn_search_t  nbs,
 
         for (int i = 0; i < nbls->nri; i++)
         {
-            int nrj;
+            int cost;
 
-            /* The number of pairs in this i-entry */
-            nrj = nbls->jindex[i+1] - nbls->jindex[i];
+            /* The cost of the pairs in this i-entry */
+            cost = fep_ientry_cost(nbls->jindex[i+1] - nbls->jindex[i]);
 
             /* Decide if list th_dest is too large and we should procede
              * to the next destination list.
              */
-            if (th_dest+1 < nnbl && nbld->nrj > 0 &&
-                nbld->nrj + nrj - nrj_target > nrj_target - nbld->nrj)
+            if (th_dest+1 < nnbl && cost_dest > 0 &&
+                cost_dest + cost - cost_target > cost_target - cost_dest)
             {
                 th_dest++;
-                nbld = nbs->work[th_dest].nbl_fep;
+                nbld      = nbs->work[th_dest].nbl_fep;
+                cost_dest = 0;
             }
+            cost_dest += cost;
 
             nbld->iinr[nbld->nri]  = nbls->iinr[i];
             nbld->gid[nbld->nri]   = nbls->gid[i];
@@ -4421,3 +4444,99 @@ void nbnxnPrepareListForDynamicPruning(nbnxn_pairlist_set_t *listSet)
         list->nci              = -1;
     }
 }
+
+/* Adds cost to the home atoms of the cluster starting at nbnxn atom a0 */
+static void add_cluster_atom_cost(const int *a, int a0, int na_c,
+                                  int natoms, realA cost,
+                                  realA *atomCost)
+{
+    realA costPerAtom = cost/na_c;
+
+    for (int i = a0; i < a0 + na_c; i++)
+    {
+        /* Skip filler particles and non-home atoms */
+        if (a[i] >= 0 && a[i] < natoms)
+        {
+            atomCost[a[i]] += costPerAtom;
+        }
+    }
+}
+
+void nbnxn_add_pairlist_atom_cost(const nbnxn_search_t        nbs,
+                                  const nbnxn_pairlist_set_t *nbl_list,
+                                  int                         natoms,
+                                  realA                      *atomCost)
+{
+    /* We use the number of cluster pairs as a proxy for the cost.
+     * Each cluster pair is split equally over its i- and j-cluster,
+     * so interactions with non-home clusters are only counted in half.
+     */
+    for (int th = 0; th < nbl_list->nnbl; th++)
+    {
+        const nbnxn_pairlist_t *nbl = nbl_list->nbl[th];
+
+        if (nbl->bSimple)
+        {
+            /* With dynamic pruning the inner list might not be set */
+            const bool        useOuter = (nbl->nci < 0);
+            const int         nci      = (useOuter ? nbl->nciOuter : nbl->nci);
+            const nbnxn_ci_t *ciList   = (useOuter ? nbl->ciOuter : nbl->ci);
+            const nbnxn_cj_t *cjList   = (useOuter ? nbl->cjOuter : nbl->cj);
+
+            for (int i = 0; i < nci; i++)
+            {
+                const nbnxn_ci_t &ci = ciList[i];
+
+                add_cluster_atom_cost(nbs->a, ci.ci*nbl->na_ci, nbl->na_ci,
+                                      natoms, 0.5*(ci.cj_ind_end - ci.cj_ind_start),
+                                      atomCost);
+                for (int j = ci.cj_ind_start; j < ci.cj_ind_end; j++)
+                {
+                    add_cluster_atom_cost(nbs->a, cjList[j].cj*nbl->na_cj, nbl->na_cj,
+                                          natoms, 0.5,
+                                          atomCost);
+                }
+            }
+        }
+        else
+        {
+            const unsigned int clusterMask = (1U << c_nbnxnGpuNumClusterPerSupercluster) - 1;
+
+            for (int i = 0; i < nbl->nsci; i++)
+            {
+                const nbnxn_sci_t &sci = nbl->sci[i];
+                int                ncp = 0;
+
+                for (int j4 = sci.cj4_ind_start; j4 < sci.cj4_ind_end; j4++)
+                {
+                    const nbnxn_cj4_t &cj4   = nbl->cj4[j4];
+                    unsigned int       imask = 0;
+                    for (int s = 0; s < c_nbnxnGpuClusterpairSplit; s++)
+                    {
+                        imask |= cj4.imei[s].imask;
+                    }
+                    for (int j = 0; j < c_nbnxnGpuJgroupSize; j++)
+                    {
+                        /* Count the i-clusters in range of this j-cluster */
+                        unsigned int jmask = (imask >> (j*c_nbnxnGpuNumClusterPerSupercluster)) & clusterMask;
+                        int          ncpj  = 0;
+                        for (; jmask != 0; jmask >>= 1)
+                        {
+                            ncpj += (jmask & 1);
+                        }
+                        if (ncpj > 0)
+                        {
+                            add_cluster_atom_cost(nbs->a, cj4.cj[j]*nbl->na_cj, nbl->na_cj,
+                                                  natoms, 0.5*ncpj,
+                                                  atomCost);
+                            ncp += ncpj;
+                        }
+                    }
+                }
+                add_cluster_atom_cost(nbs->a, sci.sci*nbl->na_sc, nbl->na_sc,
+                                      natoms, 0.5*ncp,
+                                      atomCost);
+            }
+        }
+    }
+}
@@ -89,4 +89,13 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
  */
 void nbnxnPrepareListForDynamicPruning(nbnxn_pairlist_set_t *listSet);
 
+/* Adds an estimate of the non-bonded cost, based on the number of cluster
+ * pairs in the lists in nbl_list, to the home atoms 0 to natoms in atomCost.
+ * The cost is in units of cluster pairs and is used for load balancing.
+ */
+void nbnxn_add_pairlist_atom_cost(const nbnxn_search_t        nbs,
+                                  const nbnxn_pairlist_set_t *nbl_list,
+                                  int                         natoms,
+                                  realA                      *atomCost);
+
 #endif
@@ -47,6 +47,7 @@
 #include <cstdint>
 
 #include <array>
+#include <vector>
 
 #include "gromacs/awh/awh.h"
 #include "gromacs/domdec/dlbtiming.h"
@@ -635,7 +636,39 @@ static void do_nb_verlet_fep(nbnxn_pairlist_set_t *nbl_lists,
     /* If we do foreign lambda and we have soft-core interactions
      * we have to recalculate the (non-linear) energies contributions.
      */
-    if (fepvals->n_lambda > 0 && (flags & GMX_FORCE_DHDL) && fepvals->sc_alpha != 0)
+    if (fepvals->n_lambda > 0 && (flags & GMX_FORCE_DHDL) && fepvals->sc_alpha != 0 &&
+        gmx_nb_free_energy_have_multi_lambda_kernel(fr))
+    {
+        /* Evaluate all lambda values in a single pass over the lists */
+        std::vector<realA>  lambdaCoul(enerd->n_lambda);
+        std::vector<realA>  lambdaVdw(enerd->n_lambda);
+        std::vector<double> energies(enerd->n_lambda, 0);
+
+        for (i = 0; i < enerd->n_lambda; i++)
+        {
+            lambdaCoul[i] = (i == 0 ? lambda[efptCOUL] : fepvals->all_lambda[efptCOUL][i-1]);
+            lambdaVdw[i]  = (i == 0 ? lambda[efptVDW] : fepvals->all_lambda[efptVDW][i-1]);
+        }
+#pragma omp parallel for schedule(static) num_threads(nbl_lists->nnbl)
+        for (th = 0; th < nbl_lists->nnbl; th++)
+        {
+            try
+            {
+                gmx_nb_free_energy_multi_lambda_kernel(nbl_lists->nbl_fep[th],
+                                                       x, fr, mdatoms,
+                                                       enerd->n_lambda,
+                                                       lambdaCoul.data(), lambdaVdw.data(),
+                                                       energies.data(), nrnb);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        }
+
+        for (i = 0; i < enerd->n_lambda; i++)
+        {
+            enerd->enerpart_lambda[i] += energies[i];
+        }
+    }
+    else if (fepvals->n_lambda > 0 && (flags & GMX_FORCE_DHDL) && fepvals->sc_alpha != 0)
     {
         kernel_data.flags          = (donb_flags & ~(GMX_NONBONDED_DO_FORCE | GMX_NONBONDED_DO_SHIFTFORCE)) | GMX_NONBONDED_DO_FOREIGNLAMBDA;
         kernel_data.lambda         = lam_i;
@@ -0,0 +1,313 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the assignment of LINCS constraints to tasks.
+ *
+ * Clusters of coupled constraints that are small compared to the task
+ * size are assigned completely to a task, which makes the tasks
+ * independent. The results of multiple tasks are compared to those
+ * of a single task.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/topology/block.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of atoms in the constrained chain
+const int   c_numAtoms   = 241;
+//! The number of LINCS tasks to use
+const int   c_numTasks   = 4;
+//! The constraint length
+const realA c_bondLength = 0.1;
+
+/*! \brief Test fixture for the LINCS task assignment
+ *
+ * The global topology is a single chain of c_numAtoms atoms connected
+ * by constraints. As with domain decomposition, the local topology
+ * passed to set_lincs() can contain only part of these constraints,
+ * which we use to generate clusters of coupled constraints of
+ * different sizes.
+ */
+class LincsTaskTest : public ::testing::Test
+{
+    public:
+        //! Constructor
+        LincsTaskTest() :
+            mtop_(), moltype_(), molblock_(), iparams_(), at2con_(), idef_(), mdatoms_(), cr_(),
+            numThreadsSaved_(gmx_omp_nthreads_get(emntLINCS))
+        {
+            iparams_.constr.dA = c_bondLength;
+            iparams_.constr.dB = c_bondLength;
+
+            globalConstraints_                = chainConstraints(0);
+            moltype_.atoms.nr                 = c_numAtoms;
+            moltype_.ilist[F_CONSTR].iatoms   = globalConstraints_.data();
+            moltype_.ilist[F_CONSTR].nr       = globalConstraints_.size();
+            molblock_.type                    = 0;
+            molblock_.nmol                    = 1;
+            molblock_.natoms_mol              = c_numAtoms;
+            mtop_.nmoltype                    = 1;
+            mtop_.moltype                     = &moltype_;
+            mtop_.nmolblock                   = 1;
+            mtop_.molblock                    = &molblock_;
+            mtop_.natoms                      = c_numAtoms;
+            mtop_.ffparams.ntypes             = 1;
+            mtop_.ffparams.iparams            = &iparams_;
+            int numFlexibleConstraints;
+            at2con_ = make_at2con(0, c_numAtoms, moltype_.ilist, &iparams_, TRUE, &numFlexibleConstraints);
+
+            idef_.ntypes  = 1;
+            idef_.iparams = &iparams_;
+
+            /* A zig-zag chain with the constraint length between
+             * consecutive atoms, that is then displaced by an update.
+             */
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                x_.emplace_back(0.08*i, 0.06*(i % 2), 0);
+                xUpdated_.emplace_back(x_[i][XX] + 0.005*std::sin(1.3*i),
+                                       x_[i][YY] + 0.005*std::cos(0.7*i),
+                                       x_[i][ZZ] + 0.005*std::sin(2.1*i));
+                invmass_.push_back(1/(i % 3 == 0 ? 14.0 : 12.0));
+            }
+            mdatoms_.nr      = c_numAtoms;
+            mdatoms_.homenr  = c_numAtoms;
+            mdatoms_.invmass = invmass_.data();
+
+            cr_.nnodes = 1;
+
+            ir_.efep           = efepNO;
+            ir_.LincsWarnAngle = 90;
+
+            clear_mat(box_);
+            init_nrnb(&nrnb_);
+        }
+        ~LincsTaskTest()
+        {
+            done_blocka(&at2con_);
+            gmx_omp_nthreads_set(emntLINCS, numThreadsSaved_);
+        }
+
+        /*! \brief Returns the constraints of the chain
+         *
+         * With clusterSize > 0, every constraint following clusterSize
+         * constraints is left out, which gives clusters of coupled
+         * constraints of size clusterSize.
+         */
+        static std::vector<int> chainConstraints(int clusterSize)
+        {
+            std::vector<int> iatoms;
+            for (int i = 0; i < c_numAtoms - 1; i++)
+            {
+                if (clusterSize == 0 || (i + 1) % (clusterSize + 1) != 0)
+                {
+                    iatoms.push_back(0);
+                    iatoms.push_back(i);
+                    iatoms.push_back(i + 1);
+                }
+            }
+            return iatoms;
+        }
+
+        //! Returns LINCS data initialized for \p numTasks tasks
+        gmx_lincsdata_t initLincs(int numTasks)
+        {
+            gmx_omp_nthreads_set(emntLINCS, numTasks);
+
+            return init_lincs(nullptr, &mtop_, 0, &at2con_, FALSE, 1, 4);
+        }
+
+        //! Sets the local constraints \p iatoms for \p lincsd
+        void setConstraints(gmx_lincsdata_t lincsd, std::vector<int> *iatoms)
+        {
+            idef_.il[F_CONSTR].iatoms = iatoms->data();
+            idef_.il[F_CONSTR].nr     = iatoms->size();
+            set_lincs(&idef_, &mdatoms_, TRUE, &cr_, lincsd);
+        }
+
+        //! Returns the constrained updated coordinates
+        std::vector<RVec> constrain(gmx_lincsdata_t lincsd)
+        {
+            std::vector<RVec> xConstrained(xUpdated_);
+            tensor            virial = {{0}};
+            int               warnCount = 0;
+            EXPECT_TRUE(constrain_lincs(nullptr, FALSE, FALSE, &ir_, 0, lincsd, &mdatoms_, &cr_,
+                                        as_rvec_array(x_.data()), as_rvec_array(xConstrained.data()), nullptr,
+                                        box_, nullptr, 0, nullptr, 1, nullptr,
+                                        FALSE, virial, econqCoord, &nrnb_, -1, &warnCount));
+            return xConstrained;
+        }
+
+        /*! \brief Checks that multiple LINCS tasks give the same result as one
+         *
+         * Also checks that the constraints are satisfied.
+         */
+        void checkMatchesSingleTask(gmx_lincsdata_t lincsd, std::vector<int> *iatoms)
+        {
+            std::vector<RVec> xConstrained = constrain(lincsd);
+
+            gmx_lincsdata_t   lincsdSingle = initLincs(1);
+            setConstraints(lincsdSingle, iatoms);
+            std::vector<RVec> xReference   = constrain(lincsdSingle);
+
+            FloatingPointTolerance tolerance(relativeToleranceAsFloatingPoint(1, GMX_DOUBLE ? 1e-10 : 1e-6));
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(xReference[i][d], xConstrained[i][d], tolerance) << "atom " << i << " dim " << d;
+                }
+            }
+
+            FloatingPointTolerance lengthTolerance(relativeToleranceAsFloatingPoint(c_bondLength, 1e-3));
+            for (size_t c = 0; c < iatoms->size(); c += 3)
+            {
+                int a1 = (*iatoms)[c + 1];
+                int a2 = (*iatoms)[c + 2];
+                EXPECT_REAL_EQ_TOL(c_bondLength, std::sqrt(distance2(xConstrained[a1], xConstrained[a2])), lengthTolerance)
+                << "constraint between atoms " << a1 << " and " << a2;
+            }
+        }
+
+        //! The global topology
+        gmx_mtop_t        mtop_;
+        //! The molecule type of the chain
+        gmx_moltype_t     moltype_;
+        //! The molecule block of the chain
+        gmx_molblock_t    molblock_;
+        //! The constraint parameters
+        t_iparams         iparams_;
+        //! The constraints of the global topology
+        std::vector<int>  globalConstraints_;
+        //! The atom to constraint lookup of the global topology
+        t_blocka          at2con_;
+        //! The local topology
+        t_idef            idef_;
+        //! The coordinates before the update
+        std::vector<RVec> x_;
+        //! The coordinates after the update
+        std::vector<RVec> xUpdated_;
+        //! The inverse masses
+        std::vector<realA> invmass_;
+        //! The atom data
+        t_mdatoms         mdatoms_;
+        //! The communication record, without domain decomposition
+        t_commrec         cr_;
+        //! The input record
+        t_inputrec        ir_;
+        //! The box, not used without PBC
+        matrix            box_;
+        //! The flop counting
+        t_nrnb            nrnb_;
+        //! The number of LINCS threads before the test
+        int               numThreadsSaved_;
+};
+
+TEST_F(LincsTaskTest, SmallClustersGiveIndependentTasks)
+{
+    // 200 constraints in clusters of 5, with a maximum of 50/8 per task
+    std::vector<int> iatoms = chainConstraints(5);
+    gmx_lincsdata_t  lincsd = initLincs(c_numTasks);
+    setConstraints(lincsd, &iatoms);
+
+    EXPECT_FALSE(lincs_tasks_are_dependent(lincsd));
+    checkMatchesSingleTask(lincsd, &iatoms);
+}
+
+TEST_F(LincsTaskTest, LargeClusterGivesDependentTasks)
+{
+    std::vector<int> iatoms = chainConstraints(0);
+    gmx_lincsdata_t  lincsd = initLincs(c_numTasks);
+    setConstraints(lincsd, &iatoms);
+
+    EXPECT_TRUE(lincs_tasks_are_dependent(lincsd));
+    checkMatchesSingleTask(lincsd, &iatoms);
+}
+
+TEST_F(LincsTaskTest, TaskDependenceFollowsRepartitioning)
+{
+    /* As with domain decomposition, set_lincs() is called repeatedly
+     * on the same data, with local constraints that give independent
+     * and dependent tasks.
+     */
+    std::vector<int> iatomsSmall = chainConstraints(5);
+    std::vector<int> iatomsLarge = chainConstraints(0);
+    gmx_lincsdata_t  lincsd      = initLincs(c_numTasks);
+
+    setConstraints(lincsd, &iatomsSmall);
+    EXPECT_FALSE(lincs_tasks_are_dependent(lincsd));
+    checkMatchesSingleTask(lincsd, &iatomsSmall);
+
+    setConstraints(lincsd, &iatomsLarge);
+    EXPECT_TRUE(lincs_tasks_are_dependent(lincsd));
+    checkMatchesSingleTask(lincsd, &iatomsLarge);
+
+    setConstraints(lincsd, &iatomsSmall);
+    EXPECT_FALSE(lincs_tasks_are_dependent(lincsd));
+    checkMatchesSingleTask(lincsd, &iatomsSmall);
+}
+
+} // namespace
+} // namespace
+} // namespace
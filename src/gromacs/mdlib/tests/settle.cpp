@@ -34,6 +34,9 @@
  */
 #include "gmxpre.h"
 
+#include <cmath>
+
+#include <algorithm>
 #include <tuple>
 #include <vector>
 
@@ -116,6 +119,119 @@ const double g_positions[] = {
 //! Simple cubic simulation box to use in tests
 matrix g_box = {{realA(1.86206), 0, 0}, {0, realA(1.86206), 0}, {0, 0, realA(1.86206)}};
 
+/*! \brief Computes the SETTLE derivative projection directly, in double precision
+ *
+ * The three bond corrections are obtained by solving the constraint
+ * coupling equations for the actual bond directions, so this does not
+ * share any code with settle_proj. \p derp should contain a copy of
+ * \p der on input, the contributions for each settle are subtracted
+ * from it. */
+void computeReferenceProjection(int numSettles, const t_pbc *pbc,
+                                realA dOH, realA dHH,
+                                const std::vector<realA> &invmass,
+                                const std::vector<realA> &x,
+                                const std::vector<realA> &der,
+                                std::vector<realA> *derp,
+                                tensor virialProjection)
+{
+    const int atomsPerSettle = NRAL(F_SETTLE);
+    // The atoms pairs (within the settle) of the three constraints
+    const int constraintAtoms[DIM][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    const rvec *xv               = reinterpret_cast<const rvec *>(x.data());
+    const rvec *derv             = reinterpret_cast<const rvec *>(der.data());
+    rvec       *derpv            = reinterpret_cast<rvec *>(derp->data());
+
+    for (int i = 0; i < numSettles; i++)
+    {
+        const int a0 = i*atomsPerSettle;
+        double    length[DIM];
+        double    u[DIM][DIM];
+        for (int c = 0; c < DIM; c++)
+        {
+            rvec dx;
+            pbc_dx_aiuc(pbc, xv[a0 + constraintAtoms[c][0]], xv[a0 + constraintAtoms[c][1]], dx);
+            length[c] = (c < 2 ? dOH : dHH);
+            for (int d = 0; d < DIM; d++)
+            {
+                u[c][d] = dx[d]/length[c];
+            }
+        }
+
+        // Set up and solve mat*lambda = dc
+        double mat[DIM][DIM];
+        double dc[DIM];
+        for (int c = 0; c < DIM; c++)
+        {
+            const int a = constraintAtoms[c][0];
+            const int b = constraintAtoms[c][1];
+            dc[c]       = 0;
+            for (int d = 0; d < DIM; d++)
+            {
+                dc[c] += (derv[a0 + a][d] - derv[a0 + b][d])*u[c][d];
+            }
+            for (int c2 = 0; c2 < DIM; c2++)
+            {
+                double coupling = 0;
+                for (int atom = 0; atom < 2; atom++)
+                {
+                    const int sign = (atom == 0 ? 1 : -1);
+                    const int ai   = constraintAtoms[c][atom];
+                    if (ai == constraintAtoms[c2][0])
+                    {
+                        coupling += sign*invmass[a0 + ai];
+                    }
+                    else if (ai == constraintAtoms[c2][1])
+                    {
+                        coupling -= sign*invmass[a0 + ai];
+                    }
+                }
+                mat[c][c2] = coupling*(u[c][XX]*u[c2][XX] + u[c][YY]*u[c2][YY] + u[c][ZZ]*u[c2][ZZ]);
+            }
+        }
+        const double det =
+            mat[XX][XX]*(mat[YY][YY]*mat[ZZ][ZZ] - mat[YY][ZZ]*mat[ZZ][YY]) -
+            mat[XX][YY]*(mat[YY][XX]*mat[ZZ][ZZ] - mat[YY][ZZ]*mat[ZZ][XX]) +
+            mat[XX][ZZ]*(mat[YY][XX]*mat[ZZ][YY] - mat[YY][YY]*mat[ZZ][XX]);
+        double lambda[DIM];
+        for (int c = 0; c < DIM; c++)
+        {
+            // Cramer's rule
+            double m[DIM][DIM];
+            for (int r = 0; r < DIM; r++)
+            {
+                for (int c2 = 0; c2 < DIM; c2++)
+                {
+                    m[r][c2] = (c2 == c ? dc[r] : mat[r][c2]);
+                }
+            }
+            lambda[c] =
+                (m[XX][XX]*(m[YY][YY]*m[ZZ][ZZ] - m[YY][ZZ]*m[ZZ][YY]) -
+                 m[XX][YY]*(m[YY][XX]*m[ZZ][ZZ] - m[YY][ZZ]*m[ZZ][XX]) +
+                 m[XX][ZZ]*(m[YY][XX]*m[ZZ][YY] - m[YY][YY]*m[ZZ][XX]))/det;
+        }
+
+        for (int c = 0; c < DIM; c++)
+        {
+            for (int atom = 0; atom < 2; atom++)
+            {
+                const int    sign = (atom == 0 ? 1 : -1);
+                const int    ai   = a0 + constraintAtoms[c][atom];
+                for (int d = 0; d < DIM; d++)
+                {
+                    derpv[ai][d] -= sign*invmass[ai]*lambda[c]*u[c][d];
+                }
+            }
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    virialProjection[d2][d] += length[c]*lambda[c]*u[c][d2]*u[c][d];
+                }
+            }
+        }
+    }
+}
+
 //! Convenience typedef
 typedef std::tuple<int, bool, bool, bool> SettleTestParameters;
 
@@ -261,6 +377,77 @@ TEST_P(SettleTest, SatisfiesConstraints)
             startingPositions.data(), updatedPositions_.data(), reciprocalTimeStep,
             useVelocities ? velocities_.data() : nullptr,
             calcVirial, virial, &errorOccured);
+
+    // Project the bond components out of a set of derivatives, using the
+    // same settles. The projected derivatives should have no relative
+    // component along any of the bonds of the constrained coordinates.
+    std::vector<realA> derivatives(updatedPositions_.size());
+    for (size_t i = 0; i != derivatives.size(); ++i)
+    {
+        derivatives[i] = 0.1*((i*7) % 11) - 0.5;
+    }
+    std::vector<realA> referenceProjectedDerivatives(derivatives);
+    tensor             referenceVirialProjection = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    computeReferenceProjection(numSettles, usePbc ? &pbcXYZ_ : &pbcNone_,
+                               dOH, dHH, massReciprocal,
+                               updatedPositions_, derivatives,
+                               &referenceProjectedDerivatives,
+                               referenceVirialProjection);
+    realA referenceVirialScale = 0;
+    for (int d = 0; d < DIM; ++d)
+    {
+        for (int dd = 0; dd < DIM; ++dd)
+        {
+            referenceVirialScale = std::max(referenceVirialScale, std::abs(referenceVirialProjection[d][dd]));
+        }
+    }
+
+    // settle_proj distributes settles over threads in units of SIMD
+    // packs, so check that each combination of thread count and index
+    // together projects each settle once, and that the SIMD and
+    // remainder paths agree with the reference.
+    FloatingPointTolerance projectionReferenceTolerance =
+        relativeToleranceAsFloatingPoint(1.0, GMX_DOUBLE ? 1e-10 : 1e-5);
+    FloatingPointTolerance virialReferenceTolerance =
+        relativeToleranceAsFloatingPoint(referenceVirialScale, GMX_DOUBLE ? 1e-10 : 1e-5);
+    std::vector<realA> projectedDerivatives;
+    for (int numProjectionThreads : { 1, 2, 3, 4, 7 })
+    {
+        projectedDerivatives = derivatives;
+        tensor virialProjection = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        for (int projectionThread = 0; projectionThread < numProjectionThreads; ++projectionThread)
+        {
+            settle_proj(settled, econqVeloc, numProjectionThreads, projectionThread,
+                        usePbc ? &pbcXYZ_ : &pbcNone_,
+                        reinterpret_cast<rvec *>(updatedPositions_.data()),
+                        reinterpret_cast<rvec *>(derivatives.data()),
+                        reinterpret_cast<rvec *>(projectedDerivatives.data()),
+                        calcVirial ? mdatoms.homenr : 0, virialProjection);
+        }
+
+        std::string threadDescription = formatString("with projection on %d threads ", numProjectionThreads);
+        for (size_t i = 0; i != projectedDerivatives.size(); ++i)
+        {
+            EXPECT_REAL_EQ_TOL(referenceProjectedDerivatives[i], projectedDerivatives[i], projectionReferenceTolerance)
+            << formatString("for projected derivative coordinate %zu ", i) << threadDescription << testDescription;
+        }
+        for (int d = 0; d < DIM; ++d)
+        {
+            for (int dd = 0; dd < DIM; ++dd)
+            {
+                if (calcVirial)
+                {
+                    EXPECT_REAL_EQ_TOL(referenceVirialProjection[d][dd], virialProjection[d][dd], virialReferenceTolerance)
+                    << formatString("for projection virial component[%d][%d] ", d, dd) << threadDescription << testDescription;
+                }
+                else
+                {
+                    EXPECT_EQ(0, virialProjection[d][dd])
+                    << formatString("for projection virial component[%d][%d] ", d, dd) << threadDescription << testDescription;
+                }
+            }
+        }
+    }
     settle_free(settled);
     EXPECT_FALSE(errorOccured) << testDescription;
 
@@ -296,6 +483,19 @@ TEST_P(SettleTest, SatisfiesConstraints)
         {
             EXPECT_TRUE(useVelocities == (0. != velocities_[velocityIndex])) << formatString("for water %d velocity coordinate %d ", i, j) << testDescription;
         }
+
+        const rvec *projected = reinterpret_cast<const rvec *>(projectedDerivatives.data()) + i*atomsPerSettle;
+        rvec        dOH1, dOH2, dH1H2, dpOH1, dpOH2, dpH1H2;
+        rvec_sub(positionO, positionH1, dOH1);
+        rvec_sub(positionO, positionH2, dOH2);
+        rvec_sub(positionH1, positionH2, dH1H2);
+        rvec_sub(projected[0], projected[1], dpOH1);
+        rvec_sub(projected[0], projected[2], dpOH2);
+        rvec_sub(projected[1], projected[2], dpH1H2);
+        FloatingPointTolerance projectionTolerance = absoluteTolerance(GMX_DOUBLE ? 1e-10 : 1e-5);
+        EXPECT_REAL_EQ_TOL(0, iprod(dpOH1, dOH1), projectionTolerance) << formatString("for projection of water %d ", i) << testDescription;
+        EXPECT_REAL_EQ_TOL(0, iprod(dpOH2, dOH2), projectionTolerance) << formatString("for projection of water %d ", i) << testDescription;
+        EXPECT_REAL_EQ_TOL(0, iprod(dpH1H2, dH1H2), projectionTolerance) << formatString("for projection of water %d ", i) << testDescription;
     }
 
     // This merely tests whether the viral was updated from
@@ -311,11 +511,11 @@ TEST_P(SettleTest, SatisfiesConstraints)
 }
 
 // Scan the full Cartesian product of numbers of SETTLE interactions
-// (4 and 17 are chosen to test cases that do and do not match
+// (4, 7 and 17 are chosen to test cases that do and do not match
 // hardware SIMD widths), and whether or not we use PBC, velocities or
 // calculate the virial contribution.
 INSTANTIATE_TEST_CASE_P(WithParameters, SettleTest,
-                            ::testing::Combine(::testing::Values(1, 4, 7),
+                            ::testing::Combine(::testing::Values(1, 4, 7, 17),
                                                    ::testing::Bool(),
                                                    ::testing::Bool(),
                                                    ::testing::Bool()));
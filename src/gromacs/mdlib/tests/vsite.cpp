@@ -0,0 +1,299 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2018, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD construction and force spreading of virtual sites.
+ *
+ * The SIMD kernels are compared to the scalar code, which is used
+ * when vsites are passed to the vsite routines one at a time.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/vsite.h"
+
+#include <cmath>
+
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The number of vsites, chosen to give several packs for all SIMD widths
+const int c_numVsites = 37;
+
+/*! \brief Vsites that are constructed from the vsite before them
+ *
+ * These put a dependency within a SIMD pack for all SIMD widths,
+ * which should be handled by the scalar code only for that pack.
+ */
+const int c_dependentVsites[] = { 6, 19 };
+
+//! The time step used for computing vsite velocities
+const realA c_dt = 0.002;
+
+//! Convenience typedef of vsite type and whether to use PBC
+typedef std::tuple<int, bool> VsiteSimdTestParameters;
+
+/*! \brief Test fixture for comparing the SIMD and scalar vsite code
+ *
+ * Vsite i is atom 4*i and is constructed from atoms 4*i+1 to 4*i+3,
+ * except for the dependent vsites, which use the previous vsite as
+ * their first constructing atom. With PBC some of the vsites are
+ * constructed from atoms on different sides of the box.
+ */
+class VsiteSimdTest : public ::testing::TestWithParam<VsiteSimdTestParameters>
+{
+    public:
+        //! Constructor
+        VsiteSimdTest() :
+            ftype_(std::get<0>(GetParam())),
+            ePBC_(std::get<1>(GetParam()) ? epbcXYZ : epbcNONE),
+            x_(4*c_numVsites),
+            f_(4*c_numVsites),
+            vsite_()
+        {
+            clear_mat(box_);
+            for (int d = 0; d < DIM; d++)
+            {
+                box_[d][d] = 2.0;
+            }
+
+            ip_[0].vsite.a = (ftype_ == F_VSITE3FD ? 0.4 : 0.3);
+            ip_[0].vsite.b = (ftype_ == F_VSITE3FD ? 0.11 : 0.25);
+            ip_[0].vsite.c = (ftype_ == F_VSITE3OUT ? 1.5 : 0);
+
+            DefaultRandomEngine           rng(1234);
+            UniformRealDistribution<realA> dist;
+            RVec                          base;
+            for (int i = 0; i < c_numVsites; i++)
+            {
+                bool isDependent = false;
+                for (int dependent : c_dependentVsites)
+                {
+                    isDependent = isDependent || (i == dependent);
+                }
+                if (!isDependent)
+                {
+                    base = { 2*dist(rng), 2*dist(rng), realA(i % 3 == 0 ? 1.99 : 1.0) };
+                }
+                for (int k = 1; k <= 3; k++)
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        realA xd = base[d] + 0.1*(dist(rng) - 0.5) + (d == k - 1 ? 0.05*k : 0);
+                        if (ePBC_ != epbcNONE)
+                        {
+                            xd = std::fmod(xd + box_[d][d], box_[d][d]);
+                        }
+                        x_[4*i + k][d] = xd;
+                    }
+                }
+                /* The old vsite position, the new one should be close */
+                rvec_add(x_[4*i + 1], RVec(0.01, 0.01, 0.01), x_[4*i]);
+
+                iatoms_.push_back(0);
+                iatoms_.push_back(4*i);
+                iatoms_.push_back(isDependent ? 4*(i - 1) : 4*i + 1);
+                iatoms_.push_back(4*i + 2);
+                iatoms_.push_back(4*i + 3);
+            }
+            for (RVec &f : f_)
+            {
+                f = { 2*dist(rng) - 1, 2*dist(rng) - 1, 2*dist(rng) - 1 };
+            }
+
+            vsite_.nthreads        = 1;
+            vsite_.n_intercg_vsite = c_numVsites;
+        }
+
+        //! Constructs vsites \p start to \p start + \p num - 1 in \p x
+        void construct(int start, int num, std::vector<RVec> *x, std::vector<RVec> *v)
+        {
+            t_ilist ilist[F_NRE] = {};
+            ilist[ftype_].nr     = num*(1 + NRAL(ftype_));
+            ilist[ftype_].iatoms = iatoms_.data() + start*(1 + NRAL(ftype_));
+            construct_vsites(&vsite_, as_rvec_array(x->data()), c_dt, as_rvec_array(v->data()),
+                             ip_, ilist, ePBC_, TRUE, nullptr, box_);
+        }
+
+        //! Spreads the forces of vsites \p start to \p start + \p num - 1
+        void spread(int start, int num, const std::vector<RVec> &x, std::vector<RVec> *f,
+                    rvec *fshift, gmx_bool VirCorr, matrix vir)
+        {
+            t_idef idef = {};
+            idef.iparams           = ip_;
+            idef.il[ftype_].nr     = num*(1 + NRAL(ftype_));
+            idef.il[ftype_].iatoms = iatoms_.data() + start*(1 + NRAL(ftype_));
+            t_nrnb nrnb;
+            init_nrnb(&nrnb);
+            spread_vsite_f(&vsite_, as_rvec_array(x.data()), as_rvec_array(f->data()), fshift,
+                           VirCorr, vir, &nrnb, &idef, ePBC_, TRUE, nullptr, box_, nullptr);
+        }
+
+        //! The vsite type to test
+        int                  ftype_;
+        //! The PBC type to test
+        int                  ePBC_;
+        //! The box
+        matrix               box_;
+        //! The interaction parameters, there is a single type
+        t_iparams            ip_[1];
+        //! The vsite and constructing atom indices
+        std::vector<t_iatom> iatoms_;
+        //! The positions
+        std::vector<RVec>    x_;
+        //! The forces
+        std::vector<RVec>    f_;
+        //! The vsite struct, no charge groups and no domain decomposition
+        gmx_vsite_t          vsite_;
+};
+
+TEST_P(VsiteSimdTest, ConstructionMatchesScalar)
+{
+    std::vector<RVec> xRef(x_), vRef(x_.size(), RVec(0, 0, 0));
+    for (int i = 0; i < c_numVsites; i++)
+    {
+        construct(i, 1, &xRef, &vRef);
+    }
+    std::vector<RVec> x(x_), v(x_.size(), RVec(0, 0, 0));
+    construct(0, c_numVsites, &x, &v);
+
+    FloatingPointTolerance xTolerance = relativeToleranceAsFloatingPoint(1, GMX_DOUBLE ? 1e-10 : 1e-5);
+    FloatingPointTolerance vTolerance = relativeToleranceAsFloatingPoint(1/c_dt, GMX_DOUBLE ? 1e-10 : 1e-5);
+    for (size_t a = 0; a < x.size(); a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(xRef[a][d], x[a][d], xTolerance) << formatString("for x of atom %zu dim %d", a, d);
+            EXPECT_REAL_EQ_TOL(vRef[a][d], v[a][d], vTolerance) << formatString("for v of atom %zu dim %d", a, d);
+        }
+    }
+}
+
+TEST_P(VsiteSimdTest, SpreadingMatchesScalar)
+{
+    std::vector<RVec> x(x_), v(x_.size());
+    construct(0, c_numVsites, &x, &v);
+
+    FloatingPointTolerance tolerance = relativeToleranceAsFloatingPoint(10, GMX_DOUBLE ? 1e-10 : 1e-5);
+    for (gmx_bool VirCorr : { FALSE, TRUE })
+    {
+        /* We test the shift forces without and the virial correction with VirCorr */
+        std::vector<RVec> fRef(f_), f(f_);
+        rvec              fshiftRef[SHIFTS], fshift[SHIFTS];
+        matrix            virRef, vir;
+        clear_rvecs(SHIFTS, fshiftRef);
+        clear_rvecs(SHIFTS, fshift);
+        clear_mat(virRef);
+        clear_mat(vir);
+
+        for (int i = 0; i < c_numVsites; i++)
+        {
+            spread(i, 1, x, &fRef, VirCorr ? nullptr : fshiftRef, VirCorr, virRef);
+        }
+        spread(0, c_numVsites, x, &f, VirCorr ? nullptr : fshift, VirCorr, vir);
+
+        for (size_t a = 0; a < f.size(); a++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(fRef[a][d], f[a][d], tolerance) << formatString("for f of atom %zu dim %d, VirCorr %d", a, d, VirCorr);
+            }
+        }
+        /* The shift forces can be distributed differently over the shifts,
+         * so we compare their contributions to the virial.
+         */
+        rvec   shiftVec[SHIFTS];
+        matrix shiftVirRef, shiftVir;
+        calc_shifts(box_, shiftVec);
+        clear_mat(shiftVirRef);
+        clear_mat(shiftVir);
+        for (int s = 0; s < SHIFTS; s++)
+        {
+            for (int d1 = 0; d1 < DIM; d1++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    shiftVirRef[d1][d2] += shiftVec[s][d1]*fshiftRef[s][d2];
+                    shiftVir[d1][d2]    += shiftVec[s][d1]*fshift[s][d2];
+                }
+            }
+        }
+        for (int d1 = 0; d1 < DIM; d1++)
+        {
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                EXPECT_REAL_EQ_TOL(shiftVirRef[d1][d2], shiftVir[d1][d2], tolerance) << formatString("for shift virial element %d %d", d1, d2);
+            }
+        }
+        for (int d1 = 0; d1 < DIM; d1++)
+        {
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                EXPECT_REAL_EQ_TOL(virRef[d1][d2], vir[d1][d2], tolerance) << formatString("for virial element %d %d", d1, d2);
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithParameters, VsiteSimdTest,
+                            ::testing::Combine(::testing::Values(F_VSITE3, F_VSITE3FD, F_VSITE3OUT),
+                                                   ::testing::Bool()));
+
+} // namespace
+} // namespace
+} // namespace
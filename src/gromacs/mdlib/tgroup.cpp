@@ -157,6 +157,8 @@ void init_ekindata(FILE gmx_unused *log, gmx_mtop_t *mtop, t_grpopts *opts,
     ekind->ngacc = opts->ngacc;
     snew(ekind->grpstat, opts->ngacc);
     init_grpstat(mtop, opts->ngacc, ekind->grpstat);
+
+    ekind->bEkinhFromUpdate = FALSE;
 }
 
 void accumulate_u(t_commrec *cr, t_grpopts *opts, gmx_ekindata_t *ekind)
@@ -385,6 +385,56 @@ updateMDLeapfrogSimpleSimd(int                       start,
 
 #endif // GMX_HAVE_SIMD_UPDATE
 
+/*! \brief The number of atoms per block in the update with kinetic energy accumulation
+ *
+ * The block should be small enough for the updated velocities
+ * to still be in L1 cache when accumulating the kinetic energy,
+ * and a multiple of the SIMD width.
+ */
+static const int c_updateEkinhBlockSize = 256;
+
+/*! \brief Accumulates the half step kinetic energy of atoms \p start to \p nrend
+ *
+ * This is the atom loop of calc_ke_part_normal() without the acceleration
+ * group velocity correction, which is only non-zero with NEMD.
+ *
+ * \param[in]    start       Index of first atom
+ * \param[in]    nrend       Last atom: \p nrend - 1
+ * \param[in]    md          Atom properties
+ * \param[in]    v           Velocities
+ * \param[inout] ekinSum     Kinetic energy tensor per T-coupling group
+ * \param[inout] dekindlSum  dEkin/dlambda
+ */
+static void accumulateEkinh(int                       start,
+                            int                       nrend,
+                            const t_mdatoms          *md,
+                            const rvec * gmx_restrict v,
+                            matrix                   *ekinSum,
+                            realA                    *dekindlSum)
+{
+    int gt = 0;
+    for (int a = start; a < nrend; a++)
+    {
+        if (md->cTC)
+        {
+            gt = md->cTC[a];
+        }
+        realA hm = 0.5*md->massT[a];
+
+        for (int d = 0; d < DIM; d++)
+        {
+            for (int m = 0; m < DIM; m++)
+            {
+                ekinSum[gt][m][d] += hm*v[a][m]*v[a][d];
+            }
+        }
+        if (md->nMassPerturbed && md->bPerturbed[a])
+        {
+            *dekindlSum += 0.5*(md->massB[a] - md->massA[a])*iprod(v[a], v[a]);
+        }
+    }
+}
+
 /*! \brief Sets the NEMD acceleration type */
 enum class AccelerationType
 {
@@ -1141,62 +1191,72 @@ static void calc_ke_part_normal(rvec v[], t_grpopts *opts, t_mdatoms *md,
     ekind->dekindl_old = ekind->dekindl;
     nthread            = gmx_omp_nthreads_get(emntUpdate);
 
-#pragma omp parallel for num_threads(nthread) schedule(static)
-    for (thread = 0; thread < nthread; thread++)
-    {
-        // This OpenMP only loops over arrays and does not call any functions
-        // or memory allocation. It should not be able to throw, so for now
-        // we do not need a try/catch wrapper.
-        int     start_t, end_t, n;
-        int     ga, gt;
-        rvec    v_corrt;
-        realA    hm;
-        int     d, m;
-        matrix *ekin_sum;
-        realA   *dekindl_sum;
-
-        start_t = ((thread+0)*md->homenr)/nthread;
-        end_t   = ((thread+1)*md->homenr)/nthread;
-
-        ekin_sum    = ekind->ekin_work[thread];
-        dekindl_sum = ekind->dekindl_work[thread];
-
-        for (gt = 0; gt < opts->ngtc; gt++)
-        {
-            clear_mat(ekin_sum[gt]);
-        }
-        *dekindl_sum = 0.0;
+    /* With leap-frog the update, or with constraints update_constraints(),
+     * can already have accumulated the half step kinetic energy
+     * in the work arrays.
+     */
+    bool bHaveEkinhWork = (ekind->bEkinhFromUpdate && !bEkinAveVel);
+    ekind->bEkinhFromUpdate = FALSE;
 
-        ga = 0;
-        gt = 0;
-        for (n = start_t; n < end_t; n++)
+    if (!bHaveEkinhWork)
+    {
+#pragma omp parallel for num_threads(nthread) schedule(static)
+        for (thread = 0; thread < nthread; thread++)
         {
-            if (md->cACC)
-            {
-                ga = md->cACC[n];
-            }
-            if (md->cTC)
+            // This OpenMP only loops over arrays and does not call any functions
+            // or memory allocation. It should not be able to throw, so for now
+            // we do not need a try/catch wrapper.
+            int     start_t, end_t, n;
+            int     ga, gt;
+            rvec    v_corrt;
+            realA    hm;
+            int     d, m;
+            matrix *ekin_sum;
+            realA   *dekindl_sum;
+
+            start_t = ((thread+0)*md->homenr)/nthread;
+            end_t   = ((thread+1)*md->homenr)/nthread;
+
+            ekin_sum    = ekind->ekin_work[thread];
+            dekindl_sum = ekind->dekindl_work[thread];
+
+            for (gt = 0; gt < opts->ngtc; gt++)
             {
-                gt = md->cTC[n];
+                clear_mat(ekin_sum[gt]);
             }
-            hm   = 0.5*md->massT[n];
+            *dekindl_sum = 0.0;
 
-            for (d = 0; (d < DIM); d++)
-            {
-                v_corrt[d]  = v[n][d]  - grpstat[ga].u[d];
-            }
-            for (d = 0; (d < DIM); d++)
+            ga = 0;
+            gt = 0;
+            for (n = start_t; n < end_t; n++)
             {
-                for (m = 0; (m < DIM); m++)
+                if (md->cACC)
                 {
-                    /* if we're computing a full step velocity, v_corrt[d] has v(t).  Otherwise, v(t+dt/2) */
-                    ekin_sum[gt][m][d] += hm*v_corrt[m]*v_corrt[d];
+                    ga = md->cACC[n];
+                }
+                if (md->cTC)
+                {
+                    gt = md->cTC[n];
+                }
+                hm   = 0.5*md->massT[n];
+
+                for (d = 0; (d < DIM); d++)
+                {
+                    v_corrt[d]  = v[n][d]  - grpstat[ga].u[d];
+                }
+                for (d = 0; (d < DIM); d++)
+                {
+                    for (m = 0; (m < DIM); m++)
+                    {
+                        /* if we're computing a full step velocity, v_corrt[d] has v(t).  Otherwise, v(t+dt/2) */
+                        ekin_sum[gt][m][d] += hm*v_corrt[m]*v_corrt[d];
+                    }
+                }
+                if (md->nMassPerturbed && md->bPerturbed[n])
+                {
+                    *dekindl_sum +=
+                        0.5*(md->massB[n] - md->massA[n])*iprod(v_corrt, v_corrt);
                 }
-            }
-            if (md->nMassPerturbed && md->bPerturbed[n])
-            {
-                *dekindl_sum +=
-                    0.5*(md->massB[n] - md->massA[n])*iprod(v_corrt, v_corrt);
             }
         }
     }
@@ -1569,7 +1629,9 @@ void update_constraints(FILE                          *fplog,
                         gmx_update_t                  *upd,
                         gmx_constr_t                   constr,
                         gmx_bool                       bFirstHalf,
-                        gmx_bool                       bCalcVir)
+                        gmx_bool                       bCalcVir,
+                        gmx_ekindata_t                *ekind,
+                        gmx_bool                       bCalcEkinh)
 {
     gmx_bool             bLastStep, bLog = FALSE, bEner = FALSE, bDoConstr = FALSE;
     tensor               vir_con;
@@ -1770,11 +1832,48 @@ void update_constraints(FILE                          *fplog,
             // cppcheck-suppress unreadVariable
             nth = gmx_omp_nthreads_get(emntUpdate);
 #endif
+            /* With leap-frog the constrained velocities are final here,
+             * so we accumulate the kinetic energy in this pass over the home
+             * atoms, instead of in a separate pass in calc_ke_part().
+             */
+            bool doEkinh = (bCalcEkinh && inputrec->eI == eiMD && bDoConstr &&
+                            !ekind->bNEMD && ekind->cosacc.cos_accel == 0);
+            if (doEkinh)
+            {
+                const rvec *v = as_rvec_array(state->v.data());
+
 #pragma omp parallel for num_threads(nth) schedule(static)
-            for (int i = 0; i < homenr; i++)
+                for (int th = 0; th < nth; th++)
+                {
+                    // This only loops over arrays, it does not throw
+                    int start_th, end_th;
+                    getThreadAtomRange(nth, th, homenr, &start_th, &end_th);
+
+                    matrix *ekinSum    = ekind->ekin_work[th];
+                    realA  *dekindlSum = ekind->dekindl_work[th];
+                    for (int g = 0; g < ekind->ngtc; g++)
+                    {
+                        clear_mat(ekinSum[g]);
+                    }
+                    *dekindlSum = 0;
+
+                    for (int i = start_th; i < end_th; i++)
+                    {
+                        copy_rvec(xp[i], state->x[i]);
+                    }
+                    accumulateEkinh(start_th, end_th, md, v,
+                                    ekinSum, dekindlSum);
+                }
+                ekind->bEkinhFromUpdate = TRUE;
+            }
+            else
             {
-                // Trivial statement, does not throw
-                copy_rvec(xp[i], state->x[i]);
+#pragma omp parallel for num_threads(nth) schedule(static)
+                for (int i = 0; i < homenr; i++)
+                {
+                    // Trivial statement, does not throw
+                    copy_rvec(xp[i], state->x[i]);
+                }
             }
         }
         wallcycle_stop(wcycle, ewcUPDATE);
@@ -1898,7 +1997,8 @@ void update_coords(FILE                          *fplog,
                    gmx_update_t                  *upd,
                    int                            UpdatePart,
                    t_commrec                     *cr, /* these shouldn't be here -- need to think about it */
-                   gmx_constr_t                   constr)
+                   gmx_constr_t                   constr,
+                   gmx_bool                       bCalcEkinh)
 {
     gmx_bool bDoConstr = (nullptr != constr);
 
@@ -1931,6 +2031,15 @@ void update_coords(FILE                          *fplog,
 
     int nth = gmx_omp_nthreads_get(emntUpdate);
 
+    /* Without constraints the leap-frog velocities are final after
+     * the update, so we can accumulate the kinetic energy while
+     * the velocities are still in cache, instead of streaming them
+     * through memory again in calc_ke_part().
+     */
+    bool doEkinh = (bCalcEkinh && inputrec->eI == eiMD && !bDoConstr &&
+                    !ekind->bNEMD && ekind->cosacc.cos_accel == 0);
+    ekind->bEkinhFromUpdate = doEkinh;
+
 #pragma omp parallel for num_threads(nth) schedule(static)
     for (int th = 0; th < nth; th++)
     {
@@ -1959,10 +2068,36 @@ void update_coords(FILE                          *fplog,
             switch (inputrec->eI)
             {
                 case (eiMD):
-                    do_update_md(start_th, end_th, step, dt,
-                                 inputrec, md, ekind, state->box,
-                                 x_rvec, xp_rvec, v_rvec, f_rvec,
-                                 state->nosehoover_vxi.data(), M);
+                    if (doEkinh)
+                    {
+                        matrix *ekinSum    = ekind->ekin_work[th];
+                        realA  *dekindlSum = ekind->dekindl_work[th];
+
+                        for (int g = 0; g < ekind->ngtc; g++)
+                        {
+                            clear_mat(ekinSum[g]);
+                        }
+                        *dekindlSum = 0;
+
+                        for (int a = start_th; a < end_th; a += c_updateEkinhBlockSize)
+                        {
+                            int aEnd = std::min(a + c_updateEkinhBlockSize, end_th);
+
+                            do_update_md(a, aEnd, step, dt,
+                                         inputrec, md, ekind, state->box,
+                                         x_rvec, xp_rvec, v_rvec, f_rvec,
+                                         state->nosehoover_vxi.data(), M);
+                            accumulateEkinh(a, aEnd, md, v_rvec,
+                                            ekinSum, dekindlSum);
+                        }
+                    }
+                    else
+                    {
+                        do_update_md(start_th, end_th, step, dt,
+                                     inputrec, md, ekind, state->box,
+                                     x_rvec, xp_rvec, v_rvec, f_rvec,
+                                     state->nosehoover_vxi.data(), M);
+                    }
                     break;
                 case (eiSD1):
                     /* With constraints, the SD1 update is done in 2 parts */
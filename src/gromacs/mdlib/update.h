@@ -126,7 +126,13 @@ void update_coords(FILE                          *fplog,
                    gmx_update_t                  *upd,
                    int                            bUpdatePart,
                    t_commrec                     *cr, /* these shouldn't be here -- need to think about it */
-                   gmx_constr                    *constr);
+                   gmx_constr                    *constr,
+                   gmx_bool                       bCalcEkinh);
+/* When bCalcEkinh is set, the leap-frog integrator without constraints
+ * accumulates the half step kinetic energy during the update,
+ * which is then used by the next call to calc_ke_part().
+ * With constraints this is done by update_constraints() instead.
+ */
 
 /* Return TRUE if OK, FALSE in case of Shake Error */
 
@@ -149,7 +155,14 @@ void update_constraints(FILE                    *fplog,
                         gmx_update_t            *upd,
                         gmx_constr              *constr,
                         gmx_bool                 bFirstHalf,
-                        gmx_bool                 bCalcVir);
+                        gmx_bool                 bCalcVir,
+                        gmx_ekindata_t          *ekind,
+                        gmx_bool                 bCalcEkinh);
+/* When bCalcEkinh is set, the leap-frog integrator with constraints
+ * accumulates the half step kinetic energy of the constrained velocities
+ * while copying back the coordinates, which is then used by the next
+ * call to calc_ke_part().
+ */
 
 /* Return TRUE if OK, FALSE in case of Shake Error */
 
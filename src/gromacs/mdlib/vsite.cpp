@@ -40,6 +40,8 @@
 
 #include <stdio.h>
 
+#include <cstdint>
+
 #include <algorithm>
 #include <vector>
 
@@ -54,6 +56,10 @@
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/exceptions.h"
@@ -455,6 +461,259 @@ static PbcMode getPbcMode(const t_pbc       *pbcPtr,
     }
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/*! \brief Returns whether we have SIMD kernels for vsite type \p ftype */
+static bool haveVsiteSimdKernel(int ftype)
+{
+    return (ftype == F_VSITE3 || ftype == F_VSITE3FD || ftype == F_VSITE3OUT);
+}
+
+/*! \brief Loads the atom indices and parameters of a SIMD-width pack of vsites
+ *
+ * All vsite types with SIMD kernels have three constructing atoms.
+ * Returns false when the vsite of one pack entry is a constructing atom
+ * of another entry in the pack, then the pack should be processed
+ * sequentially instead.
+ */
+static bool loadVsite3Pack(const t_iatom    *ia,
+                           const t_iparams   ip[],
+                           std::int32_t      av[],
+                           std::int32_t      ai[],
+                           std::int32_t      aj[],
+                           std::int32_t      ak[],
+                           realA             a[],
+                           realA             b[],
+                           realA             c[])
+{
+    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        int tp = ia[0];
+        av[s]  = ia[1];
+        ai[s]  = ia[2];
+        aj[s]  = ia[3];
+        ak[s]  = ia[4];
+        a[s]   = ip[tp].vsite.a;
+        b[s]   = ip[tp].vsite.b;
+        c[s]   = ip[tp].vsite.c;
+
+        ia    += 1 + NRAL(F_VSITE3);
+    }
+
+    bool haveDependency = false;
+    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (int t = 0; t < GMX_SIMD_REAL_WIDTH; t++)
+        {
+            haveDependency = haveDependency ||
+                (av[s] == ai[t] || av[s] == aj[t] || av[s] == ak[t]);
+        }
+    }
+
+    return !haveDependency;
+}
+
+/*! \brief Construct a single vsite of type \p ftype with the scalar code
+ *
+ * Used for SIMD packs with dependencies within the pack.
+ * Does the same as construct_vsites_thread() with PbcMode::all,
+ * or with PbcMode::none when \p pbc is nullptr.
+ */
+template<int ftype>
+static void constructVsite3Scalar(const t_iatom   *ia,
+                                  const t_iparams  ip[],
+                                  rvec             x[],
+                                  rvec            *v,
+                                  realA            inv_dt,
+                                  const t_pbc     *pbc)
+{
+    const int   tp     = ia[0];
+    const int   avsite = ia[1];
+    const int   ai     = ia[2];
+    const int   aj     = ia[3];
+    const int   ak     = ia[4];
+    const realA a1     = ip[tp].vsite.a;
+    const realA b1     = ip[tp].vsite.b;
+
+    rvec        xv;
+    copy_rvec(x[avsite], xv);
+
+    switch (ftype)
+    {
+        case F_VSITE3:
+            constr_vsite3(x[ai], x[aj], x[ak], x[avsite], a1, b1, pbc);
+            break;
+        case F_VSITE3FD:
+            constr_vsite3FD(x[ai], x[aj], x[ak], x[avsite], a1, b1, pbc);
+            break;
+        case F_VSITE3OUT:
+            constr_vsite3OUT(x[ai], x[aj], x[ak], x[avsite], a1, b1, ip[tp].vsite.c, pbc);
+            break;
+    }
+
+    if (pbc != nullptr)
+    {
+        /* Put the vsite in the periodic image closest to its old position */
+        rvec dx;
+        int  ishift = pbc_dx_aiuc(pbc, x[avsite], xv, dx);
+        if (ishift != CENTRAL)
+        {
+            rvec_add(xv, dx, x[avsite]);
+        }
+    }
+    if (v != nullptr)
+    {
+        rvec vv;
+        rvec_sub(x[avsite], xv, vv);
+        svmul(inv_dt, vv, v[avsite]);
+    }
+}
+
+/*! \brief Construct vsites of type \p ftype using SIMD
+ *
+ * Constructs complete SIMD-width packs of vsites from the start of
+ * the list and returns the number of iatoms entries processed.
+ * The remainder should be constructed with the scalar code.
+ * Packs with dependencies within the pack are constructed with
+ * the scalar code here.
+ * With PBC, the vsites are put in the periodic image closest to
+ * their old position, as done by the scalar code with PbcMode::all.
+ */
+template<int ftype>
+static int constructVsites3Simd(const t_iatom   *ia,
+                                int              nr,
+                                const t_iparams  ip[],
+                                rvec             x[],
+                                rvec            *v,
+                                realA            inv_dt,
+                                const t_pbc     *pbc)
+{
+    using gmx::SimdReal;
+
+    const int                                   inc = 1 + NRAL(ftype);
+
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    av[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ai[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    aj[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ak[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           a[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           b[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           c[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+
+    /* With pbc=nullptr, set_pbc_simd sets up no PBC */
+    set_pbc_simd(pbc, pbc_simd);
+
+    SimdReal   invDt(inv_dt);
+    realA     *xr = x[0];
+
+    int        i;
+    for (i = 0; i + GMX_SIMD_REAL_WIDTH*inc <= nr; i += GMX_SIMD_REAL_WIDTH*inc)
+    {
+        if (!loadVsite3Pack(ia + i, ip, av, ai, aj, ak, a, b, c))
+        {
+            for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                constructVsite3Scalar<ftype>(ia + i + s*inc, ip, x, v, inv_dt, pbc);
+            }
+            continue;
+        }
+
+        SimdReal xi[DIM], xj[DIM], xk[DIM], xv[DIM];
+        gmx::gatherLoadUTranspose<3>(xr, ai, &xi[XX], &xi[YY], &xi[ZZ]);
+        gmx::gatherLoadUTranspose<3>(xr, aj, &xj[XX], &xj[YY], &xj[ZZ]);
+        gmx::gatherLoadUTranspose<3>(xr, ak, &xk[XX], &xk[YY], &xk[ZZ]);
+        gmx::gatherLoadUTranspose<3>(xr, av, &xv[XX], &xv[YY], &xv[ZZ]);
+
+        SimdReal a_S = gmx::load<SimdReal>(a);
+        SimdReal b_S = gmx::load<SimdReal>(b);
+
+        /* For F_VSITE3FD the second vector is xjk, otherwise xik */
+        SimdReal xij[DIM], x2[DIM];
+        pbc_dx_aiuc(pbc_simd, xj, xi, xij);
+        pbc_dx_aiuc(pbc_simd, xk, (ftype == F_VSITE3FD ? xj : xi), x2);
+
+        SimdReal xNew[DIM];
+        if (ftype == F_VSITE3)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                xNew[d] = xi[d] + a_S*xij[d] + b_S*x2[d];
+            }
+        }
+        else if (ftype == F_VSITE3FD)
+        {
+            SimdReal temp[DIM];
+            for (int d = 0; d < DIM; d++)
+            {
+                temp[d] = xij[d] + a_S*x2[d];
+            }
+            SimdReal c_S = b_S*invsqrt(norm2(temp[XX], temp[YY], temp[ZZ]));
+            for (int d = 0; d < DIM; d++)
+            {
+                xNew[d] = xi[d] + c_S*temp[d];
+            }
+        }
+        else
+        {
+            SimdReal c_S = gmx::load<SimdReal>(c);
+            SimdReal temp[DIM];
+            cprod(xij[XX], xij[YY], xij[ZZ], x2[XX], x2[YY], x2[ZZ],
+                  &temp[XX], &temp[YY], &temp[ZZ]);
+            for (int d = 0; d < DIM; d++)
+            {
+                xNew[d] = xi[d] + a_S*xij[d] + b_S*x2[d] + c_S*temp[d];
+            }
+        }
+
+        /* Put the vsite in the periodic image closest to its old position */
+        SimdReal dxv[DIM];
+        pbc_dx_aiuc(pbc_simd, xNew, xv, dxv);
+        for (int d = 0; d < DIM; d++)
+        {
+            xNew[d] = xv[d] + dxv[d];
+        }
+        gmx::transposeScatterStoreU<3>(xr, av, xNew[XX], xNew[YY], xNew[ZZ]);
+
+        if (v != nullptr)
+        {
+            gmx::transposeScatterStoreU<3>(v[0], av,
+                                           dxv[XX]*invDt, dxv[YY]*invDt, dxv[ZZ]*invDt);
+        }
+    }
+
+    return i;
+}
+
+/*! \brief Construct the leading SIMD-width packs of the vsites of type \p ftype
+ *
+ * Returns the number of iatoms entries processed, which is zero
+ * when there is no SIMD kernel for \p ftype.
+ */
+static int constructVsitesSimd(int              ftype,
+                               const t_iatom   *ia,
+                               int              nr,
+                               const t_iparams  ip[],
+                               rvec             x[],
+                               rvec            *v,
+                               realA            inv_dt,
+                               const t_pbc     *pbc)
+{
+    switch (ftype)
+    {
+        case F_VSITE3:
+            return constructVsites3Simd<F_VSITE3>(ia, nr, ip, x, v, inv_dt, pbc);
+        case F_VSITE3FD:
+            return constructVsites3Simd<F_VSITE3FD>(ia, nr, ip, x, v, inv_dt, pbc);
+        case F_VSITE3OUT:
+            return constructVsites3Simd<F_VSITE3OUT>(ia, nr, ip, x, v, inv_dt, pbc);
+        default:
+            return 0;
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 static void construct_vsites_thread(const gmx_vsite_t *vsite,
                                     rvec x[],
                                     realA dt, rvec *v,
@@ -495,7 +754,17 @@ static void construct_vsites_thread(const gmx_vsite_t *vsite,
                 vsite_pbc = vsite->vsite_pbc_loc[ftype - c_ftypeVsiteStart];
             }
 
-            for (int i = 0; i < nr; )
+            int i = 0;
+#if GMX_SIMD_HAVE_REAL
+            /* With charge groups the PBC treatment differs per vsite */
+            if (haveVsiteSimdKernel(ftype) && pbcMode != PbcMode::chargeGroup)
+            {
+                i   = constructVsitesSimd(ftype, ia, nr, ip, x, v, inv_dt, pbc_null);
+                ia += i;
+            }
+#endif
+
+            while (i < nr)
             {
                 int  tp     = ia[0];
                 /* The vsite and constructing atoms */
@@ -1487,6 +1756,356 @@ static int vsite_count(const t_ilist *ilist, int ftype)
     }
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/*! \brief Adds the shift force contributions of a single vsite spread by SIMD
+ *
+ * This is only called for the, rare, vsites with the vsite or its
+ * constructing atoms in different periodic images. The distribution
+ * of the forces over the shift vectors can differ from that of the
+ * scalar spreading routines, but the resulting shift virial is the same.
+ * For F_VSITE3FD the shift of atom k is taken with respect to atom j.
+ */
+template<int ftype>
+static void addVsite3ShiftForces(int          av,
+                                 int          ai,
+                                 int          aj,
+                                 int          ak,
+                                 const rvec   x[],
+                                 const t_pbc *pbc,
+                                 const rvec   fv,
+                                 const rvec   fj,
+                                 const rvec   fk,
+                                 rvec         fshift[])
+{
+    rvec dx;
+    int  svi = pbc_dx_aiuc(pbc, x[av], x[ai], dx);
+    int  sji = pbc_dx_aiuc(pbc, x[aj], x[ai], dx);
+    int  sk  = pbc_dx_aiuc(pbc, x[ak], ftype == F_VSITE3FD ? x[aj] : x[ai], dx);
+
+    if (svi == CENTRAL && sji == CENTRAL && sk == CENTRAL)
+    {
+        return;
+    }
+
+    rvec fi;
+    rvec_sub(fv, fj, fi);
+    rvec_dec(fi, fk);
+
+    rvec_dec(fshift[svi], fv);
+    if (ftype == F_VSITE3FD)
+    {
+        rvec_inc(fshift[CENTRAL], fi);
+        rvec_dec(fshift[CENTRAL], fk);
+        rvec_inc(fshift[sji], fj);
+        rvec_inc(fshift[sji], fk);
+    }
+    else
+    {
+        rvec_inc(fshift[CENTRAL], fi);
+        rvec_inc(fshift[sji], fj);
+    }
+    rvec_inc(fshift[sk], fk);
+}
+
+/*! \brief Spread the force of a single vsite of type \p ftype with the scalar code
+ *
+ * Used for SIMD packs with dependencies within the pack.
+ */
+template<int ftype>
+static void spreadVsite3Scalar(const t_iatom   *ia,
+                               const t_iparams  ip[],
+                               const rvec       x[],
+                               rvec             f[],
+                               rvec            *fshift,
+                               gmx_bool         VirCorr,
+                               matrix           dxdf,
+                               const t_pbc     *pbc)
+{
+    const int   tp = ia[0];
+    const realA a1 = ip[tp].vsite.a;
+    const realA b1 = ip[tp].vsite.b;
+
+    switch (ftype)
+    {
+        case F_VSITE3:
+            spread_vsite3(ia, a1, b1, x, f, fshift, pbc, nullptr);
+            break;
+        case F_VSITE3FD:
+            spread_vsite3FD(ia, a1, b1, x, f, fshift, VirCorr, dxdf, pbc, nullptr);
+            break;
+        case F_VSITE3OUT:
+            spread_vsite3OUT(ia, a1, b1, ip[tp].vsite.c, x, f, fshift, VirCorr, dxdf, pbc, nullptr);
+            break;
+    }
+    clear_rvec(f[ia[1]]);
+}
+
+/*! \brief Spread the forces of vsites of type \p ftype using SIMD
+ *
+ * Spreads complete SIMD-width packs of vsites from the start of
+ * the list and returns the number of iatoms entries processed.
+ * The remainder should be spread with the scalar code.
+ * Packs with dependencies within the pack are spread with
+ * the scalar code here.
+ * Should not be called with both \p fshift and a graph.
+ */
+template<int ftype>
+static int spreadVsites3Simd(const t_iatom   *ia,
+                             int              nr,
+                             const t_iparams  ip[],
+                             const rvec       x[],
+                             rvec             f[],
+                             rvec            *fshift,
+                             gmx_bool         VirCorr,
+                             matrix           dxdf,
+                             const t_pbc     *pbc)
+{
+    using gmx::SimdReal;
+    using gmx::SimdBool;
+
+    const int                                   inc = 1 + NRAL(ftype);
+
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    av[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ai[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    aj[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t    ak[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           a[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           b[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           c[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           shifted[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           fvBuf[DIM*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           fjBuf[DIM*GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) realA           fkBuf[DIM*GMX_SIMD_REAL_WIDTH];
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* Only the non-linear constructions need a virial correction */
+    const bool  doVirCorr   = (VirCorr && ftype != F_VSITE3);
+    /* Without PBC all shifts are CENTRAL */
+    const bool  doShift     = (fshift != nullptr && pbc != nullptr);
+
+    const realA *xr         = x[0];
+    realA       *fr         = f[0];
+    SimdReal     zero_S     = gmx::setZero();
+
+    SimdReal     dxdf_S[DIM][DIM];
+    for (int d1 = 0; d1 < DIM; d1++)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            dxdf_S[d1][d2] = zero_S;
+        }
+    }
+
+    int i;
+    for (i = 0; i + GMX_SIMD_REAL_WIDTH*inc <= nr; i += GMX_SIMD_REAL_WIDTH*inc)
+    {
+        if (!loadVsite3Pack(ia + i, ip, av, ai, aj, ak, a, b, c))
+        {
+            for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                spreadVsite3Scalar<ftype>(ia + i + s*inc, ip, x, f, fshift, VirCorr, dxdf, pbc);
+            }
+            continue;
+        }
+
+        SimdReal xi[DIM], xj[DIM], xk[DIM], fv[DIM];
+        gmx::gatherLoadUTranspose<3>(xr, ai, &xi[XX], &xi[YY], &xi[ZZ]);
+        gmx::gatherLoadUTranspose<3>(xr, aj, &xj[XX], &xj[YY], &xj[ZZ]);
+        gmx::gatherLoadUTranspose<3>(xr, ak, &xk[XX], &xk[YY], &xk[ZZ]);
+        gmx::gatherLoadUTranspose<3>(fr, av, &fv[XX], &fv[YY], &fv[ZZ]);
+
+        SimdReal a_S = gmx::load<SimdReal>(a);
+        SimdReal b_S = gmx::load<SimdReal>(b);
+
+        /* For F_VSITE3FD the second vector is xjk, otherwise xik */
+        SimdReal xij[DIM], x2[DIM];
+        pbc_dx_aiuc(pbc_simd, xj, xi, xij);
+        pbc_dx_aiuc(pbc_simd, xk, (ftype == F_VSITE3FD ? xj : xi), x2);
+
+        /* The forces on aj and ak, the force on ai is fv - fj - fk */
+        SimdReal fj[DIM], fk[DIM];
+        /* Only used with F_VSITE3FD */
+        SimdReal xix[DIM], temp[DIM];
+        if (ftype == F_VSITE3)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                fj[d] = a_S*fv[d];
+                fk[d] = b_S*fv[d];
+            }
+        }
+        else if (ftype == F_VSITE3FD)
+        {
+            /* xix goes from i to point x on the line jk */
+            for (int d = 0; d < DIM; d++)
+            {
+                xix[d] = xij[d] + a_S*x2[d];
+            }
+            SimdReal invl2 = invsqrt(norm2(xix[XX], xix[YY], xix[ZZ]));
+            SimdReal c_S   = b_S*invl2;
+            invl2          = invl2*invl2;
+            SimdReal fproj = iprod(xix[XX], xix[YY], xix[ZZ], fv[XX], fv[YY], fv[ZZ])*invl2;
+            SimdReal a1    = SimdReal(1) - a_S;
+            for (int d = 0; d < DIM; d++)
+            {
+                temp[d] = c_S*(fv[d] - fproj*xix[d]);
+                fj[d]   = a1*temp[d];
+                fk[d]   = a_S*temp[d];
+            }
+        }
+        else
+        {
+            SimdReal c_S = gmx::load<SimdReal>(c);
+            SimdReal cfx = c_S*fv[XX];
+            SimdReal cfy = c_S*fv[YY];
+            SimdReal cfz = c_S*fv[ZZ];
+
+            fj[XX] = a_S*fv[XX] - x2[ZZ]*cfy + x2[YY]*cfz;
+            fj[YY] = x2[ZZ]*cfx + a_S*fv[YY] - x2[XX]*cfz;
+            fj[ZZ] = x2[XX]*cfy - x2[YY]*cfx + a_S*fv[ZZ];
+
+            fk[XX] = b_S*fv[XX] + xij[ZZ]*cfy - xij[YY]*cfz;
+            fk[YY] = xij[XX]*cfz - xij[ZZ]*cfx + b_S*fv[YY];
+            fk[ZZ] = xij[YY]*cfx - xij[XX]*cfy + b_S*fv[ZZ];
+        }
+
+        gmx::transposeScatterIncrU<3>(fr, ai,
+                                      fv[XX] - fj[XX] - fk[XX],
+                                      fv[YY] - fj[YY] - fk[YY],
+                                      fv[ZZ] - fj[ZZ] - fk[ZZ]);
+        gmx::transposeScatterIncrU<3>(fr, aj, fj[XX], fj[YY], fj[ZZ]);
+        gmx::transposeScatterIncrU<3>(fr, ak, fk[XX], fk[YY], fk[ZZ]);
+        gmx::transposeScatterStoreU<3>(fr, av, zero_S, zero_S, zero_S);
+
+        if (doVirCorr || doShift)
+        {
+            SimdReal xv[DIM], xiv[DIM];
+            gmx::gatherLoadUTranspose<3>(xr, av, &xv[XX], &xv[YY], &xv[ZZ]);
+            pbc_dx_aiuc(pbc_simd, xv, xi, xiv);
+
+            if (doVirCorr)
+            {
+                /* See spread_vsite3FD for the reference position */
+                for (int d1 = 0; d1 < DIM; d1++)
+                {
+                    for (int d2 = 0; d2 < DIM; d2++)
+                    {
+                        if (ftype == F_VSITE3FD)
+                        {
+                            dxdf_S[d1][d2] = dxdf_S[d1][d2] - xiv[d1]*fv[d2] + xix[d1]*temp[d2];
+                        }
+                        else
+                        {
+                            dxdf_S[d1][d2] = dxdf_S[d1][d2] - xiv[d1]*fv[d2] + xij[d1]*fj[d2] + x2[d1]*fk[d2];
+                        }
+                    }
+                }
+            }
+
+            if (doShift)
+            {
+                /* A PBC correction was applied when the corrected distance
+                 * differs from the plain difference.
+                 */
+                SimdBool isShifted = (xiv[XX] != xv[XX] - xi[XX] ||
+                                      xiv[YY] != xv[YY] - xi[YY] ||
+                                      xiv[ZZ] != xv[ZZ] - xi[ZZ] ||
+                                      xij[XX] != xj[XX] - xi[XX] ||
+                                      xij[YY] != xj[YY] - xi[YY] ||
+                                      xij[ZZ] != xj[ZZ] - xi[ZZ]);
+                if (ftype == F_VSITE3FD)
+                {
+                    isShifted = (isShifted ||
+                                 x2[XX] != xk[XX] - xj[XX] ||
+                                 x2[YY] != xk[YY] - xj[YY] ||
+                                 x2[ZZ] != xk[ZZ] - xj[ZZ]);
+                }
+                else
+                {
+                    isShifted = (isShifted ||
+                                 x2[XX] != xk[XX] - xi[XX] ||
+                                 x2[YY] != xk[YY] - xi[YY] ||
+                                 x2[ZZ] != xk[ZZ] - xi[ZZ]);
+                }
+
+                if (anyTrue(isShifted))
+                {
+                    store(shifted, selectByMask(SimdReal(1), isShifted));
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        store(fvBuf + d*GMX_SIMD_REAL_WIDTH, fv[d]);
+                        store(fjBuf + d*GMX_SIMD_REAL_WIDTH, fj[d]);
+                        store(fkBuf + d*GMX_SIMD_REAL_WIDTH, fk[d]);
+                    }
+                    for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+                    {
+                        if (shifted[s] != 0)
+                        {
+                            rvec fvs, fjs, fks;
+                            for (int d = 0; d < DIM; d++)
+                            {
+                                fvs[d] = fvBuf[d*GMX_SIMD_REAL_WIDTH + s];
+                                fjs[d] = fjBuf[d*GMX_SIMD_REAL_WIDTH + s];
+                                fks[d] = fkBuf[d*GMX_SIMD_REAL_WIDTH + s];
+                            }
+                            addVsite3ShiftForces<ftype>(av[s], ai[s], aj[s], ak[s],
+                                                        x, pbc, fvs, fjs, fks,
+                                                        fshift);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (doVirCorr)
+    {
+        for (int d1 = 0; d1 < DIM; d1++)
+        {
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                dxdf[d1][d2] += reduce(dxdf_S[d1][d2]);
+            }
+        }
+    }
+
+    return i;
+}
+
+/*! \brief Spread the forces of the leading SIMD-width packs of vsites of type \p ftype
+ *
+ * Returns the number of iatoms entries processed, which is zero
+ * when there is no SIMD kernel for \p ftype.
+ */
+static int spreadVsitesSimd(int              ftype,
+                            const t_iatom   *ia,
+                            int              nr,
+                            const t_iparams  ip[],
+                            const rvec       x[],
+                            rvec             f[],
+                            rvec            *fshift,
+                            gmx_bool         VirCorr,
+                            matrix           dxdf,
+                            const t_pbc     *pbc)
+{
+    switch (ftype)
+    {
+        case F_VSITE3:
+            return spreadVsites3Simd<F_VSITE3>(ia, nr, ip, x, f, fshift, VirCorr, dxdf, pbc);
+        case F_VSITE3FD:
+            return spreadVsites3Simd<F_VSITE3FD>(ia, nr, ip, x, f, fshift, VirCorr, dxdf, pbc);
+        case F_VSITE3OUT:
+            return spreadVsites3Simd<F_VSITE3OUT>(ia, nr, ip, x, f, fshift, VirCorr, dxdf, pbc);
+        default:
+            return 0;
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 static void spread_vsite_f_thread(const gmx_vsite_t *vsite,
                                   const rvec x[],
                                   rvec f[], rvec *fshift,
@@ -1524,7 +2143,18 @@ static void spread_vsite_f_thread(const gmx_vsite_t *vsite,
                 vsite_pbc = vsite->vsite_pbc_loc[ftype - c_ftypeVsiteStart];
             }
 
-            for (int i = 0; i < nr; )
+            int i = 0;
+#if GMX_SIMD_HAVE_REAL
+            /* The SIMD kernels only determine shifts using PBC, not a graph */
+            if (haveVsiteSimdKernel(ftype) && pbcMode != PbcMode::chargeGroup &&
+                (fshift == nullptr || g == nullptr))
+            {
+                i   = spreadVsitesSimd(ftype, ia, nr, ip, x, f, fshift, VirCorr, dxdf, pbc_null);
+                ia += i;
+            }
+#endif
+
+            while (i < nr)
             {
                 if (vsite_pbc != nullptr)
                 {
@@ -81,6 +81,9 @@ typedef struct gmx_ekindata_t {
     realA             dekindl;         /* dEkin/dlambda at half step           */
     realA             dekindl_old;     /* dEkin/dlambda at old half step       */
     t_cos_acc        cosacc;          /* Cosine acceleration data             */
+    gmx_bool         bEkinhFromUpdate; /* ekin_work and dekindl_work contain the
+                                        * half step kinetic energy accumulated
+                                        * during the leap-frog update          */
 } gmx_ekindata_t;
 
 #define GID(igid, jgid, gnr) ((igid < jgid) ? (igid*gnr+jgid) : (jgid*gnr+igid))
@@ -1809,6 +1809,10 @@ static void make_local_pull_group(gmx_ga2la_t *ga2la,
                 {
                     srenew(pg->weight_loc, pg->nalloc_loc);
                 }
+                if (pg->epgrppbc == epgrppbcCOS)
+                {
+                    srenew(pg->sin_loc, pg->nalloc_loc);
+                }
             }
             pg->ind_loc[pg->nat_loc] = ii;
             if (pg->params.weight != nullptr)
@@ -1971,6 +1975,7 @@ static void init_pull_group_index(FILE *fplog, t_commrec *cr,
         pg->nalloc_loc = 0;
         pg->ind_loc    = nullptr;
         pg->weight_loc = nullptr;
+        pg->sin_loc    = nullptr;
     }
     else
     {
@@ -1979,6 +1984,7 @@ static void init_pull_group_index(FILE *fplog, t_commrec *cr,
         if (pg->epgrppbc == epgrppbcCOS)
         {
             snew(pg->weight_loc, pg->params.nat);
+            snew(pg->sin_loc, pg->params.nat);
         }
         else
         {
@@ -2588,6 +2594,7 @@ static void destroy_pull_group(pull_group_work_t *pgrp)
     {
         sfree(pgrp->weight_loc);
     }
+    sfree(pgrp->sin_loc);
     sfree(pgrp->mdw);
     sfree(pgrp->dv);
 
@@ -84,6 +84,7 @@ typedef struct
     int           nalloc_loc; /* Allocation size for ind_loc and weight_loc */
     int          *ind_loc;    /* Local pull indices */
     realA         *weight_loc; /* Weights for the local indices */
+    realA         *sin_loc;    /* With cosine weighting: sin(2 pi x/box) along cosdim of the local atoms */
 
     realA          mwscale;    /* mass*weight scaling factor 1/sum w m */
     realA          wscale;     /* scaling factor for the weights: sum w m/sum w w m */
@@ -137,6 +138,12 @@ struct pull_sum_com_t {
     double sum_cmp;   /* Sum of cos(xp)*sin(xp)*mass */
     double sum_smp;   /* Sum of sin(xp)*sin(xp)*mass */
 
+    /* For cylinder groups, also uses sum_wm and sum_wwm */
+    double sum_a;     /* Sum of weight*mass*(axial distance)        */
+    dvec   radf_fac0; /* Sum of mass*gradient(weight)               */
+    dvec   radf_fac1; /* Sum of mass*gradient(weight)*(axial dist.) */
+    int    nat_loc;   /* The number of atoms within the cylinder    */
+
     /* Dummy data to ensure adjacent elements in an array are separated
      * by a cache line size, max 128 bytes.
      * TODO: Replace this by some automated mechanism.
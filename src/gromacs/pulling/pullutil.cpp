@@ -193,16 +193,100 @@ static void pull_set_pbcatoms(t_commrec *cr, struct pull_t *pull,
     }
 }
 
+/* Sums the cylinder weights and COM contributions for the local atoms
+ * of the reference group pref with local indices ind_start to ind_end.
+ * The atoms within the cylinder are stored in pdyna, starting at
+ * index ind_start. The sums and the number of atoms stored are
+ * returned in sum_com.
+ */
+static void sum_cyl_part(const pull_group_work_t *pref,
+                         int ind_start, int ind_end,
+                         const rvec *x, const realA *mass,
+                         const t_pbc *pbc,
+                         const rvec g_x, const rvec dir,
+                         double inv_cyl_r2,
+                         pull_group_work_t *pdyna,
+                         pull_sum_com_t *sum_com)
+{
+    double sum_a     = 0;
+    double wmass     = 0;
+    double wwmass    = 0;
+    dvec   radf_fac0 = { 0, 0, 0 };
+    dvec   radf_fac1 = { 0, 0, 0 };
+    int    nat       = ind_start;
+
+    for (int i = ind_start; i < ind_end; i++)
+    {
+        int    ii = pref->ind_loc[i];
+        double dr2, dr2_rel, inp;
+        dvec   dr;
+        rvec   dx;
+
+        pbc_dx_aiuc(pbc, x[ii], g_x, dx);
+        inp = iprod(dir, dx);
+        dr2 = 0;
+        for (int m = 0; m < DIM; m++)
+        {
+            /* Determine the radial components */
+            dr[m] = dx[m] - inp*dir[m];
+            dr2  += dr[m]*dr[m];
+        }
+        dr2_rel = dr2*inv_cyl_r2;
+
+        if (dr2_rel < 1)
+        {
+            double m_ii, weight, dweight_r;
+            dvec   mdw;
+
+            /* add to index, to sum of COM, to weight array */
+            pdyna->ind_loc[nat] = ii;
+
+            m_ii      = mass[ii];
+            /* The radial weight function is 1-2x^2+x^4,
+             * where x=r/cylinder_r. Since this function depends
+             * on the radial component, we also get radial forces
+             * on both groups.
+             */
+            weight    = 1 + (-2 + dr2_rel)*dr2_rel;
+            dweight_r = (-4 + 4*dr2_rel)*inv_cyl_r2;
+            pdyna->weight_loc[nat] = weight;
+            sum_a    += m_ii*weight*inp;
+            wmass    += m_ii*weight;
+            wwmass   += m_ii*weight*weight;
+            dsvmul(m_ii*dweight_r, dr, mdw);
+            copy_dvec(mdw, pdyna->mdw[nat]);
+            /* Currently we only have the axial component of the
+             * distance (inp) up to an unkown offset. We add this
+             * offset after the reduction needs to determine the
+             * COM of the cylinder group.
+             */
+            pdyna->dv[nat] = inp;
+            for (int m = 0; m < DIM; m++)
+            {
+                radf_fac0[m] += mdw[m];
+                radf_fac1[m] += mdw[m]*inp;
+            }
+            nat++;
+        }
+    }
+
+    sum_com->sum_wm  = wmass;
+    sum_com->sum_wwm = wwmass;
+    sum_com->sum_a   = sum_a;
+    copy_dvec(radf_fac0, sum_com->radf_fac0);
+    copy_dvec(radf_fac1, sum_com->radf_fac1);
+    sum_com->nat_loc = nat - ind_start;
+}
+
 static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
                              t_pbc *pbc, double t, rvec *x)
 {
     /* The size and stride per coord for the reduction buffer */
     const int       stride = 9;
-    int             c, i, ii, m, start, end;
-    rvec            g_x, dx, dir;
+    int             c, m;
+    rvec            g_x, dir;
     double          inv_cyl_r2;
     pull_comm_t    *comm;
-    gmx_ga2la_t    *ga2la = nullptr;
 
     comm = &pull->comm;
 
@@ -211,14 +295,6 @@ static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
         snew(comm->dbuf_cyl, pull->ncoord*stride);
     }
 
-    if (cr && DOMAINDECOMP(cr))
-    {
-        ga2la = cr->dd->ga2la;
-    }
-
-    start = 0;
-    end   = md->homenr;
-
     inv_cyl_r2 = 1.0/gmx::square(pull->params.cylinder_r);
 
     /* loop over all groups to make a reference group for each*/
@@ -245,7 +321,6 @@ static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
             pgrp  = &pull->group[pcrd->params.group[1]];
             pdyna = &pull->dyna[c];
             copy_dvec_to_rvec(pcrd->vec, dir);
-            pdyna->nat_loc = 0;
 
             /* We calculate distances with respect to the reference location
              * of this cylinder group (g_x), which we already have now since
@@ -262,77 +337,58 @@ static void make_cyl_refgrps(t_commrec *cr, struct pull_t *pull, t_mdatoms *md,
                 g_x[m] = pgrp->x[m] - pcrd->vec[m]*pcrd->value_ref;
             }
 
-            /* loop over all atoms in the main ref group */
-            for (i = 0; i < pref->params.nat; i++)
+            /* The atoms of the dynamic group are a subset of the local atoms
+             * of the reference group, so we can allocate all storage here.
+             */
+            if (pref->nat_loc > pdyna->nalloc_loc)
             {
-                ii = pref->params.ind[i];
-                if (ga2la)
-                {
-                    if (!ga2la_get_home(ga2la, pref->params.ind[i], &ii))
-                    {
-                        ii = -1;
-                    }
-                }
-                if (ii >= start && ii < end)
-                {
-                    double dr2, dr2_rel, inp;
-                    dvec   dr;
+                pdyna->nalloc_loc = over_alloc_large(pref->nat_loc);
+                srenew(pdyna->ind_loc,    pdyna->nalloc_loc);
+                srenew(pdyna->weight_loc, pdyna->nalloc_loc);
+                srenew(pdyna->mdw,        pdyna->nalloc_loc);
+                srenew(pdyna->dv,         pdyna->nalloc_loc);
+            }
 
-                    pbc_dx_aiuc(pbc, x[ii], g_x, dx);
-                    inp = iprod(dir, dx);
-                    dr2 = 0;
-                    for (m = 0; m < DIM; m++)
-                    {
-                        /* Determine the radial components */
-                        dr[m] = dx[m] - inp*dir[m];
-                        dr2  += dr[m]*dr[m];
-                    }
-                    dr2_rel = dr2*inv_cyl_r2;
+            /* Loop over the local atoms in the main ref group */
+            int nthreads = (pref->nat_loc <= c_pullMaxNumLocalAtomsSingleThreaded ? 1 : pull->nthreads);
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+            for (int th = 0; th < nthreads; th++)
+            {
+                int ind_start = (pref->nat_loc*(th + 0))/nthreads;
+                int ind_end   = (pref->nat_loc*(th + 1))/nthreads;
+                sum_cyl_part(pref, ind_start, ind_end,
+                             x, md->massT, pbc, g_x, dir, inv_cyl_r2,
+                             pdyna, &pull->sum_com[th]);
+            }
 
-                    if (dr2_rel < 1)
-                    {
-                        double mass, weight, dweight_r;
-                        dvec   mdw;
+            /* Reduce the thread contributions and compact the atom data
+             * that the threads stored starting at their first atom index.
+             */
+            pdyna->nat_loc = 0;
+            for (int th = 0; th < nthreads; th++)
+            {
+                const pull_sum_com_t *sum_com   = &pull->sum_com[th];
+                int                   ind_start = (pref->nat_loc*th)/nthreads;
 
-                        /* add to index, to sum of COM, to weight array */
-                        if (pdyna->nat_loc >= pdyna->nalloc_loc)
-                        {
-                            pdyna->nalloc_loc = over_alloc_large(pdyna->nat_loc+1);
-                            srenew(pdyna->ind_loc,    pdyna->nalloc_loc);
-                            srenew(pdyna->weight_loc, pdyna->nalloc_loc);
-                            srenew(pdyna->mdw,        pdyna->nalloc_loc);
-                            srenew(pdyna->dv,         pdyna->nalloc_loc);
-                        }
-                        pdyna->ind_loc[pdyna->nat_loc] = ii;
-
-                        mass      = md->massT[ii];
-                        /* The radial weight function is 1-2x^2+x^4,
-                         * where x=r/cylinder_r. Since this function depends
-                         * on the radial component, we also get radial forces
-                         * on both groups.
-                         */
-                        weight    = 1 + (-2 + dr2_rel)*dr2_rel;
-                        dweight_r = (-4 + 4*dr2_rel)*inv_cyl_r2;
-                        pdyna->weight_loc[pdyna->nat_loc] = weight;
-                        sum_a    += mass*weight*inp;
-                        wmass    += mass*weight;
-                        wwmass   += mass*weight*weight;
-                        dsvmul(mass*dweight_r, dr, mdw);
-                        copy_dvec(mdw, pdyna->mdw[pdyna->nat_loc]);
-                        /* Currently we only have the axial component of the
-                         * distance (inp) up to an unkown offset. We add this
-                         * offset after the reduction needs to determine the
-                         * COM of the cylinder group.
-                         */
-                        pdyna->dv[pdyna->nat_loc] = inp;
-                        for (m = 0; m < DIM; m++)
-                        {
-                            radf_fac0[m] += mdw[m];
-                            radf_fac1[m] += mdw[m]*inp;
-                        }
-                        pdyna->nat_loc++;
+                wmass  += sum_com->sum_wm;
+                wwmass += sum_com->sum_wwm;
+                sum_a  += sum_com->sum_a;
+                dvec_inc(radf_fac0, sum_com->radf_fac0);
+                dvec_inc(radf_fac1, sum_com->radf_fac1);
+
+                if (ind_start > pdyna->nat_loc)
+                {
+                    for (int i = 0; i < sum_com->nat_loc; i++)
+                    {
+                        int i_src = ind_start + i;
+                        int i_dst = pdyna->nat_loc + i;
+                        pdyna->ind_loc[i_dst]    = pdyna->ind_loc[i_src];
+                        pdyna->weight_loc[i_dst] = pdyna->weight_loc[i_src];
+                        copy_dvec(pdyna->mdw[i_src], pdyna->mdw[i_dst]);
+                        pdyna->dv[i_dst]         = pdyna->dv[i_src];
                     }
                 }
+                pdyna->nat_loc += sum_com->nat_loc;
             }
         }
         comm->dbuf_cyl[c*stride+0] = wmass;
@@ -501,7 +557,7 @@ static void sum_com_part(const pull_group_work_t *pgrp,
     }
 }
 
-static void sum_com_part_cosweight(const pull_group_work_t *pgrp,
+static void sum_com_part_cosweight(pull_group_work_t *pgrp,
                                    int ind_start, int ind_end,
                                    int cosdim, realA twopi_box,
                                    const rvec *x, const rvec *xp,
@@ -524,6 +580,9 @@ static void sum_com_part_cosweight(const pull_group_work_t *pgrp,
         /* Determine cos and sin sums */
         realA cw  = std::cos(x[ii][cosdim]*twopi_box);
         realA sw  = std::sin(x[ii][cosdim]*twopi_box);
+        /* Store cos and sin for setting the local weights after reduction */
+        pgrp->weight_loc[i] = cw;
+        pgrp->sin_loc[i]    = sw;
         sum_cm  += static_cast<double>(cw*m);
         sum_sm  += static_cast<double>(sw*m);
         sum_ccm += static_cast<double>(cw*cw*m);
@@ -774,7 +833,6 @@ void pull_calc_coms(t_commrec *cr,
             {
                 /* Cosine weighting geometry */
                 double csw, snw, wmass, wwmass;
-                int    i, ii;
 
                 /* Determine the optimal location of the cosine weight */
                 csw                   = comm->dbuf[g*3][0];
@@ -789,14 +847,15 @@ void pull_calc_coms(t_commrec *cr,
                 pgrp->mwscale = 1.0/wmass;
                 pgrp->wscale  = wmass/wwmass;
                 pgrp->invtm   = wwmass/(wmass*wmass);
-                /* Set the weights for the local atoms */
+                /* Set the weights for the local atoms,
+                 * using the cos and sin values stored in weight_loc and sin_loc
+                 */
                 csw *= pgrp->invtm;
                 snw *= pgrp->invtm;
-                for (i = 0; i < pgrp->nat_loc; i++)
+#pragma omp parallel for num_threads(pull->nthreads) schedule(static)
+                for (int i = 0; i < pgrp->nat_loc; i++)
                 {
-                    ii                  = pgrp->ind_loc[i];
-                    pgrp->weight_loc[i] = csw*cos(twopi_box*x[ii][pull->cosdim]) +
-                        snw*sin(twopi_box*x[ii][pull->cosdim]);
+                    pgrp->weight_loc[i] = csw*pgrp->weight_loc[i] + snw*pgrp->sin_loc[i];
                 }
                 if (xp)
                 {
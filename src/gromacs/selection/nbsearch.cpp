@@ -76,6 +76,12 @@ namespace gmx
 namespace
 {
 
+/*! \brief
+ * Number of reference positions in a grid cell for which distances are
+ * computed in one batch.
+ */
+const int c_distanceBatchSize = 16;
+
 /*! \brief
  * Computes the bounding box for a set of positions.
  *
@@ -121,7 +127,6 @@ class AnalysisNeighborhoodSearchImpl
         typedef AnalysisNeighborhoodPairSearch::ImplPointer
             PairSearchImplPointer;
         typedef std::vector<PairSearchImplPointer> PairSearchList;
-        typedef std::vector<std::vector<int> > CellList;
 
         explicit AnalysisNeighborhoodSearchImpl(realA cutoff);
         ~AnalysisNeighborhoodSearchImpl();
@@ -204,8 +209,34 @@ class AnalysisNeighborhoodSearchImpl
          *
          * \p cell should satisfy the conditions that \p mapPointToGridCell()
          * produces.
+         * sortGridCells() should be called after all positions have been
+         * added.
          */
         void addToGridCell(const rvec cell, int i);
+        /*! \brief
+         * Sorts the reference positions by grid cell.
+         *
+         * Fills \p cellStart_, \p cellRefIndices_ and \p cellRefX_ from the
+         * cells assigned with addToGridCell().  Within each cell, the
+         * positions remain in ascending index order.
+         */
+        void sortGridCells();
+        /*! \brief
+         * Computes distances from a point to a batch of positions in a cell.
+         *
+         * \param[in]  xtest  Point to compute the distances from.
+         * \param[in]  shift  Shift to subtract from the distance vectors.
+         * \param[in]  start  First index into the sorted reference positions.
+         * \param[in]  count  Number of positions (at most
+         *     \ref c_distanceBatchSize).
+         * \param[out] r2     Squared distances (XY only if \p bXY_ is set).
+         *
+         * The loop is written over contiguous coordinate arrays so that the
+         * compiler can vectorize it.  The distances are computed exactly as
+         * for individual pairs.
+         */
+        void computeCellDistances(const rvec xtest, const rvec shift,
+                                  int start, int count, realA r2[]) const;
         /*! \brief
          * Initializes a cell pair loop for a dimension.
          *
@@ -317,8 +348,19 @@ class AnalysisNeighborhoodSearchImpl
         realA                    cellShiftYX_;
         //! Number of cells along each dimension.
         ivec                    ncelldim_;
-        //! Data structure to hold the grid cell contents.
-        CellList                cells_;
+        //! Grid cell index of each reference position.
+        std::vector<int>        refCellIndex_;
+        /*! \brief
+         * Start of each grid cell in the sorted reference position arrays.
+         *
+         * Has one more element than there are cells; the last element is the
+         * number of reference positions.
+         */
+        std::vector<int>        cellStart_;
+        //! Reference position indices sorted by grid cell.
+        std::vector<int>        cellRefIndices_;
+        //! In-unit-cell reference coordinates sorted by grid cell, for each dimension.
+        std::vector<realA>       cellRefX_[DIM];
 
         Mutex                   createPairSearchMutex_;
         PairSearchList          pairSearchList_;
@@ -404,6 +446,12 @@ class AnalysisNeighborhoodPairSearchImpl
         ivec                                    cellBound_;
         //! Stores the index within the current cell during pair loops.
         int                                     prevcai_;
+        //! Index within the current cell of the first distance in batchR2_.
+        int                                     batchStart_;
+        //! Number of valid distances in batchR2_ (zero if none).
+        int                                     batchCount_;
+        //! Distances computed for the current batch in the current cell.
+        realA                                   batchR2_[c_distanceBatchSize];
 
         GMX_DISALLOW_COPY_AND_ASSIGN(AnalysisNeighborhoodPairSearchImpl);
 };
@@ -543,17 +591,8 @@ bool AnalysisNeighborhoodSearchImpl::initGridCells(
     {
         return false;
     }
-    // Never decrease the size of the cell vector to avoid reallocating
-    // memory for the nested vectors.  The actual size of the vector is not
-    // used outside this function.
-    if (cells_.size() < static_cast<size_t>(totalCellCount))
-    {
-        cells_.resize(totalCellCount);
-    }
-    for (int ci = 0; ci < totalCellCount; ++ci)
-    {
-        cells_[ci].clear();
-    }
+    cellStart_.assign(totalCellCount + 1, 0);
+    refCellIndex_.resize(posCount);
     return true;
 }
 
@@ -725,7 +764,66 @@ int AnalysisNeighborhoodSearchImpl::getGridCellIndex(const rvec cell) const
 void AnalysisNeighborhoodSearchImpl::addToGridCell(const rvec cell, int i)
 {
     const int ci = getGridCellIndex(cell);
-    cells_[ci].push_back(i);
+    refCellIndex_[i] = ci;
+    ++cellStart_[ci + 1];
+}
+
+void AnalysisNeighborhoodSearchImpl::sortGridCells()
+{
+    const int cellCount = static_cast<int>(cellStart_.size()) - 1;
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        cellStart_[ci + 1] += cellStart_[ci];
+    }
+    cellRefIndices_.resize(nref_);
+    for (int dd = 0; dd < DIM; ++dd)
+    {
+        cellRefX_[dd].resize(nref_);
+    }
+    // Use the start indices as insertion points, and shift them back after.
+    for (int i = 0; i < nref_; ++i)
+    {
+        const int k = cellStart_[refCellIndex_[i]]++;
+        cellRefIndices_[k] = i;
+        for (int dd = 0; dd < DIM; ++dd)
+        {
+            cellRefX_[dd][k] = xref_[i][dd];
+        }
+    }
+    for (int ci = cellCount; ci > 0; --ci)
+    {
+        cellStart_[ci] = cellStart_[ci - 1];
+    }
+    cellStart_[0] = 0;
+}
+
+void AnalysisNeighborhoodSearchImpl::computeCellDistances(
+        const rvec xtest, const rvec shift, int start, int count, realA r2[]) const
+{
+    const realA *x  = cellRefX_[XX].data() + start;
+    const realA *y  = cellRefX_[YY].data() + start;
+    const realA *z  = cellRefX_[ZZ].data() + start;
+    const realA  tx = xtest[XX], ty = xtest[YY], tz = xtest[ZZ];
+    const realA  sx = shift[XX], sy = shift[YY], sz = shift[ZZ];
+    if (bXY_)
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            const realA dx = (x[k] - tx) - sx;
+            const realA dy = (y[k] - ty) - sy;
+            r2[k] = dx*dx + dy*dy;
+        }
+    }
+    else
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            const realA dx = (x[k] - tx) - sx;
+            const realA dy = (y[k] - ty) - sy;
+            const realA dz = (z[k] - tz) - sz;
+            r2[k] = dx*dx + dy*dy + dz*dz;
+        }
+    }
 }
 
 void AnalysisNeighborhoodSearchImpl::initCellRange(
@@ -938,6 +1036,7 @@ void AnalysisNeighborhoodSearchImpl::init(
             mapPointToGridCell(positions.x_[ii], refcell, xrefAlloc_[i]);
             addToGridCell(refcell, i);
         }
+        sortGridCells();
     }
     else if (refIndices_ != nullptr)
     {
@@ -977,6 +1076,8 @@ void AnalysisNeighborhoodPairSearchImpl::reset(int testIndex)
     clear_rvec(prevdx_);
     exclind_       = 0;
     prevcai_       = -1;
+    batchStart_    = 0;
+    batchCount_    = 0;
     if (testIndex_ >= 0 && testIndex_ < testPosCount_)
     {
         const int index =
@@ -1099,39 +1200,53 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
                 {
                     continue;
                 }
-                const int cellSize = static_cast<int>(search_.cells_[ci].size());
-                for (; cai < cellSize; ++cai)
+                const int cellStart = search_.cellStart_[ci];
+                const int cellSize  = search_.cellStart_[ci + 1] - cellStart;
+                while (cai < cellSize)
                 {
-                    const int i = search_.cells_[ci][cai];
-                    if (selfSearchMode_ && ci == testCellIndex_ && i >= testIndex_)
-                    {
-                        continue;
-                    }
-                    if (isExcluded(i))
+                    // Compute the distances for a batch of positions at
+                    // once, and then process the pairs in order.  If the
+                    // search was resumed within a batch, the distances
+                    // computed in the earlier call are still valid.
+                    if (cai >= batchStart_ + batchCount_)
                     {
-                        continue;
+                        batchStart_ = cai;
+                        batchCount_ = std::min(cellSize - batchStart_, c_distanceBatchSize);
+                        search_.computeCellDistances(xtest_, shift, cellStart + batchStart_,
+                                                     batchCount_, batchR2_);
                     }
-                    rvec       dx;
-                    rvec_sub(search_.xref_[i], xtest_, dx);
-                    rvec_sub(dx, shift, dx);
-                    const realA r2
-                        = search_.bXY_
-                            ? dx[XX]*dx[XX] + dx[YY]*dx[YY]
-                            : norm2(dx);
-                    if (r2 <= search_.cutoff2_)
+                    for (; cai < batchStart_ + batchCount_; ++cai)
                     {
-                        if (action(i, r2, dx))
+                        const int i = search_.cellRefIndices_[cellStart + cai];
+                        if (selfSearchMode_ && ci == testCellIndex_ && i >= testIndex_)
+                        {
+                            continue;
+                        }
+                        if (isExcluded(i))
+                        {
+                            continue;
+                        }
+                        const realA r2 = batchR2_[cai - batchStart_];
+                        if (r2 <= search_.cutoff2_)
                         {
-                            prevcai_ = cai;
-                            previ_   = i;
-                            prevr2_  = r2;
-                            copy_rvec(dx, prevdx_);
-                            return true;
+                            rvec       dx;
+                            rvec_sub(search_.xref_[i], xtest_, dx);
+                            rvec_sub(dx, shift, dx);
+                            if (action(i, r2, dx))
+                            {
+                                prevcai_ = cai;
+                                previ_   = i;
+                                prevr2_  = r2;
+                                copy_rvec(dx, prevdx_);
+                                return true;
+                            }
                         }
                     }
                 }
-                exclind_ = 0;
-                cai      = 0;
+                exclind_    = 0;
+                cai         = 0;
+                batchStart_ = 0;
+                batchCount_ = 0;
             }
             while (search_.nextCell(testcell_, currCell_, cellBound_));
         }
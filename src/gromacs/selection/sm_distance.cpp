@@ -39,12 +39,21 @@
  * This file implements the \p distance, \p mindistance and \p within
  * selection methods.
  *
+ * The \p within method keeps a Verlet-type pair list, built with a cutoff
+ * extended by a skin, and reuses it for subsequent frames as long as the
+ * positions have moved less than half the skin.  All distances in the list
+ * are recomputed each frame, so the result is the same as with a full search.
+ *
  * \author Teemu Murtola <teemu.murtola@gmail.com>
  * \ingroup module_selection
  */
 #include "gmxpre.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/nbsearch.h"
 #include "gromacs/selection/position.h"
 #include "gromacs/utility/arraysize.h"
@@ -62,8 +71,12 @@
  */
 struct t_methoddata_distance
 {
-    t_methoddata_distance() : cutoff(-1.0)
+    t_methoddata_distance()
+        : cutoff(-1.0), pbc(nullptr), bSearchInit(false), bBuildList(false),
+          bListValid(false), bListStale(false), bListPbc(false), nListReuse(0),
+          listBackoff(0), listSkip(0)
     {
+        clear_mat(listBox);
     }
 
     /** Cutoff distance. */
@@ -74,8 +87,55 @@ struct t_methoddata_distance
     gmx::AnalysisNeighborhood        nb;
     /** Neighborhood search for an invididual frame. */
     gmx::AnalysisNeighborhoodSearch  nbsearch;
+    /** PBC information for the current frame (NULL if no PBC). */
+    const t_pbc                     *pbc;
+    /** Whether \p nbsearch has been initialized for the current frame. */
+    bool                             bSearchInit;
+
+    /*! \name Pair list for the \p within method
+     *
+     * The tested positions are identified by their reference ids
+     * (gmx_ana_indexmap_t::refid) to find them in the list in later frames.
+     */
+    //!\{
+    /** Neighborhood search with the cutoff extended by the skin. */
+    gmx::AnalysisNeighborhood        nbList;
+    /** Whether the pair list should be built in the current frame. */
+    bool                             bBuildList;
+    /** Whether the pair list can be used in the current frame. */
+    bool                             bListValid;
+    /** Whether a listed position has moved too much since the list was built. */
+    bool                             bListStale;
+    /** Whether PBC was used when the list was built. */
+    bool                             bListPbc;
+    /** Box when the list was built. */
+    matrix                           listBox;
+    /** Reference positions when the list was built. */
+    std::vector<gmx::RVec>           listRefX;
+    /** Reference ids of the reference positions when the list was built. */
+    std::vector<int>                 listRefId;
+    /** Tested positions when the list was built, indexed by reference id. */
+    std::vector<gmx::RVec>           listX;
+    /** Start of the pairs for each tested position in \p listPairs. */
+    std::vector<int>                 listStart;
+    /** Number of pairs for each tested position, -1 if not in the list. */
+    std::vector<int>                 listCount;
+    /** Reference position indices of all pairs in the list. */
+    std::vector<int>                 listPairs;
+    /** Number of frames the current list has been reused for. */
+    int                              nListReuse;
+    /** Number of frames to skip before building a new list after an unused one. */
+    int                              listBackoff;
+    /** Number of frames left to skip before building a new list. */
+    int                              listSkip;
+    //!\}
 };
 
+/** Skin distance added to the cutoff for the \p within pair list. */
+static const realA withinSkin = 0.1;
+/** Maximum number of frames to skip building the \p within pair list. */
+static const int  withinMaxBackoff = 16;
+
 /*! \brief
  * Allocates data for distance-based selection methods.
  *
@@ -124,6 +184,17 @@ free_data_common(void *data);
  */
 static void
 init_frame_common(const gmx::SelMethodEvalContext &context, void *data);
+/*! \brief
+ * Initializes the evaluation of the \p within selection method for a frame.
+ *
+ * \param[in]  context Evaluation context.
+ * \param      data    Should point to a \c t_methoddata_distance.
+ *
+ * Checks whether the pair list from an earlier frame can still be used.
+ * The neighborhood search is only initialized if it is needed.
+ */
+static void
+init_frame_within(const gmx::SelMethodEvalContext &context, void *data);
 /** Evaluates the \p distance selection method. */
 static void
 evaluate_distance(const gmx::SelMethodEvalContext & /*context*/,
@@ -215,7 +286,7 @@ gmx_ana_selmethod_t sm_within = {
     &init_common,
     nullptr,
     &free_data_common,
-    &init_frame_common,
+    &init_frame_within,
     nullptr,
     &evaluate_within,
     {"within REAL of POS_EXPR",
@@ -241,6 +312,7 @@ init_common(const gmx_mtop_t * /* top */, int /* npar */, gmx_ana_selparam_t *pa
         GMX_THROW(gmx::InvalidInputError("Distance cutoff should be > 0"));
     }
     d->nb.setCutoff(d->cutoff);
+    d->nbList.setCutoff(d->cutoff + withinSkin);
 }
 
 /*!
@@ -285,12 +357,221 @@ evaluate_distance(const gmx::SelMethodEvalContext & /*context*/,
     }
 }
 
+/*! \brief
+ * Computes the displacement of a position from an earlier position.
+ *
+ * \param[in] pbc  PBC information (can be NULL).
+ * \param[in] x    Current position.
+ * \param[in] x0   Earlier position.
+ * \returns   Squared distance between \p x and \p x0.
+ */
+static realA
+displacement2(const t_pbc *pbc, const rvec x, const rvec x0)
+{
+    rvec dx;
+
+    if (pbc)
+    {
+        pbc_dx(pbc, x, x0, dx);
+    }
+    else
+    {
+        rvec_sub(x, x0, dx);
+    }
+    return norm2(dx);
+}
+
+/*! \brief
+ * Checks whether the \p within pair list is still valid for the current frame.
+ *
+ * \param[in] d    Method data with the reference positions for this frame.
+ * \param[in] pbc  PBC information for this frame (can be NULL).
+ * \returns   true if the reference positions and the box are the same as
+ *     when the list was built and no reference position has moved more than
+ *     half the skin.
+ */
+static bool
+is_within_list_current(const t_methoddata_distance *d, const t_pbc *pbc)
+{
+    const realA maxDisp2 = gmx::square(0.5*withinSkin);
+
+    if (d->bListStale || (pbc != nullptr) != d->bListPbc)
+    {
+        return false;
+    }
+    if (pbc)
+    {
+        for (int i = 0; i < DIM; ++i)
+        {
+            for (int j = 0; j < DIM; ++j)
+            {
+                if (pbc->box[i][j] != d->listBox[i][j])
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    if (d->p.count() != static_cast<int>(d->listRefX.size()))
+    {
+        return false;
+    }
+    for (int i = 0; i < d->p.count(); ++i)
+    {
+        const int refid = (d->p.m.refid != nullptr ? d->p.m.refid[i] : i);
+        if (refid != d->listRefId[i]
+            || displacement2(pbc, d->p.x[i], d->listRefX[i]) > maxDisp2)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+init_frame_within(const gmx::SelMethodEvalContext &context, void *data)
+{
+    t_methoddata_distance *d = static_cast<t_methoddata_distance *>(data);
+
+    d->nbsearch.reset();
+    d->pbc         = context.pbc;
+    d->bSearchInit = false;
+    d->bBuildList  = false;
+    if (d->bListValid && is_within_list_current(d, context.pbc))
+    {
+        ++d->nListReuse;
+        return;
+    }
+    if (d->bListValid)
+    {
+        /* If the list was never reused, the positions move too much between
+         * frames for the list to pay off, so wait for a while before
+         * building a new one. */
+        if (d->nListReuse == 0)
+        {
+            d->listBackoff = std::min(2*d->listBackoff + 1, withinMaxBackoff);
+        }
+        else
+        {
+            d->listBackoff = 0;
+        }
+        d->listSkip   = d->listBackoff;
+        d->bListValid = false;
+    }
+    if (d->listSkip > 0)
+    {
+        --d->listSkip;
+    }
+    else
+    {
+        d->bBuildList = true;
+    }
+}
+
+/*! \brief
+ * Returns the neighborhood search for the current frame, initializing it if
+ * necessary.
+ *
+ * \param d  Method data for the \p within method.
+ */
+static gmx::AnalysisNeighborhoodSearch &
+get_within_search(t_methoddata_distance *d)
+{
+    if (!d->bSearchInit)
+    {
+        gmx::AnalysisNeighborhoodPositions pos(d->p.x, d->p.count());
+        d->nbsearch    = d->nb.initSearch(d->pbc, pos);
+        d->bSearchInit = true;
+    }
+    return d->nbsearch;
+}
+
+/*! \brief
+ * Evaluates \p within and builds the pair list for the current frame.
+ *
+ * \param[in]  pos   Positions to evaluate.
+ * \param[out] out   Output data structure.
+ * \param      d     Method data for the \p within method.
+ */
+static void
+build_within_list(gmx_ana_pos_t *pos, gmx_ana_selvalue_t *out,
+                  t_methoddata_distance *d)
+{
+    const realA                        cutoff2 = gmx::square(d->cutoff);
+    const int                          nkeys   = pos->m.b.nr;
+    gmx::AnalysisNeighborhoodPositions refPos(d->p.x, d->p.count());
+    gmx::AnalysisNeighborhoodSearch    search  = d->nbList.initSearch(d->pbc, refPos);
+
+    d->bListPbc = (d->pbc != nullptr);
+    if (d->pbc)
+    {
+        copy_mat(d->pbc->box, d->listBox);
+    }
+    d->listRefX.assign(d->p.x, d->p.x + d->p.count());
+    d->listRefId.resize(d->p.count());
+    for (int i = 0; i < d->p.count(); ++i)
+    {
+        d->listRefId[i] = (d->p.m.refid != nullptr ? d->p.m.refid[i] : i);
+    }
+    d->listX.resize(nkeys);
+    d->listStart.resize(nkeys);
+    d->listCount.assign(nkeys, -1);
+    d->listPairs.clear();
+
+    for (int b = 0; b < pos->count(); ++b)
+    {
+        const int                           key     = (pos->m.refid != nullptr ? pos->m.refid[b] : -1);
+        const bool                          bKey    = (key >= 0 && key < nkeys);
+        bool                                bWithin = false;
+        gmx::AnalysisNeighborhoodPair       pair;
+        gmx::AnalysisNeighborhoodPairSearch pairSearch
+            = search.startPairSearch(gmx::AnalysisNeighborhoodPositions(pos->x[b]));
+
+        if (bKey)
+        {
+            copy_rvec(pos->x[b], d->listX[key]);
+            d->listStart[key] = static_cast<int>(d->listPairs.size());
+        }
+        while (pairSearch.findNextPair(&pair))
+        {
+            if (pair.distance2() <= cutoff2)
+            {
+                bWithin = true;
+            }
+            if (bKey)
+            {
+                d->listPairs.push_back(pair.refIndex());
+            }
+            else if (bWithin)
+            {
+                break;
+            }
+        }
+        if (bKey)
+        {
+            d->listCount[key] = static_cast<int>(d->listPairs.size()) - d->listStart[key];
+        }
+        if (bWithin)
+        {
+            gmx_ana_pos_add_to_group(out->u.g, pos, b);
+        }
+    }
+    d->bBuildList = false;
+    d->bListValid = true;
+    d->bListStale = false;
+    d->nListReuse = 0;
+}
+
 /*!
  * See sel_updatefunc() for description of the parameters.
  * \p data should point to a \c t_methoddata_distance.
  *
  * Finds the atoms that are closer than the defined cutoff to
  * \c t_methoddata_distance::xref and puts them in \p out.g.
+ *
+ * If a pair list is available, the distances are only computed for the pairs
+ * in the list.  Positions that are not in the list or have moved too much
+ * are searched for as usual.
  */
 static void
 evaluate_within(const gmx::SelMethodEvalContext & /*context*/,
@@ -299,9 +580,50 @@ evaluate_within(const gmx::SelMethodEvalContext & /*context*/,
     t_methoddata_distance *d = static_cast<t_methoddata_distance *>(data);
 
     out->u.g->isize = 0;
+    if (d->bBuildList)
+    {
+        build_within_list(pos, out, d);
+        return;
+    }
+    if (!d->bListValid)
+    {
+        gmx::AnalysisNeighborhoodSearch &search = get_within_search(d);
+        for (int b = 0; b < pos->count(); ++b)
+        {
+            if (search.isWithin(pos->x[b]))
+            {
+                gmx_ana_pos_add_to_group(out->u.g, pos, b);
+            }
+        }
+        return;
+    }
+
+    const realA cutoff2  = gmx::square(d->cutoff);
+    const realA maxDisp2 = gmx::square(0.5*withinSkin);
+    const int   nkeys    = static_cast<int>(d->listCount.size());
     for (int b = 0; b < pos->count(); ++b)
     {
-        if (d->nbsearch.isWithin(pos->x[b]))
+        const int key     = (pos->m.refid != nullptr ? pos->m.refid[b] : -1);
+        bool      bWithin = false;
+
+        if (key >= 0 && key < nkeys && d->listCount[key] >= 0
+            && displacement2(d->pbc, pos->x[b], d->listX[key]) <= maxDisp2)
+        {
+            const int *pairs = &d->listPairs[d->listStart[key]];
+            for (int i = 0; i < d->listCount[key] && !bWithin; ++i)
+            {
+                bWithin = (displacement2(d->pbc, d->p.x[pairs[i]], pos->x[b]) <= cutoff2);
+            }
+        }
+        else
+        {
+            if (key >= 0 && key < nkeys && d->listCount[key] >= 0)
+            {
+                d->bListStale = true;
+            }
+            bWithin = get_within_search(d).isWithin(pos->x[b]);
+        }
+        if (bWithin)
         {
             gmx_ana_pos_add_to_group(out->u.g, pos, b);
         }
@@ -47,6 +47,7 @@
 
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/ioptionscontainer.h"
+#include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/indexutil.h"
 #include "gromacs/selection/selection.h"
 #include "gromacs/topology/topology.h"
@@ -210,7 +211,7 @@ class SelectionCollectionDataTest : public SelectionCollectionTest
 
         void runParser(const gmx::ArrayRef<const char *const> &selections);
         void runCompiler();
-        void runEvaluate();
+        void runEvaluate(t_pbc *pbc = nullptr);
         void runEvaluateFinal();
 
         void runTest(int                                     natoms,
@@ -360,12 +361,12 @@ SelectionCollectionDataTest::checkCompiled()
 
 
 void
-SelectionCollectionDataTest::runEvaluate()
+SelectionCollectionDataTest::runEvaluate(t_pbc *pbc)
 {
     using gmx::test::TestReferenceChecker;
 
     ++framenr_;
-    ASSERT_NO_THROW_GMX(sc_.evaluate(topManager_.frame(), nullptr));
+    ASSERT_NO_THROW_GMX(sc_.evaluate(topManager_.frame(), pbc));
     std::string          frame = gmx::formatString("Frame%d", framenr_);
     TestReferenceChecker compound(
             checker_.checkCompound("EvaluatedSelections", frame.c_str()));
@@ -1089,6 +1090,51 @@ TEST_F(SelectionCollectionDataTest, HandlesWithinKeyword)
 }
 
 
+TEST_F(SelectionCollectionDataTest, HandlesWithinKeywordOverFrames)
+{
+    static const char * const selections[] = {
+        "within 1.05 of resnr 2",
+        "y < 2.5 and within 1.05 of resnr 2",
+        "within 1.05 of (resnr 2 and x < 1.5)"
+    };
+    setFlags(TestFlags() | efTestEvaluation | efTestPositionAtoms);
+    ASSERT_NO_FATAL_FAILURE(runParser(selections));
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_FATAL_FAILURE(runCompiler());
+    t_trxframe *frame = topManager_.frame();
+    t_pbc       pbc;
+    set_pbc(&pbc, epbcXYZ, frame->box);
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    // Moves smaller than half the pair list skin, which still change
+    // the result.
+    frame->x[5][YY] = 1.97;
+    frame->x[6][YY] = 3.04;
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    // Larger moves of tested positions, also into the dynamic tested group.
+    frame->x[2][XX]  = 1.5;
+    frame->x[2][YY]  = 2.4;
+    frame->x[12][XX] = 2.9;
+    frame->x[12][YY] = 1.2;
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    // A larger move of a reference position into the dynamic reference group.
+    frame->x[4][XX] = 1.4;
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    // A smaller box, which brings periodic images within the cutoff.
+    frame->box[XX][XX] = 3.0;
+    set_pbc(&pbc, epbcXYZ, frame->box);
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    // Small moves in the new box.
+    frame->x[5][XX]  = 2.03;
+    frame->x[5][YY]  = 1.94;
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    frame->x[13][XX] = 3.97;
+    frame->x[13][YY] = 2.03;
+    frame->x[14][XX] = 3.96;
+    ASSERT_NO_FATAL_FAILURE(runEvaluate(&pbc));
+    ASSERT_NO_FATAL_FAILURE(runEvaluateFinal());
+}
+
+
 TEST_F(SelectionCollectionDataTest, HandlesInSolidAngleKeyword)
 {
     // Both of these should evaluate to empty on a correct implementation.
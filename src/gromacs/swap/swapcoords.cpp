@@ -43,6 +43,7 @@
 
 #include "swapcoords.h"
 
+#include <cmath>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -70,6 +71,7 @@
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/snprintf.h"
@@ -388,16 +390,11 @@ static gmx_bool compartment_contains_atom(
     x    -= m;
     width = w2 - w1;
 
-    /* Now choose the PBC image of x that is closest to the origin: */
+    /* Now choose the PBC image of x that is closest to the origin, i.e.
+     * map x into ]-l/2, l/2]. Shifting by whole box lengths in one go
+     * avoids looping for positions that are several boxes away. */
     l_2 = 0.5*l;
-    while (x  > l_2)
-    {
-        x -= l;
-    }
-    while (x <= -l_2)
-    {
-        x += l;
-    }
+    x  -= l*std::ceil((x - l_2)/l);
 
     *distance_from_b = (realA)fabs(x - bulkOffset*0.5*width);
 
@@ -662,7 +659,12 @@ static void detect_flux_per_channel(
 }
 
 
-/*! \brief Determines which ions or solvent molecules are in compartment A and B */
+/*! \brief Determines which ions or solvent molecules are in compartment A and B
+ *
+ * The two compartments tile the box along the swap dimension, so each molecule
+ * is assigned in a single pass over the group: it is tested against compartment
+ * A and only tested against B when it is not in A.
+ */
 static void sortMoleculesIntoCompartments(
         t_swapgrp      *g,
         t_commrec      *cr,
@@ -673,53 +675,75 @@ static void sortMoleculesIntoCompartments(
         gmx_bool        bRerun,
         gmx_bool        bIsSolvent)
 {
-    gmx_swapcoords_t s = sc->si_priv;
-    int              nMolNotInComp[eCompNR]; /* consistency check */
-    realA             cyl0_r2 = sc->cyl0r * sc->cyl0r;
-    realA             cyl1_r2 = sc->cyl1r * sc->cyl1r;
+    gmx_swapcoords_t s           = sc->si_priv;
+    int              sd          = s->swapdim;
+    int              nMolNotInComp;             /* consistency check */
+    realA            cyl0_r2     = sc->cyl0r * sc->cyl0r;
+    realA            cyl1_r2     = sc->cyl1r * sc->cyl1r;
+    realA            left[eCompNR], right[eCompNR];
+    gmx_bool         bDetectFlux = MASTER(cr) && (g->comp_now != nullptr) && !bIsSolvent;
 
     /* Get us a counter that cycles in the range of [0 ... sc->nAverage[ */
     int replace = (step/sc->nstswap) % sc->nAverage;
 
     for (int comp = eCompA; comp <= eCompB; comp++)
     {
-        realA left, right;
-
-        /* Get lists of atoms that match criteria for this compartment */
-        get_compartment_boundaries(comp, sc->si_priv, box, &left, &right);
+        /* Get the boundaries of this compartment */
+        get_compartment_boundaries(comp, sc->si_priv, box, &left[comp], &right[comp]);
 
         /* First clear the ion molecule lists */
-        g->comp[comp].nMol  = 0;
-        nMolNotInComp[comp] = 0; /* consistency check */
-
-        /* Loop over the molecules and atoms of this group */
-        for (int iMol = 0, iAtom = 0; iAtom < g->nat; iAtom += g->apm, iMol++)
-        {
-            realA dist;
-            int  sd = s->swapdim;
+        g->comp[comp].nMol = 0;
+    }
+    nMolNotInComp = 0;
 
-            /* Is this first atom of the molecule in the compartment that we look at? */
-            if (compartment_contains_atom(left, right, g->xc[iAtom][sd], box[sd][sd], sc->bulkOffset[comp], &dist) )
-            {
-                /* Add the first atom of this molecule to the list of molecules in this compartment */
-                add_to_list(iAtom, &g->comp[comp], dist);
+    /* Loop over the molecules and atoms of this group */
+    for (int iMol = 0, iAtom = 0; iAtom < g->nat; iAtom += g->apm, iMol++)
+    {
+        realA dist;
+        int   comp;
 
-                /* Master also checks for ion groups through which channel each ion has passed */
-                if (MASTER(cr) && (g->comp_now != nullptr) && !bIsSolvent)
-                {
-                    int globalAtomNr = g->ind[iAtom] + 1; /* PDB index starts at 1 ... */
-                    detect_flux_per_channel(g, globalAtomNr, comp, g->xc[iAtom],
-                                            &g->comp_now[iMol], &g->comp_from[iMol], &g->channel_label[iMol],
-                                            sc, cyl0_r2, cyl1_r2, step, bRerun, fpout);
-                }
-            }
-            else
+        /* In which compartment is the first atom of this molecule? */
+        for (comp = eCompA; comp <= eCompB; comp++)
+        {
+            if (compartment_contains_atom(left[comp], right[comp], g->xc[iAtom][sd], box[sd][sd], sc->bulkOffset[comp], &dist) )
             {
-                nMolNotInComp[comp]++;
+                break;
             }
         }
-        /* Correct the time-averaged number of ions in the compartment */
-        if (!bIsSolvent)
+
+        if (comp > eCompB)
+        {
+            nMolNotInComp++;
+            continue;
+        }
+
+#ifndef NDEBUG
+        /* The compartments tile the box, so a molecule in A can not also be in B */
+        if (comp == eCompA)
+        {
+            realA distB;
+            GMX_ASSERT(!compartment_contains_atom(left[eCompB], right[eCompB], g->xc[iAtom][sd], box[sd][sd], sc->bulkOffset[eCompB], &distB),
+                       "A molecule can not be in both compartments");
+        }
+#endif
+
+        /* Add the first atom of this molecule to the list of molecules in this compartment */
+        add_to_list(iAtom, &g->comp[comp], dist);
+
+        /* Master also checks for ion groups through which channel each ion has passed */
+        if (bDetectFlux)
+        {
+            int globalAtomNr = g->ind[iAtom] + 1; /* PDB index starts at 1 ... */
+            detect_flux_per_channel(g, globalAtomNr, comp, g->xc[iAtom],
+                                    &g->comp_now[iMol], &g->comp_from[iMol], &g->channel_label[iMol],
+                                    sc, cyl0_r2, cyl1_r2, step, bRerun, fpout);
+        }
+    }
+
+    /* Correct the time-averaged number of ions in the compartments */
+    if (!bIsSolvent)
+    {
+        for (int comp = eCompA; comp <= eCompB; comp++)
         {
             update_time_window(&g->comp[comp], sc->nAverage, replace);
         }
@@ -749,10 +773,10 @@ static void sortMoleculesIntoCompartments(
     }
 
     /* Consistency checks */
-    if (nMolNotInComp[eCompA] + nMolNotInComp[eCompB] != g->nat / g->apm)
+    if (nMolNotInComp > 0)
     {
-        fprintf(stderr, "%s Warning: Inconsistency while assigning '%s' molecules to compartments. !inA: %d, !inB: %d, total molecules %d\n",
-                SwS, g->molname, nMolNotInComp[eCompA], nMolNotInComp[eCompB], g->nat/g->apm);
+        fprintf(stderr, "%s Warning: Inconsistency while assigning '%s' molecules to compartments. %d of %d molecules are in neither compartment\n",
+                SwS, g->molname, nMolNotInComp, g->nat/g->apm);
     }
 
     int sum = g->comp[eCompA].nMol + g->comp[eCompB].nMol;
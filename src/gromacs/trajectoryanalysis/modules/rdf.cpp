@@ -134,10 +134,10 @@ class Rdf : public TrajectoryAnalysisModule
         virtual void writeOutput();
 
     private:
-        std::string                               fnRdf_;
-        std::string                               fnCumulative_;
-        SurfaceType                               surface_;
-        AnalysisDataPlotSettings                  plotSettings_;
+        std::string                                fnRdf_;
+        std::string                                fnCumulative_;
+        SurfaceType                                surface_;
+        AnalysisDataPlotSettings                   plotSettings_;
 
         /*! \brief
          * Reference selection to compute RDFs around.
@@ -147,20 +147,21 @@ class Rdf : public TrajectoryAnalysisModule
          * The RDF is computed by finding the nearest position from each
          * surface group for each position, and then binning those distances.
          */
-        Selection                                 refSel_;
+        Selection                                  refSel_;
         /*! \brief
          * Selections to compute RDFs for.
          */
-        SelectionList                             sel_;
+        SelectionList                              sel_;
 
         /*! \brief
-         * Raw pairwise distance data from which the RDF is computed.
+         * Binned pairwise distance data from which the RDF is computed.
          *
-         * There is a data set for each selection in `sel_`, with a single
-         * column.  Each point set will contain a single pairwise distance
-         * that contributes to the RDF.
+         * There is a data set for each selection in `sel_`, with two
+         * columns.  The pair distances are binned within each frame, and each
+         * point set contains the center of a histogram bin and the number of
+         * pairs in that bin.
          */
-        AnalysisData                              pairDist_;
+        AnalysisData                               pairDist_;
         /*! \brief
          * Normalization factors for each frame.
          *
@@ -169,7 +170,7 @@ class Rdf : public TrajectoryAnalysisModule
          * `sel_.size()` more columns, each containing the number density of
          * positions for one selection.
          */
-        AnalysisData                              normFactors_;
+        AnalysisData                               normFactors_;
         /*! \brief
          * Histogram module that computes the actual RDF from `pairDist_`.
          *
@@ -177,34 +178,34 @@ class Rdf : public TrajectoryAnalysisModule
          * the averager is normalized by the average number of reference
          * positions (average of the first column of `normFactors_`).
          */
-        AnalysisDataSimpleHistogramModulePointer  pairCounts_;
+        AnalysisDataWeightedHistogramModulePointer pairCounts_;
         /*! \brief
          * Average normalization factors.
          */
-        AnalysisDataAverageModulePointer          normAve_;
+        AnalysisDataAverageModulePointer           normAve_;
         //! Neighborhood search with `refSel_` as the reference positions.
-        AnalysisNeighborhood                      nb_;
+        AnalysisNeighborhood                       nb_;
 
         // User input options.
-        double                                    binwidth_;
-        double                                    cutoff_;
-        double                                    rmax_;
-        Normalization                             normalization_;
-        bool                                      bNormalizationSet_;
-        bool                                      bXY_;
-        bool                                      bExclusions_;
+        double                                     binwidth_;
+        double                                     cutoff_;
+        double                                     rmax_;
+        Normalization                              normalization_;
+        bool                                       bNormalizationSet_;
+        bool                                       bXY_;
+        bool                                       bExclusions_;
 
         // Pre-computed values for faster access during analysis.
         realA                                      cut2_;
         realA                                      rmax2_;
-        int                                       surfaceGroupCount_;
+        int                                        surfaceGroupCount_;
 
         // Copy and assign disallowed by base.
 };
 
 Rdf::Rdf()
     : surface_(SurfaceType_None),
-      pairCounts_(new AnalysisDataSimpleHistogramModule()),
+      pairCounts_(new AnalysisDataWeightedHistogramModule()),
       normAve_(new AnalysisDataAverageModule()),
       binwidth_(0.002), cutoff_(0.0), rmax_(0.0),
       normalization_(Normalization_Rdf), bNormalizationSet_(false), bXY_(false),
@@ -343,7 +344,7 @@ Rdf::initAnalysis(const TrajectoryAnalysisSettings &settings,
     pairDist_.setDataSetCount(sel_.size());
     for (size_t i = 0; i < sel_.size(); ++i)
     {
-        pairDist_.setColumnCount(i, 1);
+        pairDist_.setColumnCount(i, 2);
     }
     plotSettings_ = settings.plotSettings();
     nb_.setXYMode(bXY_);
@@ -431,10 +432,12 @@ class RdfModuleData : public TrajectoryAnalysisModuleData
         RdfModuleData(TrajectoryAnalysisModule          *module,
                       const AnalysisDataParallelOptions &opt,
                       const SelectionCollection         &selections,
-                      int                                surfaceGroupCount)
+                      int                                surfaceGroupCount,
+                      int                                binCount)
             : TrajectoryAnalysisModuleData(module, opt, selections)
         {
             surfaceDist2_.resize(surfaceGroupCount);
+            binCounts_.resize(binCount);
         }
 
         virtual void finish() { finishDataHandles(); }
@@ -451,6 +454,14 @@ class RdfModuleData : public TrajectoryAnalysisModuleData
          * the RDF from these numbers.
          */
         std::vector<realA> surfaceDist2_;
+        /*! \brief
+         * Number of pairs in each histogram bin for the current selection.
+         *
+         * The distances are binned here within a frame, and only the nonzero
+         * bins are passed on to the histogram module, instead of passing each
+         * pair distance as a separate point.
+         */
+        std::vector<int>   binCounts_;
 };
 
 TrajectoryAnalysisModuleDataPointer Rdf::startFrames(
@@ -458,7 +469,8 @@ TrajectoryAnalysisModuleDataPointer Rdf::startFrames(
         const SelectionCollection         &selections)
 {
     return TrajectoryAnalysisModuleDataPointer(
-            new RdfModuleData(this, opt, selections, surfaceGroupCount_));
+            new RdfModuleData(this, opt, selections, surfaceGroupCount_,
+                              pairCounts_->settings().binCount()));
 }
 
 void
@@ -514,11 +526,15 @@ Rdf::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
         nh.setPoint(0, refSel.posCount());
     }
 
+    const AnalysisHistogramSettings &histSettings = pairCounts_->settings();
+    std::vector<int>                &binCounts    = frameData.binCounts_;
+
     dh.startFrame(frnr, fr.time);
     AnalysisNeighborhoodSearch    nbsearch = nb_.initSearch(pbc, refSel);
     for (size_t g = 0; g < sel.size(); ++g)
     {
         dh.selectDataSet(g);
+        std::fill(binCounts.begin(), binCounts.end(), 0);
 
         if (bSurface)
         {
@@ -551,8 +567,11 @@ Rdf::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                     // surface positions.
                     if (r2 > cut2_ && r2 <= rmax2_)
                     {
-                        dh.setPoint(0, std::sqrt(r2));
-                        dh.finishPointSet();
+                        const int bin = histSettings.findBin(std::sqrt(r2));
+                        if (bin != -1)
+                        {
+                            ++binCounts[bin];
+                        }
                     }
                 }
             }
@@ -568,13 +587,25 @@ Rdf::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                 const realA r2 = pair.distance2();
                 if (r2 > cut2_)
                 {
-                    // TODO: Consider whether the histogramming could be done with
-                    // less overhead (after first measuring the overhead).
-                    dh.setPoint(0, std::sqrt(r2));
-                    dh.finishPointSet();
+                    const int bin = histSettings.findBin(std::sqrt(r2));
+                    if (bin != -1)
+                    {
+                        ++binCounts[bin];
+                    }
                 }
             }
         }
+        // Pass the frame-local histogram on as (bin center, count) pairs.
+        for (int bin = 0; bin < histSettings.binCount(); ++bin)
+        {
+            if (binCounts[bin] > 0)
+            {
+                dh.setPoint(0, histSettings.firstEdge()
+                            + (bin + 0.5) * histSettings.binWidth());
+                dh.setPoint(1, binCounts[bin]);
+                dh.finishPointSet();
+            }
+        }
         // Normalization factor for the number density (only used without
         // -surf, but does not hurt to populate otherwise).
         nh.setPoint(g + 1, sel[g].posCount() * inverseVolume);
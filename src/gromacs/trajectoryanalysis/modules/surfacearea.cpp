@@ -52,8 +52,10 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/nbsearch.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 using namespace gmx;
@@ -615,62 +617,110 @@ nsc_dclm_pbc(const rvec *coords, const ArrayRef<const realA> &radius, int nat,
     pos.indexed(constArrayRefFromArray(index, nat));
     AnalysisNeighborhoodSearch    nbsearch(nb->initSearch(pbc, pos));
 
-    std::vector<int>              wkdot(n_dot);
+    // The unit sphere dots are stored separately for each coordinate, so
+    // that the occlusion test for a neighbor is a simple loop over all dots
+    // that the compiler can vectorize.  Instead of skipping dots that are
+    // already covered, the test updates a mask for all dots.
+    std::vector<realA>             dotX(n_dot), dotY(n_dot), dotZ(n_dot);
+    for (int j = 0; j < n_dot; ++j)
+    {
+        dotX[j] = xus[3*j];
+        dotY[j] = xus[3*j+1];
+        dotZ[j] = xus[3*j+2];
+    }
 
-    for (int i = 0; i < nat; ++i)
+    // The atoms are processed in parallel, and the results are stored per
+    // atom and summed in atom order below, so that the totals do not depend
+    // on the number of threads.
+    const bool                    bDots   = ((mode & FLAG_DOTS) != 0);
+    const bool                    bVolume = ((mode & FLAG_VOLUME) != 0);
+    std::vector<realA>             atomAreas(nat);
+    std::vector<realA>             atomVolumes(bVolume ? nat : 0);
+    std::vector<unsigned char>    surfaceDots(bDots ? nat*n_dot : 0);
+
+    const int                     nthreads = gmx_omp_get_max_threads();
+#pragma omp parallel num_threads(nthreads)
     {
-        const int                      iat  = index[i];
-        const realA                     ai   = radius[iat];
-        const realA                     aisq = ai*ai;
-        AnalysisNeighborhoodPairSearch pairSearch(
-                nbsearch.startPairSearch(coords[iat]));
-        AnalysisNeighborhoodPair       pair;
-        std::fill(wkdot.begin(), wkdot.end(), 1);
-        int currDotCount = n_dot;
-        while (currDotCount > 0 && pairSearch.findNextPair(&pair))
+        try
         {
-            const int  jat = index[pair.refIndex()];
-            const realA aj  = radius[jat];
-            const realA d2  = pair.distance2();
-            if (iat == jat || d2 > gmx::square(ai+aj))
-            {
-                continue;
-            }
-            const rvec &dx     = pair.dx();
-            const realA  refdot = (d2 + aisq - aj*aj)/(2*ai);
-            // TODO: Consider whether micro-optimizations from the old
-            // implementation would be useful, compared to the complexity that
-            // they bring: instead of this direct loop, the neighbors were
-            // stored into a temporary array, the loop order was
-            // reversed (first over dots, then over neighbors), and for each
-            // dot, it was first checked whether the same neighbor that
-            // resulted in marking the previous dot covered would also cover
-            // this dot. This presumably plays together with sorting of the
-            // surface dots (done in make_unsp) to avoid some of the looping.
-            // Alternatively, we could keep a skip list here to avoid
-            // repeatedly looping over dots that have already marked as
-            // covered.
-            for (int j = 0; j < n_dot; ++j)
+            std::vector<unsigned char> wkdot(n_dot);
+
+#pragma omp for schedule(dynamic, 16)
+            for (int i = 0; i < nat; ++i)
             {
-                if (wkdot[j] && iprod(&xus[3*j], dx) > refdot)
+                const int                      iat  = index[i];
+                const realA                     ai   = radius[iat];
+                const realA                     aisq = ai*ai;
+                AnalysisNeighborhoodPairSearch pairSearch(
+                        nbsearch.startPairSearch(coords[iat]));
+                AnalysisNeighborhoodPair       pair;
+                std::fill(wkdot.begin(), wkdot.end(), 1);
+                int currDotCount = n_dot;
+                while (currDotCount > 0 && pairSearch.findNextPair(&pair))
+                {
+                    const int  jat = index[pair.refIndex()];
+                    const realA aj  = radius[jat];
+                    const realA d2  = pair.distance2();
+                    if (iat == jat || d2 > gmx::square(ai+aj))
+                    {
+                        continue;
+                    }
+                    const rvec &dx     = pair.dx();
+                    const realA  refdot = (d2 + aisq - aj*aj)/(2*ai);
+                    const realA  dxx    = dx[XX], dxy = dx[YY], dxz = dx[ZZ];
+                    unsigned char *wk   = wkdot.data();
+                    currDotCount = 0;
+                    for (int j = 0; j < n_dot; ++j)
+                    {
+                        const bool bCovered = (dotX[j]*dxx + dotY[j]*dxy + dotZ[j]*dxz > refdot);
+                        wk[j]         &= static_cast<unsigned char>(!bCovered);
+                        currDotCount  += wk[j];
+                    }
+                }
+
+                atomAreas[i] = aisq * dotarea * currDotCount;
+                if (bDots)
+                {
+                    std::copy(wkdot.begin(), wkdot.end(), surfaceDots.begin() + i*n_dot);
+                }
+                if (bVolume)
                 {
-                    --currDotCount;
-                    wkdot[j] = 0;
+                    const realA xi = coords[iat][XX];
+                    const realA yi = coords[iat][YY];
+                    const realA zi = coords[iat][ZZ];
+                    realA       dx = 0.0, dy = 0.0, dz = 0.0;
+                    for (int l = 0; l < n_dot; l++)
+                    {
+                        if (wkdot[l])
+                        {
+                            dx = dx+xus[3*l];
+                            dy = dy+xus[1+3*l];
+                            dz = dz+xus[2+3*l];
+                        }
+                    }
+                    atomVolumes[i] = aisq*(dx*(xi-xs)+dy*(yi-ys)+dz*(zi-zs) + ai*currDotCount);
                 }
             }
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
 
-        const realA a = aisq * dotarea * currDotCount;
+    for (int i = 0; i < nat; ++i)
+    {
+        const int  iat = index[i];
+        const realA ai  = radius[iat];
+        const realA a   = atomAreas[i];
         area = area + a;
         if (mode & FLAG_ATOM_AREA)
         {
             atom_area[i] = a;
         }
-        const realA xi = coords[iat][XX];
-        const realA yi = coords[iat][YY];
-        const realA zi = coords[iat][ZZ];
-        if (mode & FLAG_DOTS)
+        if (bDots)
         {
+            const realA          xi    = coords[iat][XX];
+            const realA          yi    = coords[iat][YY];
+            const realA          zi    = coords[iat][ZZ];
+            const unsigned char *wkdot = &surfaceDots[i*n_dot];
             for (int l = 0; l < n_dot; l++)
             {
                 if (wkdot[l])
@@ -687,19 +737,9 @@ nsc_dclm_pbc(const rvec *coords, const ArrayRef<const realA> &radius, int nat,
                 }
             }
         }
-        if (mode & FLAG_VOLUME)
+        if (bVolume)
         {
-            realA dx = 0.0, dy = 0.0, dz = 0.0;
-            for (int l = 0; l < n_dot; l++)
-            {
-                if (wkdot[l])
-                {
-                    dx = dx+xus[3*l];
-                    dy = dy+xus[1+3*l];
-                    dz = dz+xus[2+3*l];
-                }
-            }
-            vol = vol+aisq*(dx*(xi-xs)+dy*(yi-ys)+dz*(zi-zs) + ai*currDotCount);
+            vol = vol+atomVolumes[i];
         }
     }
 
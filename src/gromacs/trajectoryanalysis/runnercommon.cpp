@@ -46,7 +46,9 @@
 #include <string.h>
 
 #include <algorithm>
+#include <exception>
 #include <string>
+#include <thread>
 
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/oenv.h"
@@ -87,6 +89,8 @@ class TrajectoryAnalysisRunnerCommon::Impl : public ITopologyProvider
         void initTopology(bool required);
         void initFirstFrame();
         void initFrameIndexGroup();
+        void startPrefetch();
+        bool finishPrefetch();
         void finishTrajectory();
 
         // From ITopologyProvider
@@ -129,6 +133,19 @@ class TrajectoryAnalysisRunnerCommon::Impl : public ITopologyProvider
         bool                        bTrajOpen_;
         //! The current frame, or \p NULL if no frame loaded yet.
         t_trxframe                 *fr;
+        /*! \brief
+         * Frame that the next frame is read into in the background.
+         *
+         * Shares the index array with \p fr, but has its own coordinate
+         * arrays.  Swapped with \p fr when the next frame is requested.
+         */
+        t_trxframe                 *nextFr_;
+        //! Thread reading the next frame into \p nextFr_ while the current one is analyzed.
+        std::thread                 prefetchThread_;
+        //! Whether the background read found a frame.
+        bool                        bNextFrameRead_;
+        //! Exception thrown by the background read, rethrown by finishPrefetch().
+        std::exception_ptr          prefetchException_;
         gmx_rmpbc_t                 gpbc_;
         //! Used to store the status variable from read_first_frame().
         t_trxstatus                *status_;
@@ -140,7 +157,8 @@ TrajectoryAnalysisRunnerCommon::Impl::Impl(TrajectoryAnalysisSettings *settings)
     : settings_(*settings),
       startTime_(0.0), endTime_(0.0), deltaTime_(0.0),
       bStartTimeSet_(false), bEndTimeSet_(false), bDeltaTimeSet_(false),
-      bTrajOpen_(false), fr(nullptr), gpbc_(nullptr), status_(nullptr), oenv_(nullptr)
+      bTrajOpen_(false), fr(nullptr), nextFr_(nullptr), bNextFrameRead_(false),
+      gpbc_(nullptr), status_(nullptr), oenv_(nullptr)
 {
 }
 
@@ -157,6 +175,14 @@ TrajectoryAnalysisRunnerCommon::Impl::~Impl()
         sfree(fr->index);
         sfree(fr);
     }
+    if (nextFr_ != nullptr)
+    {
+        // The index array is shared with fr and already freed above.
+        sfree(nextFr_->x);
+        sfree(nextFr_->v);
+        sfree(nextFr_->f);
+        sfree(nextFr_);
+    }
     if (oenv_ != nullptr)
     {
         output_env_done(oenv_);
@@ -294,9 +320,68 @@ TrajectoryAnalysisRunnerCommon::Impl::initFrameIndexGroup()
               fr->index);
 }
 
+void
+TrajectoryAnalysisRunnerCommon::Impl::startPrefetch()
+{
+    if (nextFr_ == nullptr)
+    {
+        // Set up the second frame with the same contents as the current
+        // one, so that only the reading needs to fill in the data.
+        snew(nextFr_, 1);
+        *nextFr_    = *fr;
+        nextFr_->x  = nullptr;
+        nextFr_->v  = nullptr;
+        nextFr_->f  = nullptr;
+        if (fr->x != nullptr)
+        {
+            snew(nextFr_->x, fr->natoms);
+        }
+        if (fr->v != nullptr)
+        {
+            snew(nextFr_->v, fr->natoms);
+        }
+        if (fr->f != nullptr)
+        {
+            snew(nextFr_->f, fr->natoms);
+        }
+    }
+    prefetchThread_ = std::thread([this]
+                                  {
+                                      try
+                                      {
+                                          bNextFrameRead_ = read_next_frame(oenv_, status_, nextFr_);
+                                      }
+                                      catch (...)
+                                      {
+                                          bNextFrameRead_    = false;
+                                          prefetchException_ = std::current_exception();
+                                      }
+                                  });
+}
+
+bool
+TrajectoryAnalysisRunnerCommon::Impl::finishPrefetch()
+{
+    prefetchThread_.join();
+    if (prefetchException_)
+    {
+        std::exception_ptr exception = prefetchException_;
+        prefetchException_ = nullptr;
+        std::rethrow_exception(exception);
+    }
+    return bNextFrameRead_;
+}
+
 void
 TrajectoryAnalysisRunnerCommon::Impl::finishTrajectory()
 {
+    if (prefetchThread_.joinable())
+    {
+        // The frame read in the background is not needed anymore, and any
+        // error in reading it is irrelevant.
+        prefetchThread_.join();
+        prefetchException_ = nullptr;
+    }
     if (bTrajOpen_)
     {
         close_trx(status_);
@@ -451,7 +536,18 @@ TrajectoryAnalysisRunnerCommon::readNextFrame()
     bool bContinue = false;
     if (hasTrajectory())
     {
-        bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
+        if (impl_->prefetchThread_.joinable())
+        {
+            bContinue = impl_->finishPrefetch();
+            if (bContinue)
+            {
+                std::swap(impl_->fr, impl_->nextFr_);
+            }
+        }
+        else
+        {
+            bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
+        }
     }
     if (!bContinue)
     {
@@ -464,6 +560,11 @@ TrajectoryAnalysisRunnerCommon::readNextFrame()
 void
 TrajectoryAnalysisRunnerCommon::initFrame()
 {
+    // Read the next frame in the background while this one is analyzed.
+    if (impl_->bTrajOpen_ && !impl_->prefetchThread_.joinable())
+    {
+        impl_->startPrefetch();
+    }
     if (impl_->gpbc_ != nullptr)
     {
         gmx_rmpbc_trxfr(impl_->gpbc_, impl_->fr);
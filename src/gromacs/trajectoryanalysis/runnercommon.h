@@ -114,7 +114,9 @@ class TrajectoryAnalysisRunnerCommon
         /*! \brief
          * Performs common initialization for the currently loaded frame.
          *
-         * Currently, makes molecules whole if requested.
+         * Makes molecules whole if requested, and starts reading the next
+         * frame from the trajectory in the background, so that the I/O
+         * overlaps with the analysis of the current frame.
          */
         void initFrame();
 
@@ -646,6 +646,10 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
     }
 
     const bool useReplicaExchange = (replExParams.exchangeInterval > 0);
+    if (useReplicaExchange && replExParams.exchangeParameters && startingFromCheckpoint)
+    {
+        gmx_fatal(FARGS, "Replica exchange of parameters can not continue from a checkpoint, since the assignment of parameters to simulations is not stored");
+    }
     if (useReplicaExchange && MASTER(cr))
     {
         repl_ex = init_replica_exchange(fplog, cr->ms, top_global->natoms, ir,
@@ -1218,6 +1222,15 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                   do_per_step(step, nstglobalcomm) ||
                   (EI_VV(ir->eI) && inputrecNvtTrotter(ir) && do_per_step(step-1, nstglobalcomm)));
 
+        // Organize to do inter-simulation signalling on steps if
+        // and when algorithms require it.
+        bool doInterSimSignal = (simulationsShareState && do_per_step(step, nstSignalComm));
+
+        /* Do we call compute_globals after the update? With Leap-Frog
+         * we also need the kinetic energy one step before communication.
+         */
+        bool doComputeGlobals = (bGStat || (!EI_VV(ir->eI) && do_per_step(step+1, nstglobalcomm)) || doInterSimSignal);
+
         force_flags = (GMX_FORCE_STATECHANGED |
                        ((inputrecDynamicBox(ir) || bRerunMD) ? GMX_FORCE_DYNAMICBOX : 0) |
                        GMX_FORCE_ALLFORCES |
@@ -1292,7 +1305,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
 
             update_coords(fplog, step, ir, mdatoms, state, f, fcd,
                           ekind, M, upd, etrtVELOCITY1,
-                          cr, constr);
+                          cr, constr, FALSE);
 
             if (!bRerunMD || rerun_fr.bV || bForceUpdate)         /* Why is rerun_fr.bV here?  Unclear. */
             {
@@ -1301,7 +1314,8 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, f,
                                    &top->idef, shake_vir,
                                    cr, nrnb, wcycle, upd, constr,
-                                   TRUE, bCalcVir);
+                                   TRUE, bCalcVir,
+                                   nullptr, FALSE);
                 wallcycle_start(wcycle, ewcUPDATE);
             }
             else if (graph)
@@ -1556,7 +1570,8 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, f,
                                    &top->idef, tmp_vir,
                                    cr, nrnb, wcycle, upd, constr,
-                                   TRUE, bCalcVir);
+                                   TRUE, bCalcVir,
+                                   nullptr, FALSE);
             }
         }
         /* Box is changed in update() when we do pressure coupling,
@@ -1594,7 +1609,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                 /* velocity half-step update */
                 update_coords(fplog, step, ir, mdatoms, state, f, fcd,
                               ekind, M, upd, etrtVELOCITY2,
-                              cr, constr);
+                              cr, constr, FALSE);
             }
 
             /* Above, initialize just copies ekinh into ekin,
@@ -1613,15 +1628,21 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                 copy_rvecn(as_rvec_array(state->x.data()), cbuf, 0, state->natoms);
             }
 
+            /* With leap-frog the half step kinetic energy is computed
+             * in compute_globals below, which the update can do while
+             * passing over the velocities.
+             */
             update_coords(fplog, step, ir, mdatoms, state, f, fcd,
-                          ekind, M, upd, etrtPOSITION, cr, constr);
+                          ekind, M, upd, etrtPOSITION, cr, constr,
+                          !EI_VV(ir->eI) && doComputeGlobals);
             wallcycle_stop(wcycle, ewcUPDATE);
 
             update_constraints(fplog, step, &dvdl_constr, ir, mdatoms, state,
                                fr->bMolPBC, graph, f,
                                &top->idef, shake_vir,
                                cr, nrnb, wcycle, upd, constr,
-                               FALSE, bCalcVir);
+                               FALSE, bCalcVir,
+                               ekind, !EI_VV(ir->eI) && doComputeGlobals);
 
             if (ir->eI == eiVVAK)
             {
@@ -1639,7 +1660,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                 copy_rvecn(cbuf, as_rvec_array(state->x.data()), 0, state->natoms);
 
                 update_coords(fplog, step, ir, mdatoms, state, f, fcd,
-                              ekind, M, upd, etrtPOSITION, cr, constr);
+                              ekind, M, upd, etrtPOSITION, cr, constr, FALSE);
                 wallcycle_stop(wcycle, ewcUPDATE);
 
                 /* do we need an extra constraint here? just need to copy out of as_rvec_array(state->v.data()) to upd->xp? */
@@ -1651,7 +1672,8 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, f,
                                    &top->idef, tmp_vir,
                                    cr, nrnb, wcycle, upd, nullptr,
-                                   FALSE, bCalcVir);
+                                   FALSE, bCalcVir,
+                                   nullptr, FALSE);
             }
             if (EI_VV(ir->eI))
             {
@@ -1706,11 +1728,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
          * the kinetic energy one step before communication.
          */
         {
-            // Organize to do inter-simulation signalling on steps if
-            // and when algorithms require it.
-            bool doInterSimSignal = (simulationsShareState && do_per_step(step, nstSignalComm));
-
-            if (bGStat || (!EI_VV(ir->eI) && do_per_step(step+1, nstglobalcomm)) || doInterSimSignal)
+            if (doComputeGlobals)
             {
                 // Since we're already communicating at this step, we
                 // can propagate intra-simulation signals. Note that
@@ -1878,14 +1896,26 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
 
         /* Replica exchange */
         bExchanged = FALSE;
+        gmx_bool bExchangedParameters = FALSE;
         if (bDoReplEx)
         {
-            bExchanged = replica_exchange(fplog, cr, repl_ex,
-                                          state_global, enerd,
-                                          state, step, t);
+            if (replExParams.exchangeParameters)
+            {
+                /* Only the parameters change, the local state stays in place */
+                bExchangedParameters = replica_exchange_parameters(fplog, cr, repl_ex,
+                                                                   ir, upd, enerd,
+                                                                   state, step, t);
+                bExchanged           = bExchangedParameters;
+            }
+            else
+            {
+                bExchanged = replica_exchange(fplog, cr, repl_ex,
+                                              state_global, enerd,
+                                              state, step, t);
+            }
         }
 
-        if ( (bExchanged || bNeedRepartition) && DOMAINDECOMP(cr) )
+        if ( ((bExchanged && !bExchangedParameters) || bNeedRepartition) && DOMAINDECOMP(cr) )
         {
             dd_partition_system(fplog, step, cr, TRUE, 1,
                                 state_global, top_global, ir,
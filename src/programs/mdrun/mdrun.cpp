@@ -351,6 +351,8 @@ int Mdrunner::mainFunction(int argc, char *argv[])
           "Number of random exchanges to carry out each exchange interval (N^3 is one suggestion).  -nex zero or not specified gives neighbor replica exchange." },
         { "-reseed",  FALSE, etINT, {&replExParams.randomSeed},
           "Seed for replica exchange, -1 is generate a seed" },
+        { "-replexpar", FALSE, etBOOL, {&replExParams.exchangeParameters},
+          "Exchange the temperature and/or lambda state between the simulations instead of the coordinates and velocities, not supported with pressure coupling" },
         { "-imdport",    FALSE, etINT, {&imdOptions.port},
           "HIDDENIMD listening port" },
         { "-imdwait",  FALSE, etBOOL, {&imdOptions.wait},
@@ -50,6 +50,7 @@
 #include "gromacs/math/units.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/main.h"
+#include "gromacs/mdlib/update.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/md_enums.h"
@@ -96,6 +97,9 @@ typedef struct gmx_repl_ex
     int     **nmoves;      /* number of moves between replicas i and j */
     int      *nexchange;   /* i-th element of the array is the number of exchanges between replica i-1 and i */
 
+    gmx_bool  bExchangeParameters; /* swap parameters between simulations instead of states */
+    int      *simState;            /* with bExchangeParameters, the state (replica) index of each simulation */
+
     /* these are helper arrays for replica exchange; allocated here so they
        don't have to be allocated each time */
     int      *destinations;
@@ -111,6 +115,7 @@ typedef struct gmx_repl_ex
     realA  *beta;
     realA  *Vol;
     realA **de;
+    realA  *sumbuf; /* buffer for summing Epot, Vol and de over the simulations */
 
 } t_gmx_repl_ex;
 
@@ -254,6 +259,40 @@ init_replica_exchange(FILE                            *fplog,
             gmx_fatal(FARGS, "delta_lambda is not zero");
         }
     }
+
+    re->bExchangeParameters = replExParams.exchangeParameters;
+    if (re->bExchangeParameters)
+    {
+        /* With parameter exchange the temperature coupling and integrator
+         * need to pick up a change of reference temperature immediately,
+         * which is not the case for the extended ensemble algorithms.
+         */
+        if (re->bNPT)
+        {
+            gmx_fatal(FARGS, "Replica exchange of parameters is not supported with pressure coupling");
+        }
+        if (bTemp)
+        {
+            if (!(ir->etc == etcNO || ir->etc == etcVRESCALE || ETC_ANDERSEN(ir->etc)))
+            {
+                gmx_fatal(FARGS, "Replica exchange of parameters is not supported with the %s thermostat", ETCOUPLTYPE(ir->etc));
+            }
+            for (i = 0; i < ir->opts.ngtc; i++)
+            {
+                if (ir->opts.annealing[i] != eannNO)
+                {
+                    gmx_fatal(FARGS, "Replica exchange of parameters is not supported with simulated annealing");
+                }
+            }
+        }
+        fprintf(fplog, "Repl  Exchanging the temperature and/or lambda state between the simulations instead of the states\n");
+
+        snew(re->simState, re->nrepl);
+        for (i = 0; i < re->nrepl; i++)
+        {
+            re->simState[i] = i;
+        }
+    }
     if (re->bNPT)
     {
         snew(re->pres, re->nrepl);
@@ -434,6 +473,7 @@ init_replica_exchange(FILE                            *fplog,
     {
         snew(re->de[i], re->nrepl);
     }
+    snew(re->sumbuf, re->nrepl*(2 + re->nrepl));
     re->nex = replExParams.numExchanges;
     return re;
 }
@@ -802,10 +842,14 @@ static realA calc_delta(FILE *fplog, gmx_bool bPrint, struct gmx_repl_ex *re, in
     return delta;
 }
 
+/* Determines the exchanges, myState is the replica index of the state
+ * of this simulation, which is re->repl unless we exchange parameters.
+ */
 static void
 test_for_replica_exchange(FILE                 *fplog,
                           const gmx_multisim_t *ms,
                           struct gmx_repl_ex   *re,
+                          int                   myState,
                           const gmx_enerdata_t *enerd,
                           realA                  vol,
                           gmx_int64_t           step,
@@ -834,7 +878,7 @@ test_for_replica_exchange(FILE                 *fplog,
             re->Vol[i] = 0;
         }
         bVol               = TRUE;
-        re->Vol[re->repl]  = vol;
+        re->Vol[myState]   = vol;
     }
     if ((re->type == ereTEMP || re->type == ereTL))
     {
@@ -843,7 +887,7 @@ test_for_replica_exchange(FILE                 *fplog,
             re->Epot[i] = 0;
         }
         bEpot              = TRUE;
-        re->Epot[re->repl] = enerd->term[F_EPOT];
+        re->Epot[myState]  = enerd->term[F_EPOT];
         /* temperatures of different states*/
         for (i = 0; i < re->nrepl; i++)
         {
@@ -872,24 +916,69 @@ test_for_replica_exchange(FILE                 *fplog,
         }
         for (i = 0; i < re->nrepl; i++)
         {
-            re->de[i][re->repl] = (enerd->enerpart_lambda[(int)re->q[ereLAMBDA][i]+1]-enerd->enerpart_lambda[0]);
+            re->de[i][myState] = (enerd->enerpart_lambda[(int)re->q[ereLAMBDA][i]+1]-enerd->enerpart_lambda[0]);
         }
     }
 
-    /* now actually do the communication */
-    if (bVol)
-    {
-        gmx_sum_sim(re->nrepl, re->Vol, ms);
-    }
-    if (bEpot)
-    {
-        gmx_sum_sim(re->nrepl, re->Epot, ms);
-    }
-    if (bDLambda)
+    /* now actually do the communication, using a single summation
+     * over the simulations for all quantities
+     */
+    if (bVol || bEpot || bDLambda)
     {
-        for (i = 0; i < re->nrepl; i++)
+        realA *buf = re->sumbuf;
+        int    n   = 0;
+
+        if (bVol)
+        {
+            for (i = 0; i < re->nrepl; i++)
+            {
+                buf[n++] = re->Vol[i];
+            }
+        }
+        if (bEpot)
+        {
+            for (i = 0; i < re->nrepl; i++)
+            {
+                buf[n++] = re->Epot[i];
+            }
+        }
+        if (bDLambda)
+        {
+            for (i = 0; i < re->nrepl; i++)
+            {
+                for (j = 0; j < re->nrepl; j++)
+                {
+                    buf[n++] = re->de[i][j];
+                }
+            }
+        }
+
+        gmx_sum_sim(n, buf, ms);
+
+        n = 0;
+        if (bVol)
+        {
+            for (i = 0; i < re->nrepl; i++)
+            {
+                re->Vol[i] = buf[n++];
+            }
+        }
+        if (bEpot)
+        {
+            for (i = 0; i < re->nrepl; i++)
+            {
+                re->Epot[i] = buf[n++];
+            }
+        }
+        if (bDLambda)
         {
-            gmx_sum_sim(re->nrepl, re->de[i], ms);
+            for (i = 0; i < re->nrepl; i++)
+            {
+                for (j = 0; j < re->nrepl; j++)
+                {
+                    re->de[i][j] = buf[n++];
+                }
+            }
         }
     }
 
@@ -986,7 +1075,7 @@ test_for_replica_exchange(FILE                 *fplog,
             a = re->ind[i-1];
             b = re->ind[i];
 
-            bPrint = (re->repl == a || re->repl == b);
+            bPrint = (myState == a || myState == b);
             if (i % 2 == m)
             {
                 delta = calc_delta(fplog, bPrint, re, a, b, a, b);
@@ -1228,7 +1317,7 @@ gmx_bool replica_exchange(FILE *fplog, const t_commrec *cr, struct gmx_repl_ex *
     if (MASTER(cr))
     {
         replica_id  = re->repl;
-        test_for_replica_exchange(fplog, cr->ms, re, enerd, det(state_local->box), step, time);
+        test_for_replica_exchange(fplog, cr->ms, re, re->repl, enerd, det(state_local->box), step, time);
         prepare_to_do_exchange(re, replica_id, &maxswap, &bThisReplicaExchanged);
     }
     /* Do intra-simulation broadcast so all processors belonging to
@@ -1296,6 +1385,92 @@ gmx_bool replica_exchange(FILE *fplog, const t_commrec *cr, struct gmx_repl_ex *
     return bThisReplicaExchanged;
 }
 
+gmx_bool replica_exchange_parameters(FILE *fplog, const t_commrec *cr, struct gmx_repl_ex *re,
+                                     t_inputrec *ir, gmx_update_t *upd,
+                                     const gmx_enerdata_t *enerd,
+                                     t_state *state_local, gmx_int64_t step, realA time)
+{
+    /* The values to pass on to the other ranks of our simulation:
+     * whether our parameters changed, the new lambda state (-1 when
+     * not exchanging lambda), the ratio of the new and old temperature
+     */
+    realA param[3] = { 0, -1, 1 };
+
+    if (MASTER(cr))
+    {
+        int  s;
+        int *newState = re->tmpswap;
+        int  oldState = re->simState[re->repl];
+
+        /* All masters get the same reduced energies and random numbers,
+         * so they all determine the same exchanges.
+         */
+        test_for_replica_exchange(fplog, cr->ms, re, oldState, enerd, det(state_local->box), step, time);
+
+        /* The configuration in state destinations[k] moves to state k,
+         * which means the simulation in state destinations[k] takes
+         * on the parameters of state k.
+         */
+        for (s = 0; s < re->nrepl; s++)
+        {
+            newState[re->destinations[s]] = s;
+        }
+        for (s = 0; s < re->nrepl; s++)
+        {
+            re->simState[s] = newState[re->simState[s]];
+        }
+
+        fprintf(fplog, "Repl st");
+        for (s = 0; s < re->nrepl; s++)
+        {
+            fprintf(fplog, " %2d", re->simState[s]);
+        }
+        fprintf(fplog, "\n");
+
+        int myState = re->simState[re->repl];
+        if (myState != oldState)
+        {
+            param[0] = 1;
+            if (re->type == ereLAMBDA || re->type == ereTL)
+            {
+                param[1] = re->q[ereLAMBDA][myState];
+            }
+            if (re->type == ereTEMP || re->type == ereTL)
+            {
+                param[2] = re->q[ereTEMP][myState]/re->q[ereTEMP][oldState];
+            }
+        }
+    }
+    if (DOMAINDECOMP(cr))
+    {
+        gmx_bcast(sizeof(param), param, cr);
+    }
+
+    if (param[0] == 0)
+    {
+        return FALSE;
+    }
+
+    if (param[1] >= 0)
+    {
+        /* The lambda values are set from fep_state at the next step */
+        state_local->fep_state = static_cast<int>(param[1]);
+    }
+    if (param[2] != 1)
+    {
+        for (int i = 0; i < ir->opts.ngtc; i++)
+        {
+            ir->opts.ref_t[i] *= param[2];
+        }
+        update_temperature_constants(upd, ir);
+
+        /* As with the exchange of states, scale the velocities to the new temperature */
+        scale_velocities(state_local, std::sqrt(param[2]));
+    }
+
+    return TRUE;
+}
+
 void print_replica_exchange_statistics(FILE *fplog, struct gmx_repl_ex *re)
 {
     int  i;
@@ -45,6 +45,7 @@
 
 struct gmx_enerdata_t;
 struct gmx_multisim_t;
+struct gmx_update_t;
 struct t_commrec;
 struct t_inputrec;
 class t_state;
@@ -55,13 +56,15 @@ struct ReplicaExchangeParameters
     ReplicaExchangeParameters() :
         exchangeInterval(0),
         numExchanges(0),
-        randomSeed(-1)
+        randomSeed(-1),
+        exchangeParameters(FALSE)
     {
     };
 
-    int exchangeInterval; /* Interval in steps at which to attempt exchanges, 0 means no replica exchange */
-    int numExchanges;     /* The number of exchanges to attempt at an exchange step */
-    int randomSeed;       /* The random seed, -1 means generate a seed */
+    int      exchangeInterval;   /* Interval in steps at which to attempt exchanges, 0 means no replica exchange */
+    int      numExchanges;       /* The number of exchanges to attempt at an exchange step */
+    int      randomSeed;         /* The random seed, -1 means generate a seed */
+    gmx_bool exchangeParameters; /* Swap the temperature and/or lambda state between the simulations instead of their states */
 };
 
 /* Abstract type for replica exchange */
@@ -89,6 +92,26 @@ gmx_bool replica_exchange(FILE *fplog,
  * in state and still needs to be redistributed over the ranks.
  */
 
+gmx_bool replica_exchange_parameters(FILE *fplog,
+                                     const t_commrec *cr,
+                                     gmx_repl_ex_t re,
+                                     t_inputrec *ir,
+                                     gmx_update_t *upd,
+                                     const gmx_enerdata_t *enerd,
+                                     t_state *state_local,
+                                     gmx_int64_t step, realA time);
+/* Attempts replica exchange with ReplicaExchangeParameters::exchangeParameters,
+ * should be called on all ranks.
+ * Instead of exchanging the states between the simulations, the simulations
+ * swap their ensemble parameters: the reference temperature, with velocity
+ * scaling, and/or the lambda state. Thus no coordinate data is communicated
+ * and the state does not need to be redistributed. The only communication
+ * is a single reduction of the energies over the master ranks, from which
+ * each master determines the same exchanges, and a broadcast of the new
+ * parameters within each simulation.
+ * Returns TRUE if the parameters of this simulation have changed.
+ */
+
 void print_replica_exchange_statistics(FILE *fplog, gmx_repl_ex_t re);
 /* Should only be called on the master ranks */
 
@@ -92,7 +92,8 @@ MultiSimTest::MultiSimTest() : size_(gmx_node_num()),
 }
 
 void MultiSimTest::organizeMdpFile(const char *controlVariable,
-                                   int         numSteps)
+                                   int         numSteps,
+                                   realA       temperatureStep)
 {
     const realA  baseTemperature = 298;
     const realA  basePressure    = 1;
@@ -114,7 +115,7 @@ void MultiSimTest::organizeMdpFile(const char *controlVariable,
                      // control variable specification
                      "%s\n",
                      numSteps,
-                     baseTemperature + 0.0001*rank_,
+                     baseTemperature + temperatureStep*rank_,
                      basePressure * std::pow(1.01, rank_),
                      /* Set things up so that the initial KE decreases with
                         increasing replica number, so that the (identical)
@@ -48,6 +48,8 @@
 
 #include <gtest/gtest.h>
 
+#include "gromacs/utility/real.h"
+
 #include "testutils/cmdlinetest.h"
 
 #include "moduletest.h"
@@ -86,9 +88,12 @@ class MultiSimTest : public gmx::test::ParameterizedMdrunTestFixture
          * string with "mdp-param = value" such that different paths
          * in init_replica_exchange() are followed.
          * \param numSteps        Number of MD steps to perform.
+         * \param temperatureStep Difference in reference temperature
+         * between consecutive replicas.
          */
         void organizeMdpFile(const char *controlVariable,
-                             int         numSteps = 2);
+                             int         numSteps = 2,
+                             realA       temperatureStep = 0.0001);
         //! Test that a basic simulation works
         void runExitsNormallyTest();
         //! Test that mdrun -maxh and restart works
@@ -44,10 +44,16 @@
 
 #include "config.h"
 
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "gromacs/utility/path.h"
 #include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textreader.h"
 
 #include "testutils/testfilemanager.h"
 
@@ -77,6 +83,124 @@ INSTANTIATE_TEST_CASE_P(DISABLED_WithDifferentControlVariables, ReplicaExchangeE
                             ::testing::Values("pcoupl = no", "pcoupl = Berendsen"));
 #endif
 
+/*! \internal
+ * \brief Test fixture for replica exchange of parameters
+ *
+ * Checks in the log file of each simulation that the assignment of
+ * states to simulations follows the accepted exchanges.
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+class ReplicaExchangeParametersEnsembleTest : public MultiSimTest
+{
+    public:
+        //! Checks the states and exchange statistics in the log of this rank
+        void checkLogFile()
+        {
+            std::string logFileName
+                = Path::concatenateBeforeExtension(runner_.logFileName_, formatString("%d", rank_));
+            std::istringstream log(TextReader::readFileToString(logFileName));
+
+            std::vector<int>   simState(size_);
+            std::iota(simState.begin(), simState.end(), 0);
+            std::vector<int>   expectedState(simState);
+            int                numExchanges           = 0;
+            int                numStateLines          = 0;
+            int                numExchangesReported   = -1;
+            bool               foundParameterExchange = false;
+            std::string        line;
+            while (std::getline(log, line))
+            {
+                std::vector<std::string> tokens = splitString(line);
+                if (tokens.size() < 2 || tokens[0] != "Repl")
+                {
+                    continue;
+                }
+                if (line.find("instead of the states") != std::string::npos)
+                {
+                    foundParameterExchange = true;
+                }
+                else if (tokens[1] == "ex")
+                {
+                    /* An x between two states means the simulations in
+                       those states have swapped their parameters */
+                    for (size_t i = 3; i + 1 < tokens.size(); i++)
+                    {
+                        if (tokens[i] == "x")
+                        {
+                            int a = std::stoi(tokens[i - 1]);
+                            int b = std::stoi(tokens[i + 1]);
+                            for (int &state : expectedState)
+                            {
+                                state = (state == a ? b : (state == b ? a : state));
+                            }
+                            numExchanges++;
+                        }
+                    }
+                }
+                else if (tokens[1] == "st")
+                {
+                    ASSERT_EQ(static_cast<size_t>(2 + size_), tokens.size()) << line;
+                    for (int sim = 0; sim < size_; sim++)
+                    {
+                        simState[sim] = std::stoi(tokens[2 + sim]);
+                    }
+                    EXPECT_EQ(expectedState, simState) << line;
+                    numStateLines++;
+                }
+                else if (tokens[1] == "number" && std::getline(log, line) && std::getline(log, line))
+                {
+                    /* The line after the replica indices lists the
+                       number of exchanges between neighbours */
+                    tokens               = splitString(line);
+                    numExchangesReported = 0;
+                    for (size_t i = 1; i < tokens.size(); i++)
+                    {
+                        numExchangesReported += std::stoi(tokens[i]);
+                    }
+                }
+            }
+            EXPECT_TRUE(foundParameterExchange);
+            EXPECT_GT(numStateLines, 1);
+            // The reference temperatures are close and the system is
+            // tiny, so nearly all exchange attempts are accepted
+            EXPECT_GT(numExchanges, 0);
+            EXPECT_EQ(numExchanges, numExchangesReported);
+        }
+};
+
+TEST_P(ReplicaExchangeParametersEnsembleTest, ExchangesParameters)
+{
+    if (size_ <= 1)
+    {
+        /* Can't test replica exchange without multiple ranks. */
+        return;
+    }
+
+    mdrunCaller_->addOption("-replex", 1);
+    mdrunCaller_->addOption("-replexpar");
+    /* Use a clear difference in temperature, so that the velocities
+       are rescaled by a non-trivial factor on exchange */
+    organizeMdpFile(GetParam(), 6, 2);
+    EXPECT_EQ(0, runner_.callGromppOnThisRank());
+
+    // mdrun names the files without the rank suffix
+    runner_.tprFileName_ = mdrunTprFileName_;
+    ASSERT_EQ(0, runner_.callMdrun(*mdrunCaller_));
+
+    checkLogFile();
+}
+
+/* Exchange of parameters does not support pressure coupling, so the
+   reference temperature is the only control variable. */
+#if GMX_LIB_MPI
+INSTANTIATE_TEST_CASE_P(WithDifferentControlVariables, ReplicaExchangeParametersEnsembleTest,
+                            ::testing::Values("pcoupl = no"));
+#else
+INSTANTIATE_TEST_CASE_P(DISABLED_WithDifferentControlVariables, ReplicaExchangeParametersEnsembleTest,
+                            ::testing::Values("pcoupl = no"));
+#endif
+
 //! Convenience typedef
 typedef MultiSimTest ReplicaExchangeTerminationTest;
 